@@ -0,0 +1,329 @@
+/**
+ * UFOMap: An Efficient Probabilistic 3D Mapping Framework That Embraces the Unknown
+ *
+ * @author D. Duberg, KTH Royal Institute of Technology, Copyright (c) 2020.
+ * @see https://github.com/UnknownFreeOccupied/ufomap
+ * License: BSD 3
+ *
+ */
+
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, D. Duberg, KTH Royal Institute of Technology
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef UFO_BENCHMARK_SCAN_GENERATOR_H
+#define UFO_BENCHMARK_SCAN_GENERATOR_H
+
+// UFO
+#include <ufo/map/point_cloud.h>
+
+// STD
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <random>
+#include <vector>
+
+namespace ufo::benchmark
+{
+using ufo::map::Point3;
+using ufo::map::PointCloud;
+
+/**
+ * @brief Procedural indoor/outdoor scene that rays can be cast against
+ *
+ * @details A ground plane inside a rectangular enclosure, with randomly placed boxes,
+ * spheres and vertical pillars. The same seed always gives the same scene.
+ */
+class Scene
+{
+ public:
+	Scene(std::uint32_t seed = 42, double half_extent = 25.0, double wall_height = 6.0,
+	      std::size_t num_boxes = 60, std::size_t num_spheres = 30,
+	      std::size_t num_pillars = 30)
+	    : half_extent_(half_extent), wall_height_(wall_height)
+	{
+		std::mt19937 gen(seed);
+		std::uniform_real_distribution<double> pos(-0.9 * half_extent, 0.9 * half_extent);
+		std::uniform_real_distribution<double> size(0.2, 1.5);
+
+		for (std::size_t i = 0; i != num_boxes; ++i) {
+			Point3 center(pos(gen), pos(gen), 0.0);
+			Point3 half_size(size(gen), size(gen), size(gen));
+			center.z() = half_size.z();
+			boxes_.push_back({center - half_size, center + half_size});
+		}
+		for (std::size_t i = 0; i != num_spheres; ++i) {
+			double radius = size(gen);
+			spheres_.push_back({Point3(pos(gen), pos(gen), radius + size(gen)), radius});
+		}
+		for (std::size_t i = 0; i != num_pillars; ++i) {
+			pillars_.push_back({pos(gen), pos(gen), 0.5 * size(gen), 4 * size(gen)});
+		}
+	}
+
+	double getHalfExtent() const noexcept { return half_extent_; }
+
+	/**
+	 * @brief Distance along the normalized direction to the first surface hit
+	 */
+	std::optional<double> castRay(Point3 const& origin, Point3 const& direction,
+	                              double max_range) const
+	{
+		double t = max_range;
+		auto hit = [&t](double candidate) {
+			if (0.0 < candidate && candidate < t) {
+				t = candidate;
+			}
+		};
+
+		// Ground and ceiling
+		if (0.0 != direction.z()) {
+			hit(-origin.z() / direction.z());
+			hit((wall_height_ - origin.z()) / direction.z());
+		}
+		// Walls, seen from the inside
+		for (int i : {0, 1}) {
+			if (0.0 != direction[i]) {
+				double wall = 0.0 < direction[i] ? half_extent_ : -half_extent_;
+				hit((wall - origin[i]) / direction[i]);
+			}
+		}
+		for (Box const& box : boxes_) {
+			hit(intersect(box, origin, direction));
+		}
+		for (Sphere const& sphere : spheres_) {
+			hit(intersect(sphere, origin, direction));
+		}
+		for (Pillar const& pillar : pillars_) {
+			hit(intersect(pillar, origin, direction));
+		}
+
+		return t < max_range ? std::optional<double>(t) : std::nullopt;
+	}
+
+ private:
+	struct Box {
+		Point3 min;
+		Point3 max;
+	};
+
+	struct Sphere {
+		Point3 center;
+		double radius;
+	};
+
+	// Vertical cylinder standing on the ground
+	struct Pillar {
+		double x;
+		double y;
+		double radius;
+		double height;
+	};
+
+	static constexpr double NO_HIT = -1.0;
+
+	static double intersect(Box const& box, Point3 const& origin, Point3 const& direction)
+	{
+		double t_min = 0.0;
+		double t_max = std::numeric_limits<double>::max();
+		for (int i : {0, 1, 2}) {
+			double inv = 1.0 / direction[i];
+			double t_0 = (box.min[i] - origin[i]) * inv;
+			double t_1 = (box.max[i] - origin[i]) * inv;
+			if (t_0 > t_1) {
+				std::swap(t_0, t_1);
+			}
+			t_min = std::max(t_min, t_0);
+			t_max = std::min(t_max, t_1);
+			if (t_min > t_max) {
+				return NO_HIT;
+			}
+		}
+		return t_min;
+	}
+
+	static double intersect(Sphere const& sphere, Point3 const& origin,
+	                        Point3 const& direction)
+	{
+		Point3 oc = origin - sphere.center;
+		double b = oc.dot(direction);
+		double c = oc.dot(oc) - sphere.radius * sphere.radius;
+		double discriminant = b * b - c;
+		return 0.0 > discriminant ? NO_HIT : -b - std::sqrt(discriminant);
+	}
+
+	static double intersect(Pillar const& pillar, Point3 const& origin,
+	                        Point3 const& direction)
+	{
+		double ox = origin.x() - pillar.x;
+		double oy = origin.y() - pillar.y;
+		double a = direction.x() * direction.x() + direction.y() * direction.y();
+		if (0.0 == a) {
+			return NO_HIT;
+		}
+		double b = ox * direction.x() + oy * direction.y();
+		double c = ox * ox + oy * oy - pillar.radius * pillar.radius;
+		double discriminant = b * b - a * c;
+		if (0.0 > discriminant) {
+			return NO_HIT;
+		}
+		double t = (-b - std::sqrt(discriminant)) / a;
+		double z = origin.z() + t * direction.z();
+		return 0.0 <= z && z <= pillar.height ? t : NO_HIT;
+	}
+
+ private:
+	double half_extent_;
+	double wall_height_;
+	std::vector<Box> boxes_;
+	std::vector<Sphere> spheres_;
+	std::vector<Pillar> pillars_;
+};
+
+/**
+ * @brief Sensor pose, the sensor looks along +x rotated by yaw around z
+ */
+struct SensorPose {
+	Point3 position;
+	double yaw;
+};
+
+/**
+ * @brief Poses on a circle through the scene, looking along the direction of travel
+ */
+inline std::vector<SensorPose> circularTrajectory(Scene const& scene,
+                                                  std::size_t num_poses,
+                                                  double height = 1.5)
+{
+	std::vector<SensorPose> poses;
+	double radius = 0.5 * scene.getHalfExtent();
+	for (std::size_t i = 0; i != num_poses; ++i) {
+		double angle = (2.0 * M_PI * i) / num_poses;
+		poses.push_back({Point3(radius * std::cos(angle), radius * std::sin(angle), height),
+		                 angle + M_PI / 2.0});
+	}
+	return poses;
+}
+
+/**
+ * @brief Rotating multi-beam LiDAR, beams spread evenly over the vertical field of view
+ */
+struct LidarModel {
+	std::size_t beams = 32;
+	std::size_t points_per_beam = 1024;  // Per revolution
+	double vertical_fov_min = -M_PI / 12.0;
+	double vertical_fov_max = M_PI / 12.0;
+	double max_range = 30.0;
+	double range_noise = 0.02;  // Standard deviation in meters
+};
+
+/**
+ * @brief Pinhole depth camera
+ */
+struct DepthCameraModel {
+	std::size_t width = 320;
+	std::size_t height = 240;
+	double horizontal_fov = M_PI / 2.0;
+	double max_range = 8.0;
+	double range_noise = 0.01;  // Standard deviation in meters
+};
+
+/**
+ * @brief Generates scans of a scene, the points are in the world frame and rays that do
+ * not hit anything within range give no point
+ */
+class ScanGenerator
+{
+ public:
+	ScanGenerator(Scene const& scene, std::uint32_t seed = 42) : scene_(scene), gen_(seed)
+	{
+	}
+
+	PointCloud scan(SensorPose const& pose, LidarModel const& lidar)
+	{
+		PointCloud cloud;
+		cloud.reserve(lidar.beams * lidar.points_per_beam);
+		for (std::size_t beam = 0; beam != lidar.beams; ++beam) {
+			double pitch =
+			    lidar.vertical_fov_min + (lidar.vertical_fov_max - lidar.vertical_fov_min) *
+			                                 beam / std::max<std::size_t>(1, lidar.beams - 1);
+			for (std::size_t i = 0; i != lidar.points_per_beam; ++i) {
+				double yaw = pose.yaw + (2.0 * M_PI * i) / lidar.points_per_beam;
+				Point3 direction(std::cos(pitch) * std::cos(yaw),
+				                 std::cos(pitch) * std::sin(yaw), std::sin(pitch));
+				addPoint(cloud, pose.position, direction, lidar.max_range, lidar.range_noise);
+			}
+		}
+		return cloud;
+	}
+
+	PointCloud scan(SensorPose const& pose, DepthCameraModel const& camera)
+	{
+		PointCloud cloud;
+		cloud.reserve(camera.width * camera.height);
+		double focal = (camera.width / 2.0) / std::tan(camera.horizontal_fov / 2.0);
+		double cos_yaw = std::cos(pose.yaw);
+		double sin_yaw = std::sin(pose.yaw);
+		for (std::size_t v = 0; v != camera.height; ++v) {
+			for (std::size_t u = 0; u != camera.width; ++u) {
+				// Camera frame: x forward, y left, z up
+				Point3 ray(focal, (camera.width / 2.0) - u, (camera.height / 2.0) - v);
+				ray.normalize();
+				Point3 direction(cos_yaw * ray.x() - sin_yaw * ray.y(),
+				                 sin_yaw * ray.x() + cos_yaw * ray.y(), ray.z());
+				// The depth is measured along the optical axis, not along the ray
+				double max_range = camera.max_range / ray.x();
+				addPoint(cloud, pose.position, direction, max_range, camera.range_noise);
+			}
+		}
+		return cloud;
+	}
+
+ private:
+	void addPoint(PointCloud& cloud, Point3 const& origin, Point3 const& direction,
+	              double max_range, double range_noise)
+	{
+		if (std::optional<double> range = scene_.castRay(origin, direction, max_range)) {
+			std::normal_distribution<double> noise(0.0, range_noise);
+			cloud.push_back(origin + direction * std::max(0.0, *range + noise(gen_)));
+		}
+	}
+
+ private:
+	Scene const& scene_;
+	std::mt19937 gen_;
+};
+}  // namespace ufo::benchmark
+
+#endif  // UFO_BENCHMARK_SCAN_GENERATOR_H
@@ -0,0 +1,454 @@
+/**
+ * UFOMap: An Efficient Probabilistic 3D Mapping Framework That Embraces the Unknown
+ *
+ * @author D. Duberg, KTH Royal Institute of Technology, Copyright (c) 2020.
+ * @see https://github.com/UnknownFreeOccupied/ufomap
+ * License: BSD 3
+ *
+ */
+
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, D. Duberg, KTH Royal Institute of Technology
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// UFO
+#include <ufo/map/occupancy_map.h>
+#include <ufo/map/occupancy_map_mapped.h>
+
+#include "scan_generator.h"
+
+// STD
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ufo::benchmark;
+using ufo::map::OccupancyMap;
+using ufo::map::OccupancyMapMapped;
+using ufo::map::TraversePredicate;
+
+/**
+ * @brief Usage: ufomap_bench [--output results.json] [--filter name] [--scans N]
+ * [--resolution R] [--depth-levels D] [--threads T] [--seed S]
+ *
+ * Every benchmark reports its throughput, the latency percentiles of its iterations and
+ * the peak resident memory of the process. The results are written as JSON so runs can
+ * be diffed.
+ */
+
+struct Settings {
+	std::string output;
+	std::string filter;
+	std::size_t scans = 20;
+	double resolution = 0.1;
+	ufo::map::DepthType depth_levels = 16;
+	unsigned int threads = 0;
+	std::uint32_t seed = 42;
+};
+
+struct Result {
+	std::string name;
+	std::string unit;  // What the throughput counts, e.g. points or nodes
+	std::size_t items = 0;
+	std::size_t bytes = 0;
+	std::vector<double> latencies;  // Seconds per iteration
+	std::size_t peak_memory = 0;    // Bytes
+	std::size_t map_memory = 0;     // Bytes reserved by the map after the benchmark
+};
+
+static double percentile(std::vector<double> sorted, double p)
+{
+	if (sorted.empty()) {
+		return 0.0;
+	}
+	std::sort(std::begin(sorted), std::end(sorted));
+	std::size_t idx = static_cast<std::size_t>(p * (sorted.size() - 1) + 0.5);
+	return sorted[idx];
+}
+
+static std::size_t peakMemory()
+{
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return static_cast<std::size_t>(usage.ru_maxrss) * 1024;  // Kilobytes on Linux
+}
+
+class Runner
+{
+ public:
+	explicit Runner(Settings const& settings) : settings_(settings) {}
+
+	/**
+	 * @brief Run fun once per iteration, fun returns the number of items processed
+	 */
+	void run(std::string const& name, std::string const& unit, std::size_t iterations,
+	         std::function<std::size_t(std::size_t)> fun,
+	         std::function<std::size_t()> bytes = {},
+	         OccupancyMap const* map = nullptr)
+	{
+		if (!settings_.filter.empty() && std::string::npos == name.find(settings_.filter)) {
+			return;
+		}
+
+		Result result;
+		result.name = name;
+		result.unit = unit;
+		for (std::size_t i = 0; i != iterations; ++i) {
+			auto start = std::chrono::steady_clock::now();
+			result.items += fun(i);
+			auto stop = std::chrono::steady_clock::now();
+			result.latencies.push_back(std::chrono::duration<double>(stop - start).count());
+		}
+		if (bytes) {
+			result.bytes = bytes();
+		}
+		result.peak_memory = peakMemory();
+		result.map_memory = map ? map->memoryReserved() : 0;
+
+		print(result);
+		results_.push_back(std::move(result));
+	}
+
+	void write() const
+	{
+		if (settings_.output.empty()) {
+			return;
+		}
+		std::ofstream file(settings_.output);
+		file << std::setprecision(9) << "{\n"
+		     << "  \"settings\": {\"scans\": " << settings_.scans
+		     << ", \"resolution\": " << settings_.resolution
+		     << ", \"depth_levels\": " << settings_.depth_levels
+		     << ", \"threads\": " << settings_.threads << ", \"seed\": " << settings_.seed
+		     << "},\n  \"results\": [";
+		for (std::size_t i = 0; i != results_.size(); ++i) {
+			Result const& r = results_[i];
+			double total = totalTime(r);
+			file << (0 == i ? "\n" : ",\n") << "    {\"name\": \"" << r.name
+			     << "\", \"unit\": \"" << r.unit << "\", \"iterations\": " << r.latencies.size()
+			     << ", \"items\": " << r.items << ", \"seconds\": " << total
+			     << ", \"items_per_second\": " << (0 < total ? r.items / total : 0.0)
+			     << ", \"bytes\": " << r.bytes
+			     << ", \"megabytes_per_second\": " << (0 < total ? r.bytes / total / 1e6 : 0.0)
+			     << ", \"latency_p50\": " << percentile(r.latencies, 0.5)
+			     << ", \"latency_p90\": " << percentile(r.latencies, 0.9)
+			     << ", \"latency_p99\": " << percentile(r.latencies, 0.99)
+			     << ", \"latency_max\": " << percentile(r.latencies, 1.0)
+			     << ", \"peak_memory\": " << r.peak_memory
+			     << ", \"map_memory\": " << r.map_memory << "}";
+		}
+		file << "\n  ]\n}\n";
+	}
+
+ private:
+	static double totalTime(Result const& result)
+	{
+		double total = 0.0;
+		for (double latency : result.latencies) {
+			total += latency;
+		}
+		return total;
+	}
+
+	static void print(Result const& r)
+	{
+		double total = totalTime(r);
+		std::cout << std::left << std::setw(28) << r.name << std::right << std::fixed
+		          << std::setprecision(0) << std::setw(14)
+		          << (0 < total ? r.items / total : 0.0) << " " << std::left << std::setw(8)
+		          << (r.unit + "/s") << std::right;
+		if (0 < r.bytes) {
+			std::cout << std::setprecision(1) << std::setw(9) << (r.bytes / total / 1e6)
+			          << " MB/s";
+		} else {
+			std::cout << std::setw(14) << "";
+		}
+		std::cout << std::setprecision(3) << "  p50 " << 1e3 * percentile(r.latencies, 0.5)
+		          << " ms  p99 " << 1e3 * percentile(r.latencies, 0.99) << " ms  peak "
+		          << std::setprecision(1) << r.peak_memory / 1e6 << " MB" << std::endl;
+	}
+
+ private:
+	Settings settings_;
+	std::vector<Result> results_;
+};
+
+static Settings parse(int argc, char* argv[])
+{
+	Settings settings;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		char const* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value) {
+			std::cerr << "Missing value for " << arg << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		if ("--output" == arg) {
+			settings.output = value;
+		} else if ("--filter" == arg) {
+			settings.filter = value;
+		} else if ("--scans" == arg) {
+			settings.scans = std::stoul(value);
+		} else if ("--resolution" == arg) {
+			settings.resolution = std::stod(value);
+		} else if ("--depth-levels" == arg) {
+			settings.depth_levels = std::stoul(value);
+		} else if ("--threads" == arg) {
+			settings.threads = std::stoul(value);
+		} else if ("--seed" == arg) {
+			settings.seed = std::stoul(value);
+		} else {
+			std::cerr << "Unknown argument " << arg << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		++i;
+	}
+	return settings;
+}
+
+int main(int argc, char* argv[])
+{
+	Settings settings = parse(argc, argv);
+	Runner runner(settings);
+
+	Scene scene(settings.seed);
+	ScanGenerator generator(scene, settings.seed);
+	std::vector<SensorPose> poses = circularTrajectory(scene, settings.scans);
+
+	LidarModel lidar;
+	DepthCameraModel camera;
+	std::vector<PointCloud> lidar_scans;
+	std::vector<PointCloud> camera_scans;
+	for (SensorPose const& pose : poses) {
+		lidar_scans.push_back(generator.scan(pose, lidar));
+		camera_scans.push_back(generator.scan(pose, camera));
+	}
+
+	auto makeMap = [&settings]() {
+		OccupancyMap map(settings.resolution, settings.depth_levels);
+		map.setIntegrationThreads(settings.threads);
+		return map;
+	};
+
+	//
+	// Integration
+	//
+
+	OccupancyMap map = makeMap();
+	runner.run(
+	    "insert_lidar", "points", poses.size(),
+	    [&](std::size_t i) {
+		    map.insertPointCloud(poses[i].position, lidar_scans[i], lidar.max_range);
+		    return lidar_scans[i].size();
+	    },
+	    {}, &map);
+
+	{
+		OccupancyMap camera_map = makeMap();
+		runner.run(
+		    "insert_camera", "points", poses.size(),
+		    [&](std::size_t i) {
+			    camera_map.insertPointCloud(poses[i].position, camera_scans[i],
+			                                camera.max_range);
+			    return camera_scans[i].size();
+		    },
+		    {}, &camera_map);
+	}
+
+	{
+		OccupancyMap discrete_map = makeMap();
+		runner.run(
+		    "insert_discrete_lidar", "points", poses.size(),
+		    [&](std::size_t i) {
+			    discrete_map.insertPointCloudDiscrete(poses[i].position, lidar_scans[i],
+			                                          lidar.max_range);
+			    return lidar_scans[i].size();
+		    },
+		    {}, &discrete_map);
+	}
+
+	//
+	// Iterators and traverse, on the map built from the LiDAR scans
+	//
+
+	runner.run("iterate_leaves", "nodes", 10, [&](std::size_t) {
+		std::size_t n = 0;
+		for (auto it = map.beginLeaves(true, true, false), end = map.endLeaves(); it != end;
+		     ++it) {
+			++n;
+		}
+		return n;
+	});
+
+	runner.run("iterate_tree", "nodes", 10, [&](std::size_t) {
+		std::size_t n = 0;
+		for (auto it = map.beginTree(true, true, false), end = map.endTree(); it != end;
+		     ++it) {
+			++n;
+		}
+		return n;
+	});
+
+	runner.run("traverse_leaves", "nodes", 10, [&](std::size_t) {
+		std::size_t n = 0;
+		map.traverse(TraversePredicate<true, true, false>{},
+		             [&n](auto const&) { ++n; });
+		return n;
+	});
+
+	runner.run("traverse_tree", "nodes", 10, [&](std::size_t) {
+		std::size_t n = 0;
+		map.traverse(TraversePredicate<true, true, false, false>{},
+		             [&n](auto const&) { ++n; });
+		return n;
+	});
+
+	{
+		std::mt19937 gen(settings.seed);
+		std::uniform_real_distribution<double> pos(-scene.getHalfExtent(),
+		                                           scene.getHalfExtent());
+		runner.run("nearest_occupied_10", "queries", 1000, [&](std::size_t) {
+			std::size_t n = 0;
+			for (auto it = map.beginNNLeaves(Point3(pos(gen), pos(gen), 1.0), true, false,
+			                                 false),
+			          end = map.endNNLeaves();
+			     it != end && 10 > n; ++it) {
+				++n;
+			}
+			return std::size_t(1);
+		});
+	}
+
+	//
+	// Input/output
+	//
+
+	for (bool compress : {false, true}) {
+		std::string suffix = compress ? "_lz4" : "";
+		std::size_t size = 0;
+		runner.run(
+		    "write" + suffix, "maps", 10,
+		    [&](std::size_t) {
+			    std::stringstream s(std::ios_base::in | std::ios_base::out |
+			                        std::ios_base::binary);
+			    map.write(s, compress);
+			    size = s.str().size();
+			    return std::size_t(1);
+		    },
+		    [&]() { return 10 * size; });
+
+		std::stringstream data(std::ios_base::in | std::ios_base::out |
+		                       std::ios_base::binary);
+		map.write(data, compress);
+		std::string const buffer = data.str();
+		OccupancyMap read_map = makeMap();
+		runner.run(
+		    "read" + suffix, "maps", 10,
+		    [&](std::size_t) {
+			    std::stringstream s(buffer, std::ios_base::in | std::ios_base::binary);
+			    read_map.read(s);
+			    return std::size_t(1);
+		    },
+		    [&]() { return 10 * buffer.size(); });
+
+		// The subtree index is opt-in, with it the subtrees are read in parallel
+		std::stringstream indexed_data(std::ios_base::in | std::ios_base::out |
+		                               std::ios_base::binary);
+		map.enableFileIndex(true);
+		map.write(indexed_data, compress);
+		map.enableFileIndex(false);
+		std::string const indexed_buffer = indexed_data.str();
+		runner.run(
+		    "read_indexed" + suffix, "maps", 10,
+		    [&](std::size_t) {
+			    std::stringstream s(indexed_buffer, std::ios_base::in | std::ios_base::binary);
+			    read_map.read(s);
+			    return std::size_t(1);
+		    },
+		    [&]() { return 10 * indexed_buffer.size(); });
+	}
+
+	//
+	// Memory-mapped format, opening includes paging in what the queries touch
+	//
+
+	{
+		std::string const filename =
+		    (std::filesystem::temp_directory_path() / "ufomap_bench.umm").string();
+		OccupancyMapMapped::write(map, filename);
+		std::mt19937 gen(settings.seed);
+		std::uniform_real_distribution<double> pos(-scene.getHalfExtent(),
+		                                           scene.getHalfExtent());
+		runner.run("open_mapped_query_1000", "queries", 10, [&](std::size_t) {
+			OccupancyMapMapped mapped(filename);
+			std::size_t n = 0;
+			for (; 1000 != n; ++n) {
+				mapped.getState(Point3(pos(gen), pos(gen), 1.0));
+			}
+			return n;
+		});
+		std::filesystem::remove(filename);
+	}
+
+	//
+	// Set value volume
+	//
+
+	{
+		std::mt19937 gen(settings.seed);
+		std::uniform_real_distribution<double> pos(-scene.getHalfExtent(),
+		                                           scene.getHalfExtent());
+		std::uniform_real_distribution<double> radius(0.5, 2.0);
+		runner.run(
+		    "set_value_volume_sphere", "volumes", 100,
+		    [&](std::size_t) {
+			    map.setValueVolume(
+			        ufo::geometry::Sphere(Point3(pos(gen), pos(gen), 1.5), radius(gen)), 0.2);
+			    return std::size_t(1);
+		    },
+		    {}, &map);
+	}
+
+	runner.write();
+	return EXIT_SUCCESS;
+}
@@ -54,6 +54,8 @@ struct AABB {
 
 	AABB(AABB const& aabb) : center(aabb.center), half_size(aabb.half_size) {}
 
+	AABB& operator=(AABB const& rhs) = default;
+
 	AABB(Point const& center, double half_size)
 	    : center(center), half_size(half_size, half_size, half_size)
 	{
@@ -60,6 +60,12 @@ class BoundingVolume
 
 	bool intersects(BoundingVolume const& other) const;
 
+	/**
+	 * @brief Which children of the node at center intersect any of the bounding volumes
+	 * and which are completely inside one of them
+	 */
+	ChildrenMask intersectsChildren(Point const& center, double child_half_size) const;
+
 	std::vector<BoundingVar>::iterator begin() { return bounding_volume_.begin(); }
 
 	std::vector<BoundingVar>::const_iterator begin() const
@@ -43,14 +43,20 @@
 #define UFO_GEOMETRY_COLLISION_CHECKS_H
 
 #include <ufo/geometry/aabb.h>
-#include <ufo/geometry/bounding_volume.h>
-// #include <ufo/geometry/capsule.h>
+#include <ufo/geometry/capsule.h>
+#include <ufo/geometry/cone.h>
+#include <ufo/geometry/cylinder.h>
+#include <ufo/geometry/ellipsoid.h>
 #include <ufo/geometry/frustum.h>
 #include <ufo/geometry/line_segment.h>
 #include <ufo/geometry/obb.h>
 #include <ufo/geometry/plane.h>
 #include <ufo/geometry/ray.h>
 #include <ufo/geometry/sphere.h>
+#include <ufo/geometry/triangle.h>
+#include <ufo/geometry/types.h>
+
+#include <cstdint>
 
 namespace ufo::geometry {
 /////////////////////////////////////////////////////////////////////////////////////////
@@ -60,7 +66,10 @@ namespace ufo::geometry {
 
 // AABB
 bool intersects(const AABB& aabb_1, const AABB& aabb_2);
-// bool intersects(const AABB& aabb, const Capsule& capsule);
+bool intersects(const AABB& aabb, const Capsule& capsule);
+bool intersects(const AABB& aabb, const Cone& cone);
+bool intersects(const AABB& aabb, const Cylinder& cylinder);
+bool intersects(const AABB& aabb, const Ellipsoid& ellipsoid);
 bool intersects(const AABB& aabb, const Frustum& frustum);
 bool intersects(const AABB& aabb, const LineSegment& line_segment);
 bool intersects(const AABB& aabb, const OBB& obb);
@@ -68,27 +77,74 @@ bool intersects(const AABB& aabb, const Plane& plane);
 bool intersects(const AABB& aabb, const Point& point);
 bool intersects(const AABB& aabb, const Ray& ray);
 bool intersects(const AABB& aabb, const Sphere& sphere);
-
-// TODO: Capsule
-// bool intersects(const Capsule& capsule, const AABB& aabb);
-// bool intersects(const Capsule& capsule_1, const Capsule& capsule_2);
-// bool intersects(const Capsule& capsule, const Frustum& frustum);
-// bool intersects(const Capsule& capsule, const LineSegment& line_segment);
-// bool intersects(const Capsule& capsule, const OBB& obb);
-// bool intersects(const Capsule& capsule, const Plane& plane);
-// bool intersects(const Capsule& capsule, const Point& point);
-// bool intersects(const Capsule& capsule, const Ray& ray);
-// bool intersects(const Capsule& capsule, const Sphere& sphere);
-
-// TODO: Cone
-
-// TODO: Cylinder
-
-// TODO: Ellipsoid
+bool intersects(const AABB& aabb, const Triangle& triangle);
+
+// Capsule
+bool intersects(const Capsule& capsule, const AABB& aabb);
+bool intersects(const Capsule& capsule_1, const Capsule& capsule_2);
+bool intersects(const Capsule& capsule, const Cone& cone);
+bool intersects(const Capsule& capsule, const Cylinder& cylinder);
+bool intersects(const Capsule& capsule, const Ellipsoid& ellipsoid);
+bool intersects(const Capsule& capsule, const Frustum& frustum);
+bool intersects(const Capsule& capsule, const LineSegment& line_segment);
+bool intersects(const Capsule& capsule, const OBB& obb);
+bool intersects(const Capsule& capsule, const Plane& plane);
+bool intersects(const Capsule& capsule, const Point& point);
+bool intersects(const Capsule& capsule, const Ray& ray);
+bool intersects(const Capsule& capsule, const Sphere& sphere);
+bool intersects(const Capsule& capsule, const Triangle& triangle);
+
+// Cone
+bool intersects(const Cone& cone, const AABB& aabb);
+bool intersects(const Cone& cone, const Capsule& capsule);
+bool intersects(const Cone& cone_1, const Cone& cone_2);
+bool intersects(const Cone& cone, const Cylinder& cylinder);
+bool intersects(const Cone& cone, const Ellipsoid& ellipsoid);
+bool intersects(const Cone& cone, const Frustum& frustum);
+bool intersects(const Cone& cone, const LineSegment& line_segment);
+bool intersects(const Cone& cone, const OBB& obb);
+bool intersects(const Cone& cone, const Plane& plane);
+bool intersects(const Cone& cone, const Point& point);
+bool intersects(const Cone& cone, const Ray& ray);
+bool intersects(const Cone& cone, const Sphere& sphere);
+bool intersects(const Cone& cone, const Triangle& triangle);
+
+// Cylinder
+bool intersects(const Cylinder& cylinder, const AABB& aabb);
+bool intersects(const Cylinder& cylinder, const Capsule& capsule);
+bool intersects(const Cylinder& cylinder, const Cone& cone);
+bool intersects(const Cylinder& cylinder_1, const Cylinder& cylinder_2);
+bool intersects(const Cylinder& cylinder, const Ellipsoid& ellipsoid);
+bool intersects(const Cylinder& cylinder, const Frustum& frustum);
+bool intersects(const Cylinder& cylinder, const LineSegment& line_segment);
+bool intersects(const Cylinder& cylinder, const OBB& obb);
+bool intersects(const Cylinder& cylinder, const Plane& plane);
+bool intersects(const Cylinder& cylinder, const Point& point);
+bool intersects(const Cylinder& cylinder, const Ray& ray);
+bool intersects(const Cylinder& cylinder, const Sphere& sphere);
+bool intersects(const Cylinder& cylinder, const Triangle& triangle);
+
+// Ellipsoid
+bool intersects(const Ellipsoid& ellipsoid, const AABB& aabb);
+bool intersects(const Ellipsoid& ellipsoid, const Capsule& capsule);
+bool intersects(const Ellipsoid& ellipsoid, const Cone& cone);
+bool intersects(const Ellipsoid& ellipsoid, const Cylinder& cylinder);
+bool intersects(const Ellipsoid& ellipsoid_1, const Ellipsoid& ellipsoid_2);
+bool intersects(const Ellipsoid& ellipsoid, const Frustum& frustum);
+bool intersects(const Ellipsoid& ellipsoid, const LineSegment& line_segment);
+bool intersects(const Ellipsoid& ellipsoid, const OBB& obb);
+bool intersects(const Ellipsoid& ellipsoid, const Plane& plane);
+bool intersects(const Ellipsoid& ellipsoid, const Point& point);
+bool intersects(const Ellipsoid& ellipsoid, const Ray& ray);
+bool intersects(const Ellipsoid& ellipsoid, const Sphere& sphere);
+bool intersects(const Ellipsoid& ellipsoid, const Triangle& triangle);
 
 // Frustum
 bool intersects(const Frustum& frustum, const AABB& aabb);
-// bool intersects(const Frustum& frustum, const Capsule& capsule);
+bool intersects(const Frustum& frustum, const Capsule& capsule);
+bool intersects(const Frustum& frustum, const Cone& cone);
+bool intersects(const Frustum& frustum, const Cylinder& cylinder);
+bool intersects(const Frustum& frustum, const Ellipsoid& ellipsoid);
 bool intersects(const Frustum& frustum_1, const Frustum& frustum_2);
 bool intersects(const Frustum& frustum, const LineSegment& line_segment);
 bool intersects(const Frustum& frustum, const OBB& obb);
@@ -96,10 +152,14 @@ bool intersects(const Frustum& frustum, const Plane& plane);
 bool intersects(const Frustum& frustum, const Point& point);
 bool intersects(const Frustum& frustum, const Ray& ray);
 bool intersects(const Frustum& frustum, const Sphere& sphere);
+bool intersects(const Frustum& frustum, const Triangle& triangle);
 
 // Line segment
 bool intersects(const LineSegment& line_segment, const AABB& aabb);
-// bool intersects(const LineSegment& line_segment, const Capsule& capsule);
+bool intersects(const LineSegment& line_segment, const Capsule& capsule);
+bool intersects(const LineSegment& line_segment, const Cone& cone);
+bool intersects(const LineSegment& line_segment, const Cylinder& cylinder);
+bool intersects(const LineSegment& line_segment, const Ellipsoid& ellipsoid);
 bool intersects(const LineSegment& line_segment, const Frustum& frustum);
 bool intersects(const LineSegment& line_segment_1,
                 const LineSegment& line_segment_2);
@@ -108,10 +168,14 @@ bool intersects(const LineSegment& line_segment, const Plane& plane);
 bool intersects(const LineSegment& line_segment, const Point& point);
 bool intersects(const LineSegment& line_segment, const Ray& ray);
 bool intersects(const LineSegment& line_segment, const Sphere& sphere);
+bool intersects(const LineSegment& line_segment, const Triangle& triangle);
 
 // OBB
 bool intersects(const OBB& obb, const AABB& aabb);
-// bool intersects(const OBB& obb, const Capsule& capsule);
+bool intersects(const OBB& obb, const Capsule& capsule);
+bool intersects(const OBB& obb, const Cone& cone);
+bool intersects(const OBB& obb, const Cylinder& cylinder);
+bool intersects(const OBB& obb, const Ellipsoid& ellipsoid);
 bool intersects(const OBB& obb, const Frustum& frustum);
 bool intersects(const OBB& obb, const LineSegment& line_segment);
 bool intersects(const OBB& obb_1, const OBB& obb_2);
@@ -119,10 +183,14 @@ bool intersects(const OBB& obb, const Plane& plane);
 bool intersects(const OBB& obb, const Point& point);
 bool intersects(const OBB& obb, const Ray& ray);
 bool intersects(const OBB& obb, const Sphere& sphere);
+bool intersects(const OBB& obb, const Triangle& triangle);
 
 // Plane
 bool intersects(const Plane& plane, const AABB& aabb);
-// bool intersects(const Plane& plane, const Capsule& capsule);
+bool intersects(const Plane& plane, const Capsule& capsule);
+bool intersects(const Plane& plane, const Cone& cone);
+bool intersects(const Plane& plane, const Cylinder& cylinder);
+bool intersects(const Plane& plane, const Ellipsoid& ellipsoid);
 bool intersects(const Plane& plane, const Frustum& frustum);
 bool intersects(const Plane& plane, const LineSegment& line_segment);
 bool intersects(const Plane& plane, const OBB& obb);
@@ -130,10 +198,14 @@ bool intersects(const Plane& plane_1, const Plane& plane_2);
 bool intersects(const Plane& plane, const Point& point);
 bool intersects(const Plane& plane, const Ray& ray);
 bool intersects(const Plane& plane, const Sphere& sphere);
+bool intersects(const Plane& plane, const Triangle& triangle);
 
 // Point
 bool intersects(const Point& point, const AABB& aabb);
-// bool intersects(const Point& point, const Capsule& capsule);
+bool intersects(const Point& point, const Capsule& capsule);
+bool intersects(const Point& point, const Cone& cone);
+bool intersects(const Point& point, const Cylinder& cylinder);
+bool intersects(const Point& point, const Ellipsoid& ellipsoid);
 bool intersects(const Point& point, const Frustum& frustum);
 bool intersects(const Point& point, const LineSegment& line_segment);
 bool intersects(const Point& point, const OBB& obb);
@@ -141,10 +213,14 @@ bool intersects(const Point& point, const Plane& plane);
 bool intersects(const Point& point_1, const Point& point_2);
 bool intersects(const Point& point, const Ray& ray);
 bool intersects(const Point& point, const Sphere& sphere);
+bool intersects(const Point& point, const Triangle& triangle);
 
 // Ray
 bool intersects(const Ray& ray, const AABB& aabb);
-// bool intersects(const Ray& ray, const Capsule& capsule);
+bool intersects(const Ray& ray, const Capsule& capsule);
+bool intersects(const Ray& ray, const Cone& cone);
+bool intersects(const Ray& ray, const Cylinder& cylinder);
+bool intersects(const Ray& ray, const Ellipsoid& ellipsoid);
 bool intersects(const Ray& ray, const Frustum& frustum);
 bool intersects(const Ray& ray, const LineSegment& line_segment);
 bool intersects(const Ray& ray, const OBB& obb);
@@ -152,10 +228,14 @@ bool intersects(const Ray& ray, const Plane& plane);
 bool intersects(const Ray& ray, const Point& point);
 bool intersects(const Ray& ray_1, const Ray& ray_2);
 bool intersects(const Ray& ray, const Sphere& sphere);
+bool intersects(const Ray& ray, const Triangle& triangle);
 
 // Sphere
 bool intersects(const Sphere& sphere, const AABB& aabb);
-// bool intersects(const Sphere& sphere, const Capsule& capsule);
+bool intersects(const Sphere& sphere, const Capsule& capsule);
+bool intersects(const Sphere& sphere, const Cone& cone);
+bool intersects(const Sphere& sphere, const Cylinder& cylinder);
+bool intersects(const Sphere& sphere, const Ellipsoid& ellipsoid);
 bool intersects(const Sphere& sphere, const Frustum& frustum);
 bool intersects(const Sphere& sphere, const LineSegment& line_segment);
 bool intersects(const Sphere& sphere, const OBB& obb);
@@ -163,8 +243,22 @@ bool intersects(const Sphere& sphere, const Plane& plane);
 bool intersects(const Sphere& sphere, const Point& point);
 bool intersects(const Sphere& sphere, const Ray& ray);
 bool intersects(const Sphere& sphere_1, const Sphere& sphere_2);
-
-// TODO: Triangle
+bool intersects(const Sphere& sphere, const Triangle& triangle);
+
+// Triangle
+bool intersects(const Triangle& triangle, const AABB& aabb);
+bool intersects(const Triangle& triangle, const Capsule& capsule);
+bool intersects(const Triangle& triangle, const Cone& cone);
+bool intersects(const Triangle& triangle, const Cylinder& cylinder);
+bool intersects(const Triangle& triangle, const Ellipsoid& ellipsoid);
+bool intersects(const Triangle& triangle, const Frustum& frustum);
+bool intersects(const Triangle& triangle, const LineSegment& line_segment);
+bool intersects(const Triangle& triangle, const OBB& obb);
+bool intersects(const Triangle& triangle, const Plane& plane);
+bool intersects(const Triangle& triangle, const Point& point);
+bool intersects(const Triangle& triangle, const Ray& ray);
+bool intersects(const Triangle& triangle, const Sphere& sphere);
+bool intersects(const Triangle& triangle_1, const Triangle& triangle_2);
 
 /////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////// Inside tests
@@ -262,6 +356,55 @@ bool inside(const Sphere& sphere_1, const Sphere& sphere_2);
 
 // TODO: Triangle
 
+/////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////// Children tests
+//////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Which of the eight children of a node intersect a bounding volume and which are
+ * completely inside it. Bit i is child i, with the child centers as in
+ * Octree::getChildCenter.
+ */
+struct ChildrenMask {
+	std::uint8_t intersects = 0;
+	std::uint8_t inside = 0;
+};
+
+// Vectorized over the children
+ChildrenMask intersectsChildren(const AABB& aabb, const Point& center,
+                                double child_half_size);
+ChildrenMask intersectsChildren(const Frustum& frustum, const Point& center,
+                                double child_half_size);
+ChildrenMask intersectsChildren(const OBB& obb, const Point& center,
+                                double child_half_size);
+ChildrenMask intersectsChildren(const Sphere& sphere, const Point& center,
+                                double child_half_size);
+
+ChildrenMask intersectsChildren(const BoundingVar& bounding_volume, const Point& center,
+                                double child_half_size);
+
+/**
+ * @brief Tests the children one at a time. No child is reported as inside, so they are
+ * all tested again on the next depth.
+ */
+template <typename BoundingType>
+ChildrenMask intersectsChildren(const BoundingType& bounding_volume, const Point& center,
+                                double child_half_size)
+{
+	ChildrenMask mask;
+	AABB child(center, child_half_size);
+	for (unsigned int i = 0; i < 8; ++i) {
+		child.center[0] = center[0] + ((i & 1) ? child_half_size : -child_half_size);
+		child.center[1] = center[1] + ((i & 2) ? child_half_size : -child_half_size);
+		child.center[2] = center[2] + ((i & 4) ? child_half_size : -child_half_size);
+		if (intersects(bounding_volume, child)) {
+			mask.intersects |= 1U << i;
+		}
+	}
+	return mask;
+}
+
 }  // namespace ufo::geometry
 
 #endif  // UFO_GEOMETRY_COLLISION_CHECKS_H
\ No newline at end of file
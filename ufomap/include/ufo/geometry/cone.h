@@ -44,8 +44,20 @@
 
 #include <ufo/geometry/point.h>
 
-namespace ufo::geometry {
+namespace ufo::geometry
+{
+// Right circular cone with its apex at start and a base of the given radius at end
 struct Cone {
+	Point start;
+	Point end;
+	double radius;
+
+	Cone() : start(0.0, 0.0, 0.0), end(0.0, 0.0, 0.0), radius(0.0) {}
+
+	Cone(Point const& start, Point const& end, double radius)
+	    : start(start), end(end), radius(radius)
+	{
+	}
 };
 }  // namespace ufo::geometry
 
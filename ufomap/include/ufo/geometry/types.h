@@ -43,6 +43,10 @@
 #define UFO_GEOMETRY_TYPES_H
 
 #include <ufo/geometry/aabb.h>
+#include <ufo/geometry/capsule.h>
+#include <ufo/geometry/cone.h>
+#include <ufo/geometry/cylinder.h>
+#include <ufo/geometry/ellipsoid.h>
 #include <ufo/geometry/frustum.h>
 #include <ufo/geometry/line_segment.h>
 #include <ufo/geometry/obb.h>
@@ -50,12 +54,13 @@
 #include <ufo/geometry/point.h>
 #include <ufo/geometry/ray.h>
 #include <ufo/geometry/sphere.h>
+#include <ufo/geometry/triangle.h>
 
 #include <variant>
 
 namespace ufo::geometry {
-using BoundingVar =
-    std::variant<AABB, Frustum, LineSegment, OBB, Plane, Point, Ray, Sphere>;
+using BoundingVar = std::variant<AABB, Capsule, Cone, Cylinder, Ellipsoid, Frustum,
+                                 LineSegment, OBB, Plane, Point, Ray, Sphere, Triangle>;
 }  // namespace ufo::geometry
 
 #endif  // UFO_GEOMETRY_TYPES_H
\ No newline at end of file
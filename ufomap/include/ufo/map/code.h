@@ -50,10 +50,16 @@
 #include <immintrin.h>
 
 #include <algorithm>
+#include <cstdint>
 #include <execution>
+#include <iterator>
+#include <limits>
 #include <list>
+#include <tuple>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace ufo::map
@@ -94,33 +100,38 @@ class Code
 		return code_ != rhs.code_ || depth_ != rhs.depth_;
 	}
 
+	/**
+	 * @brief Morton order, a code comes before the codes of its descendants. Sorting codes
+	 * gives the order a depth-first traversal of the octree visits the nodes in.
+	 */
 	bool operator<(Code const& rhs) const
 	{
-		// TODO: Check
-		return get3Bits(code_) < get3Bits(rhs.code_) &&
-		       get3Bits(code_ >> 1) < get3Bits(rhs.code_ >> 1) &&
-		       get3Bits(code_ >> 2) < get3Bits(rhs.code_ >> 2);
+		// Codes created from keys above depth 0 can have bits set below their depth
+		CodeType lhs_code = toDepth(depth_).code_;
+		CodeType rhs_code = rhs.toDepth(rhs.depth_).code_;
+		return lhs_code < rhs_code || (lhs_code == rhs_code && depth_ > rhs.depth_);
 	}
 
-	bool operator<=(Code const& rhs) const
-	{
-		return get3Bits(code_) <= get3Bits(rhs.code_) &&
-		       get3Bits(code_ >> 1) <= get3Bits(rhs.code_ >> 1) &&
-		       get3Bits(code_ >> 2) <= get3Bits(rhs.code_ >> 2);
-	}
+	bool operator<=(Code const& rhs) const { return !(rhs < *this); }
 
-	bool operator>(Code const& rhs) const
-	{
-		return get3Bits(code_) > get3Bits(rhs.code_) &&
-		       get3Bits(code_ >> 1) > get3Bits(rhs.code_ >> 1) &&
-		       get3Bits(code_ >> 2) > get3Bits(rhs.code_ >> 2);
-	}
+	bool operator>(Code const& rhs) const { return rhs < *this; }
 
-	bool operator>=(Code const& rhs) const
+	bool operator>=(Code const& rhs) const { return !(*this < rhs); }
+
+	/**
+	 * @brief Get the depth of the deepest common ancestor of two codes
+	 *
+	 * @param a,b The codes
+	 * @return DepthType The depth of the deepest node containing both codes
+	 */
+	static DepthType commonAncestorDepth(Code const& a, Code const& b)
 	{
-		return get3Bits(code_) >= get3Bits(rhs.code_) &&
-		       get3Bits(code_ >> 1) >= get3Bits(rhs.code_ >> 1) &&
-		       get3Bits(code_ >> 2) >= get3Bits(rhs.code_ >> 2);
+		DepthType depth = 0;
+		for (CodeType diff = a.toDepth(a.depth_).code_ ^ b.toDepth(b.depth_).code_; 0 != diff;
+		     diff >>= 3) {
+			++depth;
+		}
+		return std::max({depth, a.depth_, b.depth_});
 	}
 
 	/**
@@ -318,16 +329,27 @@ class Code
 	DepthType getDepth() const { return depth_; }
 
 	/**
-	 * @brief
+	 * @brief Hash of both the code and the depth. The bits are mixed (MurmurHash3
+	 * finalizer) since nearby nodes have codes that only differ in the lower bits and
+	 * codes at a depth have their lower 3 * depth bits set to zero.
 	 *
 	 */
 	struct Hash {
 		std::size_t operator()(Code const& code) const
 		{
-			return static_cast<std::size_t>(code.code_);
+			return static_cast<std::size_t>(hash(code));
 		}
 
-		static size_t hash(Code const& code) { return code.code_; }
+		static std::uint64_t hash(Code const& code)
+		{
+			std::uint64_t h = code.code_ ^ (code.depth_ * 0x9e3779b97f4a7c15ULL);
+			h ^= h >> 33;
+			h *= 0xff51afd7ed558ccdULL;
+			h ^= h >> 33;
+			h *= 0xc4ceb9fe1a85ec53ULL;
+			h ^= h >> 33;
+			return h;
+		}
 
 		static bool equal(Code const& a, Code const& b) { return a == b; }
 	};
@@ -370,419 +392,289 @@ class Code
 	DepthType depth_;
 };
 
-// using CodeSet = std::unordered_set<Code, Code::Hash>;
-// template <typename T>
-// using CodeMap = std::unordered_map<Code, T, Code::Hash>;
 using CodeRay = std::vector<Code>;
 
-class CodeSet
+/**
+ * @brief Open addressing hash table with codes as keys, base of CodeSet and CodeMap
+ *
+ * @details The entries are stored densely in insertion order, which makes iterating
+ * cheap and independent of the number of buckets. The buckets are linearly probed and
+ * only store the position of an entry together with part of its hash, so most probes do
+ * not have to look at the entries. Clearing only touches the buckets in use.
+ *
+ * Inserting can invalidate iterators, in the same way as for a std::vector. As for the
+ * standard containers the keys can not be modified through iterators, so the iterators
+ * of a set are const and the entries of a map are std::pair<Code const, T>.
+ *
+ * @tparam ENTRY Code for a set, std::pair<Code const, T> for a map
+ */
+template <typename ENTRY>
+class CodeHashTable
 {
  public:
-	CodeSet(unsigned int power = 18) : power_(power)
-	{
-		num_buckets_ = size_t(1) << power_;
-		data_.resize(num_buckets_);
-	}
-
-	struct CodeSetIterator {
-		CodeSetIterator(CodeSet const* set = nullptr) : set_(set)
-		{
-			if (!set_) {
-				return;
-			}
+	using value_type = ENTRY;
+	using const_iterator = typename std::vector<ENTRY>::const_iterator;
+	using iterator = std::conditional_t<std::is_same_v<Code, ENTRY>, const_iterator,
+	                                    typename std::vector<ENTRY>::iterator>;
 
-			if (set_->data_.empty()) {
-				set_ = nullptr;
-			} else {
-				outer_iter_ = set_->data_.begin();
-				outer_iter_end_ = set_->data_.end();
-				while (outer_iter_ != outer_iter_end_ && outer_iter_->empty()) {
-					++outer_iter_;
-				}
-				if (outer_iter_ == outer_iter_end_) {
-					set_ = nullptr;
-				} else {
-					inner_iter_ = outer_iter_->begin();
-					inner_iter_end_ = outer_iter_->end();
-				}
-			}
-		}
+	CodeHashTable(unsigned int power = 18) { allocate(std::max(power, MIN_POWER)); }
 
-		Code const& operator*() const { return *inner_iter_; }
+	//
+	// Iterators
+	//
 
-		// Postfix increment
-		CodeSetIterator operator++(int)
-		{
-			CodeSetIterator result = *this;
-			++(*this);
-			return result;
-		}
+	iterator begin() noexcept { return entries_.begin(); }
 
-		// Prefix increment
-		CodeSetIterator& operator++()
-		{
-			++inner_iter_;
-			if (inner_iter_ == inner_iter_end_) {
-				++outer_iter_;
-				while (outer_iter_ != outer_iter_end_ && outer_iter_->empty()) {
-					++outer_iter_;
-				}
-				if (outer_iter_ == outer_iter_end_) {
-					set_ = nullptr;
-				} else {
-					inner_iter_ = outer_iter_->begin();
-					inner_iter_end_ = outer_iter_->end();
-				}
-			}
-			return *this;
-		}
+	const_iterator begin() const noexcept { return entries_.cbegin(); }
 
-		bool operator==(CodeSetIterator const& rhs) const { return (rhs.set_ == set_); }
+	iterator end() noexcept { return entries_.end(); }
 
-		bool operator!=(CodeSetIterator const& rhs) const { return (rhs.set_ != set_); }
+	const_iterator end() const noexcept { return entries_.cend(); }
 
-	 private:
-		CodeSet const* set_;
-		std::vector<std::vector<Code>>::const_iterator outer_iter_;
-		std::vector<std::vector<Code>>::const_iterator outer_iter_end_;
-		std::vector<Code>::const_iterator inner_iter_;
-		std::vector<Code>::const_iterator inner_iter_end_;
-		// typename decltype(CodeSet::data_)::const_iterator outer_iter_;
-		// typename decltype(CodeSet::data_)::const_iterator outer_iter_end_;
-		// typename decltype(CodeSet::data_)::value_type::const_iterator inner_iter_;
-		// typename decltype(CodeSet::data_)::value_type::const_iterator inner_iter_end_;
-	};
+	//
+	// Lookup
+	//
 
-	std::pair<int, bool> insert(Code const& value)
+	iterator find(Code const& key)
 	{
-		size_t hash = getBucket(value);
-		if (std::any_of(std::execution::seq, data_[hash].begin(), data_[hash].end(),
-		                [&value](auto const& elem) { return value == elem; })) {
-			return std::make_pair(0, false);  // TODO: Fix
-		}
-
-		++size_;
-
-		if (load_factor() > max_load_factor() && power_ < MAX_POWER) {
-			rehash(num_buckets_ * 2);
-			hash = getBucket(value);
-		}
-
-		data_[hash].push_back(value);
-
-		return std::make_pair(0, true);  // TOOD: Fix
+		std::size_t index = findIndex(key);
+		return NO_INDEX == index ? end() : std::next(begin(), index);
 	}
 
-	void clear()
+	const_iterator find(Code const& key) const
 	{
-		std::for_each(std::execution::seq, data_.begin(), data_.end(),
-		              [](auto& bucket) { bucket.clear(); });
-		size_ = 0;
+		std::size_t index = findIndex(key);
+		return NO_INDEX == index ? end() : std::next(begin(), index);
 	}
 
-	bool empty() const noexcept { return 0 == size_; }
-
-	size_t size() const noexcept { return size_; }
-
-	size_t bucket_count() const noexcept { return num_buckets_; }
-
-	unsigned int bucket_count_power() const noexcept { return power_; }
-
-	float load_factor() const { return size_ / ((float)num_buckets_); }
+	std::size_t count(Code const& key) const { return NO_INDEX == findIndex(key) ? 0 : 1; }
 
-	float max_load_factor() const { return max_load_factor_; }
-
-	void max_load_factor(float max_load_factor)
+	/**
+	 * @brief Hint that key is about to be looked up or inserted, so its bucket is loaded
+	 * into the cache in the meantime
+	 */
+	void prefetch(Code const& key) const noexcept
 	{
-		max_load_factor_ = max_load_factor;
-
-		if (load_factor() > max_load_factor_ && power_ < MAX_POWER) {
-			rehash(num_buckets_ * 2);
-		}
+		_mm_prefetch(reinterpret_cast<char const*>(&buckets_[home(Code::Hash::hash(key))]),
+		             _MM_HINT_T0);
 	}
 
-	void rehash(std::size_t count)
-	{
-		std::size_t min_count = std::max((float)count, size() / max_load_factor());
-		unsigned int power =
-		    std::max(power_, std::min((unsigned int)std::log2(min_count) + 1, MAX_POWER));
-
-		if (power_ == power) {
-			return;
-		}
-
-		power_ = power;
-		num_buckets_ = std::size_t(1) << power_;
-
-		decltype(data_) new_data;
-		new_data.resize(num_buckets_);
-
-		for (Code const& value : *this) {
-			new_data[getBucket(value)].push_back(value);
-		}
+	//
+	// Modifiers
+	//
 
-		data_.swap(new_data);
-	}
-
-	void reserve(std::size_t count)
+	/**
+	 * @brief Remove all entries, only the buckets in use are touched unless most of them
+	 * are in use
+	 */
+	void clear()
 	{
-		power_ = std::max(power_, std::min((unsigned int)std::log2(count) + 1, MAX_POWER));
-		data_.reserve(std::size_t(1) << power_);
+		if (entries_.size() > (buckets_.size() >> 3)) {
+			std::fill(std::begin(buckets_), std::end(buckets_), Bucket());
+		} else {
+			for (std::size_t i = 0; i != entries_.size(); ++i) {
+				// The entry is known to be in the table, so there is no need to stop at empty
+				// buckets left by entries cleared before this one
+				std::size_t bucket = home(Code::Hash::hash(keyOf(entries_[i])));
+				while (buckets_[bucket].index != i + 1) {
+					bucket = (bucket + 1) & mask_;
+				}
+				buckets_[bucket] = Bucket();
+			}
+		}
+		entries_.clear();
 	}
 
-	CodeSetIterator begin() const { return CodeSetIterator(this); }
-
-	CodeSetIterator end() const { return CodeSetIterator(); }
-
-	void swap(CodeSet& other)
+	void swap(CodeHashTable& other) noexcept
 	{
-		data_.swap(other.data_);
+		entries_.swap(other.entries_);
+		buckets_.swap(other.buckets_);
 		std::swap(power_, other.power_);
-		std::swap(num_buckets_, other.num_buckets_);
-		std::swap(size_, other.size_);
+		std::swap(mask_, other.mask_);
 		std::swap(max_load_factor_, other.max_load_factor_);
 	}
 
-	using const_iterator = CodeSetIterator;
+	//
+	// Capacity
+	//
 
- private:
-	std::size_t getBucket(Code const& key) const
-	{
-		unsigned int offset = 3 * key.getDepth();
-		unsigned int modder = (num_buckets_ - 1) << offset;
-		return (Code::Hash()(key) & modder) >> offset;
-	}
+	bool empty() const noexcept { return entries_.empty(); }
 
- private:
-	std::vector<std::vector<Code>> data_;
-	unsigned int power_;
-	std::size_t num_buckets_;
-	std::size_t size_ = 0;
-	float max_load_factor_ = 1.0;
+	std::size_t size() const noexcept { return entries_.size(); }
 
-	inline static const unsigned int MAX_POWER = 28;
+	//
+	// Bucket interface
+	//
 
-	friend struct CodeSetIterator;
-};
+	std::size_t bucket_count() const noexcept { return buckets_.size(); }
 
-template <class T>
-class CodeMap
-{
- public:
-	CodeMap(unsigned int power = 18) : power_(power)
-	{
-		num_buckets_ = std::size_t(1) << power_;  // std::pow(2, power_);
-		data_.resize(num_buckets_);
-	}
+	unsigned int bucket_count_power() const noexcept { return power_; }
 
-	struct CodeMapIterator {
-		CodeMapIterator(const CodeMap* map = nullptr) : map_(map)
-		{
-			if (nullptr == map_) {
-				return;
-			}
+	//
+	// Hash policy
+	//
 
-			if (map_->data_.empty()) {
-				map_ = nullptr;
-			} else {
-				outer_iter_ = map_->data_.begin();
-				outer_iter_end_ = map_->data_.end();
-				while (outer_iter_ != outer_iter_end_ && outer_iter_->empty()) {
-					++outer_iter_;
-				}
-				if (outer_iter_ == outer_iter_end_) {
-					map_ = nullptr;
-				} else {
-					inner_iter_ = outer_iter_->begin();
-					inner_iter_end_ = outer_iter_->end();
-				}
-			}
-		}
+	float load_factor() const { return size() / static_cast<float>(bucket_count()); }
 
-		const std::pair<Code, T>& operator*() const
-		{
-			return *inner_iter_;  // map_->data_[outer_index_][inner_index_];
-		}
+	float max_load_factor() const noexcept { return max_load_factor_; }
 
-		std::pair<Code, T> operator*()
-		{
-			return *inner_iter_;  // map_->data_[outer_index_][inner_index_];
-		}
+	void max_load_factor(float max_load_factor)
+	{
+		// Linear probing degrades quickly when the table is almost full
+		max_load_factor_ = std::clamp(max_load_factor, 0.1f, 0.9f);
+		rehash(0);
+	}
 
-		// Postfix increment
-		CodeMapIterator operator++(int)
-		{
-			CodeMapIterator result = *this;
-			++(*this);
-			return result;
+	/**
+	 * @brief Set the number of buckets to at least count, and enough to hold the current
+	 * entries without exceeding the max load factor
+	 */
+	void rehash(std::size_t count)
+	{
+		count = std::max(count, static_cast<std::size_t>(size() / max_load_factor_) + 1);
+		unsigned int power = power_;
+		while (power < MAX_POWER && (std::size_t(1) << power) < count) {
+			++power;
 		}
-
-		// Prefix increment
-		CodeMapIterator& operator++()
-		{
-			++inner_iter_;
-			if (inner_iter_ == inner_iter_end_) {
-				++outer_iter_;
-				while (outer_iter_ != outer_iter_end_ && outer_iter_->empty()) {
-					++outer_iter_;
-				}
-				if (outer_iter_ == outer_iter_end_) {
-					map_ = nullptr;
-				} else {
-					inner_iter_ = outer_iter_->begin();
-					inner_iter_end_ = outer_iter_->end();
-				}
+		if (power != power_) {
+			allocate(power);
+			for (std::size_t i = 0; i != entries_.size(); ++i) {
+				std::uint64_t hash = Code::Hash::hash(keyOf(entries_[i]));
+				buckets_[emptyBucket(hash)] = Bucket{static_cast<std::uint32_t>(i + 1),
+				                                     static_cast<std::uint32_t>(hash)};
 			}
-			return *this;
 		}
+	}
 
-		bool operator==(const CodeMapIterator& rhs) const { return (rhs.map_ == map_); }
-
-		bool operator!=(const CodeMapIterator& rhs) const { return (rhs.map_ != map_); }
-
-	 private:
-		const CodeMap* map_;
-		typename std::vector<std::list<std::pair<Code, T>>>::const_iterator outer_iter_;
-		typename std::vector<std::list<std::pair<Code, T>>>::const_iterator outer_iter_end_;
-		typename std::list<std::pair<Code, T>>::const_iterator inner_iter_;
-		typename std::list<std::pair<Code, T>>::const_iterator inner_iter_end_;
-		// typename decltype(CodeMap<T>::data_)::const_iterator outer_iter_;
-		// typename decltype(CodeMap<T>::data_)::const_iterator outer_iter_end_;
-		// typename decltype(CodeMap<T>::data_)::value_type::const_iterator inner_iter_;
-		// typename decltype(CodeMap<T>::data_)::value_type::const_iterator inner_iter_end_;
-	};
-
-	T& operator[](Code const& key)
+	/**
+	 * @brief Make room for count entries without rehashing
+	 */
+	void reserve(std::size_t count)
 	{
-		std::size_t hash = getBucket(key);
-		auto it = std::find_if(std::execution::seq, data_[hash].begin(), data_[hash].end(),
-		                       [&key](const auto& elem) { return key == elem.first; });
-		if (it != data_[hash].end()) {
-			return it->second;
-		}
-
-		++size_;
-
-		if (load_factor() > max_load_factor() && power_ < MAX_POWER) {
-			rehash(num_buckets_ * 2);
-			hash = getBucket(key);
-		}
-
-		return std::get<1>(data_[hash].emplace_front(key, T()));  // TODO: How to
-		                                                          // call default?
+		entries_.reserve(count);
+		rehash(static_cast<std::size_t>(count / max_load_factor_) + 1);
 	}
 
-	std::pair<int, bool> try_emplace(Code const& key,
-	                                 const T& value)  // TODO: Fix
+ protected:
+	template <typename... Args>
+	std::pair<iterator, bool> emplace(Code const& key, Args&&... args)
 	{
-		std::size_t hash = getBucket(key);
-		if (std::any_of(std::execution::seq, data_[hash].begin(), data_[hash].end(),
-		                [&key](const auto& elem) { return key == elem.first; })) {
-			return std::make_pair(0, false);  // TODO: Fix
+		std::uint64_t hash = Code::Hash::hash(key);
+		std::size_t bucket = home(hash);
+		for (; 0 != buckets_[bucket].index; bucket = (bucket + 1) & mask_) {
+			Bucket const& b = buckets_[bucket];
+			if (static_cast<std::uint32_t>(hash) == b.tag &&
+			    key == keyOf(entries_[b.index - 1])) {
+				return std::make_pair(std::next(begin(), b.index - 1), false);
+			}
 		}
 
-		++size_;
-
-		if (load_factor() > max_load_factor() && power_ < MAX_POWER) {
-			rehash(num_buckets_ * 2);
-			hash = getBucket(key);
+		if (size() + 1 > max_load_factor_ * bucket_count()) {
+			rehash(bucket_count() * 2);
+			bucket = emptyBucket(hash);
 		}
 
-		data_[hash].emplace_front(key, value);
-
-		return std::make_pair(0, true);  // TODO: Fix
-	}
-
-	void clear()
-	{
-		std::for_each(std::execution::seq, data_.begin(), data_.end(),
-		              [](auto& bucket) { bucket.clear(); });
-		size_ = 0;
+		entries_.emplace_back(std::forward<Args>(args)...);
+		buckets_[bucket] = Bucket{static_cast<std::uint32_t>(entries_.size()),
+		                          static_cast<std::uint32_t>(hash)};
+		return std::make_pair(std::prev(end()), true);
 	}
 
-	bool empty() const { return 0 == size_; }
-
-	std::size_t size() { return size_; }
-
-	std::size_t bucket_count() const { return num_buckets_; }
+ private:
+	// Index is the position of the entry plus one, zero means the bucket is empty. Tag is
+	// the lower half of the hash of the entry.
+	struct Bucket {
+		std::uint32_t index = 0;
+		std::uint32_t tag = 0;
+	};
 
-	unsigned int bucket_count_power() const { return power_; }
+	static Code const& keyOf(Code const& entry) noexcept { return entry; }
 
-	float load_factor() const { return size_ / ((float)num_buckets_); }
+	template <typename T>
+	static Code const& keyOf(std::pair<Code const, T> const& entry) noexcept
+	{
+		return entry.first;
+	}
 
-	float max_load_factor() const { return max_load_factor_; }
+	// The upper bits of the hash are used for the bucket, the lower for the tag
+	std::size_t home(std::uint64_t hash) const noexcept { return hash >> (64 - power_); }
 
-	void max_load_factor(float max_load_factor)
+	std::size_t findIndex(Code const& key) const
 	{
-		max_load_factor_ = max_load_factor;
-
-		if (load_factor() > max_load_factor_ && power_ < MAX_POWER) {
-			rehash(num_buckets_ * 2);
+		std::uint64_t hash = Code::Hash::hash(key);
+		for (std::size_t bucket = home(hash); 0 != buckets_[bucket].index;
+		     bucket = (bucket + 1) & mask_) {
+			Bucket const& b = buckets_[bucket];
+			if (static_cast<std::uint32_t>(hash) == b.tag &&
+			    key == keyOf(entries_[b.index - 1])) {
+				return b.index - 1;
+			}
 		}
+		return NO_INDEX;
 	}
 
-	void rehash(std::size_t count)
+	std::size_t emptyBucket(std::uint64_t hash) const noexcept
 	{
-		std::size_t min_count = std::max((float)count, size() / max_load_factor());
-		unsigned int power =
-		    std::max(power_, std::min((unsigned int)std::log2(min_count) + 1, MAX_POWER));
-
-		if (power_ == power) {
-			return;
+		std::size_t bucket = home(hash);
+		while (0 != buckets_[bucket].index) {
+			bucket = (bucket + 1) & mask_;
 		}
+		return bucket;
+	}
 
+	void allocate(unsigned int power)
+	{
 		power_ = power;
-		num_buckets_ = std::size_t(1) << power_;
+		mask_ = (std::size_t(1) << power_) - 1;
+		buckets_.assign(std::size_t(1) << power_, Bucket());
+	}
 
-		decltype(data_) new_data;
-		new_data.resize(num_buckets_);
+ private:
+	std::vector<ENTRY> entries_;  // The entries in insertion order
+	std::vector<Bucket> buckets_;
+	unsigned int power_;  // Number of buckets is 2^power_
+	std::size_t mask_;
+	float max_load_factor_ = 0.5;
+
+	inline static const unsigned int MIN_POWER = 3;
+	inline static const unsigned int MAX_POWER = 32;
+	inline static const std::size_t NO_INDEX = std::numeric_limits<std::size_t>::max();
+};
 
-		for (const auto& [key, value] : *this) {
-			new_data[getBucket(key)].emplace_front(key, value);
-		}
+class CodeSet : public CodeHashTable<Code>
+{
+ public:
+	using CodeHashTable<Code>::CodeHashTable;
 
-		data_.swap(new_data);
-		// fprintf(stderr, "\n\nRehash, new power: %u\n\n", power_);
-	}
+	std::pair<iterator, bool> insert(Code const& value) { return emplace(value, value); }
+};
 
-	void reserve(std::size_t count)
-	{
-		power_ = std::max(power_, std::min((unsigned int)std::log2(count) + 1, MAX_POWER));
-		data_.reserve(std::size_t(1) << power_);
-	}
+template <class T>
+class CodeMap : public CodeHashTable<std::pair<Code const, T>>
+{
+ private:
+	using Base = CodeHashTable<std::pair<Code const, T>>;
 
-	CodeMapIterator begin() const { return CodeMapIterator(this); }
+ public:
+	using Base::Base;
 
-	CodeMapIterator end() const { return CodeMapIterator(); }
+	using key_type = Code;
+	using mapped_type = T;
 
-	void swap(CodeMap<T>& other)
+	T& operator[](Code const& key)
 	{
-		data_.swap(other.data_);
-		std::swap(power_, other.power_);
-		std::swap(num_buckets_, other.num_buckets_);
-		std::swap(size_, other.size_);
-		std::swap(max_load_factor_, other.max_load_factor_);
+		return Base::emplace(key, std::piecewise_construct, std::forward_as_tuple(key),
+		                     std::forward_as_tuple())
+		    .first->second;
 	}
 
- private:
-	std::size_t getBucket(Code const& key) const
+	template <typename... Args>
+	std::pair<typename Base::iterator, bool> try_emplace(Code const& key, Args&&... args)
 	{
-		unsigned int offset = 3 * key.getDepth();
-		unsigned int modder = (num_buckets_ - 1) << offset;
-		return (Code::Hash()(key) & modder) >> offset;
+		return Base::emplace(key, std::piecewise_construct, std::forward_as_tuple(key),
+		                     std::forward_as_tuple(std::forward<Args>(args)...));
 	}
-
- private:
-	std::vector<std::list<std::pair<Code, T>>> data_;
-	unsigned int power_;
-	std::size_t num_buckets_;
-	std::size_t size_ = 0;
-	float max_load_factor_ = 1.0;
-
-	inline static const unsigned int MAX_POWER = 28;
-
-	friend struct CodeMapIterator;
 };
 }  // namespace ufo::map
 
-#endif  // UFO_MAP_CODE_H
\ No newline at end of file
+#endif  // UFO_MAP_CODE_H
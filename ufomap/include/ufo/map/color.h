@@ -62,15 +62,9 @@ struct Color {
 
 	Color(ColorType r, ColorType g, ColorType b) : r(r), g(g), b(b) {}
 
-	Color(Color const& other) : r(other.r), g(other.g), b(other.b) {}
+	Color(Color const& other) = default;
 
-	Color& operator=(Color const& rhs)
-	{
-		r = rhs.r;
-		g = rhs.g;
-		b = rhs.b;
-		return *this;
-	}
+	Color& operator=(Color const& rhs) = default;
 
 	bool operator==(Color const& other) const
 	{
@@ -0,0 +1,253 @@
+/**
+ * UFOMap: An Efficient Probabilistic 3D Mapping Framework That Embraces the Unknown
+ *
+ * @author D. Duberg, KTH Royal Institute of Technology, Copyright (c) 2020.
+ * @see https://github.com/UnknownFreeOccupied/ufomap
+ * License: BSD 3
+ *
+ */
+
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, D. Duberg, KTH Royal Institute of Technology
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef UFO_MAP_DISTANCE_FIELD_H
+#define UFO_MAP_DISTANCE_FIELD_H
+
+// UFO
+#include <ufo/map/key.h>
+#include <ufo/map/types.h>
+
+// STD
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace ufo::map
+{
+/**
+ * @brief Euclidean distance field over the voxels at depth 0 of an octree, giving the
+ * distance to the closest obstacle voxel up to a maximum distance
+ *
+ * @details Kept up to date incrementally, as in Lau et al. "Efficient grid-based spatial
+ * representations for robot navigation in dynamic environments". Setting an obstacle
+ * starts a lowering wavefront, which lowers the distance of the voxels closer to it than
+ * to their current closest obstacle. Removing an obstacle starts a raising wavefront,
+ * which resets the voxels that had it as closest obstacle, after which the lowering
+ * wavefronts of the remaining obstacles around them refill them. Only the voxels within
+ * the maximum distance of an obstacle are stored, in blocks allocated on demand.
+ */
+class DistanceField
+{
+ public:
+	//
+	// Constructor
+	//
+
+	/**
+	 * @param resolution The size of a voxel
+	 * @param max_value The key of the voxel whose minimum corner is at the origin
+	 * @param max_distance Distances are only computed up to this distance
+	 */
+	DistanceField(double resolution, KeyType max_value, double max_distance);
+
+	//
+	// Parameters
+	//
+
+	double getResolution() const noexcept { return resolution_; }
+
+	double getMaxDistance() const noexcept { return max_distance_; }
+
+	//
+	// Obstacles
+	//
+
+	/**
+	 * @brief Mark the voxel as an obstacle, takes effect on the next update
+	 *
+	 * @param key Key at depth 0
+	 */
+	void setObstacle(Key const& key);
+
+	/**
+	 * @brief Mark the voxel as free, takes effect on the next update
+	 *
+	 * @param key Key at depth 0
+	 */
+	void removeObstacle(Key const& key);
+
+	/**
+	 * @brief Mark all voxels with keys between min and max, inclusive, as obstacles
+	 */
+	void setObstacles(Key const& min, Key const& max);
+
+	/**
+	 * @brief Mark all voxels with keys between min and max, inclusive, as free
+	 */
+	void removeObstacles(Key const& min, Key const& max);
+
+	bool isObstacle(Key const& key) const;
+
+	std::size_t getNumObstacles() const noexcept { return num_obstacles_; }
+
+	/**
+	 * @brief Propagate the wavefronts started by the obstacles set and removed since the
+	 * last update
+	 */
+	void update();
+
+	/**
+	 * @brief Remove all obstacles
+	 */
+	void clear();
+
+	//
+	// Distance
+	//
+
+	/**
+	 * @brief Distance from point to the closest obstacle, trilinearly interpolated between
+	 * the centers of the surrounding voxels and at most the maximum distance
+	 */
+	double distance(Point3 const& point) const;
+
+	/**
+	 * @brief Distance from point to the closest obstacle, as well as its gradient
+	 */
+	double distance(Point3 const& point, Point3& gradient) const;
+
+ private:
+	// Closest obstacle of a voxel and the squared distance to it, in voxels
+	struct Cell {
+		std::array<KeyType, 3> obstacle{NO_OBSTACLE, NO_OBSTACLE, NO_OBSTACLE};
+		std::uint32_t squared_distance = NO_DISTANCE;
+		bool raise = false;   // Waiting to reset its neighbors
+		bool queued = false;  // Waiting to lower its neighbors
+	};
+
+	static constexpr KeyType NO_OBSTACLE = std::numeric_limits<KeyType>::max();
+	static constexpr std::uint32_t NO_DISTANCE = std::numeric_limits<std::uint32_t>::max();
+	static constexpr int BLOCK_BITS = 3;
+	static constexpr KeyType BLOCK_MASK = (KeyType(1) << BLOCK_BITS) - 1;
+	static constexpr std::size_t BLOCK_SIZE = std::size_t(1) << (3 * BLOCK_BITS);
+
+	using Block = std::array<Cell, BLOCK_SIZE>;
+	using Index = std::array<KeyType, 3>;
+
+	/**
+	 * @brief The blocks around a voxel, each looked up at most once while visiting the
+	 * neighbors of the voxel
+	 */
+	struct Neighborhood {
+		std::array<Block*, 27> blocks{};
+		std::uint32_t fetched = 0;
+	};
+
+	static std::uint64_t pack(Index const& index) noexcept
+	{
+		return std::uint64_t(index[0]) | (std::uint64_t(index[1]) << 21) |
+		       (std::uint64_t(index[2]) << 42);
+	}
+
+	static Index unpack(std::uint64_t packed) noexcept
+	{
+		return {KeyType(packed & 0x1FFFFF), KeyType((packed >> 21) & 0x1FFFFF),
+		        KeyType(packed >> 42)};
+	}
+
+	static std::size_t cellIndex(Index const& index) noexcept
+	{
+		return (index[0] & BLOCK_MASK) | ((index[1] & BLOCK_MASK) << BLOCK_BITS) |
+		       ((index[2] & BLOCK_MASK) << (2 * BLOCK_BITS));
+	}
+
+	static std::uint64_t blockOf(Index const& index) noexcept
+	{
+		return pack({index[0] >> BLOCK_BITS, index[1] >> BLOCK_BITS, index[2] >> BLOCK_BITS});
+	}
+
+	Cell* findCell(Index const& index);
+
+	Cell const* findCell(Index const& index) const;
+
+	Cell& createCell(Index const& index);
+
+	/**
+	 * @brief The block of neighbor, a neighbor of index, nullptr if it does not exist and
+	 * create is false
+	 */
+	Block* neighborBlock(Neighborhood& neighborhood, Index const& index,
+	                     Index const& neighbor, bool create);
+
+	bool isObstacle(Cell const& cell, Index const& index) const noexcept
+	{
+		return cell.obstacle == index;
+	}
+
+	// Whether the closest obstacle of cell is still an obstacle
+	bool hasValidObstacle(Cell const& cell) const;
+
+	void push(std::uint32_t squared_distance, Index const& index);
+
+	void raise(Index const& index, Cell& cell);
+
+	void lower(Index const& index, Cell const& cell);
+
+	// Distance of the voxel in the units of the map, the maximum distance if the voxel is
+	// further away or outside of the map
+	double cellDistance(std::int64_t x, std::int64_t y, std::int64_t z) const;
+
+	double interpolate(Point3 const& point, Point3* gradient) const;
+
+ private:
+	double resolution_;
+	double resolution_factor_;
+	KeyType max_value_;
+	double max_distance_;
+	std::uint32_t max_squared_distance_;  // In voxels
+
+	std::unordered_map<std::uint64_t, std::unique_ptr<Block>> blocks_;
+	std::size_t num_obstacles_ = 0;
+
+	// Voxels waiting to reset their neighbors
+	std::vector<std::uint64_t> raise_;
+	// Voxels waiting to lower their neighbors, bucketed by their squared distance
+	std::vector<std::vector<std::uint64_t>> open_;
+	std::size_t open_min_;
+};
+}  // namespace ufo::map
+
+#endif  // UFO_MAP_DISTANCE_FIELD_H
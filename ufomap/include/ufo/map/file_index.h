@@ -0,0 +1,256 @@
+/**
+ * UFOMap: An Efficient Probabilistic 3D Mapping Framework That Embraces the Unknown
+ *
+ * @author D. Duberg, KTH Royal Institute of Technology, Copyright (c) 2020.
+ * @see https://github.com/UnknownFreeOccupied/ufomap
+ * License: BSD 3
+ *
+ */
+
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, D. Duberg, KTH Royal Institute of Technology
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef UFO_MAP_FILE_INDEX_H
+#define UFO_MAP_FILE_INDEX_H
+
+// UFO
+#include <ufo/map/lz4_block_stream.h>
+#include <ufo/map/types.h>
+
+// STD
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+namespace ufo::map
+{
+/**
+ * @brief Index of where in the data each subtree at a fixed depth is stored, so
+ * subtrees can be read in parallel and subtrees that are not needed can be skipped.
+ *
+ * @details The index is written after the data and ends with its own size and the
+ * magic bytes, so a reader finds it from the end of the file and readers that do not
+ * know about it never see it. It contains:
+ * - The magic bytes.
+ * - The depth of the subtrees (uint8).
+ * - The size of the uncompressed data and the number of bytes the data takes in the
+ * file (uint64).
+ * - The number of subtrees (uint64) followed by the code, offset and size in the
+ * uncompressed data of each subtree (uint64), in the order they are stored.
+ * - The number of frames (uint64) followed by the offset and uncompressed offset of
+ * each frame (uint64), only for compressed data.
+ * - The number of bytes in the index, including this and the magic bytes (uint64).
+ * - The magic bytes.
+ *
+ * Only subtrees that have children are indexed, leaf nodes are stored with their
+ * parent.
+ */
+struct FileIndex {
+	static constexpr char MAGIC[4] = {'U', 'F', 'O', 'I'};
+
+	struct Subtree {
+		std::uint64_t code;
+		std::uint64_t offset;
+		std::uint64_t size;
+	};
+
+	DepthType depth = 0;
+	std::uint64_t data_size = 0;
+	std::uint64_t stored_size = 0;
+	std::vector<Subtree> subtrees;
+	std::vector<LZ4BlockFormat::Frame> frames;
+
+	/**
+	 * @brief Append the index to s, after the data it indexes
+	 */
+	bool write(std::ostream& s) const
+	{
+		std::uint8_t const index_depth = depth;
+		std::uint64_t const num_subtrees = subtrees.size();
+		std::uint64_t const num_frames = frames.size();
+		std::uint64_t const index_size = FIXED_SIZE + num_subtrees * sizeof(Subtree) +
+		                                 num_frames * sizeof(LZ4BlockFormat::Frame);
+
+		s.write(MAGIC, sizeof(MAGIC));
+		writeValue(s, index_depth);
+		writeValue(s, data_size);
+		writeValue(s, stored_size);
+		writeValue(s, num_subtrees);
+		s.write(reinterpret_cast<char const*>(subtrees.data()),
+		        num_subtrees * sizeof(Subtree));
+		writeValue(s, num_frames);
+		s.write(reinterpret_cast<char const*>(frames.data()),
+		        num_frames * sizeof(LZ4BlockFormat::Frame));
+		writeValue(s, index_size);
+		s.write(MAGIC, sizeof(MAGIC));
+		return s.good();
+	}
+
+	/**
+	 * @brief Read the index of the data starting at the current position of s. The index
+	 * is found from the end of s, s is left where it was.
+	 *
+	 * @return false If s has no valid index for this data, or s can not seek
+	 */
+	bool read(std::istream& s)
+	{
+		std::streampos const data_start = s.tellg();
+		if (std::streampos(-1) == data_start) {
+			s.clear();
+			return false;
+		}
+
+		bool success = false;
+		std::uint64_t index_size;
+		char magic[sizeof(MAGIC)];
+		std::streamoff const trailer_size = sizeof(index_size) + sizeof(magic);
+		if (s.seekg(0, std::ios_base::end)) {
+			std::streampos const end = s.tellg();
+			if (end - data_start >= trailer_size && s.seekg(end - trailer_size) &&
+			    readValue(s, index_size) && s.read(magic, sizeof(magic)) &&
+			    0 == std::memcmp(magic, MAGIC, sizeof(MAGIC)) &&
+			    index_size <= static_cast<std::uint64_t>(end - data_start)) {
+				std::streampos const index_start = end - std::streamoff(index_size);
+				success = s.seekg(index_start) && readIndex(s, index_size) &&
+				          stored_size == static_cast<std::uint64_t>(index_start - data_start);
+			}
+		}
+
+		s.clear();
+		s.seekg(data_start);
+		return success;
+	}
+
+	/**
+	 * @brief Skip past the index if one starts at the current position of s
+	 */
+	static void skip(std::istream& s)
+	{
+		std::streampos const position = s.tellg();
+		if (std::streampos(-1) == position) {
+			s.clear();
+			return;
+		}
+		std::streampos const end = s.seekg(0, std::ios_base::end) ? s.tellg() : position;
+		FileIndex index;
+		if (!s.seekg(position) ||
+		    !index.readIndex(s, static_cast<std::uint64_t>(end - position))) {
+			s.clear();
+			s.seekg(position);
+		}
+	}
+
+ private:
+	// The size of the index without the subtrees and frames
+	static constexpr std::uint64_t FIXED_SIZE =
+	    2 * sizeof(MAGIC) + sizeof(std::uint8_t) + 5 * sizeof(std::uint64_t);
+
+	/**
+	 * @brief Read and validate an index of at most max_size bytes starting at the current
+	 * position of s, leaves s after the index
+	 */
+	bool readIndex(std::istream& s, std::uint64_t max_size)
+	{
+		if (FIXED_SIZE > max_size) {
+			return false;
+		}
+		// Bytes left for the subtrees and frames, bounds the counts before allocating
+		std::uint64_t available = max_size - FIXED_SIZE;
+
+		char magic[sizeof(MAGIC)];
+		std::uint8_t index_depth;
+		std::uint64_t num_subtrees;
+		std::uint64_t num_frames;
+		std::uint64_t index_size;
+		if (!s.read(magic, sizeof(magic)) || 0 != std::memcmp(magic, MAGIC, sizeof(MAGIC)) ||
+		    !readValue(s, index_depth) || !readValue(s, data_size) ||
+		    !readValue(s, stored_size) || !readValue(s, num_subtrees) ||
+		    num_subtrees > data_size || num_subtrees > available / sizeof(Subtree)) {
+			return false;
+		}
+		depth = index_depth;
+		available -= num_subtrees * sizeof(Subtree);
+
+		subtrees.resize(num_subtrees);
+		if (!s.read(reinterpret_cast<char*>(subtrees.data()),
+		            num_subtrees * sizeof(Subtree)) ||
+		    !readValue(s, num_frames) || num_frames > stored_size ||
+		    num_frames > available / sizeof(LZ4BlockFormat::Frame)) {
+			return false;
+		}
+
+		frames.resize(num_frames);
+		if (!s.read(reinterpret_cast<char*>(frames.data()),
+		            num_frames * sizeof(LZ4BlockFormat::Frame)) ||
+		    !readValue(s, index_size) || !s.read(magic, sizeof(magic)) ||
+		    0 != std::memcmp(magic, MAGIC, sizeof(MAGIC)) ||
+		    index_size != FIXED_SIZE + num_subtrees * sizeof(Subtree) +
+		                      num_frames * sizeof(LZ4BlockFormat::Frame)) {
+			return false;
+		}
+
+		// Subtrees and frames are stored in order and within the data
+		std::uint64_t end = 0;
+		for (Subtree const& subtree : subtrees) {
+			if (subtree.offset < end || data_size - subtree.offset < subtree.size) {
+				return false;
+			}
+			end = subtree.offset + subtree.size;
+		}
+		for (std::size_t i = 0; i != frames.size(); ++i) {
+			if (frames[i].offset >= stored_size || frames[i].uncompressed_offset >= data_size ||
+			    (0 != i && (frames[i].offset <= frames[i - 1].offset ||
+			                frames[i].uncompressed_offset <= frames[i - 1].uncompressed_offset))) {
+				return false;
+			}
+		}
+		return frames.empty() || 0 == frames.front().uncompressed_offset;
+	}
+
+	template <typename T>
+	static void writeValue(std::ostream& s, T const& value)
+	{
+		s.write(reinterpret_cast<char const*>(&value), sizeof(value));
+	}
+
+	template <typename T>
+	static bool readValue(std::istream& s, T& value)
+	{
+		return static_cast<bool>(s.read(reinterpret_cast<char*>(&value), sizeof(value)));
+	}
+};
+}  // namespace ufo::map
+
+#endif  // UFO_MAP_FILE_INDEX_H
@@ -125,17 +125,17 @@ class OccupancyMapNearestIterator
 
 	bool containsOccupied() const
 	{
-		return containsOccupied(Base::container_.top(), Base::getDepth());
+		return containsOccupied(Base::container_.top());
 	}
 
 	bool containsFree() const
 	{
-		return containsFree(Base::container_.top(), Base::getDepth());
+		return containsFree(Base::container_.top());
 	}
 
 	bool containsUnknown() const
 	{
-		return containsUnknown(Base::container_.top(), Base::getDepth());
+		return containsUnknown(Base::container_.top());
 	}
 
 	double getOccupancy() const
@@ -67,6 +67,9 @@ class OctreeIterator
 		// Indicates if this node is completely inside the bounding volume.
 		// Meaning its children does not have to do any intersection checks.
 		bool inside;
+		// Which children intersect, and are inside, the bounding volume. Computed for all
+		// children at once when descending into them, unless the node is inside.
+		ufo::geometry::ChildrenMask children;
 	};
 
  public:
@@ -140,7 +143,7 @@ class OctreeIterator
 
 	ufo::geometry::AABB getBoundingVolume() const { return path_[current_depth_].aabb; }
 
-	// bool completelyInsideBoundingVolume() const { return path_[current_depth_].inside; }
+	bool completelyInsideBoundingVolume() const { return path_[current_depth_].inside; }
 
 	DepthType getDepth() const { return current_depth_; }
 
@@ -197,7 +200,8 @@ class OctreeIterator
 			path_[depth].aabb.half_size = Point3(s, s, s);
 		}
 
-		if (validNode(node, current_depth_) && current_depth_ >= min_depth_) {
+		if ((node.inside || bounding_volume_.intersects(node.aabb)) &&
+		    validNode(node, current_depth_) && current_depth_ >= min_depth_) {
 			path_[current_depth_] = node;
 			if (!validReturnNode()) {
 				operator++();
@@ -210,38 +214,11 @@ class OctreeIterator
 
 	bool hasMore() const { return getDepth() <= max_depth_; }
 
-	virtual bool validNode(IteratorNode& node, DepthType) const
+	virtual bool validNode(IteratorNode&, DepthType) const
 	{
-		if (node.inside) {
-			return true;
-		}
-
-		// Bounding volume can only contain one otherwise we cannot make sure the node is
-		// completely inside and we therefore only do the simple intersection test instead
-		// if (0 < depth && 1 == bounding_volume_.size()) {
-		// 	// Check if the node is completely inside the bounding volume
-		// 	double hs = node.aabb.half_size[0];
-		// 	Point3 const& c = node.aabb.center;
-		// 	std::array<Point3, 8> corners = {Point3(-hs, -hs, -hs), Point3(-hs, -hs, hs),
-		// 	                                 Point3(-hs, hs, -hs),  Point3(-hs, hs, hs),
-		// 	                                 Point3(hs, -hs, -hs),  Point3(hs, -hs, hs),
-		// 	                                 Point3(hs, hs, -hs),   Point3(hs, hs, hs)};
-		// 	bool one_inside = false;
-		// 	node.inside = true;
-		// 	for (Point3 const& offset : corners) {
-		// 		if (!bounding_volume_.intersects(c + offset)) {
-		// 			// The node is not completely inside the bounding volume
-		// 			node.inside = false;
-		// 			break;
-		// 		}
-		// 		one_inside = true;
-		// 	}
-
-		// 	if (one_inside) {
-		// 		return true;
-		// 	}
-		// }
-		return bounding_volume_.intersects(node.aabb);
+		// The bounding volume has already been tested, for all siblings at once in
+		// getNextNode
+		return true;
 	}
 
 	virtual bool validReturnNode() const
@@ -299,14 +276,21 @@ class OctreeIterator
 	{
 		DepthType depth = current_depth_;
 		DepthType parent_depth = depth + 1;
-		Point3 const& p_center = path_[parent_depth].aabb.center;
+		IteratorNode& parent = path_[parent_depth];
+		Point3 const& p_center = parent.aabb.center;
 		double hs = path_[depth].aabb.half_size[0];
+		if (0 == path_[depth].index && !parent.inside) {
+			parent.children = bounding_volume_.intersectsChildren(p_center, hs);
+		}
 		for (; 8 > path_[depth].index; ++path_[depth].index) {
-			INNER_NODE const& inner_node =
-			    static_cast<INNER_NODE const&>(*path_[parent_depth].node);
-			path_[depth].node = &tree_->getChild(inner_node, depth, path_[depth].index);
-			path_[depth].aabb.center = tree_->getChildCenter(p_center, hs, path_[depth].index);
-			path_[depth].inside = path_[parent_depth].inside;
+			unsigned int const index = path_[depth].index;
+			if (!parent.inside && !((parent.children.intersects >> index) & 1U)) {
+				continue;
+			}
+			INNER_NODE const& inner_node = static_cast<INNER_NODE const&>(*parent.node);
+			path_[depth].node = &tree_->getChild(inner_node, depth, index);
+			path_[depth].aabb.center = tree_->getChildCenter(p_center, hs, index);
+			path_[depth].inside = parent.inside || ((parent.children.inside >> index) & 1U);
 
 			if (validNode(path_[depth], depth)) {
 				return true;
@@ -236,7 +236,7 @@ class OctreeNearestIterator
 		IteratorNode top = container_.top();
 		container_.pop();
 
-		if (getDepth() <= min_depth_ || isLeaf()) {
+		if (top.depth <= min_depth_ || tree_->isLeaf(top.node, top.depth)) {
 			return;
 		}
 
@@ -0,0 +1,413 @@
+/**
+ * UFOMap: An Efficient Probabilistic 3D Mapping Framework That Embraces the Unknown
+ *
+ * @author D. Duberg, KTH Royal Institute of Technology, Copyright (c) 2020.
+ * @see https://github.com/UnknownFreeOccupied/ufomap
+ * License: BSD 3
+ *
+ */
+
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, D. Duberg, KTH Royal Institute of Technology
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef UFO_MAP_LZ4_BLOCK_STREAM_H
+#define UFO_MAP_LZ4_BLOCK_STREAM_H
+
+// STD
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+// Compression
+#include <lz4.h>
+#include <lz4hc.h>
+
+namespace ufo::map
+{
+/**
+ * @brief Framed LZ4 format, the data is split into blocks that are compressed
+ * independently of each other so they can be compressed and decompressed in parallel.
+ *
+ * @details The format is the magic bytes followed by frames, each frame is the
+ * uncompressed size (uint32), the compressed size (uint32) and the compressed bytes.
+ * A frame with an uncompressed size of zero ends the data.
+ */
+struct LZ4BlockFormat {
+	static constexpr char MAGIC[4] = {'U', 'F', 'O', 'B'};
+
+	/**
+	 * @brief Where a frame starts, relative to the magic bytes, and where its data starts
+	 * in the uncompressed data
+	 */
+	struct Frame {
+		std::uint64_t offset;
+		std::uint64_t uncompressed_offset;
+	};
+
+	/**
+	 * @brief Consume the magic bytes if s is at the start of framed data, otherwise leave
+	 * s where it was
+	 */
+	static bool readMagic(std::istream& s)
+	{
+		std::streampos const position = s.tellg();
+		char magic[sizeof(MAGIC)];
+		if (s.read(magic, sizeof(magic)) && 0 == std::memcmp(magic, MAGIC, sizeof(MAGIC))) {
+			return true;
+		}
+		s.clear();
+		s.seekg(position);
+		return false;
+	}
+};
+
+/**
+ * @brief Output stream buffer that writes everything put into it to an underlying
+ * stream in the framed LZ4 format.
+ *
+ * @details Full blocks are compressed in the background while the next is filled. At
+ * most two blocks per thread are in memory at any time.
+ */
+class LZ4BlockOutputBuffer : public std::streambuf
+{
+ private:
+	using Block = std::vector<char>;
+
+ public:
+	LZ4BlockOutputBuffer(std::ostream& out, std::size_t block_size,
+	                     unsigned int num_threads, int acceleration_level = 1,
+	                     int compression_level = 0)
+	    : out_(out),
+	      block_size_(std::clamp(block_size, std::size_t(1),
+	                             static_cast<std::size_t>(LZ4_MAX_INPUT_SIZE))),
+	      max_pending_(2 * std::max(1U, num_threads)),
+	      parallel_(1 < num_threads),
+	      acceleration_level_(acceleration_level),
+	      compression_level_(compression_level)
+	{
+		out_.write(LZ4BlockFormat::MAGIC, sizeof(LZ4BlockFormat::MAGIC));
+		nextBlock();
+	}
+
+	~LZ4BlockOutputBuffer() { finish(); }
+
+	/**
+	 * @brief Compress and write what is left and end the data. Nothing can be put into
+	 * the buffer afterwards.
+	 *
+	 * @return true If everything was compressed and written
+	 */
+	bool finish()
+	{
+		if (!finished_) {
+			finished_ = true;
+			submit();
+			while (!pending_.empty()) {
+				writeFront();
+			}
+			std::uint32_t const end[2] = {0, 0};
+			out_.write(reinterpret_cast<char const*>(end), sizeof(end));
+			compressed_size_ += sizeof(end);
+			setp(nullptr, nullptr);
+		}
+		return !failed_ && out_.good();
+	}
+
+	/**
+	 * @return The number of uncompressed bytes put into the buffer
+	 */
+	std::uint64_t size() const noexcept
+	{
+		return uncompressed_size_ + (pptr() - pbase());
+	}
+
+	/**
+	 * @return The number of bytes written to the underlying stream, complete after finish
+	 */
+	std::uint64_t compressedSize() const noexcept { return compressed_size_; }
+
+	/**
+	 * @return The frames written to the underlying stream, complete after finish
+	 */
+	std::vector<LZ4BlockFormat::Frame> const& frames() const noexcept { return frames_; }
+
+ protected:
+	int_type overflow(int_type ch) override
+	{
+		if (finished_) {
+			return traits_type::eof();
+		}
+		submit();
+		if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+			*pptr() = traits_type::to_char_type(ch);
+			pbump(1);
+		}
+		return traits_type::not_eof(ch);
+	}
+
+	std::streamsize xsputn(char const* s, std::streamsize n) override
+	{
+		if (finished_) {
+			return 0;
+		}
+		std::streamsize written = 0;
+		while (written < n) {
+			if (pptr() == epptr()) {
+				submit();
+			}
+			std::streamsize const count = std::min(n - written, std::streamsize(epptr() - pptr()));
+			std::memcpy(pptr(), s + written, count);
+			pbump(static_cast<int>(count));
+			written += count;
+		}
+		return written;
+	}
+
+ private:
+	void nextBlock()
+	{
+		block_.resize(block_size_);
+		setp(block_.data(), block_.data() + block_.size());
+	}
+
+	void submit()
+	{
+		std::size_t const size = pptr() - pbase();
+		if (0 == size) {
+			return;
+		}
+		block_.resize(size);
+		uncompressed_size_ += size;
+
+		pending_.push_back(std::async(parallel_ ? std::launch::async : std::launch::deferred,
+		                              &LZ4BlockOutputBuffer::compress, std::move(block_),
+		                              acceleration_level_, compression_level_));
+		while (max_pending_ <= pending_.size()) {
+			writeFront();
+		}
+
+		block_ = Block();
+		if (!finished_) {
+			nextBlock();
+		}
+	}
+
+	void writeFront()
+	{
+		auto [uncompressed_size, compressed] = pending_.front().get();
+		pending_.pop_front();
+		if (0 == compressed.size()) {
+			failed_ = true;
+			return;
+		}
+		std::uint32_t const sizes[2] = {uncompressed_size,
+		                                static_cast<std::uint32_t>(compressed.size())};
+		out_.write(reinterpret_cast<char const*>(sizes), sizeof(sizes));
+		out_.write(compressed.data(), compressed.size());
+
+		frames_.push_back({compressed_size_, written_size_});
+		compressed_size_ += sizeof(sizes) + compressed.size();
+		written_size_ += uncompressed_size;
+	}
+
+	static std::pair<std::uint32_t, Block> compress(Block data, int acceleration_level,
+	                                                int compression_level)
+	{
+		int const size = static_cast<int>(data.size());
+		Block compressed(LZ4_compressBound(size));
+		int const capacity = static_cast<int>(compressed.size());
+		int compressed_size;
+		if (0 >= compression_level) {
+			compressed_size = LZ4_compress_fast(data.data(), compressed.data(), size, capacity,
+			                                    acceleration_level);
+		} else {
+			compressed_size = LZ4_compress_HC(data.data(), compressed.data(), size, capacity,
+			                                  compression_level);
+		}
+		compressed.resize(std::max(0, compressed_size));
+		return {static_cast<std::uint32_t>(data.size()), std::move(compressed)};
+	}
+
+ private:
+	std::ostream& out_;
+	std::size_t block_size_;
+	std::size_t max_pending_;
+	bool parallel_;
+	int acceleration_level_;
+	int compression_level_;
+
+	Block block_;
+	std::deque<std::future<std::pair<std::uint32_t, Block>>> pending_;
+	std::uint64_t uncompressed_size_ = 0;
+
+	// What has been written to the underlying stream
+	std::vector<LZ4BlockFormat::Frame> frames_;
+	std::uint64_t compressed_size_ = sizeof(LZ4BlockFormat::MAGIC);
+	std::uint64_t written_size_ = 0;
+	bool finished_ = false;
+	bool failed_ = false;
+};
+
+/**
+ * @brief Input stream buffer that reads data in the framed LZ4 format from an
+ * underlying stream, the magic bytes should already have been read.
+ *
+ * @details Blocks ahead of the one being read are decompressed in the background. The
+ * underlying stream is only read up to the end of the framed data.
+ */
+class LZ4BlockInputBuffer : public std::streambuf
+{
+ private:
+	using Block = std::vector<char>;
+
+ public:
+	LZ4BlockInputBuffer(std::istream& in, unsigned int num_threads)
+	    : in_(in), max_pending_(2 * std::max(1U, num_threads)), parallel_(1 < num_threads)
+	{
+		setg(nullptr, nullptr, nullptr);
+	}
+
+	/**
+	 * @brief Read, and discard, the rest of the framed data
+	 *
+	 * @return true If all data was valid
+	 */
+	bool finish()
+	{
+		do {
+			setg(egptr(), egptr(), egptr());
+		} while (!traits_type::eq_int_type(traits_type::eof(), underflow()));
+		return !failed_;
+	}
+
+	bool failed() const noexcept { return failed_; }
+
+ protected:
+	int_type underflow() override
+	{
+		if (gptr() < egptr()) {
+			return traits_type::to_int_type(*gptr());
+		}
+
+		fill();
+		if (pending_.empty()) {
+			return traits_type::eof();
+		}
+
+		current_ = pending_.front().get();
+		pending_.pop_front();
+		if (current_.empty()) {
+			failed_ = true;
+			pending_.clear();
+			done_ = true;
+			return traits_type::eof();
+		}
+		setg(current_.data(), current_.data(), current_.data() + current_.size());
+		fill();
+		return traits_type::to_int_type(*gptr());
+	}
+
+	std::streamsize xsgetn(char* s, std::streamsize n) override
+	{
+		std::streamsize read = 0;
+		while (read < n) {
+			if (gptr() == egptr() && traits_type::eof() == underflow()) {
+				break;
+			}
+			std::streamsize const count = std::min(n - read, std::streamsize(egptr() - gptr()));
+			std::memcpy(s + read, gptr(), count);
+			gbump(static_cast<int>(count));
+			read += count;
+		}
+		return read;
+	}
+
+ private:
+	/**
+	 * @brief Read frames and start decompressing them until enough are in flight
+	 */
+	void fill()
+	{
+		while (!done_ && max_pending_ > pending_.size()) {
+			std::uint32_t sizes[2];
+			if (!in_.read(reinterpret_cast<char*>(sizes), sizeof(sizes))) {
+				failed_ = true;
+				done_ = true;
+				return;
+			}
+			if (0 == sizes[0]) {
+				done_ = true;
+				return;
+			}
+
+			Block compressed(sizes[1]);
+			if (!in_.read(compressed.data(), compressed.size())) {
+				failed_ = true;
+				done_ = true;
+				return;
+			}
+			pending_.push_back(std::async(
+			    parallel_ ? std::launch::async : std::launch::deferred,
+			    &LZ4BlockInputBuffer::decompress, std::move(compressed), sizes[0]));
+		}
+	}
+
+	static Block decompress(Block compressed, std::uint32_t uncompressed_size)
+	{
+		Block data(uncompressed_size);
+		int const size =
+		    LZ4_decompress_safe(compressed.data(), data.data(),
+		                        static_cast<int>(compressed.size()), uncompressed_size);
+		// An empty block marks a failure, valid blocks are never empty
+		data.resize(static_cast<std::uint32_t>(size) == uncompressed_size ? size : 0);
+		return data;
+	}
+
+ private:
+	std::istream& in_;
+	std::size_t max_pending_;
+	bool parallel_;
+
+	Block current_;
+	std::deque<std::future<Block>> pending_;
+	bool done_ = false;
+	bool failed_ = false;
+};
+}  // namespace ufo::map
+
+#endif  // UFO_MAP_LZ4_BLOCK_STREAM_H
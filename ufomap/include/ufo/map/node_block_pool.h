@@ -0,0 +1,393 @@
+/**
+ * UFOMap: An Efficient Probabilistic 3D Mapping Framework That Embraces the Unknown
+ *
+ * @author D. Duberg, KTH Royal Institute of Technology, Copyright (c) 2020.
+ * @see https://github.com/UnknownFreeOccupied/ufomap
+ * License: BSD 3
+ *
+ */
+
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, D. Duberg, KTH Royal Institute of Technology
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef UFO_MAP_NODE_BLOCK_POOL_H
+#define UFO_MAP_NODE_BLOCK_POOL_H
+
+// STD
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace ufo::map
+{
+/**
+ * @brief Slab allocator for blocks of eight sibling nodes
+ *
+ * @details Blocks are handed out from large slabs and returned blocks are put on a
+ * free list so they can be reused by the next split. All memory is released at once
+ * when the pool is cleared, meaning the octree does not have to be walked.
+ *
+ * Slabs are made up of SEGMENT_SIZE aligned segments and a block never crosses a
+ * segment boundary, so the block containing any address handed out by a pool can be
+ * found with blockOf without knowing which pool it came from.
+ *
+ * allocate and deallocate can be called concurrently from multiple threads. Each thread
+ * works on a cache of free blocks of its own, which takes from and gives back to the
+ * shared pool whole batches of BATCH_SIZE blocks, so threads only contend for the shared
+ * pool once every BATCH_SIZE blocks.
+ *
+ * @tparam BLOCK The block type, normally std::array<NODE, 8>
+ */
+template <typename BLOCK>
+class NodeBlockPool
+{
+	static_assert(std::is_trivially_destructible_v<BLOCK>,
+	              "Blocks are released without calling their destructor");
+
+	// A free block stores the pointer to the next free block in its batch, and the first
+	// block of a batch in the shared pool the pointer to the next batch
+	union Slot {
+		struct {
+			Slot* next;
+			Slot* next_batch;
+		} free;
+		alignas(BLOCK) unsigned char data[sizeof(BLOCK)];
+	};
+
+	// Number of per thread caches of free blocks
+	inline static constexpr std::size_t NUM_CACHES = 64;
+	// Number of blocks moved between a cache and the shared pool at a time
+	inline static constexpr std::size_t BATCH_SIZE = 32;
+
+ public:
+	NodeBlockPool(std::size_t slab_size = DEFAULT_SLAB_SIZE, bool huge_pages = false)
+	    : slab_size_(slab_size), huge_pages_(huge_pages)
+	{
+		updateBlocksPerSlab();
+	}
+
+	NodeBlockPool(NodeBlockPool const&) = delete;
+
+	NodeBlockPool& operator=(NodeBlockPool const&) = delete;
+
+	~NodeBlockPool() { clear(); }
+
+	/**
+	 * @brief Get a default constructed block
+	 *
+	 * @return BLOCK* Pointer to the block
+	 */
+	BLOCK* allocate()
+	{
+		Cache& cache = threadCache();
+		Slot* slot;
+		{
+			std::lock_guard<std::mutex> lock(cache.mutex);
+			if (!cache.loaded) {
+				cache.loaded = cache.spare ? std::exchange(cache.spare, nullptr) : takeBatch();
+				cache.num_loaded = BATCH_SIZE;
+			}
+			slot = cache.loaded;
+			cache.loaded = slot->free.next;
+			--cache.num_loaded;
+			cache.add(1);
+		}
+		return new (slot->data) BLOCK();
+	}
+
+	/**
+	 * @brief Return a block to the pool, it will be reused by a later allocate
+	 *
+	 * @param block The block to return
+	 */
+	void deallocate(BLOCK* block) noexcept
+	{
+		Cache& cache = threadCache();
+		{
+			std::lock_guard<std::mutex> lock(cache.mutex);
+			if (BATCH_SIZE == cache.num_loaded) {
+				if (cache.spare) {
+					giveBatch(cache.spare);
+				}
+				cache.spare = std::exchange(cache.loaded, nullptr);
+				cache.num_loaded = 0;
+			}
+			Slot* slot = reinterpret_cast<Slot*>(block);
+			slot->free.next = cache.loaded;
+			cache.loaded = slot;
+			++cache.num_loaded;
+			cache.add(-1);
+		}
+	}
+
+	/**
+	 * @brief Get the block that contains an address
+	 *
+	 * @param address Address of a block, or of anything inside it, handed out by a pool
+	 * @return BLOCK* The block containing address
+	 */
+	static BLOCK* blockOf(void const* address) noexcept
+	{
+		std::uintptr_t addr = reinterpret_cast<std::uintptr_t>(address);
+		std::uintptr_t segment = addr & ~(std::uintptr_t(SEGMENT_SIZE) - 1);
+		return reinterpret_cast<BLOCK*>(segment +
+		                                ((addr - segment) / sizeof(Slot)) * sizeof(Slot));
+	}
+
+	/**
+	 * @brief Release all slabs, invalidates every block handed out by the pool. Must not
+	 * be called concurrently with allocate or deallocate.
+	 */
+	void clear() noexcept
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (auto const& slab : slabs_) {
+			std::free(slab.first);
+		}
+		slabs_.clear();
+		for (Cache& cache : caches_) {
+			cache.loaded = nullptr;
+			cache.num_loaded = 0;
+			cache.spare = nullptr;
+			cache.num_used = 0;
+		}
+		free_batches_ = nullptr;
+		next_in_slab_ = 0;
+		num_slabs_ = 0;
+		memory_reserved_ = 0;
+	}
+
+	//
+	// Settings
+	//
+
+	/**
+	 * @brief Back new slabs with huge pages (if supported by the system)
+	 *
+	 * @param enable Whether huge pages should be used for slabs allocated from now on
+	 */
+	void enableHugePages(bool enable) noexcept
+	{
+		huge_pages_ = enable;
+		updateBlocksPerSlab();
+	}
+
+	bool isHugePagesEnabled() const noexcept { return huge_pages_; }
+
+	//
+	// Memory
+	//
+
+	/**
+	 * @return std::size_t number of blocks currently handed out
+	 */
+	std::size_t numBlocks() const noexcept
+	{
+		// A block can be returned to another cache than it was taken from
+		std::ptrdiff_t num = 0;
+		for (Cache const& cache : caches_) {
+			num += cache.num_used.load(std::memory_order_relaxed);
+		}
+		return static_cast<std::size_t>(std::max(std::ptrdiff_t(0), num));
+	}
+
+	/**
+	 * @return std::size_t number of slabs allocated
+	 */
+	std::size_t numSlabs() const noexcept { return num_slabs_; }
+
+	/**
+	 * @return std::size_t bytes reserved from the system
+	 */
+	std::size_t memoryReserved() const noexcept { return memory_reserved_; }
+
+	/**
+	 * @return std::size_t bytes of the reserved memory holding blocks in use
+	 */
+	std::size_t memoryInUse() const noexcept { return numBlocks() * sizeof(Slot); }
+
+ private:
+	// Free blocks of the threads using it. Blocks are taken from and given to the loaded
+	// batch, and the spare batch is full. So a thread going back and forth around a
+	// multiple of BATCH_SIZE blocks does not go to the shared pool every time.
+	struct alignas(64) Cache {
+		Slot* loaded = nullptr;
+		std::size_t num_loaded = 0;
+		Slot* spare = nullptr;
+		// Blocks taken minus blocks given back, only written with mutex held
+		std::atomic<std::ptrdiff_t> num_used = 0;
+		std::mutex mutex;  // Only contended if more than NUM_CACHES threads are working
+
+		// Not a read-modify-write, which would be as costly as the rest of allocate
+		void add(std::ptrdiff_t num) noexcept
+		{
+			num_used.store(num_used.load(std::memory_order_relaxed) + num,
+			               std::memory_order_relaxed);
+		}
+	};
+
+	/**
+	 * @brief The cache of the calling thread. Threads get consecutive numbers, so the
+	 * threads working at the same time have caches of their own unless there are more
+	 * than NUM_CACHES of them.
+	 */
+	Cache& threadCache() noexcept
+	{
+		// Constant initialized, so it is not guarded
+		thread_local std::size_t thread_number = NO_THREAD_NUMBER;
+		if (NO_THREAD_NUMBER == thread_number) {
+			thread_number = next_thread_number_.fetch_add(1, std::memory_order_relaxed);
+		}
+		return caches_[thread_number % NUM_CACHES];
+	}
+
+	/**
+	 * @brief Take a full batch from the shared pool, new batches are in address order
+	 */
+	Slot* takeBatch()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (Slot* batch = free_batches_) {
+			free_batches_ = batch->free.next_batch;
+			return batch;
+		}
+
+		Slot* first = nullptr;
+		Slot** last = &first;
+		for (std::size_t i = 0; i < BATCH_SIZE; ++i) {
+			if (slabs_.empty() || blocks_per_slab_ == next_in_slab_) {
+				allocateSlab();
+			}
+			Slot* slot = reinterpret_cast<Slot*>(
+			                 reinterpret_cast<unsigned char*>(slabs_.back().first) +
+			                 (next_in_slab_ / BLOCKS_PER_SEGMENT) * SEGMENT_SIZE) +
+			             (next_in_slab_ % BLOCKS_PER_SEGMENT);
+			++next_in_slab_;
+			*last = slot;
+			last = &slot->free.next;
+		}
+		*last = nullptr;
+		return first;
+	}
+
+	/**
+	 * @brief Give a full batch back to the shared pool
+	 */
+	void giveBatch(Slot* batch) noexcept
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		batch->free.next_batch = free_batches_;
+		free_batches_ = batch;
+	}
+
+	void updateBlocksPerSlab() noexcept
+	{
+		std::size_t bytes = roundUp(std::max(slab_size_, std::size_t(1)),
+		                            huge_pages_ ? HUGE_PAGE_SIZE : SEGMENT_SIZE);
+		blocks_per_slab_ = (bytes / SEGMENT_SIZE) * BLOCKS_PER_SEGMENT;
+		// Start on a new slab so the current one is not overrun
+		if (!slabs_.empty()) {
+			next_in_slab_ = blocks_per_slab_;
+		}
+	}
+
+	void allocateSlab()
+	{
+		std::size_t bytes = (blocks_per_slab_ / BLOCKS_PER_SEGMENT) * SEGMENT_SIZE;
+		void* slab = nullptr;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+		if (huge_pages_) {
+			slab = std::aligned_alloc(HUGE_PAGE_SIZE, bytes);
+			if (slab) {
+				madvise(slab, bytes, MADV_HUGEPAGE);
+			}
+		} else {
+			slab = std::aligned_alloc(SEGMENT_SIZE, bytes);
+		}
+#else
+		slab = std::aligned_alloc(SEGMENT_SIZE, bytes);
+#endif
+		if (!slab) {
+			throw std::bad_alloc();
+		}
+		slabs_.emplace_back(static_cast<Slot*>(slab), bytes);
+		next_in_slab_ = 0;
+		num_slabs_ = slabs_.size();
+		memory_reserved_ += bytes;
+	}
+
+	static constexpr std::size_t roundUp(std::size_t value, std::size_t multiple) noexcept
+	{
+		return ((value + multiple - 1) / multiple) * multiple;
+	}
+
+ private:
+	std::vector<std::pair<Slot*, std::size_t>> slabs_;  // Slabs and their size in bytes
+	Slot* free_batches_ = nullptr;                      // Full batches returned
+	std::size_t next_in_slab_ = 0;     // Next never used block in the last slab
+	std::size_t blocks_per_slab_ = 0;  // Number of blocks that fit in a slab
+	std::mutex mutex_;                 // Guards the slabs and the returned batches
+
+	std::array<Cache, NUM_CACHES> caches_;  // Per thread caches of free blocks
+
+	// Statistics, read without locking
+	std::atomic_size_t num_slabs_ = 0;        // Number of slabs allocated
+	std::atomic_size_t memory_reserved_ = 0;  // Bytes of the slabs
+
+	std::size_t slab_size_;  // Requested slab size in bytes
+	bool huge_pages_;        // Back slabs with huge pages
+
+	inline static const std::size_t SEGMENT_SIZE = std::size_t(1) << 20;  // 1 MiB
+	inline static const std::size_t BLOCKS_PER_SEGMENT = SEGMENT_SIZE / sizeof(Slot);
+	inline static const std::size_t DEFAULT_SLAB_SIZE = SEGMENT_SIZE;
+	inline static const std::size_t HUGE_PAGE_SIZE = std::size_t(1) << 21;  // 2 MiB
+
+	inline static constexpr std::size_t NO_THREAD_NUMBER =
+	    std::numeric_limits<std::size_t>::max();
+	inline static std::atomic_size_t next_thread_number_ = 0;
+};
+}  // namespace ufo::map
+
+#endif  // UFO_MAP_NODE_BLOCK_POOL_H
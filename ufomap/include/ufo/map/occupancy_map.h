@@ -46,11 +46,12 @@
 
 namespace ufo::map
 {
-class OccupancyMap : public OccupancyMapBase<OccupancyNode<float>>
+class OccupancyMap
+    : public OccupancyMapBase<OccupancyNode<float>, OccupancyMapCompactInnerNode<OccupancyNode<float>>>
 {
  private:
 	using DATA_TYPE = OccupancyNode<float>;
-	using Base = OccupancyMapBase<DATA_TYPE>;
+	using Base = OccupancyMapBase<DATA_TYPE, OccupancyMapCompactInnerNode<DATA_TYPE>>;
 
  public:
 	//
@@ -80,6 +81,19 @@ class OccupancyMap : public OccupancyMapBase<OccupancyNode<float>>
 	//
 
 	virtual std::string getTreeType() const noexcept override { return "occupancy_map"; }
+
+	//
+	// Snapshot
+	//
+
+	/**
+	 * @brief Immutable copy of the map as it is now, which can be read from other threads
+	 * while this map is modified. The nodes are shared until this map modifies them.
+	 */
+	std::shared_ptr<OccupancyMap const> snapshot();
+
+ protected:
+	OccupancyMap(OccupancyMap& other, SnapshotTag tag);
 };
 }  // namespace ufo::map
 
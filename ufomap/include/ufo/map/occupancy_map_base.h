@@ -42,25 +42,56 @@
 #ifndef UFO_MAP_OCCUPANCY_MAP_BASE_H
 #define UFO_MAP_OCCUPANCY_MAP_BASE_H
 
+#include <ufo/map/distance_field.h>
 #include <ufo/map/iterator/occupancy_map.h>
 #include <ufo/map/iterator/occupancy_map_nearest.h>
 #include <ufo/map/occupancy_map_node.h>
 #include <ufo/map/octree.h>
 #include <ufo/map/point_cloud.h>
+#include <ufo/map/traverse.h>
 #include <ufo/map/types.h>
 
+// STD
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Free space rays are cast in packets with AVX2 when the CPU supports it at runtime
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define UFO_MAP_RAY_PACKETS
+#include <immintrin.h>
+#endif
+
 namespace ufo::map
 {
 enum OccupancyState { unknown, free, occupied };
 
-template <typename DATA_TYPE>
-class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYPE>,
-                                       OccupancyMapLeafNode<DATA_TYPE>>
+/**
+ * @tparam DATA_TYPE The data stored in each node
+ * @tparam INNER_NODE_TYPE The inner node type, either OccupancyMapInnerNode or the
+ * structure-of-arrays OccupancyMapCompactInnerNode
+ */
+template <typename DATA_TYPE, typename INNER_NODE_TYPE = OccupancyMapInnerNode<DATA_TYPE>>
+class OccupancyMapBase
+    : public Octree<DATA_TYPE, INNER_NODE_TYPE, OccupancyMapLeafNode<DATA_TYPE>>
 {
  protected:
-	using Base = Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYPE>,
-	                    OccupancyMapLeafNode<DATA_TYPE>>;
-	using INNER_NODE = OccupancyMapInnerNode<DATA_TYPE>;
+	using Base = Octree<DATA_TYPE, INNER_NODE_TYPE, OccupancyMapLeafNode<DATA_TYPE>>;
+	using INNER_NODE = INNER_NODE_TYPE;
 	using LEAF_NODE = OccupancyMapLeafNode<DATA_TYPE>;
 
 	using OccupancyMapBasereeIterator =
@@ -75,10 +106,16 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 	                                true>;
 
 	using LogitType = decltype(DATA_TYPE::occupancy);
+	using Logit = LogitTraits<LogitType>;
 
 	// TODO: Why do I need this here instead of using it from Base?
 	using Path = std::array<LEAF_NODE*, Base::MAX_DEPTH_LEVELS>;
 
+	// Whether the eight leaf children of a node are, byte for byte, their serialized data
+	static constexpr bool BULK_LEAF_CHILDREN =
+	    std::is_trivially_copyable_v<LEAF_NODE> &&
+	    sizeof(typename Base::LeafChildren) == 8 * LEAF_NODE::dataSize();
+
  public:
 	//
 	// Tree type
@@ -95,6 +132,7 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 	                                      bool unknown_space = false, bool contains = false,
 	                                      DepthType min_depth = 0) const noexcept
 	{
+		ensurePropagated();
 		return OccupancyMapBasereeIterator(this, Base::getRoot(),
 		                                   ufo::geometry::BoundingVolume(), occupied_space,
 		                                   free_space, unknown_space, contains, min_depth);
@@ -111,6 +149,7 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 	                                      bool unknown_space = false, bool contains = false,
 	                                      DepthType min_depth = 0) const noexcept
 	{
+		ensurePropagated();
 		ufo::geometry::BoundingVolume bv;
 		bv.add(bounding_volume);
 		return OccupancyMapBasereeIterator(this, Base::getRoot(), bv, occupied_space,
@@ -122,6 +161,7 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 	    bool free_space = true, bool unknown_space = false, bool contains = false,
 	    DepthType min_depth = 0) const noexcept
 	{
+		ensurePropagated();
 		return OccupancyMapBasereeIterator(this, Base::getRoot(), bounding_volume,
 		                                   occupied_space, free_space, unknown_space,
 		                                   contains, min_depth);
@@ -131,6 +171,7 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 	                                     bool unknown_space = false, bool contains = false,
 	                                     DepthType min_depth = 0) const noexcept
 	{
+		ensurePropagated();
 		return OccupancyMapLeafIterator(this, Base::getRoot(),
 		                                ufo::geometry::BoundingVolume(), occupied_space,
 		                                free_space, unknown_space, contains, min_depth);
@@ -146,6 +187,7 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 	                                     bool unknown_space = false, bool contains = false,
 	                                     DepthType min_depth = 0) const noexcept
 	{
+		ensurePropagated();
 		ufo::geometry::BoundingVolume bv;
 		bv.add(bounding_volume);
 		return OccupancyMapLeafIterator(this, Base::getRoot(), bv, occupied_space, free_space,
@@ -157,6 +199,7 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 	    bool free_space = true, bool unknown_space = false, bool contains = false,
 	    DepthType min_depth = 0) const noexcept
 	{
+		ensurePropagated();
 		return OccupancyMapLeafIterator(this, Base::getRoot(), bounding_volume,
 		                                occupied_space, free_space, unknown_space, contains,
 		                                min_depth);
@@ -173,6 +216,7 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 	                                          bool contains = false,
 	                                          DepthType min_depth = 0) const noexcept
 	{
+		ensurePropagated();
 		return OccupancyMapBasereeNNIterator(
 		    this, Base::getRoot(), ufo::geometry::BoundingVolume(), coordinate,
 		    occupied_space, free_space, unknown_space, contains, min_depth);
@@ -188,6 +232,7 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 	    bool occupied_space = true, bool free_space = true, bool unknown_space = false,
 	    bool contains = false, DepthType min_depth = 0) const noexcept
 	{
+		ensurePropagated();
 		ufo::geometry::BoundingVolume bv;
 		bv.add(bounding_volume);
 		return OccupancyMapBasereeNNIterator(this, Base::getRoot(), bv, coordinate,
@@ -200,6 +245,7 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 	    bool occupied_space = true, bool free_space = true, bool unknown_space = false,
 	    bool contains = false, DepthType min_depth = 0) const noexcept
 	{
+		ensurePropagated();
 		return OccupancyMapBasereeNNIterator(this, Base::getRoot(), bounding_volume,
 		                                     coordinate, occupied_space, free_space,
 		                                     unknown_space, contains, min_depth);
@@ -212,6 +258,7 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 	                                         bool contains = false,
 	                                         DepthType min_depth = 0) const noexcept
 	{
+		ensurePropagated();
 		return OccupancyMapLeafNNIterator(
 		    this, Base::getRoot(), ufo::geometry::BoundingVolume(), coordinate,
 		    occupied_space, free_space, unknown_space, contains, min_depth);
@@ -227,6 +274,7 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 	    bool occupied_space = true, bool free_space = true, bool unknown_space = false,
 	    bool contains = false, DepthType min_depth = 0) const noexcept
 	{
+		ensurePropagated();
 		ufo::geometry::BoundingVolume bv;
 		bv.add(bounding_volume);
 		return OccupancyMapLeafNNIterator(this, Base::getRoot(), bv, coordinate,
@@ -239,11 +287,312 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 	    bool occupied_space = true, bool free_space = true, bool unknown_space = false,
 	    bool contains = false, DepthType min_depth = 0) const noexcept
 	{
+		ensurePropagated();
 		return OccupancyMapLeafNNIterator(this, Base::getRoot(), bounding_volume, coordinate,
 		                                  occupied_space, free_space, unknown_space, contains,
 		                                  min_depth);
 	}
 
+	//
+	// Nearest neighbor search
+	//
+
+	struct Neighbor {
+		Code code;
+		Point3 center;
+		// Squared distance from the query point to the closest point of the node
+		double squared_distance;
+	};
+
+	/**
+	 * @brief Find the k nodes closest to point, like the nearest neighbor leaf iterator
+	 * but without allocating. The tree is searched depth first, closest child first, with
+	 * the k best so far kept in a bounded heap. Subtrees are skipped when they are farther
+	 * away than the k:th best or when their contains summaries rule them out.
+	 *
+	 * @param neighbors Filled with the neighbors, closest first. Reuse it between queries
+	 * to not allocate.
+	 */
+	void knnSearch(Point3 const& point, std::size_t k, std::vector<Neighbor>& neighbors,
+	               bool occupied_space = true, bool free_space = false,
+	               bool unknown_space = false, DepthType min_depth = 0) const
+	{
+		ensurePropagated();
+		auto lock = lockAll<SharedLock>();
+		nearestSearch(point, k, std::numeric_limits<double>::infinity(), neighbors,
+		              NearestFilter{occupied_space, free_space, unknown_space, min_depth});
+	}
+
+	/**
+	 * @brief Find all nodes within radius of point, closest first, see knnSearch
+	 */
+	void radiusSearch(Point3 const& point, double radius, std::vector<Neighbor>& neighbors,
+	                  bool occupied_space = true, bool free_space = false,
+	                  bool unknown_space = false, DepthType min_depth = 0) const
+	{
+		ensurePropagated();
+		auto lock = lockAll<SharedLock>();
+		nearestSearch(point, std::numeric_limits<std::size_t>::max(), radius * radius,
+		              neighbors,
+		              NearestFilter{occupied_space, free_space, unknown_space, min_depth});
+	}
+
+	/**
+	 * @brief knnSearch for many points in parallel, using the integration threads
+	 *
+	 * @param neighbors Resized to the number of points, neighbors[i] is filled with the
+	 * neighbors of points[i]
+	 */
+	void knnSearch(std::vector<Point3> const& points, std::size_t k,
+	               std::vector<std::vector<Neighbor>>& neighbors,
+	               bool occupied_space = true, bool free_space = false,
+	               bool unknown_space = false, DepthType min_depth = 0) const
+	{
+		ensurePropagated();
+		auto lock = lockAll<SharedLock>();
+		nearestSearch(points, k, std::numeric_limits<double>::infinity(), neighbors,
+		              NearestFilter{occupied_space, free_space, unknown_space, min_depth});
+	}
+
+	/**
+	 * @brief radiusSearch for many points in parallel, see knnSearch
+	 */
+	void radiusSearch(std::vector<Point3> const& points, double radius,
+	                  std::vector<std::vector<Neighbor>>& neighbors,
+	                  bool occupied_space = true, bool free_space = false,
+	                  bool unknown_space = false, DepthType min_depth = 0) const
+	{
+		ensurePropagated();
+		auto lock = lockAll<SharedLock>();
+		nearestSearch(points, std::numeric_limits<std::size_t>::max(), radius * radius,
+		              neighbors,
+		              NearestFilter{occupied_space, free_space, unknown_space, min_depth});
+	}
+
+	//
+	// Traverse
+	//
+
+	/**
+	 * @brief A node visited by traverse, with the same accessors as the iterators. Only
+	 * valid during the call to the visitor.
+	 */
+	class TraverseNode
+	{
+	 public:
+		DATA_TYPE const* operator->() const { return &node_.value; }
+
+		DATA_TYPE const& operator*() const { return node_.value; }
+
+		Code const& getCode() const { return code_; }
+
+		DepthType getDepth() const { return code_.getDepth(); }
+
+		Point3 const& getCenter() const { return center_; }
+
+		double getX() const { return center_[0]; }
+
+		double getY() const { return center_[1]; }
+
+		double getZ() const { return center_[2]; }
+
+		double getHalfSize() const { return half_size_; }
+
+		double getSize() const { return 2.0 * half_size_; }
+
+		ufo::geometry::AABB getBoundingVolume() const
+		{
+			return ufo::geometry::AABB(center_, half_size_);
+		}
+
+		bool completelyInsideBoundingVolume() const { return inside_; }
+
+		bool isPureLeaf() const { return 0 == getDepth(); }
+
+		bool isLeaf() const { return leaf_; }
+
+		bool hasChildren() const { return !leaf_; }
+
+		bool isOccupied() const { return map_.isOccupied(node_); }
+
+		bool isFree() const { return map_.isFree(node_); }
+
+		bool isUnknown() const { return map_.isUnknown(node_); }
+
+		bool containsOccupied() const { return map_.containsOccupied(node_, getDepth()); }
+
+		bool containsFree() const { return map_.containsFree(node_, getDepth()); }
+
+		bool containsUnknown() const { return map_.containsUnknown(node_, getDepth()); }
+
+		double getOccupancy() const { return map_.getOccupancy(node_); }
+
+	 private:
+		TraverseNode(OccupancyMapBase const& map, LEAF_NODE const& node, Code const& code,
+		             Point3 const& center, double half_size, bool leaf, bool inside)
+		    : map_(map),
+		      node_(node),
+		      code_(code),
+		      center_(center),
+		      half_size_(half_size),
+		      leaf_(leaf),
+		      inside_(inside)
+		{
+		}
+
+		friend class OccupancyMapBase;
+
+	 private:
+		OccupancyMapBase const& map_;
+		LEAF_NODE const& node_;
+		Code const& code_;
+		Point3 const& center_;
+		double half_size_;
+		bool leaf_;
+		bool inside_;
+	};
+
+	/**
+	 * @brief Call visitor with each node selected by predicate, in the same order as
+	 * beginTree and beginLeaves would return them. The filters are resolved at compile
+	 * time and the code and center of each node are carried down the recursion, so this is
+	 * several times faster than the iterators. Same as for the iterators, the map must not
+	 * be modified during the traversal.
+	 *
+	 * @param visitor Called as visitor(TraverseNode const&)
+	 */
+	template <bool OCCUPIED_SPACE, bool FREE_SPACE, bool UNKNOWN_SPACE, bool ONLY_LEAVES,
+	          bool CONTAINS, typename BoundingType, typename Visitor>
+	void traverse(TraversePredicate<OCCUPIED_SPACE, FREE_SPACE, UNKNOWN_SPACE, ONLY_LEAVES,
+	                                CONTAINS, BoundingType> const& predicate,
+	              Visitor&& visitor) const
+	{
+		if constexpr (std::is_same_v<BoundingType, ufo::geometry::BoundingVar>) {
+			// Resolve the type once, so the intersection tests are not dispatched
+			std::visit(
+			    [this, &predicate, &visitor](auto const& bv) {
+				    traverse(TraversePredicate<OCCUPIED_SPACE, FREE_SPACE, UNKNOWN_SPACE,
+				                               ONLY_LEAVES, CONTAINS, std::decay_t<decltype(bv)>>{
+				                 predicate.min_depth, bv},
+				             visitor);
+			    },
+			    predicate.bounding_volume);
+			return;
+		} else {
+			ensurePropagated();
+
+			DepthType const depth = Base::getTreeDepthLevels();
+			if (depth < predicate.min_depth) {
+				return;
+			}
+
+			Point3 const center(0, 0, 0);
+			ufo::geometry::AABB const aabb(center, Base::getNodeHalfSize(depth));
+			bool inside = true;
+			if constexpr (std::is_same_v<BoundingType, ufo::geometry::BoundingVolume>) {
+				inside = predicate.bounding_volume.empty();
+				if (!inside && !predicate.bounding_volume.intersects(aabb)) {
+					return;
+				}
+			} else if constexpr (!std::is_same_v<BoundingType, std::monostate>) {
+				inside = false;
+				if (!geometry::intersects(predicate.bounding_volume, aabb)) {
+					return;
+				}
+			}
+
+			// The same filters as OccupancyMapIterator
+			INNER_NODE const& root = Base::getRoot();
+			bool const is_space = (OCCUPIED_SPACE && isOccupied(root)) ||
+			                      (FREE_SPACE && isFree(root)) ||
+			                      (UNKNOWN_SPACE && isUnknown(root));
+			bool const contains_space = (OCCUPIED_SPACE && containsOccupied(root)) ||
+			                            (FREE_SPACE && containsFree(root)) ||
+			                            (UNKNOWN_SPACE && containsUnknown(root));
+			if (CONTAINS || predicate.min_depth != depth ? !contains_space : !is_space) {
+				return;
+			}
+
+			bool const leaf = Base::isLeaf(root);
+			bool const last = leaf || predicate.min_depth >= depth;
+			bool const visit = !ONLY_LEAVES && CONTAINS ? contains_space : is_space;
+			if ((!ONLY_LEAVES || last) && visit) {
+				visitor(TraverseNode(*this, root, Base::getRootCode(), center,
+				                     Base::getNodeHalfSize(depth), leaf, inside));
+			}
+
+			if (!last) {
+				traverseRecurs(root, Base::getRootCode(), center, inside, predicate, visitor);
+			}
+		}
+	}
+
+	//
+	// Clear
+	//
+
+	using Base::clear;
+
+	virtual void clear(double new_resolution, DepthType new_depth_levels) override
+	{
+		Base::clear(new_resolution, new_depth_levels);
+		if (distance_field_) {
+			distance_field_ = std::make_unique<DistanceField>(
+			    new_resolution, Base::max_value_, distance_field_->getMaxDistance());
+		}
+	}
+
+	//
+	// Distance field
+	//
+
+	/**
+	 * @brief Maintain a Euclidean distance field to the occupied space at depth 0, see
+	 * DistanceField. It is updated incrementally from the nodes whose occupancy may have
+	 * changed when a point cloud is integrated, a value is set or updated and by
+	 * setValueVolume. It is rebuilt when the map is read, a delta is applied or the map is
+	 * cleared. Copies and snapshots do not have one. Disabled by default.
+	 *
+	 * @param max_distance Distances are computed up to this distance
+	 */
+	void enableDistanceField(bool enable, double max_distance = 1.0)
+	{
+		if (!enable) {
+			distance_field_.reset();
+			return;
+		}
+		insertPointCloudWait();
+		distance_field_ = std::make_unique<DistanceField>(Base::getResolution(),
+		                                                  Base::max_value_, max_distance);
+		rebuildDistanceField();
+	}
+
+	bool isDistanceFieldEnabled() const noexcept { return nullptr != distance_field_; }
+
+	/**
+	 * @brief Distance from each of the points to the closest occupied voxel, trilinearly
+	 * interpolated and at most the maximum distance of the distance field
+	 *
+	 * @param distances Resized to the number of points
+	 */
+	void distance(std::vector<Point3> const& points, std::vector<double>& distances) const
+	{
+		distances.resize(points.size());
+		distanceQuery(points, distances.data(), nullptr);
+	}
+
+	/**
+	 * @brief Same as distance, together with the gradient of the distance at each point
+	 */
+	void distanceAndGradient(std::vector<Point3> const& points,
+	                         std::vector<double>& distances,
+	                         std::vector<Point3>& gradients) const
+	{
+		distances.resize(points.size());
+		gradients.resize(points.size());
+		distanceQuery(points, distances.data(), gradients.data());
+	}
+
 	//
 	// Integration
 	//
@@ -272,7 +621,8 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 	                      DepthType depth = 0, bool simple_ray_casting = false,
 	                      unsigned int early_stopping = 0, bool async = false)
 	{
-		std::vector<std::pair<Code, float>> occupied_hits;
+		CodeSet& indices = insertionIndices();
+		std::vector<std::pair<Code, LogitType>> occupied_hits;
 		occupied_hits.reserve(cloud.size());
 		PointCloud discretized;
 		discretized.reserve(cloud.size());
@@ -292,8 +642,8 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 			if (0 > max_range || distance <= max_range) {
 				// Occupied space
 				Code end_code = Base::toCode(end);
-				if (indices_.insert(end_code).second) {
-					occupied_hits.push_back(std::make_pair(end_code, prob_hit_log_));
+				if (indices.insert(end_code).second) {
+					occupied_hits.emplace_back(end_code, Logit::cast(prob_hit_log_));
 				}
 			} else {
 				direction /= distance;
@@ -308,15 +658,15 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 			}
 		}
 
-		LogitType prob_miss_log = prob_miss_log_ / double((2.0 * depth) + 1);
+		LogitType prob_miss_log = Logit::cast(prob_miss_log_ / double((2.0 * depth) + 1));
 
-		indices_.clear();
+		indices.clear();
 
 		insertPointCloudWait();
 
-		if (async) {
+		if (async && !isThreadSafetyEnabled()) {
 			integrate_ = std::async(
-			    std::launch::async, &OccupancyMapBase<DATA_TYPE>::insertPointCloudHelper, this,
+			    std::launch::async, &OccupancyMapBase::insertPointCloudHelper, this,
 			    sensor_origin, std::move(discretized), std::move(occupied_hits), prob_miss_log,
 			    depth, simple_ray_casting, early_stopping, min_change, max_change);
 		} else {
@@ -345,7 +695,8 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 	{
 		double squared_max_range = max_range * max_range;
 
-		std::vector<std::pair<Code, float>> occupied_hits;
+		CodeSet& indices = insertionIndices();
+		std::vector<std::pair<Code, LogitType>> occupied_hits;
 		occupied_hits.reserve(cloud.size());
 		PointCloud discretized;
 		discretized.reserve(cloud.size());
@@ -355,10 +706,10 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 			if (0 > max_range || (end - sensor_origin).squaredNorm() < squared_max_range) {
 				if (Base::isInside(end)) {
 					Code end_code = Base::toCode(end);
-					if (!indices_.insert(end_code).second) {
+					if (!indices.insert(end_code).second) {
 						continue;
 					}
-					occupied_hits.push_back(std::make_pair(end_code, prob_hit_log_));
+					occupied_hits.emplace_back(end_code, Logit::cast(prob_hit_log_));
 				}
 			} else {
 				Point3 direction = Base::toCoord(Base::toKey(end, depth)) - sensor_origin;
@@ -377,7 +728,7 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 
 			Key end_key = Base::toKey(end, depth);
 
-			if (0 < depth && !indices_.insert(Base::toCode(end_key)).second) {
+			if (0 < depth && !indices.insert(Base::toCode(end_key)).second) {
 				continue;
 			}
 
@@ -398,15 +749,15 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 			}
 		}
 
-		LogitType prob_miss_log = prob_miss_log_ / double((2.0 * depth) + 1);
+		LogitType prob_miss_log = Logit::cast(prob_miss_log_ / double((2.0 * depth) + 1));
 
-		indices_.clear();
+		indices.clear();
 
 		insertPointCloudWait();
 
-		if (async) {
+		if (async && !isThreadSafetyEnabled()) {
 			integrate_ = std::async(
-			    std::launch::async, &OccupancyMapBase<DATA_TYPE>::insertPointCloudHelper, this,
+			    std::launch::async, &OccupancyMapBase::insertPointCloudHelper, this,
 			    sensor_origin, std::move(discretized), std::move(occupied_hits), prob_miss_log,
 			    depth, simple_ray_casting, early_stopping, min_change, max_change);
 		} else {
@@ -442,47 +793,334 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 		}
 	}
 
+	/**
+	 * @brief Set the number of threads used to ray cast the free space and to update the
+	 * tree when integrating a point cloud
+	 *
+	 * @param num_threads The number of threads, 0 means one per hardware thread
+	 */
+	void setIntegrationThreads(unsigned int num_threads) noexcept
+	{
+		integration_threads_ =
+		    0 == num_threads ? std::max(1U, std::thread::hardware_concurrency()) : num_threads;
+	}
+
+	unsigned int getIntegrationThreads() const noexcept { return integration_threads_; }
+
+	/**
+	 * @brief With deterministic integration the map is bit-identical to the one produced
+	 * using a single thread. Ray casting with early stopping depends on the order the rays
+	 * are cast in, so it is only done in parallel if deterministic integration is disabled.
+	 * Enabled by default.
+	 */
+	void enableDeterministicIntegration(bool enable) noexcept
+	{
+		deterministic_integration_ = enable;
+	}
+
+	bool isDeterministicIntegrationEnabled() const noexcept
+	{
+		return deterministic_integration_;
+	}
+
+	/**
+	 * @brief Set the depth at which the tree is split into subtrees that are updated in
+	 * parallel when integrating a point cloud. Each subtree is updated by a single thread
+	 * and the nodes above the split depth are updated once all subtrees are done.
+	 *
+	 * @param depth The split depth, 0 means the tree is always updated by a single thread
+	 */
+	void setIntegrationSplitDepth(DepthType depth) noexcept
+	{
+		integration_split_depth_ = depth;
+	}
+
+	DepthType getIntegrationSplitDepth() const noexcept { return integration_split_depth_; }
+
+	/**
+	 * @brief With batch integration the updates of a point cloud are sorted in Morton
+	 * order and applied in a single depth-first sweep, so each touched inner node is only
+	 * visited and updated once instead of once per update. Enabled by default.
+	 */
+	void enableBatchIntegration(bool enable) noexcept { batch_integration_ = enable; }
+
+	bool isBatchIntegrationEnabled() const noexcept { return batch_integration_; }
+
+	/**
+	 * @brief With packet ray casting the free space rays are cast four at a time using
+	 * AVX2, giving exactly the same result as casting them one at a time. Only used if the
+	 * CPU supports AVX2, simple ray casting is disabled and there is no early stopping.
+	 * Enabled by default.
+	 */
+	void enablePacketRayCasting(bool enable) noexcept { packet_ray_casting_ = enable; }
+
+	bool isPacketRayCastingEnabled() const noexcept { return packet_ray_casting_; }
+
 	//
-	// Cast ray
+	// Lazy propagation
 	//
 
-	std::optional<Code> castRay(Point3 origin, Point3 direction,
-	                            bool ignore_unknown = false, double max_range = -1,
-	                            DepthType depth = 0) const
+	/**
+	 * @brief With lazy propagation updateOccupancy, integrateHit and integrateMiss only
+	 * mark the parents of the updated node as dirty. The dirty nodes are updated by
+	 * propagate, which is called automatically when a point cloud is integrated and before
+	 * the map is queried, iterated or written. Since a query can then modify the map,
+	 * queries must not run concurrently while there are pending updates. Disabled by
+	 * default.
+	 */
+	void enableLazyPropagation(bool enable)
 	{
-		if (0 > max_range) {
-			max_range = Base::getMin().distance(Base::getMin());
+		if (!enable) {
+			propagate();
 		}
+		lazy_propagation_ = enable;
+	}
 
-		direction.normalize();
-		Point3 end = origin + (direction * max_range);
+	bool isLazyPropagationEnabled() const noexcept { return lazy_propagation_; }
 
-		if (!Base::moveLineIntoBBX(origin, end)) {
-			// Line fully outside of octree bounds
-			return std::nullopt;
+	/**
+	 * @brief Update the inner nodes marked dirty by lazy propagation, bottom-up so each is
+	 * only updated once. Uses the same (parallel) path as point cloud integration.
+	 */
+	void propagate()
+	{
+		if (dirty_.empty()) {
+			return;
 		}
+		// The dirty node itself is the first that has to be updated
+		updateValues(dirty_,
+		             [](Code const& code, Path const&, CodeSet&) { return code.getDepth(); });
+		dirty_.clear();
+	}
 
-		Key current;
-		Key ending;
-		std::array<int, 3> step;
-		Point3 t_delta;
-		Point3 t_max;
-		Base::computeRayInit(origin, end, direction, current, ending, step, t_delta, t_max,
-		                     depth);
-		// Increment
-		Code current_code = Base::toCode(current);
-		while (current != ending && t_max.min() <= max_range) {
-			if (isOccupied(current_code)) {
-				return current_code;
+	/**
+	 * @return Whether there are updates that have not been propagated to the inner nodes
+	 */
+	bool hasPendingPropagation() const noexcept { return !dirty_.empty(); }
+
+	//
+	// Thread safety
+	//
+
+	/**
+	 * @brief In thread safe mode several threads can insert point clouds into, update and
+	 * query the map at the same time. Each subtree at the integration split depth (at
+	 * least 2) is guarded by one of a fixed number of striped reader/writer locks, so
+	 * threads working in different regions rarely wait for each other. The nodes at and
+	 * above that depth are guarded by a root lock, which writers only hold while creating
+	 * a subtree and updating its ancestors.
+	 *
+	 * Covered are point cloud insertion, the single node updates, setValueVolume,
+	 * snapshot, the point queries, the collision checks, the nearest searches and ray
+	 * casting. Insertion then uses thread local scratch buffers and ignores async, and
+	 * lazy propagation is not used.
+	 *
+	 * The point queries, isCollisionFree and collisionCheck only lock the stripes of the
+	 * subtrees they read. knnSearch, radiusSearch, castRay, castRays and setValueVolume
+	 * lock every stripe, so they wait for writers anywhere in the map.
+	 *
+	 * Other operations, such as iterating, reading, writing and clearing, must not run
+	 * concurrently with writers; iterate a snapshot instead. Disabled by default.
+	 */
+	void enableThreadSafety(bool enable)
+	{
+		if (enable == isThreadSafetyEnabled()) {
+			return;
+		}
+		if (enable) {
+			insertPointCloudWait();
+			propagate();
+			locks_ = std::make_unique<Locks>();
+			locks_->depth = integration_split_depth_;
+		} else {
+			locks_.reset();
+		}
+	}
+
+	bool isThreadSafetyEnabled() const noexcept { return nullptr != locks_; }
+
+	//
+	// Cast ray
+	//
+
+	struct RayCastResult {
+		// The first occupied node along the ray
+		std::optional<Code> hit;
+		// Distance from the origin to where the ray enters the hit node, otherwise to where
+		// the cast stopped
+		double distance = 0.0;
+		// Whether the ray passed through unknown space before it stopped
+		bool crossed_unknown = false;
+	};
+
+	/**
+	 * @brief Cast a ray until it hits an occupied node. The tree is descended in the
+	 * order the ray passes through the children, and inner nodes whose summary shows that
+	 * they contain no occupied (and no unknown, that has to be reported) space are crossed
+	 * without visiting their children.
+	 *
+	 * @param ignore_unknown Whether to continue through unknown space, otherwise the cast
+	 * stops at the first unknown node
+	 * @param max_range Maximum distance, negative for the whole map
+	 * @param depth Nodes at this depth are treated as leaves
+	 */
+	RayCastResult castRay(Point3 origin, Point3 direction, bool ignore_unknown = false,
+	                      double max_range = -1, DepthType depth = 0) const
+	{
+		ensurePropagated();
+
+		auto lock = lockAll<SharedLock>();
+
+		RayCastStart start = rayCastStart();
+		return castRay(origin, direction, ignore_unknown, max_range, depth, start);
+	}
+
+	struct RayCastResults {
+		std::vector<std::optional<Code>> hits;
+		std::vector<double> distances;
+		std::vector<char> crossed_unknown;
+	};
+
+	/**
+	 * @brief Cast a batch of rays, see castRay. The rays are sorted so that rays close to
+	 * each other are cast after each other, and each ray starts from the smallest node
+	 * containing it, found by walking up and down from where the previous ray started.
+	 * Uses the integration threads.
+	 *
+	 * @param origins Either one origin for all rays or one per direction
+	 * @return The result of ray i at index i
+	 */
+	RayCastResults castRays(std::vector<Point3> const& origins,
+	                        std::vector<Point3> const& directions,
+	                        bool ignore_unknown = false, double max_range = -1,
+	                        DepthType depth = 0) const
+	{
+		if (1 != origins.size() && directions.size() != origins.size()) {
+			throw std::invalid_argument("castRays needs one origin or one per direction");
+		}
+
+		ensurePropagated();
+
+		auto lock = lockAll<SharedLock>();
+
+		std::size_t const num_rays = directions.size();
+		RayCastResults results;
+		results.hits.resize(num_rays);
+		results.distances.resize(num_rays);
+		results.crossed_unknown.resize(num_rays);
+
+		auto origin = [&origins](std::size_t i) -> Point3 const& {
+			return 1 == origins.size() ? origins[0] : origins[i];
+		};
+
+		// Sort the rays by the Morton code of the middle of the ray
+		double const range =
+		    0 > max_range ? Base::getMin().distance(Base::getMax()) : max_range;
+		Point3 const min = Base::getMin();
+		Point3 const max = Base::getMax();
+		std::vector<std::pair<CodeType, std::size_t>> order(num_rays);
+		for (std::size_t i = 0; i != num_rays; ++i) {
+			Point3 direction = directions[i];
+			if (0 != direction.squaredNorm()) {
+				direction.normalize();
+			}
+			Point3 middle = origin(i) + (direction * (range / 2.0));
+			for (int j : {0, 1, 2}) {
+				middle[j] = std::clamp(middle[j], min[j], max[j]);
+			}
+			order[i] = std::make_pair(Base::toCode(middle).getCode(), i);
+		}
+		std::sort(std::begin(order), std::end(order));
+
+		// Each worker takes the next chunk of rays until all are cast
+		std::atomic_size_t next = 0;
+		auto worker = [&]() {
+			RayCastStart start = rayCastStart();
+			for (std::size_t first = RAYS_PER_CAST_CHUNK * next++; first < num_rays;
+			     first = RAYS_PER_CAST_CHUNK * next++) {
+				std::size_t const last = std::min(num_rays, first + RAYS_PER_CAST_CHUNK);
+				for (std::size_t j = first; j != last; ++j) {
+					std::size_t const i = order[j].second;
+					RayCastResult result =
+					    castRay(origin(i), directions[i], ignore_unknown, max_range, depth, start);
+					results.hits[i] = result.hit;
+					results.distances[i] = result.distance;
+					results.crossed_unknown[i] = result.crossed_unknown;
+				}
 			}
-			if (!ignore_unknown && isUnknown(current_code)) {
-				return std::nullopt;
+		};
+
+		std::size_t const num_threads = std::min<std::size_t>(
+		    integration_threads_, num_rays / MIN_RAYS_PER_INTEGRATION_THREAD);
+		std::vector<std::future<void>> workers;
+		for (std::size_t i = 1; i < num_threads; ++i) {
+			workers.push_back(std::async(std::launch::async, worker));
+		}
+		worker();
+		for (auto& w : workers) {
+			w.get();
+		}
+
+		return results;
+	}
+
+	//
+	// Collision checking
+	//
+
+	/**
+	 * @brief Check whether no occupied node intersects bounding_volume. Stops at the first
+	 * node found and skips subtrees without occupied nodes, so it is cheaper than
+	 * iterating the leaves in bounding_volume.
+	 *
+	 * @param treat_unknown_as_occupied Whether unknown nodes are also collisions
+	 * @param min_depth Nodes at this depth are not descended into, they are collisions if
+	 * any of their descendants is
+	 */
+	bool isCollisionFree(ufo::geometry::BoundingVar const& bounding_volume,
+	                     bool treat_unknown_as_occupied = false,
+	                     DepthType min_depth = 0) const
+	{
+		ensurePropagated();
+		auto lock = lockRead(bounding_volume);
+		return isCollisionFreeUnlocked(bounding_volume, treat_unknown_as_occupied,
+		                               min_depth);
+	}
+
+	/**
+	 * @brief isCollisionFree for each of bounding_volumes, checked in parallel
+	 *
+	 * @return Whether each of bounding_volumes is collision free
+	 */
+	std::vector<char> collisionCheck(
+	    std::vector<ufo::geometry::BoundingVar> const& bounding_volumes,
+	    bool treat_unknown_as_occupied = false, DepthType min_depth = 0) const
+	{
+		ensurePropagated();
+		auto lock = lockRead(bounding_volumes);
+
+		std::vector<char> collision_free(bounding_volumes.size());
+
+		std::atomic_size_t next = 0;
+		auto worker = [&]() {
+			for (std::size_t i = next++; i < bounding_volumes.size(); i = next++) {
+				collision_free[i] = isCollisionFreeUnlocked(
+				    bounding_volumes[i], treat_unknown_as_occupied, min_depth);
 			}
-			Base::computeRayTakeStep(current, step, t_delta, t_max);
-			current_code = Base::toCode(current);
+		};
+
+		std::size_t const num_threads = std::min<std::size_t>(
+		    integration_threads_, bounding_volumes.size() / MIN_QUERIES_PER_THREAD);
+		std::vector<std::future<void>> workers;
+		for (std::size_t i = 1; i < num_threads; ++i) {
+			workers.push_back(std::async(std::launch::async, worker));
+		}
+		worker();
+		for (auto& w : workers) {
+			w.get();
 		}
 
-		return isOccupied(current_code) ? current_code : std::nullopt;
+		return collision_free;
 	}
 
 	//
@@ -496,25 +1134,39 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 			return;
 		}
 
-		Point3 const center(0, 0, 0);
-		double half_size = Base::getNodeHalfSize(Base::getTreeDepthLevels());
-		ufo::geometry::AABB aabb(center, half_size);
-		if (!std::visit(
-		        [&aabb](auto&& arg) -> bool { return geometry::intersects(arg, aabb); },
-		        bounding_volume)) {
-			return;  // No node intersects
-		} else if (Base::getTreeDepthLevels() == min_depth) {
-			Base::deleteChildren(Base::getRoot(), Base::getTreeDepthLevels());
-			setOccupancy(Base::getRoot().value.occupancy, toLogit(occupancy_value));
-			updateNode(Base::getRoot(), Base::getTreeDepthLevels());
-			return;
-		}
+		{
+			auto lock = lockAll<UniqueLock>();
 
-		if (setValueVolumeRecurs(bounding_volume, toLogit(occupancy_value), Base::getRoot(),
-		                         center, Base::getTreeDepthLevels(), min_depth)) {
-			// TODO: Is this needed?
-			updateNode(Base::getRoot(), Base::getTreeDepthLevels());
+			Point3 const center(0, 0, 0);
+			double half_size = Base::getNodeHalfSize(Base::getTreeDepthLevels());
+			ufo::geometry::AABB aabb(center, half_size);
+			if (!std::visit(
+			        [&aabb](auto&& arg) -> bool { return geometry::intersects(arg, aabb); },
+			        bounding_volume)) {
+				return;  // No node intersects
+			} else if (Base::getTreeDepthLevels() == min_depth) {
+				Base::deleteChildren(Base::getRoot(), Base::getTreeDepthLevels());
+				setOccupancy(Base::getRoot().value.occupancy,
+				             Logit::cast(toNodeLogit(occupancy_value)));
+				updateNode(Base::getRoot(), Base::getTreeDepthLevels());
+				if (change_detection_enabled_) {
+					changes_.insert(Base::getRootCode());
+				}
+			} else if (setValueVolumeRecurs(bounding_volume, toNodeLogit(occupancy_value),
+			                                Base::getRoot(), Base::getRootCode(), center,
+			                                Base::getTreeDepthLevels(), min_depth)) {
+				// TODO: Is this needed?
+				updateNode(Base::getRoot(), Base::getTreeDepthLevels());
+			}
 		}
+
+		updateDistanceField([this, &bounding_volume]() {
+			using Predicate =
+			    TraversePredicate<true, true, true, true, false, ufo::geometry::BoundingVar>;
+			traverse(Predicate{0, bounding_volume}, [this](TraverseNode const& node) {
+				refreshDistanceField(node.getCode());
+			});
+		});
 	}
 
 	//
@@ -523,7 +1175,7 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 
 	void setOccupancy(Code const& code, double occupancy_value)
 	{
-		setNodeValue(code, toLogit(occupancy_value));
+		setNodeValue(code, Logit::cast(toNodeLogit(occupancy_value)));
 	}
 
 	void setOccupancy(Point3 const& coord, double occupancy_value, DepthType depth = 0)
@@ -543,7 +1195,7 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 
 	void updateOccupancy(Code const& code, double occupancy_value_update)
 	{
-		updateValue(code, toLogit(occupancy_value_update));
+		updateValue(code, Logit::cast(toNodeLogit(occupancy_value_update)));
 	}
 
 	void updateOccupancy(Point3 const& coord, double occupancy_value_update,
@@ -564,7 +1216,7 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 
 	void integrateHit(Code const& code)
 	{
-		updateValue(code, static_cast<float>(prob_hit_log_));
+		updateValue(code, Logit::cast(prob_hit_log_));
 	}
 
 	void integrateHit(Point3 const& coord, DepthType depth = 0)
@@ -579,7 +1231,7 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 
 	void integrateMiss(Code const& code)
 	{
-		updateValue(code, static_cast<float>(prob_miss_log_));
+		updateValue(code, Logit::cast(prob_miss_log_));
 	}
 
 	void integrateMiss(Point3 const& coord, DepthType depth = 0)
@@ -598,6 +1250,8 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 
 	double getOccupancy(Code const& code) const
 	{
+		ensurePropagated();
+		auto lock = lockRead(code);
 		return toProb(Base::getNode(code).first->value.occupancy);
 	}
 
@@ -617,6 +1271,8 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 
 	OccupancyState getState(Code const& code) const
 	{
+		ensurePropagated();
+		auto lock = lockRead(code);
 		auto [node, depth] = Base::getNode(code);
 		if (isOccupied(*node)) {
 			return OccupancyState::occupied;
@@ -697,6 +1353,8 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 
 	bool containsUnknown(Code const& code) const
 	{
+		ensurePropagated();
+		auto lock = lockRead(code);
 		auto [node, depth] = Base::getNode(code);
 		return containsUnknown(*node, depth);
 	}
@@ -713,6 +1371,8 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 
 	bool containsFree(Code const& code) const
 	{
+		ensurePropagated();
+		auto lock = lockRead(code);
 		auto [node, depth] = Base::getNode(code);
 		return containsFree(*node, depth);
 	}
@@ -731,17 +1391,17 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 	// Sensor model
 	//
 
-	double getOccupiedThres() const { return toProb(occupied_thres_log_); }
+	double getOccupiedThres() const { return sensor_model_.occupied_thres; }
 
-	double getFreeThres() const { return toProb(free_thres_log_); }
+	double getFreeThres() const { return sensor_model_.free_thres; }
 
-	double getProbHit() const { return toProb(prob_hit_log_); }
+	double getProbHit() const { return sensor_model_.prob_hit; }
 
-	double getProbMiss() const { return toProb(prob_miss_log_); }
+	double getProbMiss() const { return sensor_model_.prob_miss; }
 
-	double getClampingThresMin() const { return toProb(clamping_thres_min_log_); }
+	double getClampingThresMin() const { return sensor_model_.clamping_thres_min; }
 
-	double getClampingThresMax() const { return toProb(clamping_thres_max_log_); }
+	double getClampingThresMax() const { return sensor_model_.clamping_thres_max; }
 
 	void setOccupiedFreeThres(double new_occupied_thres, double new_free_thres)
 	{
@@ -752,24 +1412,35 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 		std::stringstream s(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
 		Base::write(s);
 
-		occupied_thres_log_ = toLogit(new_occupied_thres);
-		free_thres_log_ = toLogit(new_free_thres);
+		sensor_model_.occupied_thres = new_occupied_thres;
+		sensor_model_.free_thres = new_free_thres;
+		quantizeSensorModel();
 
 		Base::read(s);
 	}
 
-	void setProbHit(double probability) { prob_hit_log_ = toLogit(probability); }
+	void setProbHit(double probability)
+	{
+		sensor_model_.prob_hit = probability;
+		quantizeSensorModel();
+	}
 
-	void setProbMiss(double probability) { prob_miss_log_ = toLogit(probability); }
+	void setProbMiss(double probability)
+	{
+		sensor_model_.prob_miss = probability;
+		quantizeSensorModel();
+	}
 
 	void setClampingThresMin(double probability)
 	{
-		clamping_thres_min_log_ = toLogit(probability);
+		sensor_model_.clamping_thres_min = probability;
+		quantizeSensorModel();
 	}
 
 	void setClampingThresMax(double probability)
 	{
-		clamping_thres_max_log_ = toLogit(probability);
+		sensor_model_.clamping_thres_max = probability;
+		quantizeSensorModel();
 	}
 
 	//
@@ -821,6 +1492,103 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 		return true;
 	}
 
+	//
+	// Delta
+	//
+
+	/**
+	 * @brief The epoch of the last delta written, or for a replica the last delta applied
+	 */
+	std::uint64_t getDeltaEpoch() const noexcept { return delta_epoch_; }
+
+	/**
+	 * @brief Set the epoch of a replica, after it has been synced with the full map of
+	 * the source at that epoch
+	 */
+	void setDeltaEpoch(std::uint64_t epoch) noexcept { delta_epoch_ = epoch; }
+
+	/**
+	 * @brief The oldest epoch writeDelta can write a delta since
+	 */
+	std::uint64_t getOldestDeltaEpoch() const noexcept { return delta_oldest_epoch_; }
+
+	/**
+	 * @brief Forget the changes made up to and including epoch, deltas can no longer be
+	 * written since an earlier epoch
+	 */
+	void trimDeltaHistory(std::uint64_t epoch)
+	{
+		epoch = std::min(epoch, delta_epoch_);
+		if (epoch <= delta_oldest_epoch_) {
+			return;
+		}
+		CodeMap<std::uint64_t> history;
+		for (auto const& [code, changed] : delta_history_) {
+			if (changed > epoch) {
+				history[code] = changed;
+			}
+		}
+		delta_history_.swap(history);
+		delta_oldest_epoch_ = epoch;
+	}
+
+	/**
+	 * @brief Forget all changes, every replica has to be synced with the full map again.
+	 * Changes that are not detected, such as clear or read, have to be followed by this.
+	 */
+	void resetDeltaHistory()
+	{
+		changes_.clear();
+		delta_history_.clear();
+		delta_oldest_epoch_ = ++delta_epoch_;
+	}
+
+	/**
+	 * @brief Write the subtrees that have changed since since_epoch, including the
+	 * nodes removed by pruning, and start a new epoch
+	 *
+	 * @details The changes come from change detection, which has to be enabled. The
+	 * changes detected so far are moved to the delta history. A delta since epoch a is a
+	 * delta from a to getDeltaEpoch(), it can be applied to any replica at an epoch from a
+	 * onwards.
+	 *
+	 * @param since_epoch The epoch of the replica, at least getOldestDeltaEpoch()
+	 * @return false If change detection is disabled or since_epoch is too old or new
+	 */
+	bool writeDelta(std::ostream& s, std::uint64_t since_epoch)
+	{
+		WriteBuffer buffer(s);
+		return writeDelta(buffer, since_epoch) && buffer.finish();
+	}
+
+	template <typename Byte>
+	bool writeDelta(std::vector<Byte>& data, std::uint64_t since_epoch)
+	{
+		WriteBuffer buffer(data);
+		return writeDelta(buffer, since_epoch) && buffer.finish();
+	}
+
+	/**
+	 * @brief Patch this replica with a delta written by writeDelta
+	 *
+	 * @return false If the delta is invalid, is for another resolution or depth levels, or
+	 * starts after getDeltaEpoch(), in which case the replica has to be synced with the
+	 * full map
+	 */
+	bool applyDelta(std::istream& s)
+	{
+		ReadBuffer buffer(s);
+		bool const success = applyDelta(buffer);
+		buffer.finish();
+		return success;
+	}
+
+	bool applyDelta(void const* data, std::size_t size)
+	{
+		ReadBuffer buffer(data, size);
+		return applyDelta(buffer);
+	}
+
 	//
 	// Bounding box contain all known
 	//
@@ -838,15 +1606,14 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 		           std::numeric_limits<double>::lowest(),
 		           std::numeric_limits<double>::lowest());
 
-		for (auto it = beginLeaves(true, true, false), it_end = endLeaves(); it != it_end;
-		     ++it) {
-			double hf = it.getHalfSize();
-			Point3 center = it.getCenter();
+		traverse(TraversePredicate<true, true, false>(), [&](TraverseNode const& node) {
+			double hf = node.getHalfSize();
+			Point3 const& center = node.getCenter();
 			for (int i : {0, 1, 2}) {
 				min[i] = std::min(min[i], center[i] - hf);
 				max[i] = std::max(max[i], center[i] + hf);
 			}
-		}
+		});
 
 		return ufo::geometry::AABB(min, max);
 	}
@@ -861,13 +1628,10 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 	                 double free_thres = 0.5, double prob_hit = 0.7, double prob_miss = 0.4,
 	                 double clamping_thres_min = 0.1192, double clamping_thres_max = 0.971)
 	    : Base(resolution, depth_levels, automatic_pruning),
-	      occupied_thres_log_(toLogit(occupied_thres)),
-	      free_thres_log_(toLogit(free_thres)),
-	      prob_hit_log_(toLogit(prob_hit)),
-	      prob_miss_log_(toLogit(prob_miss)),
-	      clamping_thres_min_log_(toLogit(clamping_thres_min)),
-	      clamping_thres_max_log_(toLogit(clamping_thres_max))
+	      sensor_model_{occupied_thres, free_thres,         prob_hit,
+	                    prob_miss,      clamping_thres_min, clamping_thres_max}
 	{
+		quantizeSensorModel();
 		updateNode(Base::getRoot(), Base::getTreeDepthLevels());
 
 		// Reserve for better performance
@@ -875,25 +1639,33 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 		indices_.reserve(100003);
 	}
 
-	OccupancyMapBase(std::string const& filename, bool automatic_pruning = true,
-	                 double occupied_thres = 0.5, double free_thres = 0.5,
-	                 double prob_hit = 0.7, double prob_miss = 0.4,
-	                 double clamping_thres_min = 0.1192, double clamping_thres_max = 0.971)
-	    : OccupancyMapBase(0.1, 16, automatic_pruning, occupied_thres, free_thres, prob_hit,
-	                       prob_miss, clamping_thres_min, clamping_thres_max)
-	{
-		Base::read(filename);
-	}
-
 	OccupancyMapBase(OccupancyMapBase const& other)
 	    : OccupancyMapBase(other.resolution_, other.depth_levels_,
 	                       other.automatic_pruning_enabled_, other.getOccupiedThres(),
 	                       other.getFreeThres(), other.getProbHit(), other.getProbMiss(),
 	                       other.getClampingThresMin(), other.getClampingThresMax())
 	{
-		std::stringstream s(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
-		other.write(s);
-		Base::read(s);
+		// Only the data, reading a header checks the tree type, which is not known until
+		// the derived class has been constructed
+		std::vector<char> data;
+		other.writeData(data);
+		Base::readData(data.data(), data.size(), other.resolution_, other.depth_levels_);
+	}
+
+	/**
+	 * @brief Construct a snapshot of other that shares its nodes, see Octree. Updates
+	 * other is integrating or has not propagated yet are applied to other first.
+	 */
+	OccupancyMapBase(OccupancyMapBase& other, typename Base::SnapshotTag tag)
+	    : Base((other.insertPointCloudWait(), other.propagate(), other), tag),
+	      sensor_model_(other.sensor_model_),
+	      occupied_thres_log_(other.occupied_thres_log_),
+	      free_thres_log_(other.free_thres_log_),
+	      prob_hit_log_(other.prob_hit_log_),
+	      prob_miss_log_(other.prob_miss_log_),
+	      clamping_thres_min_log_(other.clamping_thres_min_log_),
+	      clamping_thres_max_log_(other.clamping_thres_max_log_)
+	{
 	}
 
 	//
@@ -908,7 +1680,105 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 
 	static double toLogit(double prob) { return std::log(prob / (1.0 - prob)); }
 
-	static double toProb(LogitType logit) { return 1.0 / (1.0 + std::exp(-logit)); }
+	static double toProb(LogitType logit) { return Logit::toProb(logit); }
+
+	/**
+	 * @brief Log-odds of prob in the units stored in the nodes, see LogitTraits
+	 */
+	static double toNodeLogit(double prob) { return Logit::quantize(toLogit(prob)); }
+
+	/**
+	 * @brief Set the sensor model in node units from sensor_model_.
+	 *
+	 * @details Rounding the hit and miss increments and the clamping thresholds each on
+	 * their own changes the ratios between them. With the few steps of an integer type a
+	 * voxel would then cross a threshold after other numbers of hits and misses than with
+	 * floating point. Instead the values within QUANTIZATION_SEARCH steps of the rounded
+	 * ones are used that classify voxels as floating point does in the most states
+	 * reached by hit/miss sequences up to QUANTIZATION_SEQUENCE_LENGTH long. Ties keep
+	 * the values closest to the rounded ones. The thresholds are rounded.
+	 */
+	void quantizeSensorModel()
+	{
+		occupied_thres_log_ = toNodeLogit(sensor_model_.occupied_thres);
+		free_thres_log_ = toNodeLogit(sensor_model_.free_thres);
+		prob_hit_log_ = toNodeLogit(sensor_model_.prob_hit);
+		prob_miss_log_ = toNodeLogit(sensor_model_.prob_miss);
+		clamping_thres_min_log_ = toNodeLogit(sensor_model_.clamping_thres_min);
+		clamping_thres_max_log_ = toNodeLogit(sensor_model_.clamping_thres_max);
+
+		if constexpr (std::is_integral_v<LogitType>) {
+			std::array<double, 4> const rounded = {prob_hit_log_, prob_miss_log_,
+			                                       clamping_thres_min_log_,
+			                                       clamping_thres_max_log_};
+			std::size_t best_mismatches = quantizationMismatches(rounded);
+			int best_distance = 0;
+			int const n = 2 * QUANTIZATION_SEARCH + 1;
+			for (int i = 0; 0 != best_mismatches && i < n * n * n * n; ++i) {
+				std::array<double, 4> candidate = rounded;
+				int distance = 0;
+				for (int j = 0, k = i; j < 4; ++j, k /= n) {
+					int const offset = k % n - QUANTIZATION_SEARCH;
+					// Saturated to the range of the type
+					candidate[j] = Logit::cast(candidate[j] + offset);
+					distance += std::abs(offset);
+				}
+				std::size_t const mismatches = quantizationMismatches(candidate);
+				if (mismatches < best_mismatches ||
+				    (mismatches == best_mismatches && distance < best_distance)) {
+					best_mismatches = mismatches;
+					best_distance = distance;
+					prob_hit_log_ = candidate[0];
+					prob_miss_log_ = candidate[1];
+					clamping_thres_min_log_ = candidate[2];
+					clamping_thres_max_log_ = candidate[3];
+				}
+			}
+		}
+	}
+
+	/**
+	 * @return The number of states, reached by hit/miss sequences from unknown, where
+	 * the node units hit, miss, clamping_thres_min and clamping_thres_max in quantized
+	 * classify a voxel differently than the sensor model does in floating point
+	 */
+	std::size_t quantizationMismatches(std::array<double, 4> const& quantized) const
+	{
+		double const occupied_thres = toLogit(sensor_model_.occupied_thres);
+		double const free_thres = toLogit(sensor_model_.free_thres);
+		std::array<double, 2> const exact_updates = {toLogit(sensor_model_.prob_hit),
+		                                             toLogit(sensor_model_.prob_miss)};
+		double const exact_min = toLogit(sensor_model_.clamping_thres_min);
+		double const exact_max = toLogit(sensor_model_.clamping_thres_max);
+		auto classify = [](double value, double occupied, double free) {
+			return occupied < value ? 1 : (free > value ? -1 : 0);
+		};
+
+		// Pairs of the floating point value and the value in node units
+		std::vector<std::pair<double, double>> states(1, {0.0, 0.0});
+		std::set<std::pair<double, double>> reached(std::begin(states), std::end(states));
+		std::size_t mismatches = 0;
+		for (std::size_t length = 0; QUANTIZATION_SEQUENCE_LENGTH != length; ++length) {
+			std::vector<std::pair<double, double>> next;
+			for (auto const& [exact, node] : states) {
+				for (std::size_t i : {0, 1}) {
+					std::pair<double, double> const state(
+					    std::clamp(exact + exact_updates[i], exact_min, exact_max),
+					    std::clamp(node + quantized[i], quantized[2], quantized[3]));
+					if (!reached.insert(state).second) {
+						continue;
+					}
+					next.push_back(state);
+					if (classify(state.first, occupied_thres, free_thres) !=
+					    classify(state.second, occupied_thres_log_, free_thres_log_)) {
+						++mismatches;
+					}
+				}
+			}
+			states.swap(next);
+		}
+		return mismatches;
+	}
 
 	//
 	// Get occupancy
@@ -971,56 +1841,640 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 
 	bool containsUnknown(INNER_NODE const& node) const
 	{
-		return static_cast<INNER_NODE const&>(node).contains_unknown;
+		if constexpr (Base::COMPACT_INNER_NODES) {
+			return Base::InnerChildren::getBit(Base::getBlock(node).contains_unknown,
+			                                   Base::getIndexInBlock(node));
+		} else {
+			return node.contains_unknown;
+		}
 	}
 
 	bool containsFree(INNER_NODE const& node) const
 	{
-		return static_cast<INNER_NODE const&>(node).contains_free;
+		if constexpr (Base::COMPACT_INNER_NODES) {
+			return Base::InnerChildren::getBit(Base::getBlock(node).contains_free,
+			                                   Base::getIndexInBlock(node));
+		} else {
+			return node.contains_free;
+		}
+	}
+
+	/**
+	 * @brief Set the contains free and contains unknown flags of node
+	 *
+	 * @return true If any of the flags changed
+	 */
+	static bool setContains(INNER_NODE& node, bool contains_free, bool contains_unknown)
+	{
+		if constexpr (Base::COMPACT_INNER_NODES) {
+			typename Base::InnerChildren& block = Base::getBlock(node);
+			std::size_t idx = Base::getIndexInBlock(node);
+			std::uint8_t old_free = block.contains_free;
+			std::uint8_t old_unknown = block.contains_unknown;
+			Base::InnerChildren::setBit(block.contains_free, idx, contains_free);
+			Base::InnerChildren::setBit(block.contains_unknown, idx, contains_unknown);
+			return old_free != block.contains_free || old_unknown != block.contains_unknown;
+		} else {
+			bool updated = node.contains_free != contains_free ||
+			               node.contains_unknown != contains_unknown;
+			node.contains_free = contains_free;
+			node.contains_unknown = contains_unknown;
+			return updated;
+		}
 	}
 
 	//
-	// Set value volume
+	// Nearest neighbor search
 	//
 
-	bool setValueVolumeRecurs(ufo::geometry::BoundingVar const& bounding_volume,
-	                          double occupancy_value, INNER_NODE& node,
-	                          Point3 const& center, DepthType current_depth,
-	                          DepthType min_depth = 0)
+	struct NearestFilter {
+		bool occupied_space;
+		bool free_space;
+		bool unknown_space;
+		DepthType min_depth;
+	};
+
+	void nearestSearch(Point3 const& point, std::size_t k, double max_squared_distance,
+	                   std::vector<Neighbor>& neighbors, NearestFilter const& filter) const
 	{
-		DepthType const child_depth = current_depth - 1;
-		double const child_half_size = Base::getNodeHalfSize(child_depth);
+		neighbors.clear();
+		if (0 == k) {
+			return;
+		}
 
-		Base::createChildren(node, current_depth);
+		DepthType const tree_depth = Base::getTreeDepthLevels();
+		Point3 const center(0, 0, 0);
+		double const squared_distance =
+		    squaredDistance(point, center, Base::getNodeHalfSize(tree_depth));
+		if (squared_distance <= max_squared_distance) {
+			nearestSearchRecurs(Base::getRoot(), Base::getRootCode(), center, squared_distance,
+			                    point, k, max_squared_distance, neighbors, filter);
+		}
 
-		ufo::geometry::AABB aabb;
-		aabb.half_size =
-		    ufo::geometry::Point(child_half_size, child_half_size, child_half_size);
-		bool changed = false;
+		// The neighbors are a max heap on the distance
+		std::sort_heap(std::begin(neighbors), std::end(neighbors), compareNeighbors);
+	}
+
+	void nearestSearch(std::vector<Point3> const& points, std::size_t k,
+	                   double max_squared_distance,
+	                   std::vector<std::vector<Neighbor>>& neighbors,
+	                   NearestFilter const& filter) const
+	{
+		neighbors.resize(points.size());
+
+		std::atomic_size_t next = 0;
+		auto worker = [&]() {
+			for (std::size_t i = next++; i < points.size(); i = next++) {
+				nearestSearch(points[i], k, max_squared_distance, neighbors[i], filter);
+			}
+		};
+
+		std::size_t const num_threads = std::min<std::size_t>(
+		    integration_threads_, points.size() / MIN_QUERIES_PER_THREAD);
+		std::vector<std::future<void>> workers;
+		for (std::size_t i = 1; i < num_threads; ++i) {
+			workers.push_back(std::async(std::launch::async, worker));
+		}
+		worker();
+		for (auto& w : workers) {
+			w.get();
+		}
+	}
+
+	void nearestSearchRecurs(LEAF_NODE const& node, Code const& code, Point3 const& center,
+	                         double squared_distance, Point3 const& point, std::size_t k,
+	                         double max_squared_distance, std::vector<Neighbor>& neighbors,
+	                         NearestFilter const& filter) const
+	{
+		DepthType const depth = code.getDepth();
+
+		if (filter.min_depth >= depth || Base::isLeaf(&node, depth)) {
+			if ((filter.occupied_space && isOccupied(node)) ||
+			    (filter.free_space && isFree(node)) ||
+			    (filter.unknown_space && isUnknown(node))) {
+				if (neighbors.size() == k) {
+					std::pop_heap(std::begin(neighbors), std::end(neighbors), compareNeighbors);
+					neighbors.back() = Neighbor{code, center, squared_distance};
+				} else {
+					neighbors.push_back(Neighbor{code, center, squared_distance});
+				}
+				std::push_heap(std::begin(neighbors), std::end(neighbors), compareNeighbors);
+			}
+			return;
+		}
+
+		if (!(filter.occupied_space && containsOccupied(node, depth)) &&
+		    !(filter.free_space && containsFree(node, depth)) &&
+		    !(filter.unknown_space && containsUnknown(node, depth))) {
+			return;
+		}
+
+		// Closest child first, so the bound shrinks as fast as possible
+		DepthType const child_depth = depth - 1;
+		double const child_half_size = Base::getNodeHalfSize(child_depth);
+		std::array<std::pair<double, unsigned int>, 8> children;
+		for (unsigned int i = 0; i < 8; ++i) {
+			children[i] = std::make_pair(
+			    squaredDistance(point, Base::getChildCenter(center, child_half_size, i),
+			                    child_half_size),
+			    i);
+		}
+		std::sort(std::begin(children), std::end(children));
+
+		INNER_NODE const& inner = static_cast<INNER_NODE const&>(node);
+		for (auto const& [child_squared_distance, child_idx] : children) {
+			if (max_squared_distance < child_squared_distance ||
+			    (neighbors.size() == k &&
+			     neighbors.front().squared_distance <= child_squared_distance)) {
+				// The remaining children are farther away
+				return;
+			}
+			nearestSearchRecurs(Base::getChild(inner, child_depth, child_idx),
+			                    code.getChild(child_idx),
+			                    Base::getChildCenter(center, child_half_size, child_idx),
+			                    child_squared_distance, point, k, max_squared_distance,
+			                    neighbors, filter);
+		}
+	}
+
+	static double squaredDistance(Point3 const& point, Point3 const& center,
+	                              double half_size)
+	{
+		Point3 const half(half_size, half_size, half_size);
+		return (point - point.clamp(center - half, center + half)).squaredNorm();
+	}
+
+	static bool compareNeighbors(Neighbor const& a, Neighbor const& b)
+	{
+		return a.squared_distance < b.squared_distance;
+	}
+
+	//
+	// Traverse
+	//
+
+	/**
+	 * @brief Visit and descend into the children of node, which has children and has been
+	 * accepted by predicate
+	 */
+	template <bool OCCUPIED_SPACE, bool FREE_SPACE, bool UNKNOWN_SPACE, bool ONLY_LEAVES,
+	          bool CONTAINS, typename BoundingType, typename Visitor>
+	void traverseRecurs(
+	    INNER_NODE const& node, Code const& code, Point3 const& center, bool inside,
+	    TraversePredicate<OCCUPIED_SPACE, FREE_SPACE, UNKNOWN_SPACE, ONLY_LEAVES, CONTAINS,
+	                      BoundingType> const& predicate,
+	    Visitor& visitor) const
+	{
+		DepthType const child_depth = code.getDepth() - 1;
+		double const child_half_size = Base::getNodeHalfSize(child_depth);
+
+		ufo::geometry::ChildrenMask children{0xFF, 0xFF};
+		if constexpr (std::is_same_v<BoundingType, ufo::geometry::BoundingVolume>) {
+			if (!inside) {
+				children = predicate.bounding_volume.intersectsChildren(center, child_half_size);
+			}
+		} else if constexpr (!std::is_same_v<BoundingType, std::monostate>) {
+			if (!inside) {
+				children = geometry::intersectsChildren(predicate.bounding_volume, center,
+				                                        child_half_size);
+			}
+		}
+		if (0 == children.intersects) {
+			return;
+		}
+
+		if (0 == child_depth) {
+			traverseChildren(Base::getLeafChildren(node), code, center, child_half_size,
+			                 children, predicate, visitor);
+		} else {
+			traverseChildren(Base::getInnerChildren(node), code, center, child_half_size,
+			                 children, predicate, visitor);
+		}
+	}
+
+	template <bool OCCUPIED_SPACE, bool FREE_SPACE, bool UNKNOWN_SPACE, bool ONLY_LEAVES,
+	          bool CONTAINS, typename BoundingType, typename Children, typename Visitor>
+	void traverseChildren(
+	    Children const& children, Code const& code, Point3 const& center,
+	    double child_half_size, ufo::geometry::ChildrenMask const& intersects,
+	    TraversePredicate<OCCUPIED_SPACE, FREE_SPACE, UNKNOWN_SPACE, ONLY_LEAVES, CONTAINS,
+	                      BoundingType> const& predicate,
+	    Visitor& visitor) const
+	{
+		constexpr bool inner_children =
+		    std::is_same_v<Children, typename Base::InnerChildren>;
+		DepthType const child_depth = code.getDepth() - 1;
+
+		// The state of all eight children as masks, bit i is child i
+		std::uint8_t occupied = 0;
+		std::uint8_t free = 0;
+		for (unsigned int i = 0; i < 8; ++i) {
+			auto const occupancy = children[i].value.occupancy;
+			occupied |= std::uint8_t(occupied_thres_log_ < occupancy) << i;
+			free |= std::uint8_t(free_thres_log_ > occupancy) << i;
+		}
+		std::uint8_t const unknown = ~(occupied | free);
+
+		std::uint8_t contains_free = free;
+		std::uint8_t contains_unknown = unknown;
+		std::uint8_t leaf = 0xFF;
+		if constexpr (inner_children && Base::COMPACT_INNER_NODES) {
+			contains_free = children.contains_free;
+			contains_unknown = children.contains_unknown;
+			leaf = children.is_leaf;
+		} else if constexpr (inner_children) {
+			leaf = 0;
+			for (unsigned int i = 0; i < 8; ++i) {
+				contains_free |= std::uint8_t(containsFree(children[i])) << i;
+				contains_unknown |= std::uint8_t(containsUnknown(children[i])) << i;
+				leaf |= std::uint8_t(Base::isLeaf(children[i])) << i;
+			}
+		}
+
+		// The same filters as OccupancyMapIterator, for all children at once
+		std::uint8_t const is_space = (OCCUPIED_SPACE ? occupied : 0) |
+		                              (FREE_SPACE ? free : 0) |
+		                              (UNKNOWN_SPACE ? unknown : 0);
+		std::uint8_t const contains_space = (OCCUPIED_SPACE ? occupied : 0) |
+		                                    (FREE_SPACE ? contains_free : 0) |
+		                                    (UNKNOWN_SPACE ? contains_unknown : 0);
+		std::uint8_t const valid =
+		    intersects.intersects &
+		    (CONTAINS || predicate.min_depth != child_depth ? contains_space : is_space);
+		std::uint8_t const last = predicate.min_depth >= child_depth ? 0xFF : leaf;
+		std::uint8_t const visit = valid & (ONLY_LEAVES ? last : 0xFF) &
+		                           (!ONLY_LEAVES && CONTAINS ? contains_space : is_space);
+		std::uint8_t const descend = valid & ~last;
+
+		// Same order as getChildCenter, without the branches
+		double const x[2] = {center[0] - child_half_size, center[0] + child_half_size};
+		double const y[2] = {center[1] - child_half_size, center[1] + child_half_size};
+		double const z[2] = {center[2] - child_half_size, center[2] + child_half_size};
+
+		// Only the selected children, lowest index first
+		for (unsigned int selected = visit | descend; 0 != selected;
+		     selected &= selected - 1) {
+			unsigned int const i = __builtin_ctz(selected);
+
+			Code const child_code = code.getChild(i);
+			Point3 const child_center(x[i & 1U], y[(i >> 1) & 1U], z[i >> 2]);
+			bool const child_inside = (intersects.inside >> i) & 1U;
+			if ((visit >> i) & 1U) {
+				visitor(TraverseNode(*this, children[i], child_code, child_center,
+				                     child_half_size, (leaf >> i) & 1U, child_inside));
+			}
+			if constexpr (inner_children) {
+				if ((descend >> i) & 1U) {
+					traverseRecurs(children[i], child_code, child_center, child_inside, predicate,
+					               visitor);
+				}
+			}
+		}
+	}
+
+	//
+	// Cast ray
+	//
+
+	// The nodes from the root down to the node the previous ray was cast from
+	struct RayCastStart {
+		std::array<LEAF_NODE const*, Base::MAX_DEPTH_LEVELS> nodes;
+		std::array<Point3, Base::MAX_DEPTH_LEVELS> centers;
+		Code code;
+	};
+
+	RayCastStart rayCastStart() const
+	{
+		RayCastStart start;
+		start.code = Base::getRootCode();
+		start.nodes[start.code.getDepth()] = &Base::getRoot();
+		start.centers[start.code.getDepth()] = Point3(0, 0, 0);
+		return start;
+	}
+
+	/**
+	 * @brief castRay without locking, starting from the smallest node containing the ray
+	 * that can be reached from start, which is updated to that node
+	 */
+	RayCastResult castRay(Point3 const& origin, Point3 direction, bool ignore_unknown,
+	                      double max_range, DepthType depth, RayCastStart& start) const
+	{
+		RayCastResult result;
+
+		if (0 > max_range) {
+			max_range = Base::getMin().distance(Base::getMax());
+		}
+
+		if (0 == direction.squaredNorm()) {
+			return result;
+		}
+		direction.normalize();
+		Point3 const inv_direction(1.0 / direction[0], 1.0 / direction[1],
+		                           1.0 / direction[2]);
+
+		DepthType const tree_depth = Base::getTreeDepthLevels();
+		auto [t_min, t_max] = rayInterval(origin, inv_direction, Point3(0, 0, 0),
+		                                  Base::getNodeHalfSize(tree_depth));
+		t_min = std::max(0.0, t_min);
+		t_max = std::min(max_range, t_max);
+		if (t_min > t_max) {
+			// Ray fully outside of octree bounds
+			result.distance = max_range;
+			return result;
+		}
+
+		// Bounds of the part of the ray inside the octree
+		Point3 const first = origin + (direction * t_min);
+		Point3 const last = origin + (direction * t_max);
+		Point3 const ray_min(std::min(first[0], last[0]), std::min(first[1], last[1]),
+		                     std::min(first[2], last[2]));
+		Point3 const ray_max(std::max(first[0], last[0]), std::max(first[1], last[1]),
+		                     std::max(first[2], last[2]));
+
+		// Up to the first node containing the ray
+		DepthType current = start.code.getDepth();
+		while (tree_depth > current) {
+			Point3 const& center = start.centers[current];
+			double const half_size = Base::getNodeHalfSize(current);
+			if (center[0] - half_size <= ray_min[0] && center[0] + half_size >= ray_max[0] &&
+			    center[1] - half_size <= ray_min[1] && center[1] + half_size >= ray_max[1] &&
+			    center[2] - half_size <= ray_min[2] && center[2] + half_size >= ray_max[2]) {
+				break;
+			}
+			++current;
+		}
+
+		// Down while a single child contains the ray
+		DepthType const min_depth = std::min(depth, tree_depth);
+		start.code = start.code.toDepth(current);
+		while (min_depth < current && !Base::isLeaf(start.nodes[current], current)) {
+			Point3 const& center = start.centers[current];
+			unsigned int child_idx = 0;
+			bool split = false;
+			for (int i : {0, 1, 2}) {
+				bool const upper = center[i] <= ray_min[i];
+				split = split || (upper != (center[i] <= ray_max[i]));
+				child_idx |= upper ? 1U << i : 0U;
+			}
+			if (split) {
+				break;
+			}
+			DepthType const child_depth = current - 1;
+			start.nodes[child_depth] = &Base::getChild(
+			    static_cast<INNER_NODE const&>(*start.nodes[current]), child_depth, child_idx);
+			start.centers[child_depth] =
+			    Base::getChildCenter(center, Base::getNodeHalfSize(child_depth), child_idx);
+			start.code = start.code.getChild(child_idx);
+			current = child_depth;
+		}
+
+		if (!castRayRecurs(*start.nodes[current], start.code, start.centers[current], t_min,
+		                   t_max, origin, inv_direction, ignore_unknown, min_depth, result)) {
+			result.distance = t_max;
+		}
+		return result;
+	}
+
+	/**
+	 * @return The distances along the ray where it enters and exits the axis aligned box,
+	 * entering after exiting if it misses the box
+	 */
+	static std::pair<double, double> rayInterval(Point3 const& origin,
+	                                             Point3 const& inv_direction,
+	                                             Point3 const& center, double half_size)
+	{
+		double t_min = std::numeric_limits<double>::lowest();
+		double t_max = std::numeric_limits<double>::max();
+		for (int i : {0, 1, 2}) {
+			double const low = center[i] - half_size - origin[i];
+			double const high = center[i] + half_size - origin[i];
+			if (std::isinf(inv_direction[i])) {
+				// Parallel to the slab
+				if (0 < low || 0 > high) {
+					return {1.0, 0.0};
+				}
+				continue;
+			}
+			double t_low = low * inv_direction[i];
+			double t_high = high * inv_direction[i];
+			if (t_low > t_high) {
+				std::swap(t_low, t_high);
+			}
+			t_min = std::max(t_min, t_low);
+			t_max = std::min(t_max, t_high);
+		}
+		return {t_min, t_max};
+	}
+
+	/**
+	 * @brief Cast the ray through node, which it passes between the distances t_min and
+	 * t_max
+	 *
+	 * @return Whether the cast stopped inside node
+	 */
+	bool castRayRecurs(LEAF_NODE const& node, Code const& code, Point3 const& center,
+	                   double t_min, double t_max, Point3 const& origin,
+	                   Point3 const& inv_direction, bool ignore_unknown,
+	                   DepthType min_depth, RayCastResult& result) const
+	{
+		DepthType const depth = code.getDepth();
+
+		if (min_depth >= depth || Base::isLeaf(&node, depth)) {
+			if (isOccupied(node)) {
+				result.hit = code;
+				result.distance = t_min;
+				return true;
+			}
+			if (isUnknown(node)) {
+				result.crossed_unknown = true;
+				if (!ignore_unknown) {
+					result.distance = t_min;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// Inner nodes hold the max occupancy of their children, so a node that is not
+		// occupied contains no occupied node. Unknown space only has to be found once.
+		if (!isOccupied(node) &&
+		    (result.crossed_unknown ||
+		     !containsUnknown(static_cast<INNER_NODE const&>(node)))) {
+			return false;
+		}
+
+		// The ray passes through the children in the order it crosses the planes through
+		// the center, starting in the child it enters node in
+		DepthType const child_depth = depth - 1;
+		double const child_half_size = Base::getNodeHalfSize(child_depth);
+		std::array<std::pair<double, unsigned int>, 3> crossings;
+		std::size_t num_crossings = 0;
+		unsigned int child_idx = 0;
+		for (int i : {0, 1, 2}) {
+			if (std::isinf(inv_direction[i])) {
+				// Parallel to the plane
+				child_idx |= center[i] <= origin[i] ? 1U << i : 0U;
+				continue;
+			}
+			double const t = (center[i] - origin[i]) * inv_direction[i];
+			bool const upper = 0 < inv_direction[i] ? t <= t_min : t > t_min;
+			child_idx |= upper ? 1U << i : 0U;
+			if (t_min < t && t_max > t) {
+				crossings[num_crossings++] = std::make_pair(t, 1U << i);
+			}
+		}
+		std::sort(std::begin(crossings), std::next(std::begin(crossings), num_crossings));
+
+		INNER_NODE const& inner = static_cast<INNER_NODE const&>(node);
+		double child_t_min = t_min;
+		for (std::size_t i = 0; i <= num_crossings; ++i) {
+			double const child_t_max = num_crossings == i ? t_max : crossings[i].first;
+			if (castRayRecurs(Base::getChild(inner, child_depth, child_idx),
+			                  code.getChild(child_idx),
+			                  Base::getChildCenter(center, child_half_size, child_idx),
+			                  child_t_min, child_t_max, origin, inv_direction, ignore_unknown,
+			                  min_depth, result)) {
+				return true;
+			}
+			if (num_crossings != i) {
+				child_t_min = child_t_max;
+				child_idx ^= crossings[i].second;
+			}
+		}
+		return false;
+	}
+
+	//
+	// Collision checking
+	//
+
+	bool isCollisionFreeUnlocked(ufo::geometry::BoundingVar const& bounding_volume,
+	                             bool treat_unknown_as_occupied, DepthType min_depth) const
+	{
+		DepthType const depth = Base::getTreeDepthLevels();
+		if (!mayCollide(Base::getRoot(), depth, treat_unknown_as_occupied)) {
+			return true;
+		}
+
+		Point3 const center(0, 0, 0);
+		ufo::geometry::AABB const aabb(center, Base::getNodeHalfSize(depth));
+		// Resolve the type once, so the intersection tests in the descent are not dispatched
+		return std::visit(
+		    [&](auto const& bv) {
+			    return !geometry::intersects(bv, aabb) ||
+			           !collides(bv, Base::getRoot(), center, depth,
+			                     treat_unknown_as_occupied, std::min(min_depth, depth));
+		    },
+		    bounding_volume);
+	}
+
+	/**
+	 * @brief Whether the subtree of node contains an occupied node, or an unknown node if
+	 * treat_unknown_as_occupied. The occupancy of an inner node is the maximum of its
+	 * children, so this is a single comparison.
+	 */
+	bool mayCollide(LEAF_NODE const& node, DepthType depth,
+	                bool treat_unknown_as_occupied) const
+	{
+		return containsOccupied(node, depth) ||
+		       (treat_unknown_as_occupied && containsUnknown(node, depth));
+	}
+
+	/**
+	 * @brief Whether a node in the subtree of node that may collide intersects
+	 * bounding_volume. Node has to intersect bounding_volume and may collide.
+	 */
+	template <typename BoundingType>
+	bool collides(BoundingType const& bounding_volume, LEAF_NODE const& node,
+	              Point3 const& center, DepthType depth, bool treat_unknown_as_occupied,
+	              DepthType min_depth) const
+	{
+		if (min_depth >= depth || Base::isLeaf(&node, depth)) {
+			return true;
+		}
+
+		DepthType const child_depth = depth - 1;
+		double const child_half_size = Base::getNodeHalfSize(child_depth);
+		INNER_NODE const& inner = static_cast<INNER_NODE const&>(node);
+		// Test the occupancy first, it is far cheaper than the intersection
+		std::uint8_t may_collide = 0;
+		for (std::size_t i = 0; i < 8; ++i) {
+			if (mayCollide(Base::getChild(inner, child_depth, i), child_depth,
+			               treat_unknown_as_occupied)) {
+				may_collide |= 1U << i;
+			}
+		}
+		if (0 == may_collide) {
+			return false;
+		}
+
+		ufo::geometry::ChildrenMask const children =
+		    geometry::intersectsChildren(bounding_volume, center, child_half_size);
+		if (may_collide & children.inside) {
+			// Every node in a child completely inside the bounding volume intersects it
+			return true;
+		}
+		may_collide &= children.intersects;
+		for (std::size_t i = 0; i < 8; ++i) {
+			if (((may_collide >> i) & 1U) &&
+			    collides(bounding_volume, Base::getChild(inner, child_depth, i),
+			             Base::getChildCenter(center, child_half_size, i), child_depth,
+			             treat_unknown_as_occupied, min_depth)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//
+	// Set value volume
+	//
+
+	bool setValueVolumeRecurs(ufo::geometry::BoundingVar const& bounding_volume,
+	                          double occupancy_value, INNER_NODE& node, Code const& code,
+	                          Point3 const& center, DepthType current_depth,
+	                          DepthType min_depth = 0, bool inside = false)
+	{
+		DepthType const child_depth = current_depth - 1;
+		double const child_half_size = Base::getNodeHalfSize(child_depth);
+
+		Base::createChildren(node, current_depth);
+
+		// Below a node completely inside the bounding volume nothing has to be tested
+		ufo::geometry::ChildrenMask const children =
+		    inside ? ufo::geometry::ChildrenMask{0xFF, 0xFF}
+		           : geometry::intersectsChildren(bounding_volume, center, child_half_size);
+		bool changed = false;
 		for (size_t i = 0; i < 8; ++i) {
-			aabb.center = Base::getChildCenter(center, child_half_size, i);
-			if (std::visit(
-			        [&aabb](auto&& arg) -> bool { return geometry::intersects(arg, aabb); },
-			        bounding_volume)) {
+			if ((children.intersects >> i) & 1U) {
 				if (0 == child_depth) {
 					if (setOccupancy(Base::getLeafChild(node, i).value.occupancy,
-					                 occupancy_value)) {
+					                 Logit::cast(occupancy_value))) {
 						changed = true;
+						if (change_detection_enabled_) {
+							changes_.insert(code.getChild(i));
+						}
 					}
 				} else {
 					INNER_NODE& child = Base::getInnerChild(node, i);
 					if (min_depth < child_depth) {
-						if (setValueVolumeRecurs(bounding_volume, occupancy_value, child, aabb.center,
-						                         child_depth, min_depth)) {
+						bool const child_inside = (children.inside >> i) & 1U;
+						if (setValueVolumeRecurs(bounding_volume, occupancy_value, child,
+						                         code.getChild(i),
+						                         Base::getChildCenter(center, child_half_size, i),
+						                         child_depth, min_depth, child_inside)) {
 							changed = true;
 						}
 					} else {
+						bool const had_children = Base::hasChildren(child);
 						Base::deleteChildren(child, child_depth);
-						if (setOccupancy(child.value.occupancy, occupancy_value)) {
+						bool const child_changed =
+						    setOccupancy(child.value.occupancy, Logit::cast(occupancy_value));
+						if (updateNode(child, child_depth) || child_changed) {
 							changed = true;
 						}
-						if (updateNode(child, child_depth)) {
-							changed = true;
+						if (change_detection_enabled_ && (child_changed || had_children)) {
+							changes_.insert(code.getChild(i));
 						}
 					}
 				}
@@ -1034,26 +2488,34 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 	// Set value
 	//
 
-	void setNodeValue(Code const& code, float occupancy)
+	void setNodeValue(Code const& code, LogitType occupancy)
 	{
-		auto [path, depth] = Base::getNodePath(code);
+		{
+			auto lock = lockWrite(code);
+			auto [path, depth] = Base::getNodePath(code);
 
-		occupancy = clampOccupancy(occupancy);
-		if (path[depth]->value.occupancy == occupancy) {
-			return;
-		}
+			occupancy = clampOccupancy(occupancy);
+			if (path[depth]->value.occupancy == occupancy) {
+				return;
+			}
 
-		if (code.getDepth() != depth) {
-			createNode(path, code, depth);
-			depth = code.getDepth();
-		}
+			if (code.getDepth() != depth) {
+				Base::createNode(code, path, depth);
+				depth = code.getDepth();
+			}
+
+			path[depth]->value.occupancy = occupancy;
+			if (Base::hasChildren(path[depth], depth)) {
+				Base::deleteChildren(static_cast<INNER_NODE&>(*path[depth]), depth);
+			}
+			if (change_detection_enabled_) {
+				changes_.insert(code);
+			}
 
-		path[depth]->value.occupancy = occupancy;
-		if (Base::hasChildren(path[depth], depth)) {
-			Base::deleteChildren(static_cast<INNER_NODE&>(*path[depth]), depth);
+			updateParents(path, depth);
 		}
 
-		updateParents(path, depth);
+		refreshDistanceField(std::array<Code, 1>{code}, false);
 	}
 
 	//
@@ -1062,29 +2524,56 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 
 	void updateValue(Code const& code, LogitType const& update)
 	{
-		auto path = Base::createNode(code);
+		{
+			auto lock = lockWrite(code);
+			Path path;
+			path[Base::getTreeDepthLevels()] = static_cast<LEAF_NODE*>(&Base::getRoot());
+			Base::createNode(code, path, Base::getTreeDepthLevels());
+			updateParents(code, path, applyUpdate(code, update, path, changes_));
+		}
+
+		refreshDistanceField(std::array<Code, 1>{code}, false);
+	}
+
+	/**
+	 * @brief Update the value of the node at path[code.getDepth()], which has to exist,
+	 * without updating its parents
+	 *
+	 * @return The depth from which the parents have to be updated, larger than the depth
+	 * of the tree if no parent has to be updated
+	 */
+	DepthType applyUpdate(Code const& code, LogitType const& update, Path const& path,
+	                      CodeSet& changes)
+	{
 		DepthType depth = code.getDepth();
 
 		if (Base::isLeaf(path[depth], depth)) {
 			if (updateOccupancy(path[depth]->value.occupancy, update)) {
 				if (change_detection_enabled_) {
-					changes_.insert(code);
+					changes.insert(code);
 				}
 			}
-		} else {
-			if (!updateAllChildren(code, static_cast<INNER_NODE&>(*path[depth]), depth,
-			                       update)) {
-				return;
-			}
-			++depth;
+			return depth;
 		}
 
-		updateParents(path, depth);
+		if (!updateAllChildren(code, static_cast<INNER_NODE&>(*path[depth]), depth, update,
+		                       changes)) {
+			return Base::getTreeDepthLevels() + 1;
+		}
+		return depth + 1;
 	}
 
 	bool updateAllChildren(Code const& code, INNER_NODE& node, DepthType depth,
 	                       LogitType const& update)
 	{
+		return updateAllChildren(code, node, depth, update, changes_);
+	}
+
+	bool updateAllChildren(Code const& code, INNER_NODE& node, DepthType depth,
+	                       LogitType const& update, CodeSet& changes)
+	{
+		Base::unshareChildren(node, depth);
+
 		bool changed = false;
 		if (1 == depth) {
 			for (int i = 0; i < 8; ++i) {
@@ -1092,7 +2581,7 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 				if (updateOccupancy(child.value.occupancy, update)) {
 					changed = true;
 					if (change_detection_enabled_) {
-						changes_.insert(code);
+						changes.insert(code);
 					}
 				}
 			}
@@ -1104,12 +2593,12 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 						changed = true;
 						updateNode(child, depth - 1);
 						if (change_detection_enabled_) {
-							changes_.insert(code);
+							changes.insert(code);
 						}
 					}
 				} else {
 					// TODO: Careful here
-					if (updateAllChildren(code.getChild(i), child, depth - 1, update)) {
+					if (updateAllChildren(code.getChild(i), child, depth - 1, update, changes)) {
 						changed = true;
 					}
 				}
@@ -1123,13 +2612,697 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 	// Update parents
 	//
 
+	/**
+	 * @brief Update the parents of the node code after applyUpdate returned depth. With
+	 * lazy propagation they are only marked dirty, see propagate.
+	 */
+	void updateParents(Code const& code, Path const& path, DepthType depth)
+	{
+		if (Base::getTreeDepthLevels() < depth) {
+			return;
+		}
+		if (lazy_propagation_ && !isThreadSafetyEnabled()) {
+			dirty_.insert(code.toDepth(std::max(DepthType(1), depth)));
+		} else {
+			updateParents(path, depth);
+		}
+	}
+
+	/**
+	 * @brief Make sure the inner nodes are up to date before the map is read. The inner
+	 * nodes only summarize their children, so this does not change what the map contains.
+	 */
+	void ensurePropagated() const
+	{
+		if (!dirty_.empty()) {
+			const_cast<OccupancyMapBase*>(this)->propagate();
+		}
+	}
+
 	void updateParents(Path const& path, DepthType depth)
 	{
-		for (unsigned int d = std::max(1u, depth); d <= Base::getTreeDepthLevels(); ++d) {
+		if (updateParents(path, depth, Base::getTreeDepthLevels())) {
+			updateNode(Base::getRoot(), Base::getTreeDepthLevels());
+		}
+	}
+
+	/**
+	 * @brief Update the parents below path[subtree_depth]
+	 *
+	 * @return Whether the node at subtree_depth has to be updated
+	 */
+	bool updateParents(Path const& path, DepthType depth, DepthType subtree_depth)
+	{
+		if (depth > subtree_depth) {
+			return false;
+		}
+		for (unsigned int d = std::max(1u, depth); d < subtree_depth; ++d) {
 			if (!updateNode(static_cast<INNER_NODE&>(*path[d]), d)) {
-				return;
+				return false;
+			}
+		}
+		return true;
+	}
+
+	//
+	// Distance field
+	//
+
+	void distanceQuery(std::vector<Point3> const& points, double* distances,
+	                   Point3* gradients) const
+	{
+		if (!distance_field_) {
+			throw std::logic_error("The distance field is not enabled");
+		}
+
+		std::shared_lock<std::shared_mutex> lock;
+		if (locks_) {
+			lock = std::shared_lock<std::shared_mutex>(locks_->distance_field);
+		}
+
+		std::atomic_size_t next = 0;
+		auto worker = [&]() {
+			for (std::size_t i = next++; i < points.size(); i = next++) {
+				distances[i] = gradients ? distance_field_->distance(points[i], gradients[i])
+				                         : distance_field_->distance(points[i]);
+			}
+		};
+
+		std::size_t const num_threads = std::min<std::size_t>(
+		    integration_threads_, points.size() / MIN_QUERIES_PER_THREAD);
+		std::vector<std::future<void>> workers;
+		for (std::size_t i = 1; i < num_threads; ++i) {
+			workers.push_back(std::async(std::launch::async, worker));
+		}
+		worker();
+		for (auto& w : workers) {
+			w.get();
+		}
+	}
+
+	/**
+	 * @brief Let refresh set and remove obstacles of the distance field, then propagate
+	 * the changes. Does nothing if the distance field is disabled.
+	 */
+	template <typename F>
+	void updateDistanceField(F refresh)
+	{
+		if (!distance_field_) {
+			return;
+		}
+		auto lock = lockAll<SharedLock>();
+		std::unique_lock<std::shared_mutex> field_lock;
+		if (locks_) {
+			field_lock = std::unique_lock<std::shared_mutex>(locks_->distance_field);
+		}
+		refresh();
+		distance_field_->update();
+	}
+
+	/**
+	 * @brief Refresh the distance field for the nodes of updates, either codes or
+	 * tuple-likes with the code first. Updates that can only lower the occupancy can not
+	 * add obstacles, so with only_obstacles the voxels at depth 0 that are not obstacles
+	 * are skipped.
+	 */
+	template <typename C>
+	void refreshDistanceField(C const& updates, bool only_obstacles)
+	{
+		updateDistanceField([this, &updates, only_obstacles]() {
+			for (auto const& update : updates) {
+				Code const& code = codeOf(update);
+				if (only_obstacles && 0 == code.getDepth() &&
+				    !distance_field_->isObstacle(code.toKey())) {
+					continue;
+				}
+				refreshDistanceField(code);
+			}
+		});
+	}
+
+	/**
+	 * @brief Set or remove the obstacles of the voxels at depth 0 covered by code
+	 */
+	void refreshDistanceField(Code const& code)
+	{
+		auto [node, depth] = Base::getNode(code);
+		refreshDistanceFieldRecurs(*node, depth, code);
+	}
+
+	void refreshDistanceFieldRecurs(LEAF_NODE const& node, DepthType depth,
+	                                Code const& code)
+	{
+		if (code.getDepth() < depth || Base::isLeaf(&node, depth)) {
+			// All voxels of code have the same state as node
+			Key const key = code.toKey();
+			KeyType const last = (KeyType(1) << code.getDepth()) - 1;
+			Key const min(key[0], key[1], key[2], 0);
+			Key const max(key[0] + last, key[1] + last, key[2] + last, 0);
+			if (isOccupied(node)) {
+				distance_field_->setObstacles(min, max);
+			} else {
+				distance_field_->removeObstacles(min, max);
+			}
+			return;
+		}
+
+		INNER_NODE const& inner = static_cast<INNER_NODE const&>(node);
+		for (std::size_t i = 0; i < 8; ++i) {
+			refreshDistanceFieldRecurs(Base::getChild(inner, depth - 1, i), depth - 1,
+			                           code.getChild(i));
+		}
+	}
+
+	void rebuildDistanceField()
+	{
+		updateDistanceField([this]() {
+			distance_field_->clear();
+			traverse(TraversePredicate<true, false, false>(), [this](TraverseNode const& node) {
+				refreshDistanceField(node.getCode());
+			});
+		});
+	}
+
+	//
+	// Thread safety
+	//
+
+	using SharedLock = std::shared_lock<std::shared_mutex>;
+	using UniqueLock = std::unique_lock<std::shared_mutex>;
+
+	inline static constexpr std::size_t NUM_LOCK_STRIPES = 64;
+
+	/**
+	 * @brief Locks held in thread safe mode, released when destroyed. Empty when thread
+	 * safe mode is disabled.
+	 */
+	template <typename Lock>
+	struct ThreadSafeLock {
+		// For operations on a region or the whole map, a fixed array so nothing is allocated
+		std::array<Lock, NUM_LOCK_STRIPES> stripes;
+		Lock stripe;
+		Lock root;
+		std::unique_lock<std::mutex> changes;
+	};
+
+	/**
+	 * @return The depth of the subtrees guarded by the stripes
+	 */
+	DepthType lockDepth() const noexcept
+	{
+		return std::clamp(locks_->depth, DepthType(2), Base::getTreeDepthLevels());
+	}
+
+	std::size_t stripeIndex(Code const& code) const
+	{
+		// Neighboring subtrees are guarded by different stripes
+		return (code.getCode() >> (3 * lockDepth())) % NUM_LOCK_STRIPES;
+	}
+
+	std::shared_mutex& stripeOf(Code const& code) const
+	{
+		return locks_->stripes[stripeIndex(code)];
+	}
+
+	/**
+	 * @brief Lock for reading the node code. A stripe is always locked before the root.
+	 */
+	ThreadSafeLock<SharedLock> lockRead(Code const& code) const
+	{
+		ThreadSafeLock<SharedLock> lock;
+		if (locks_) {
+			if (code.getDepth() < lockDepth()) {
+				lock.stripe = SharedLock(stripeOf(code));
+			}
+			lock.root = SharedLock(locks_->root);
+		}
+		return lock;
+	}
+
+	/**
+	 * @brief Lock for reading the nodes intersecting any of bounding_volumes. Only the
+	 * stripes of the subtrees they touch are locked, in ascending order, then the root.
+	 */
+	template <typename BoundingVolumes>
+	ThreadSafeLock<SharedLock> lockRead(BoundingVolumes const& bounding_volumes) const
+	{
+		ThreadSafeLock<SharedLock> lock;
+		if (locks_) {
+			std::bitset<NUM_LOCK_STRIPES> const stripes = stripesOf(bounding_volumes);
+			for (std::size_t i = 0; i != NUM_LOCK_STRIPES; ++i) {
+				if (stripes[i]) {
+					lock.stripes[i] = SharedLock(locks_->stripes[i]);
+				}
+			}
+			lock.root = SharedLock(locks_->root);
+		}
+		return lock;
+	}
+
+	std::bitset<NUM_LOCK_STRIPES> stripesOf(
+	    std::vector<ufo::geometry::BoundingVar> const& bounding_volumes) const
+	{
+		std::bitset<NUM_LOCK_STRIPES> stripes;
+		for (auto const& bounding_volume : bounding_volumes) {
+			if (stripes.all()) {
+				break;
+			}
+			stripes |= stripesOf(bounding_volume);
+		}
+		return stripes;
+	}
+
+	/**
+	 * @return The stripes of the subtrees at the lock depth that intersect
+	 * bounding_volume, found with the same tests as the queries descending the tree
+	 */
+	std::bitset<NUM_LOCK_STRIPES> stripesOf(
+	    ufo::geometry::BoundingVar const& bounding_volume) const
+	{
+		std::bitset<NUM_LOCK_STRIPES> stripes;
+		std::visit(
+		    [this, &stripes](auto const& bv) {
+			    stripesOfRecurs(bv, Base::getRootCode(), Point3(0, 0, 0), stripes);
+		    },
+		    bounding_volume);
+		return stripes;
+	}
+
+	template <typename BoundingType>
+	void stripesOfRecurs(BoundingType const& bounding_volume, Code const& code,
+	                     Point3 const& center, std::bitset<NUM_LOCK_STRIPES>& stripes) const
+	{
+		DepthType const depth = code.getDepth();
+		if (lockDepth() == depth) {
+			stripes.set(stripeIndex(code));
+			return;
+		}
+
+		double const child_half_size = Base::getNodeHalfSize(depth - 1);
+		std::uint8_t const children =
+		    geometry::intersectsChildren(bounding_volume, center, child_half_size).intersects;
+		for (unsigned int i = 0; i < 8 && !stripes.all(); ++i) {
+			if ((children >> i) & 1U) {
+				stripesOfRecurs(bounding_volume, code.getChild(i),
+				                Base::getChildCenter(center, child_half_size, i), stripes);
+			}
+		}
+	}
+
+	/**
+	 * @brief Lock for modifying the node code, its descendants and its ancestors
+	 */
+	ThreadSafeLock<UniqueLock> lockWrite(Code const& code)
+	{
+		if (!locks_ || lockDepth() <= code.getDepth()) {
+			return lockAll<UniqueLock>();
+		}
+		ThreadSafeLock<UniqueLock> lock;
+		lock.stripe = UniqueLock(stripeOf(code));
+		lock.root = UniqueLock(locks_->root);
+		if (change_detection_enabled_) {
+			lock.changes = std::unique_lock<std::mutex>(locks_->changes);
+		}
+		return lock;
+	}
+
+	template <typename Lock>
+	ThreadSafeLock<Lock> lockAll() const
+	{
+		ThreadSafeLock<Lock> lock;
+		if (locks_) {
+			for (std::size_t i = 0; i != NUM_LOCK_STRIPES; ++i) {
+				lock.stripes[i] = Lock(locks_->stripes[i]);
+			}
+			lock.root = Lock(locks_->root);
+			if constexpr (std::is_same_v<Lock, UniqueLock>) {
+				lock.changes = std::unique_lock<std::mutex>(locks_->changes);
 			}
 		}
+		return lock;
+	}
+
+	/**
+	 * @return Set used to remove duplicate end points when inserting a point cloud,
+	 * thread local in thread safe mode
+	 */
+	CodeSet& insertionIndices()
+	{
+		if (!locks_) {
+			return indices_;
+		}
+		thread_local CodeSet indices;
+		return indices;
+	}
+
+	void addMinMaxChange(Point3 const& min_change, Point3 const& max_change)
+	{
+		if (!min_max_change_detection_enabled_) {
+			return;
+		}
+		std::unique_lock<std::mutex> lock;
+		if (locks_) {
+			lock = std::unique_lock<std::mutex>(locks_->changes);
+		}
+		for (int i : {0, 1, 2}) {
+			min_change_[i] = std::min(min_change_[i], min_change[i]);
+			max_change_[i] = std::max(max_change_[i], max_change[i]);
+		}
+	}
+
+	//
+	// Update values
+	//
+
+	/**
+	 * @brief Apply a batch of updates. The updates are bucketed by the subtree at the
+	 * split depth they fall in and the subtrees are updated in parallel, after which the
+	 * nodes above the split depth are updated once.
+	 *
+	 * @param updates The updates, either codes or tuple-likes with the code first
+	 * @param apply_fun Updates an existing node, called as apply_fun(update, path,
+	 * changes) and has the same semantics as applyUpdate
+	 */
+	template <typename C, typename F>
+	void updateValues(C const& updates, F apply_fun)
+	{
+		using Update =
+		    typename SortableUpdate<std::decay_t<decltype(*std::cbegin(updates))>>::type;
+
+		DepthType const tree_depth = Base::getTreeDepthLevels();
+		DepthType const split_depth = std::min(integration_split_depth_, tree_depth);
+
+		std::size_t num_threads = std::min<std::size_t>(
+		    integration_threads_, updates.size() / MIN_UPDATES_PER_INTEGRATION_THREAD);
+
+		// With batch integration the updates are sorted in place
+		auto update_subtree = [this, &apply_fun](std::vector<Update>& subtree_updates,
+		                                         Path& path, DepthType subtree_depth,
+		                                         CodeSet& changes) {
+			if (!batch_integration_) {
+				return updateSubtree(std::cbegin(subtree_updates), std::cend(subtree_updates),
+				                     path, subtree_depth, changes, apply_fun);
+			}
+			// Stable, so updates of the same node are applied in the order they were given
+			std::stable_sort(std::begin(subtree_updates), std::end(subtree_updates),
+			                 [](Update const& a, Update const& b) {
+				                 return codeOf(a) < codeOf(b);
+			                 });
+			return updateSubtreeSorted(std::cbegin(subtree_updates),
+			                           std::cend(subtree_updates), path, subtree_depth,
+			                           changes, apply_fun);
+		};
+
+		if (locks_) {
+			updateValuesLocked(updates, std::max<std::size_t>(1, num_threads), update_subtree);
+			return;
+		}
+
+		if (1 >= num_threads || 0 == split_depth || tree_depth == split_depth) {
+			Path path;
+			path[tree_depth] = static_cast<LEAF_NODE*>(&Base::getRoot());
+			bool root_changed;
+			if (batch_integration_) {
+				std::vector<Update> sorted(std::cbegin(updates), std::cend(updates));
+				root_changed = update_subtree(sorted, path, tree_depth, changes_);
+			} else {
+				root_changed = updateSubtree(std::cbegin(updates), std::cend(updates), path,
+				                             tree_depth, changes_, apply_fun);
+			}
+			if (root_changed) {
+				updateNode(Base::getRoot(), tree_depth);
+			}
+			return;
+		}
+
+		// Bucket the updates by subtree, updates at or above the split depth are applied
+		// serially afterwards
+		std::vector<Code> subtrees;
+		std::vector<std::vector<Update>> buckets;
+		std::vector<Update> above;
+		std::unordered_map<Code, std::size_t, Code::Hash> bucket_of;
+		for (Update const& update : updates) {
+			Code const& code = codeOf(update);
+			if (split_depth <= code.getDepth()) {
+				above.push_back(update);
+				continue;
+			}
+			auto [it, inserted] =
+			    bucket_of.try_emplace(code.toDepth(split_depth), buckets.size());
+			if (inserted) {
+				subtrees.push_back(it->first);
+				buckets.emplace_back();
+			}
+			buckets[it->second].push_back(update);
+		}
+
+		// Create the subtree roots and their children, so the workers never modify a node
+		// shared with another subtree
+		std::vector<INNER_NODE*> roots;
+		roots.reserve(subtrees.size());
+		for (Code const& subtree : subtrees) {
+			INNER_NODE& root =
+			    static_cast<INNER_NODE&>(*Base::createNode(subtree)[split_depth]);
+			Base::createChildren(root, split_depth);
+			roots.push_back(&root);
+		}
+
+		// Each worker takes the next subtree until all are updated
+		num_threads = std::min(num_threads, buckets.size());
+		std::vector<char> dirty(buckets.size(), false);
+		std::atomic_size_t next = 0;
+		auto worker = [&](CodeSet& changes) {
+			Path path;
+			for (std::size_t i = next++; i < buckets.size(); i = next++) {
+				path[split_depth] = static_cast<LEAF_NODE*>(roots[i]);
+				dirty[i] = update_subtree(buckets[i], path, split_depth, changes);
+			}
+		};
+
+		std::vector<CodeSet> changes(num_threads - 1,
+		                             CodeSet(change_detection_enabled_ ? 10 : 0));
+		std::vector<std::future<void>> workers;
+		workers.reserve(num_threads - 1);
+		for (CodeSet& worker_changes : changes) {
+			workers.push_back(std::async(std::launch::async, [&worker, &worker_changes]() {
+				worker(worker_changes);
+			}));
+		}
+		worker(changes_);
+		for (auto& w : workers) {
+			w.get();
+		}
+
+		for (CodeSet const& worker_changes : changes) {
+			for (Code const& code : worker_changes) {
+				changes_.insert(code);
+			}
+		}
+
+		// Update the nodes above the split depth, one level at a time
+		std::vector<Code> level;
+		for (std::size_t i = 0; i != roots.size(); ++i) {
+			if (dirty[i] && updateNode(*roots[i], split_depth)) {
+				level.push_back(subtrees[i].toDepth(split_depth + 1));
+			}
+		}
+		for (DepthType depth = split_depth + 1; depth <= tree_depth && !level.empty();
+		     ++depth) {
+			std::sort(std::begin(level), std::end(level));
+			level.erase(std::unique(std::begin(level), std::end(level)), std::end(level));
+
+			std::vector<Code> next_level;
+			for (Code const& code : level) {
+				INNER_NODE& node = static_cast<INNER_NODE&>(*Base::getNode(code).first);
+				if (updateNode(node, depth) && depth < tree_depth) {
+					next_level.push_back(code.toDepth(depth + 1));
+				}
+			}
+			level.swap(next_level);
+		}
+
+		Path path;
+		path[tree_depth] = static_cast<LEAF_NODE*>(&Base::getRoot());
+		if (update_subtree(above, path, tree_depth, changes_)) {
+			updateNode(Base::getRoot(), tree_depth);
+		}
+	}
+
+	/**
+	 * @brief updateValues in thread safe mode. The updates are bucketed by the subtree one
+	 * depth below the lock depth they fall in. A bucket is applied holding the stripe of
+	 * its subtree at the lock depth, the root lock is only held while the path to the
+	 * subtree is created and while its ancestors are updated. Updates of nodes at or
+	 * above the bucket depth hold all locks.
+	 */
+	template <typename C, typename U>
+	void updateValuesLocked(C const& updates, std::size_t num_threads, U update_subtree)
+	{
+		using Update =
+		    typename SortableUpdate<std::decay_t<decltype(*std::cbegin(updates))>>::type;
+
+		DepthType const tree_depth = Base::getTreeDepthLevels();
+		DepthType const lock_depth = lockDepth();
+		DepthType const subtree_depth = lock_depth - 1;
+
+		std::vector<Code> subtrees;
+		std::vector<std::vector<Update>> buckets;
+		std::vector<Update> above;
+		std::unordered_map<Code, std::size_t, Code::Hash> bucket_of;
+		for (Update const& update : updates) {
+			Code const& code = codeOf(update);
+			if (subtree_depth <= code.getDepth()) {
+				above.push_back(update);
+				continue;
+			}
+			auto [it, inserted] =
+			    bucket_of.try_emplace(code.toDepth(subtree_depth), buckets.size());
+			if (inserted) {
+				subtrees.push_back(it->first);
+				buckets.emplace_back();
+			}
+			buckets[it->second].push_back(update);
+		}
+
+		std::atomic_size_t next = 0;
+		auto worker = [&](CodeSet& changes) {
+			for (std::size_t i = next++; i < buckets.size(); i = next++) {
+				UniqueLock stripe(stripeOf(subtrees[i]));
+				Path path;
+				{
+					// Creates the subtree at the lock depth, which shares its block with
+					// subtrees guarded by other stripes
+					UniqueLock root(locks_->root);
+					path = Base::createNode(subtrees[i]);
+				}
+				INNER_NODE& node = static_cast<INNER_NODE&>(*path[subtree_depth]);
+				Base::createChildren(node, subtree_depth);
+				if (update_subtree(buckets[i], path, subtree_depth, changes) &&
+				    updateNode(node, subtree_depth)) {
+					UniqueLock root(locks_->root);
+					updateParents(path, lock_depth);
+				}
+			}
+		};
+
+		num_threads = std::min(num_threads, buckets.size());
+		std::vector<CodeSet> changes(std::max<std::size_t>(1, num_threads),
+		                             CodeSet(change_detection_enabled_ ? 10 : 0));
+		std::vector<std::future<void>> workers;
+		for (std::size_t i = 1; i < num_threads; ++i) {
+			workers.push_back(std::async(std::launch::async,
+			                             [&worker, &changes, i]() { worker(changes[i]); }));
+		}
+		worker(changes[0]);
+		for (auto& w : workers) {
+			w.get();
+		}
+
+		if (!above.empty()) {
+			auto lock = lockAll<UniqueLock>();
+			Path path;
+			path[tree_depth] = static_cast<LEAF_NODE*>(&Base::getRoot());
+			if (update_subtree(above, path, tree_depth, changes[0])) {
+				updateNode(Base::getRoot(), tree_depth);
+			}
+		}
+
+		if (change_detection_enabled_) {
+			std::lock_guard<std::mutex> lock(locks_->changes);
+			for (CodeSet const& worker_changes : changes) {
+				for (Code const& code : worker_changes) {
+					changes_.insert(code);
+				}
+			}
+		}
+	}
+
+	static Code const& codeOf(Code const& update) noexcept { return update; }
+
+	template <typename T>
+	static Code const& codeOf(T const& update) noexcept
+	{
+		return std::get<0>(update);
+	}
+
+	// The type updates are copied to for sorting, which the entries of a CodeMap can not
+	// be as their keys are const
+	template <typename T>
+	struct SortableUpdate {
+		using type = T;
+	};
+
+	template <typename T>
+	struct SortableUpdate<std::pair<Code const, T>> {
+		using type = std::pair<Code, T>;
+	};
+
+	/**
+	 * @brief Apply updates in the subtree rooted at path[subtree_depth], one at a time. The
+	 * subtree root and the nodes above it are not touched.
+	 *
+	 * @return Whether the subtree root has to be updated
+	 */
+	template <typename InputIt, typename F>
+	bool updateSubtree(InputIt first, InputIt last, Path& path, DepthType subtree_depth,
+	                   CodeSet& changes, F apply_fun)
+	{
+		bool changed = false;
+		for (; first != last; ++first) {
+			Base::createNode(codeOf(*first), path, subtree_depth);
+			if (updateParents(path, apply_fun(*first, path, changes), subtree_depth)) {
+				changed = true;
+			}
+		}
+		return changed;
+	}
+
+	/**
+	 * @brief Apply updates sorted in Morton order in the subtree rooted at
+	 * path[subtree_depth], in a single depth-first sweep where each touched inner node is
+	 * updated once when it is left. The subtree root and the nodes above it are not
+	 * touched.
+	 *
+	 * @return Whether the subtree root has to be updated
+	 */
+	template <typename InputIt, typename F>
+	bool updateSubtreeSorted(InputIt first, InputIt last, Path& path,
+	                         DepthType subtree_depth, CodeSet& changes, F apply_fun)
+	{
+		// Nodes on the current path that have to be updated before they are left
+		std::array<bool, Base::MAX_DEPTH_LEVELS + 1> dirty{};
+		auto leave = [this, &path, &dirty](DepthType depth) {
+			for (DepthType d = 1; d < depth; ++d) {
+				if (dirty[d]) {
+					dirty[d] = false;
+					if (updateNode(static_cast<INNER_NODE&>(*path[d]), d)) {
+						dirty[d + 1] = true;
+					}
+				}
+			}
+		};
+
+		for (InputIt it = first; it != last; ++it) {
+			Code const& code = codeOf(*it);
+			// The nodes below the deepest common ancestor of the previous and this code
+			// are never visited again, since the updates are in depth-first order
+			DepthType depth =
+			    it == first
+			        ? subtree_depth
+			        : std::min(subtree_depth,
+			                   Code::commonAncestorDepth(codeOf(*std::prev(it)), code));
+			leave(depth);
+			Base::createNode(code, path, depth);
+			// The parents are always updated, so nodes expanded by createNode are pruned
+			DepthType parents_depth =
+			    std::min(apply_fun(*it, path, changes), code.getDepth() + 1);
+			if (parents_depth <= subtree_depth) {
+				dirty[std::max(DepthType(1), parents_depth)] = true;
+			}
+		}
+		leave(subtree_depth);
+
+		return dirty[subtree_depth];
 	}
 
 	//
@@ -1139,8 +3312,16 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 	bool updateOccupancy(LogitType& current, LogitType const& update)
 	{
 		LogitType old_occupancy = current;
-		current = std::clamp<LogitType>(current + update, clamping_thres_min_log_,
-		                                clamping_thres_max_log_);
+		if constexpr (std::is_integral_v<LogitType>) {
+			// Saturate instead of wrapping around
+			using Wide = std::conditional_t<sizeof(LogitType) < sizeof(int), int, long long>;
+			current = static_cast<LogitType>(std::clamp<Wide>(
+			    Wide(current) + Wide(update), Wide(clamping_thres_min_log_),
+			    Wide(clamping_thres_max_log_)));
+		} else {
+			current = std::clamp<LogitType>(current + update, clamping_thres_min_log_,
+			                                clamping_thres_max_log_);
+		}
 		return old_occupancy != current;
 	}
 
@@ -1179,13 +3360,7 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 	virtual bool updateNode(INNER_NODE& node, DepthType depth)
 	{
 		if (Base::isLeaf(node)) {
-			bool new_contains_free = isFree(node);
-			bool new_contains_unknown = isUnknown(node);
-			bool updated = (node.contains_free != new_contains_free) ||
-			               (node.contains_unknown != new_contains_unknown);
-			node.contains_free = new_contains_free;
-			node.contains_unknown = new_contains_unknown;
-			return updated;
+			return setContains(node, isFree(node), isUnknown(node));
 		}
 
 		LogitType new_occupancy_value = std::numeric_limits<LogitType>::lowest();
@@ -1199,6 +3374,14 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 				new_contains_free = new_contains_free || isFree(child);
 				new_contains_unknown = new_contains_unknown || isUnknown(child);
 			}
+		} else if constexpr (Base::COMPACT_INNER_NODES) {
+			// The metadata of the children is stored as masks
+			typename Base::InnerChildren const& children = Base::getInnerChildren(node);
+			for (INNER_NODE const& child : children) {
+				new_occupancy_value = std::max(new_occupancy_value, child.value.occupancy);
+			}
+			new_contains_free = 0 != children.contains_free;
+			new_contains_unknown = 0 != children.contains_unknown;
 		} else {
 			for (int i = 0; i < 8; ++i) {
 				INNER_NODE const& child = Base::getInnerChild(node, i);
@@ -1212,15 +3395,9 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 			Base::deleteChildren(node, depth);
 		}
 
-		if (node.value.occupancy != new_occupancy_value ||
-		    node.contains_free != new_contains_free ||
-		    node.contains_unknown != new_contains_unknown) {
-			node.value.occupancy = new_occupancy_value;
-			node.contains_free = new_contains_free;
-			node.contains_unknown = new_contains_unknown;
-			return true;
-		}
-		return false;
+		bool updated = node.value.occupancy != new_occupancy_value;
+		node.value.occupancy = new_occupancy_value;
+		return setContains(node, new_contains_free, new_contains_unknown) || updated;
 	}
 
 	//
@@ -1231,7 +3408,59 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 	               T const& value, DepthType depth = 0, bool simple_ray_casting = false,
 	               unsigned int early_stopping = 0) const
 	{
-		for (auto const& point : cloud) {
+		std::size_t num_threads = std::min<std::size_t>(
+		    integration_threads_, cloud.size() / MIN_RAYS_PER_INTEGRATION_THREAD);
+
+		if (1 >= num_threads || (0 < early_stopping && deterministic_integration_)) {
+			freeSpaceRays(sensor_origin, std::cbegin(cloud), std::cend(cloud), indices, value,
+			              depth, simple_ray_casting, early_stopping);
+			return;
+		}
+
+		// Each shard of rays is cast into its own map, the first one on this thread
+		auto shard_begin = [first = std::cbegin(cloud), size = cloud.size(),
+		                    num_threads](std::size_t shard) {
+			return std::next(first, (shard * size) / num_threads);
+		};
+
+		std::vector<std::future<CodeMap<T>>> shards;
+		shards.reserve(num_threads - 1);
+		for (std::size_t i = 1; i < num_threads; ++i) {
+			shards.push_back(std::async(
+			    std::launch::async, [this, &sensor_origin, &value, depth, simple_ray_casting,
+			                         early_stopping, first = shard_begin(i),
+			                         last = shard_begin(i + 1)]() {
+				    CodeMap<T> shard_indices;
+				    freeSpaceRays(sensor_origin, first, last, shard_indices, value, depth,
+				                  simple_ray_casting, early_stopping);
+				    return shard_indices;
+			    }));
+		}
+
+		freeSpaceRays(sensor_origin, shard_begin(0), shard_begin(1), indices, value, depth,
+		              simple_ray_casting, early_stopping);
+
+		// Merge in shard order so the result does not depend on the thread scheduling
+		for (auto& shard : shards) {
+			for (auto const& [code, shard_value] : shard.get()) {
+				indices.try_emplace(code, shard_value);
+			}
+		}
+	}
+
+	template <typename T, typename InputIt>
+	void freeSpaceRays(Point3 const& sensor_origin, InputIt first, InputIt last,
+	                   CodeMap<T>& indices, T const& value, DepthType depth = 0,
+	                   bool simple_ray_casting = false, unsigned int early_stopping = 0) const
+	{
+#if defined(UFO_MAP_RAY_PACKETS)
+		bool const packets =
+		    packet_ray_casting_ && !simple_ray_casting && 0 == early_stopping && hasAvx2();
+		RayPacket packet;
+#endif
+
+		for (; first != last; ++first) {
+			auto const& point = *first;
 			Point3 current = sensor_origin;
 			Point3 end;
 
@@ -1252,10 +3481,23 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 
 			if (simple_ray_casting) {
 				freeSpaceSimple(current, end, indices, value, depth, early_stopping);
+#if defined(UFO_MAP_RAY_PACKETS)
+			} else if (packets) {
+				if (addToPacket(packet, current, end, indices, value, depth)) {
+					freeSpacePacket(packet, indices, value, depth);
+					packet.size = 0;
+				}
+#endif
 			} else {
 				freeSpaceNormal(current, end, indices, value, depth, early_stopping);
 			}
 		}
+
+#if defined(UFO_MAP_RAY_PACKETS)
+		if (0 < packet.size) {
+			freeSpacePacket(packet, indices, value, depth);
+		}
+#endif
 	}
 
 	template <typename T>
@@ -1300,6 +3542,177 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 		} while (current_key != end_key && t_max.min() <= distance);
 	}
 
+#if defined(UFO_MAP_RAY_PACKETS)
+	/**
+	 * @brief The state of up to SIZE rays traversed together, one ray per lane
+	 */
+	struct RayPacket {
+		static constexpr std::size_t SIZE = 4;
+
+		alignas(32) std::array<std::array<std::int64_t, SIZE>, 3> key;
+		alignas(32) std::array<std::array<std::int64_t, SIZE>, 3> end_key;
+		alignas(32) std::array<std::array<std::int64_t, SIZE>, 3> step;
+		alignas(32) std::array<std::array<double, SIZE>, 3> t_delta;
+		alignas(32) std::array<std::array<double, SIZE>, 3> t_max;
+		alignas(32) std::array<double, SIZE> distance;
+		std::size_t size = 0;
+	};
+
+	static bool hasAvx2() noexcept
+	{
+		static bool const avx2 = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+		return avx2;
+	}
+
+	/**
+	 * @brief Initialize the ray between from and to in the next lane of packet, cast
+	 * backwards as in freeSpaceNormal. A ray within a single node is handled directly.
+	 *
+	 * @return Whether the packet is full
+	 */
+	template <typename T>
+	bool addToPacket(RayPacket& packet, Point3 const& from, Point3 const& to,
+	                 CodeMap<T>& indices, T const& value, DepthType depth) const
+	{
+		Point3 direction = from - to;
+		double distance = direction.norm();
+		direction /= distance;
+		Key current_key;
+		Key end_key;
+		std::array<int, 3> step;
+		Point3 t_delta;
+		Point3 t_max;
+		Base::computeRayInit(to, from, direction, current_key, end_key, step, t_delta, t_max,
+		                     depth);
+
+		if (current_key == end_key) {
+			indices.try_emplace(Base::toCode(current_key), value);
+			return false;
+		}
+
+		std::size_t const lane = packet.size++;
+		for (int i : {0, 1, 2}) {
+			packet.key[i][lane] = current_key[i];
+			packet.end_key[i][lane] = end_key[i];
+			packet.step[i][lane] = step[i];
+			packet.t_delta[i][lane] = t_delta[i];
+			packet.t_max[i][lane] = t_max[i];
+		}
+		packet.distance[lane] = distance;
+		return RayPacket::SIZE == packet.size;
+	}
+
+	/**
+	 * @brief Traverse the rays of packet through the 3D DDA in lockstep, see
+	 * freeSpaceNormal. The steps are taken with the same double precision operations as
+	 * computeRayTakeStep, so the rays visit exactly the same nodes.
+	 */
+	template <typename T>
+	__attribute__((target("avx2"))) void freeSpacePacket(RayPacket const& packet,
+	                                                     CodeMap<T>& indices,
+	                                                     T const& value,
+	                                                     DepthType depth) const
+	{
+		__m256i key[3];
+		__m256i end_key[3];
+		__m256i step[3];
+		__m256d t_delta[3];
+		__m256d t_max[3];
+		for (int i : {0, 1, 2}) {
+			key[i] = _mm256_load_si256(reinterpret_cast<__m256i const*>(packet.key[i].data()));
+			end_key[i] =
+			    _mm256_load_si256(reinterpret_cast<__m256i const*>(packet.end_key[i].data()));
+			step[i] =
+			    _mm256_load_si256(reinterpret_cast<__m256i const*>(packet.step[i].data()));
+			t_delta[i] = _mm256_load_pd(packet.t_delta[i].data());
+			t_max[i] = _mm256_load_pd(packet.t_max[i].data());
+		}
+		__m256d const distance = _mm256_load_pd(packet.distance.data());
+
+		// Lanes past the size of the packet are never active
+		__m256i active = _mm256_cmpgt_epi64(_mm256_set1_epi64x(packet.size),
+		                                    _mm256_setr_epi64x(0, 1, 2, 3));
+
+		// The codes of a step are inserted during the next step, so their buckets can be
+		// prefetched while stepping since inserting is what dominates
+		alignas(32) std::array<CodeType, RayPacket::SIZE> codes;
+		alignas(32) std::array<CodeType, RayPacket::SIZE> prev_codes;
+		int prev_mask = 0;
+		auto insert = [&indices, &value, depth](auto const& codes, int mask) {
+			for (std::size_t lane = 0; lane != RayPacket::SIZE; ++lane) {
+				if ((mask >> lane) & 1) {
+					indices.try_emplace(Code(codes[lane], depth), value);
+				}
+			}
+		};
+
+		do {
+			_mm256_store_si256(reinterpret_cast<__m256i*>(codes.data()), toCodes(key));
+			int const mask = _mm256_movemask_pd(_mm256_castsi256_pd(active));
+			for (std::size_t lane = 0; lane != RayPacket::SIZE; ++lane) {
+				if ((mask >> lane) & 1) {
+					indices.prefetch(Code(codes[lane], depth));
+				}
+			}
+			insert(prev_codes, prev_mask);
+			prev_codes = codes;
+			prev_mask = mask;
+
+			// Advance along the axis with the smallest t_max, ties are broken as in
+			// Vector3::minElementIndex
+			__m256d const x_le_y = _mm256_cmp_pd(t_max[0], t_max[1], _CMP_LE_OQ);
+			__m256d const x_le_z = _mm256_cmp_pd(t_max[0], t_max[2], _CMP_LE_OQ);
+			__m256d const y_le_z = _mm256_cmp_pd(t_max[1], t_max[2], _CMP_LE_OQ);
+			__m256d const lanes = _mm256_castsi256_pd(active);
+			__m256d advance[3];
+			advance[0] = _mm256_and_pd(_mm256_and_pd(x_le_y, x_le_z), lanes);
+			advance[1] = _mm256_andnot_pd(advance[0], _mm256_and_pd(y_le_z, lanes));
+			advance[2] = _mm256_andnot_pd(_mm256_or_pd(advance[0], advance[1]), lanes);
+			for (int i : {0, 1, 2}) {
+				key[i] = _mm256_add_epi64(
+				    key[i], _mm256_and_si256(_mm256_castpd_si256(advance[i]), step[i]));
+				t_max[i] = _mm256_add_pd(t_max[i], _mm256_and_pd(advance[i], t_delta[i]));
+			}
+
+			// Continue while the end has not been reached and within distance
+			__m256i const at_end = _mm256_and_si256(
+			    _mm256_and_si256(_mm256_cmpeq_epi64(key[0], end_key[0]),
+			                     _mm256_cmpeq_epi64(key[1], end_key[1])),
+			    _mm256_cmpeq_epi64(key[2], end_key[2]));
+			__m256d const t_min = _mm256_min_pd(_mm256_min_pd(t_max[0], t_max[1]), t_max[2]);
+			__m256i const in_range =
+			    _mm256_castpd_si256(_mm256_cmp_pd(t_min, distance, _CMP_LE_OQ));
+			active = _mm256_and_si256(active, _mm256_andnot_si256(at_end, in_range));
+		} while (!_mm256_testz_si256(active, active));
+
+		insert(prev_codes, prev_mask);
+	}
+
+	/**
+	 * @brief Morton codes of four keys at once, see Code::toCode
+	 */
+	__attribute__((target("avx2"))) static __m256i toCodes(__m256i const (&key)[3])
+	{
+		__m256i code[3];
+		for (int i : {0, 1, 2}) {
+			__m256i c = _mm256_and_si256(key[i], _mm256_set1_epi64x(0x1fffff));
+			c = _mm256_and_si256(_mm256_or_si256(c, _mm256_slli_epi64(c, 32)),
+			                     _mm256_set1_epi64x(0x1f00000000ffff));
+			c = _mm256_and_si256(_mm256_or_si256(c, _mm256_slli_epi64(c, 16)),
+			                     _mm256_set1_epi64x(0x1f0000ff0000ff));
+			c = _mm256_and_si256(_mm256_or_si256(c, _mm256_slli_epi64(c, 8)),
+			                     _mm256_set1_epi64x(0x100f00f00f00f00f));
+			c = _mm256_and_si256(_mm256_or_si256(c, _mm256_slli_epi64(c, 4)),
+			                     _mm256_set1_epi64x(0x10c30c30c30c30c3));
+			code[i] = _mm256_and_si256(_mm256_or_si256(c, _mm256_slli_epi64(c, 2)),
+			                           _mm256_set1_epi64x(0x1249249249249249));
+		}
+		return _mm256_or_si256(
+		    _mm256_or_si256(code[0], _mm256_slli_epi64(code[1], 1)),
+		    _mm256_slli_epi64(code[2], 2));
+	}
+#endif
+
 	template <typename T>
 	void freeSpaceSimple(Point3 const& from, Point3 const& to, CodeMap<T>& indices,
 	                     T const& value, DepthType depth = 0,
@@ -1343,15 +3756,19 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 	//
 
 	void insertPointCloudHelper(Point3 sensor_origin, PointCloud&& discretized,
-	                            std::vector<std::pair<Code, float>>&& occupied_hits,
+	                            std::vector<std::pair<Code, LogitType>>&& occupied_hits,
 	                            LogitType prob_miss_log, DepthType depth,
 	                            bool simple_ray_casting, unsigned int early_stopping,
 	                            Point3 min_change, Point3 max_change)
 	{
-		std::future<void> f = std::async(std::launch::async, [this, &occupied_hits]() {
-			std::for_each(begin(occupied_hits), end(occupied_hits),
-			              [this](auto&& hit) { updateValue(hit.first, hit.second); });
-		});
+		auto apply_fun = [this](auto const& hit, Path const& path, CodeSet& changes) {
+			return applyUpdate(hit.first, hit.second, path, changes);
+		};
+
+		std::future<void> f =
+		    std::async(std::launch::async, [this, &occupied_hits, &apply_fun]() {
+			    updateValues(occupied_hits, apply_fun);
+		    });
 
 		CodeMap<LogitType> free_hits;
 
@@ -1360,25 +3777,25 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 
 		f.wait();
 
-		for (auto const& [code, value] : free_hits) {
-			updateValue(code, value);
-		}
+		updateValues(free_hits, apply_fun);
 
-		if (min_max_change_detection_enabled_) {
-			for (int i : {0, 1, 2}) {
-				min_change_[i] = std::min(min_change_[i], min_change[i]);
-				max_change_[i] = std::max(max_change_[i], max_change[i]);
-			}
-		}
+		addMinMaxChange(min_change, max_change);
+
+		propagate();
+
+		refreshDistanceField(occupied_hits, false);
+		refreshDistanceField(free_hits, true);
 	}
 
 	//
 	// Input/output (read/write)
 	//
 
-	virtual bool readNodes(std::istream& s,
+	virtual bool readNodes(ReadBuffer& buffer,
 	                       ufo::geometry::BoundingVolume const& bounding_volume) override
 	{
+		propagate();
+
 		// Check if inside bounding_volume
 		Point3 const center(0, 0, 0);
 		double half_size = Base::getNodeHalfSize(Base::getTreeDepthLevels());
@@ -1387,29 +3804,69 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 			return true;  // No node intersects
 		}
 
+		bool const success = readSubtree(buffer, bounding_volume, Base::getRoot(), center,
+		                                 Base::getTreeDepthLevels());
+		rebuildDistanceField();
+		return success;
+	}
+
+	/**
+	 * @brief Read the subtree with node, at depth at least one, as root
+	 */
+	bool readSubtree(ReadBuffer& buffer, ufo::geometry::BoundingVolume const& bounding_volume,
+	                 INNER_NODE& node, Point3 const& center, DepthType depth)
+	{
 		uint8_t children;
-		s.read(reinterpret_cast<char*>(&children), sizeof(children));
+		if (!buffer.read(children)) {
+			return false;
+		}
 
 		if (0 == children) {
-			Base::deleteChildren(Base::getRoot(), Base::getTreeDepthLevels());
-			Base::getRoot().readData(s);
-			updateNode(Base::getRoot(), Base::getTreeDepthLevels());
+			char const* data = buffer.next(LEAF_NODE::dataSize());
+			if (nullptr == data) {
+				return false;
+			}
+			Base::deleteChildren(node, depth);
+			node.readData(data);
+			updateNode(node, depth);
 			return true;
 		}
-		return readNodesRecurs(s, bounding_volume, Base::getRoot(), center,
-		                       Base::getTreeDepthLevels());
+
+		if (1 == depth) {
+			Base::createChildren(node, depth);
+			bool const success = readLeafChildren(buffer, bounding_volume, node, center);
+			updateNode(node, depth);
+			return success;
+		}
+
+		return readNodesRecurs(buffer, bounding_volume, node, center, depth);
 	}
 
-	bool readNodesRecurs(std::istream& s,
+	bool readNodesRecurs(ReadBuffer& buffer,
 	                     ufo::geometry::BoundingVolume const& bounding_volume,
 	                     INNER_NODE& node, Point3 const& center, unsigned int current_depth)
+	{
+		bool const success =
+		    readChildNodes(buffer, bounding_volume, node, center, current_depth);
+		updateNode(node, current_depth);  // To set indicators
+		return success;
+	}
+
+	/**
+	 * @brief Read the children of node, node itself is not updated
+	 */
+	bool readChildNodes(ReadBuffer& buffer,
+	                    ufo::geometry::BoundingVolume const& bounding_volume,
+	                    INNER_NODE& node, Point3 const& center, unsigned int current_depth)
 	{
 		DepthType const child_depth = current_depth - 1;
 		double const child_half_size = Base::getNodeHalfSize(child_depth);
 
 		// 1 bit for each child; 0: leaf child, 1: child has children
 		uint8_t children;
-		s.read(reinterpret_cast<char*>(&children), sizeof(children));
+		if (!buffer.read(children)) {
+			return false;
+		}
 
 		std::array<Point3, 8> child_centers;
 		std::bitset<8> child_intersects;
@@ -1422,42 +3879,238 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 
 		Base::createChildren(node, current_depth);
 
-		for (size_t i = 0; i < 8; ++i) {
+		bool success = true;
+		for (size_t i = 0; success && i < 8; ++i) {
 			if (child_intersects[i]) {
 				INNER_NODE& child = Base::getInnerChild(node, i);
 				if ((children >> i) & 1U) {
 					if (1 == child_depth) {
-						double const grandchild_half_size = Base::getNodeHalfSize(0);
 						Base::createChildren(child, child_depth);
-						for (size_t j = 0; j < 8; ++j) {
-							if (bounding_volume.empty() ||
-							    bounding_volume.intersects(ufo::geometry::AABB(
-							        Base::getChildCenter(child_centers[i], grandchild_half_size, j),
-							        grandchild_half_size))) {
-								Base::getLeafChild(child, j).readData(s);
-							}
-						}
+						success = readLeafChildren(buffer, bounding_volume, child, child_centers[i]);
 						updateNode(child, child_depth);
 					} else {
-						readNodesRecurs(s, bounding_volume, child, child_centers[i], child_depth);
+						success =
+						    readNodesRecurs(buffer, bounding_volume, child, child_centers[i], child_depth);
 					}
 				} else {
+					char const* data = buffer.next(LEAF_NODE::dataSize());
+					if (nullptr == data) {
+						success = false;
+						break;
+					}
 					Base::deleteChildren(child, child_depth);
-					child.readData(s);
+					child.readData(data);
 					updateNode(child, child_depth);
 				}
 			}
 		}
 
-		updateNode(node, current_depth);  // To set indicators
+		return success;
+	}
+
+	virtual bool readIndexedNodes(
+	    char const* data, std::size_t size, FileIndex const& index,
+	    std::vector<char> const& load,
+	    ufo::geometry::BoundingVolume const& bounding_volume) override
+	{
+		propagate();
+
+		DepthType const depth = Base::getTreeDepthLevels();
+		if (2 > index.depth || depth <= index.depth) {
+			return false;
+		}
+
+		Point3 const center(0, 0, 0);
+		double half_size = Base::getNodeHalfSize(depth);
+		if (!bounding_volume.empty() &&
+		    !bounding_volume.intersects(ufo::geometry::AABB(center, half_size))) {
+			return true;  // No node intersects
+		}
+
+		ReadBuffer buffer(data, size);
+		if (0 == size || 0 == static_cast<std::uint8_t>(data[0])) {
+			// Only the root
+			bool const success =
+			    readSubtree(buffer, bounding_volume, Base::getRoot(), center, depth);
+			rebuildDistanceField();
+			return success;
+		}
+		buffer.next(1);
+
+		// The nodes above the index depth are read serially, the subtrees at the index
+		// depth are then read in parallel
+		IndexedRead read{data, index, load, bounding_volume};
+		if (!readIndexedRecurs(buffer, read, &Base::getRoot(), center, depth) ||
+		    read.next_subtree != index.subtrees.size()) {
+			return false;
+		}
+
+		std::atomic_size_t next = 0;
+		std::atomic_bool success = true;
+		auto worker = [&]() {
+			for (std::size_t i = next++; i < read.subtrees.size(); i = next++) {
+				IndexedSubtree const& subtree = read.subtrees[i];
+				ReadBuffer subtree_buffer(subtree.data, subtree.size);
+				if (!readChildNodes(subtree_buffer, ufo::geometry::BoundingVolume(),
+				                    *subtree.node, subtree.center, index.depth)) {
+					success = false;
+				}
+			}
+		};
+
+		std::size_t const num_threads =
+		    std::min<std::size_t>(Base::getCompressionThreads(), read.subtrees.size());
+		std::vector<std::future<void>> workers;
+		for (std::size_t i = 1; i < num_threads; ++i) {
+			workers.push_back(std::async(std::launch::async, worker));
+		}
+		worker();
+		for (auto& w : workers) {
+			w.get();
+		}
+
+		// Children are updated before their parents
+		for (auto [node, node_depth] : read.updates) {
+			updateNode(*node, node_depth);
+		}
+
+		rebuildDistanceField();
+
+		return success;
+	}
+
+	struct IndexedSubtree {
+		INNER_NODE* node;
+		Point3 center;
+		char const* data;
+		std::size_t size;
+	};
+
+	struct IndexedRead {
+		char const* data;
+		FileIndex const& index;
+		std::vector<char> const& load;
+		ufo::geometry::BoundingVolume const& bounding_volume;
+
+		std::size_t next_subtree = 0;
+		std::vector<IndexedSubtree> subtrees{};
+		std::vector<std::pair<INNER_NODE*, DepthType>> updates{};
+	};
+
+	/**
+	 * @brief Read the nodes above the index depth. Nodes outside the bounding volume are
+	 * parsed but not read, node is null for those.
+	 *
+	 * @details Nothing that may prune is done to the nodes that have subtrees below them
+	 * until the subtrees have been read, instead they are added to read.updates.
+	 */
+	bool readIndexedRecurs(ReadBuffer& buffer, IndexedRead& read, INNER_NODE* node,
+	                       Point3 const& center, DepthType current_depth)
+	{
+		DepthType const child_depth = current_depth - 1;
+		double const child_half_size = Base::getNodeHalfSize(child_depth);
+
+		// 1 bit for each child; 0: leaf child, 1: child has children
+		uint8_t children;
+		if (!buffer.read(children)) {
+			return false;
+		}
+
+		if (node) {
+			Base::createChildren(*node, current_depth);
+		}
+
+		for (size_t i = 0; i < 8; ++i) {
+			Point3 const child_center = Base::getChildCenter(center, child_half_size, i);
+			INNER_NODE* child = nullptr;
+			if (node && (read.bounding_volume.empty() ||
+			             read.bounding_volume.intersects(
+			                 ufo::geometry::AABB(child_center, child_half_size)))) {
+				child = &Base::getInnerChild(*node, i);
+			}
+
+			if (0 == ((children >> i) & 1U)) {
+				char const* data = buffer.next(LEAF_NODE::dataSize());
+				if (nullptr == data) {
+					return false;
+				}
+				if (child) {
+					Base::deleteChildren(*child, child_depth);
+					child->readData(data);
+					updateNode(*child, child_depth);
+				}
+			} else if (child_depth != read.index.depth) {
+				if (!readIndexedRecurs(buffer, read, child, child_center, child_depth)) {
+					return false;
+				}
+			} else {
+				// The subtrees are in the same order in the index as in the data
+				if (read.index.subtrees.size() <= read.next_subtree) {
+					return false;
+				}
+				std::size_t const j = read.next_subtree++;
+				FileIndex::Subtree const& subtree = read.index.subtrees[j];
+				char const* data = buffer.next(subtree.size);
+				if (nullptr == data || read.data + subtree.offset != data) {
+					return false;
+				}
+				if (child && read.load[j]) {
+					// Created here so the subtrees do not modify nodes they share
+					Base::createChildren(*child, child_depth);
+					read.subtrees.push_back({child, child_center, data, subtree.size});
+					read.updates.emplace_back(child, child_depth);
+				}
+			}
+		}
+
+		if (node) {
+			read.updates.emplace_back(node, current_depth);
+		}
+		return true;
+	}
+
+	bool readLeafChildren(ReadBuffer& buffer,
+	                      ufo::geometry::BoundingVolume const& bounding_volume,
+	                      INNER_NODE& node, Point3 const& center)
+	{
+		constexpr std::size_t size = LEAF_NODE::dataSize();
+		typename Base::LeafChildren& children = Base::getLeafChildren(node);
+
+		std::bitset<8> const intersects = leafChildrenIntersects(bounding_volume, center);
+		if (intersects.all()) {
+			// All eight children are stored after each other
+			char const* data = buffer.next(8 * size);
+			if (nullptr == data) {
+				return false;
+			}
+			if constexpr (BULK_LEAF_CHILDREN) {
+				std::memcpy(children.data(), data, 8 * size);
+			} else {
+				for (LEAF_NODE& child : children) {
+					data = child.readData(data);
+				}
+			}
+			return true;
+		}
 
+		for (size_t i = 0; i < 8; ++i) {
+			if (intersects[i]) {
+				char const* data = buffer.next(size);
+				if (nullptr == data) {
+					return false;
+				}
+				children[i].readData(data);
+			}
+		}
 		return true;
 	}
 
-	virtual bool writeNodes(std::ostream& s,
+	virtual bool writeNodes(WriteBuffer& buffer,
 	                        ufo::geometry::BoundingVolume const& bounding_volume,
-	                        DepthType min_depth) const override
+	                        DepthType min_depth, FileIndex* index) const override
 	{
+		ensurePropagated();
+
 		// Check if inside bounding_volume
 		Point3 const center(0, 0, 0);
 		double half_size = Base::getNodeHalfSize(Base::getTreeDepthLevels());
@@ -1466,24 +4119,42 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 			return true;  // No node intersects
 		}
 
-		uint8_t children = 0;
-		if (Base::hasChildren(Base::getRoot()) && Base::getTreeDepthLevels() > min_depth) {
-			children = UINT8_MAX;
-		}
-		s.write(reinterpret_cast<char*>(&children), sizeof(children));
+		return writeSubtree(buffer, bounding_volume, Base::getRoot(), center,
+		                    Base::getTreeDepthLevels(), min_depth, index);
+	}
+
+	/**
+	 * @brief Write the subtree with node, at depth at least one, as root
+	 *
+	 * @param index If not null, the subtrees at index->depth are added to it
+	 */
+	bool writeSubtree(WriteBuffer& buffer,
+	                  ufo::geometry::BoundingVolume const& bounding_volume,
+	                  INNER_NODE const& node, Point3 const& center, DepthType depth,
+	                  DepthType min_depth = 0, FileIndex* index = nullptr) const
+	{
+		uint8_t const children = Base::hasChildren(node) && depth > min_depth ? UINT8_MAX : 0;
+		buffer.write(children);
 
 		if (0 == children) {
-			Base::getRoot().writeData(s);
+			node.writeData(buffer.next(LEAF_NODE::dataSize()));
+			return true;
+		}
+
+		if (1 == depth) {
+			writeLeafChildren(buffer, bounding_volume, node, center);
 			return true;
 		}
-		return writeNodesRecurs(s, bounding_volume, Base::getRoot(), center,
-		                        Base::getTreeDepthLevels(), min_depth);
+
+		return writeNodesRecurs(buffer, bounding_volume, node, center, depth, min_depth,
+		                        index && depth > index->depth ? index : nullptr);
 	}
 
-	bool writeNodesRecurs(std::ostream& s,
+	bool writeNodesRecurs(WriteBuffer& buffer,
 	                      ufo::geometry::BoundingVolume const& bounding_volume,
 	                      INNER_NODE const& node, Point3 const& center,
-	                      DepthType current_depth, DepthType min_depth = 0) const
+	                      DepthType current_depth, DepthType min_depth = 0,
+	                      FileIndex* index = nullptr) const
 	{
 		DepthType const child_depth = current_depth - 1;
 		double const child_half_size = Base::getNodeHalfSize(child_depth);
@@ -1503,37 +4174,297 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 			                                   child_centers[i], child_half_size));
 		}
 
-		s.write(reinterpret_cast<char*>(&children), sizeof(children));
+		buffer.write(children);
 
 		for (size_t i = 0; i < 8; ++i) {
 			if (child_intersects[i]) {
 				INNER_NODE const& child = Base::getInnerChild(node, i);
 				if ((children >> i) & 1U) {
 					if (1 == child_depth) {
-						double const grandchild_half_size = Base::getNodeHalfSize(0);
-						for (size_t j = 0; j < 8; ++j) {
-							if (bounding_volume.empty() ||
-							    bounding_volume.intersects(ufo::geometry::AABB(
-							        Base::getChildCenter(child_centers[i], grandchild_half_size, j),
-							        grandchild_half_size))) {
-								Base::getLeafChild(child, j).writeData(s);
-							}
-						}
+						writeLeafChildren(buffer, bounding_volume, child, child_centers[i]);
+					} else if (index && child_depth == index->depth) {
+						std::uint64_t const offset = buffer.size();
+						writeNodesRecurs(buffer, bounding_volume, child, child_centers[i],
+						                 child_depth, min_depth);
+						index->subtrees.push_back(
+						    {Base::toCode(child_centers[i], child_depth).getCode(), offset,
+						     buffer.size() - offset});
 					} else {
-						writeNodesRecurs(s, bounding_volume, child, child_centers[i], child_depth,
-						                 min_depth);
+						writeNodesRecurs(buffer, bounding_volume, child, child_centers[i],
+						                 child_depth, min_depth, index);
 					}
 				} else {
-					child.writeData(s);
+					child.writeData(buffer.next(LEAF_NODE::dataSize()));
+				}
+			}
+		}
+
+		return true;
+	}
+
+	void writeLeafChildren(WriteBuffer& buffer,
+	                       ufo::geometry::BoundingVolume const& bounding_volume,
+	                       INNER_NODE const& node, Point3 const& center) const
+	{
+		constexpr std::size_t size = LEAF_NODE::dataSize();
+		typename Base::LeafChildren const& children = Base::getLeafChildren(node);
+
+		std::bitset<8> const intersects = leafChildrenIntersects(bounding_volume, center);
+		if (intersects.all()) {
+			char* data = buffer.next(8 * size);
+			if constexpr (BULK_LEAF_CHILDREN) {
+				std::memcpy(data, children.data(), 8 * size);
+			} else {
+				for (LEAF_NODE const& child : children) {
+					data = child.writeData(data);
 				}
 			}
+			return;
+		}
+
+		for (size_t i = 0; i < 8; ++i) {
+			if (intersects[i]) {
+				children[i].writeData(buffer.next(size));
+			}
+		}
+	}
+
+	std::bitset<8> leafChildrenIntersects(
+	    ufo::geometry::BoundingVolume const& bounding_volume, Point3 const& center) const
+	{
+		std::bitset<8> intersects;
+		if (bounding_volume.empty()) {
+			return intersects.set();
+		}
+		double const half_size = Base::getNodeHalfSize(0);
+		for (size_t i = 0; i < 8; ++i) {
+			intersects[i] = bounding_volume.intersects(
+			    ufo::geometry::AABB(Base::getChildCenter(center, half_size, i), half_size));
+		}
+		return intersects;
+	}
+
+	//
+	// Delta
+	//
+
+	// The delta starts with the magic bytes, the epochs it goes from and to, the resolution
+	// and the depth levels. Then comes a byte that is 0 if nothing changed, 1 if the
+	// whole tree changed and 2 otherwise, followed by the changed tree, see
+	// writeDeltaRecurs.
+	static constexpr char DELTA_MAGIC[4] = {'U', 'F', 'O', 'D'};
+
+	bool writeDelta(WriteBuffer& buffer, std::uint64_t since_epoch)
+	{
+		if (!change_detection_enabled_ || since_epoch < delta_oldest_epoch_ ||
+		    since_epoch > delta_epoch_) {
+			return false;
+		}
+
+		ensurePropagated();
+
+		// Move the detected changes to the history, a change of a leaf node is stored as a
+		// change of its parent so that siblings are sent together
+		if (!changes_.empty()) {
+			++delta_epoch_;
+			for (Code const& code : changes_) {
+				delta_history_[code.toDepth(std::max(DepthType(1), code.getDepth()))] =
+				    delta_epoch_;
+			}
+			changes_.clear();
+		}
+
+		// The subtrees that changed, where a pruned node replaces its removed children
+		std::vector<Code> subtrees;
+		for (auto const& [code, changed] : delta_history_) {
+			if (changed > since_epoch) {
+				subtrees.push_back(
+				    code.toDepth(std::max(code.getDepth(), Base::getNode(code).second)));
+			}
+		}
+
+		// Depth-first order, where a subtree comes right before the subtrees it contains,
+		// which are written as part of it
+		std::sort(std::begin(subtrees), std::end(subtrees));
+		auto contains = [](Code const& subtree, Code const& code) {
+			return subtree.getDepth() >= code.getDepth() &&
+			       subtree.toDepth(subtree.getDepth()) == code.toDepth(subtree.getDepth());
+		};
+		std::size_t num_subtrees = 0;
+		for (Code const& code : subtrees) {
+			if (0 == num_subtrees || !contains(subtrees[num_subtrees - 1], code)) {
+				subtrees[num_subtrees++] = code;
+			}
+		}
+		subtrees.resize(num_subtrees);
+
+		std::memcpy(buffer.next(sizeof(DELTA_MAGIC)), DELTA_MAGIC, sizeof(DELTA_MAGIC));
+		buffer.write(since_epoch);
+		buffer.write(delta_epoch_);
+		buffer.write(Base::getResolution());
+		buffer.write(static_cast<std::uint8_t>(Base::getTreeDepthLevels()));
+
+		Point3 const center(0, 0, 0);
+		DepthType const depth = Base::getTreeDepthLevels();
+		if (subtrees.empty()) {
+			buffer.write(std::uint8_t(0));
+		} else if (depth == subtrees.front().getDepth()) {
+			buffer.write(std::uint8_t(1));
+			writeSubtree(buffer, ufo::geometry::BoundingVolume(), Base::getRoot(), center,
+			             depth);
+		} else {
+			buffer.write(std::uint8_t(2));
+			writeDeltaRecurs(buffer, Base::getRoot(), center, depth, std::cbegin(subtrees),
+			                 std::cend(subtrees));
 		}
 
 		return true;
 	}
 
+	/**
+	 * @brief Write the changed subtrees [first, last) inside node
+	 *
+	 * @details Each node on the way down to the changed subtrees is a byte with a bit
+	 * set for each child that is a changed subtree and a byte with a bit set for each
+	 * child that contains changed subtrees, followed by the children in order. A changed
+	 * subtree is written as by writeNodes.
+	 */
+	template <typename InputIt>
+	void writeDeltaRecurs(WriteBuffer& buffer, INNER_NODE const& node, Point3 const& center,
+	                      DepthType depth, InputIt first, InputIt last) const
+	{
+		DepthType const child_depth = depth - 1;
+		double const child_half_size = Base::getNodeHalfSize(child_depth);
+
+		// The subtrees inside child i are [bounds[i], bounds[i + 1])
+		std::array<InputIt, 9> bounds;
+		for (std::size_t i = 0; i < 8; ++i) {
+			bounds[i] = first;
+			while (first != last && first->getChildIdx(child_depth) == i) {
+				++first;
+			}
+		}
+		bounds[8] = last;
+
+		uint8_t changed = 0;
+		uint8_t contains = 0;
+		for (std::size_t i = 0; i < 8; ++i) {
+			if (bounds[i] != bounds[i + 1]) {
+				if (child_depth == bounds[i]->getDepth()) {
+					changed |= 1U << i;
+				} else {
+					contains |= 1U << i;
+				}
+			}
+		}
+		buffer.write(changed);
+		buffer.write(contains);
+
+		for (std::size_t i = 0; i < 8; ++i) {
+			Point3 const child_center = Base::getChildCenter(center, child_half_size, i);
+			if ((changed >> i) & 1U) {
+				writeSubtree(buffer, ufo::geometry::BoundingVolume(),
+				             Base::getInnerChild(node, i), child_center, child_depth);
+			} else if ((contains >> i) & 1U) {
+				writeDeltaRecurs(buffer, Base::getInnerChild(node, i), child_center,
+				                 child_depth, bounds[i], bounds[i + 1]);
+			}
+		}
+	}
+
+	bool applyDelta(ReadBuffer& buffer)
+	{
+		char const* magic = buffer.next(sizeof(DELTA_MAGIC));
+		if (nullptr == magic || 0 != std::memcmp(magic, DELTA_MAGIC, sizeof(DELTA_MAGIC))) {
+			return false;
+		}
+
+		std::uint64_t from_epoch;
+		std::uint64_t to_epoch;
+		double resolution;
+		std::uint8_t depth_levels;
+		std::uint8_t type;
+		if (!buffer.read(from_epoch) || !buffer.read(to_epoch) || !buffer.read(resolution) ||
+		    !buffer.read(depth_levels) || !buffer.read(type)) {
+			return false;
+		}
+
+		if (Base::getResolution() != resolution ||
+		    Base::getTreeDepthLevels() != depth_levels || from_epoch > delta_epoch_) {
+			// Missed changes
+			return false;
+		}
+
+		propagate();
+
+		Point3 const center(0, 0, 0);
+		DepthType const depth = Base::getTreeDepthLevels();
+		bool success = true;
+		if (1 == type) {
+			success = readSubtree(buffer, ufo::geometry::BoundingVolume(), Base::getRoot(),
+			                      center, depth);
+		} else if (2 == type) {
+			success = applyDeltaRecurs(buffer, Base::getRoot(), center, depth);
+		} else if (0 != type) {
+			success = false;
+		}
+
+		if (success) {
+			delta_epoch_ = std::max(delta_epoch_, to_epoch);
+		}
+		rebuildDistanceField();
+		return success;
+	}
+
+	bool applyDeltaRecurs(ReadBuffer& buffer, INNER_NODE& node, Point3 const& center,
+	                      DepthType depth)
+	{
+		uint8_t changed;
+		uint8_t contains;
+		if (1 >= depth || !buffer.read(changed) || !buffer.read(contains) ||
+		    0 != (changed & contains)) {
+			return false;
+		}
+
+		DepthType const child_depth = depth - 1;
+		double const child_half_size = Base::getNodeHalfSize(child_depth);
+
+		Base::createChildren(node, depth);
+
+		bool success = true;
+		for (std::size_t i = 0; success && i < 8; ++i) {
+			Point3 const child_center = Base::getChildCenter(center, child_half_size, i);
+			if ((changed >> i) & 1U) {
+				success = readSubtree(buffer, ufo::geometry::BoundingVolume(),
+				                      Base::getInnerChild(node, i), child_center, child_depth);
+			} else if ((contains >> i) & 1U) {
+				success = applyDeltaRecurs(buffer, Base::getInnerChild(node, i), child_center,
+				                           child_depth);
+			}
+		}
+
+		updateNode(node, depth);
+
+		return success;
+	}
+
  protected:
-	// Sensor model
+	// Sensor model as given, in probabilities
+	struct SensorModel {
+		double occupied_thres;
+		double free_thres;
+		double prob_hit;
+		double prob_miss;
+		double clamping_thres_min;
+		double clamping_thres_max;
+	};
+	SensorModel sensor_model_;
+	// How far quantizeSensorModel moves the values from the rounded ones, in node units
+	inline static const int QUANTIZATION_SEARCH = 2;
+	// The length of the hit/miss sequences quantizeSensorModel compares
+	inline static const std::size_t QUANTIZATION_SEQUENCE_LENGTH = 16;
+
+	// Sensor model, log-odds in the units stored in the nodes (see quantizeSensorModel)
 	double occupied_thres_log_;      // Threshold for occupied
 	double free_thres_log_;          // Threshold for free
 	double prob_hit_log_;            // Logodds probability of hit
@@ -1548,10 +4479,49 @@ class OccupancyMapBase : public Octree<DATA_TYPE, OccupancyMapInnerNode<DATA_TYP
 	Point3 min_change_;
 	Point3 max_change_;
 
+	// Delta, the epoch each subtree last changed in
+	CodeMap<std::uint64_t> delta_history_ = CodeMap<std::uint64_t>(10);
+	std::uint64_t delta_epoch_ = 0;
+	std::uint64_t delta_oldest_epoch_ = 0;
+
 	// Defined here for speedup
 	CodeSet indices_;
 	std::future<void> integrate_;
 
+	// Parallel integration
+	unsigned int integration_threads_ = std::max(1U, std::thread::hardware_concurrency());
+	bool deterministic_integration_ = true;
+	DepthType integration_split_depth_ = 6;
+	bool batch_integration_ = true;
+	bool packet_ray_casting_ = true;
+
+	// Lazy propagation, inner nodes that have to be updated before the map is read
+	bool lazy_propagation_ = false;
+	CodeSet dirty_ = CodeSet(10);
+
+	// Thread safe mode, see enableThreadSafety. A stripe guards the nodes below the
+	// subtrees at depth it is the stripe of, the root lock the nodes above. They are
+	// locked in that order, changes last.
+	struct Locks {
+		DepthType depth;
+		std::shared_mutex root;
+		std::array<std::shared_mutex, NUM_LOCK_STRIPES> stripes;
+		std::mutex changes;                // Guards the change detection
+		std::shared_mutex distance_field;  // Guards the distance field, locked last
+	};
+	std::unique_ptr<Locks> locks_;
+
+	// Distance field, see enableDistanceField
+	std::unique_ptr<DistanceField> distance_field_;
+
+	// Fewer rays than this per thread are not worth the overhead of a thread
+	inline static const std::size_t MIN_RAYS_PER_INTEGRATION_THREAD = 512;
+	inline static const std::size_t MIN_UPDATES_PER_INTEGRATION_THREAD = 1024;
+	// Fewer queries than this per thread are not worth the overhead of a thread
+	inline static const std::size_t MIN_QUERIES_PER_THREAD = 64;
+	// Rays a worker casts in a row in castRays, each starting from where the previous did
+	inline static const std::size_t RAYS_PER_CAST_CHUNK = 256;
+
 	template <typename T, typename D, typename I, typename L, bool O>
 	friend class OccupancyMapIterator;
 	template <typename T, typename D, typename I, typename L, bool O>
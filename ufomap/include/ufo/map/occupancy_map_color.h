@@ -46,11 +46,12 @@
 
 namespace ufo::map
 {
-class OccupancyMapColor : public OccupancyMapBase<ColorOccupancyNode<float>>
+class OccupancyMapColor
+    : public OccupancyMapBase<ColorOccupancyNode<float>, OccupancyMapCompactInnerNode<ColorOccupancyNode<float>>>
 {
  private:
 	using DATA_TYPE = ColorOccupancyNode<float>;
-	using Base = OccupancyMapBase<DATA_TYPE>;
+	using Base = OccupancyMapBase<DATA_TYPE, OccupancyMapCompactInnerNode<DATA_TYPE>>;
 
  public:
 	//
@@ -86,6 +87,15 @@ class OccupancyMapColor : public OccupancyMapBase<ColorOccupancyNode<float>>
 		return "occupancy_map_color";
 	}
 
+	//
+	// Snapshot
+	//
+
+	/**
+	 * @brief See OccupancyMap::snapshot
+	 */
+	std::shared_ptr<OccupancyMapColor const> snapshot();
+
 	//
 	// Integration
 	//
@@ -110,7 +120,8 @@ class OccupancyMapColor : public OccupancyMapBase<ColorOccupancyNode<float>>
 			discretized.reserve(cloud.size());
 			Point3 min_change = Base::getMax();
 			Point3 max_change = Base::getMin();
-			for (Point3Color& end_color : cloud) {
+			CodeSet& indices = Base::insertionIndices();
+			for (Point3Color const& end_color : cloud) {
 				Point3 end = end_color;
 				Point3 origin = sensor_origin;
 				Point3 direction = (end - origin);
@@ -125,7 +136,7 @@ class OccupancyMapColor : public OccupancyMapBase<ColorOccupancyNode<float>>
 				if (0 > max_range || distance <= max_range) {
 					// Occupied space
 					Code end_code = Base::toCode(end);
-					if (indices_.insert(end_code).second) {
+					if (indices.insert(end_code).second) {
 						occupied_hits.push_back(
 						    std::make_tuple(end_code, prob_hit_log_, end_color.getColor()));
 					}
@@ -144,11 +155,11 @@ class OccupancyMapColor : public OccupancyMapBase<ColorOccupancyNode<float>>
 
 			LogitType prob_miss_log = prob_miss_log_ / double((2.0 * depth) + 1);
 
-			indices_.clear();
+			indices.clear();
 
 			Base::insertPointCloudWait();
 
-			if (async) {
+			if (async && !Base::isThreadSafetyEnabled()) {
 				integrate_ =
 				    std::async(std::launch::async, &OccupancyMapColor::insertPointCloudHelper,
 				               this, sensor_origin, std::move(discretized),
@@ -192,13 +203,14 @@ class OccupancyMapColor : public OccupancyMapBase<ColorOccupancyNode<float>>
 			discretized.reserve(cloud.size());
 			Point3 min_change = Base::getMax();
 			Point3 max_change = Base::getMin();
+			CodeSet& indices = Base::insertionIndices();
 			for (Point3Color const& end_color : cloud) {
 				Point3 end = end_color;
 				double dist_sqrt = (end - sensor_origin).squaredNorm();
 				if (0 > max_range || dist_sqrt < squared_max_range) {
 					if (Base::isInside(end)) {
 						Code end_code = Base::toCode(end);
-						if (!indices_.insert(end_code).second) {
+						if (!indices.insert(end_code).second) {
 							continue;
 						}
 						// double dist = std::sqrt(dist_sqrt);
@@ -224,7 +236,7 @@ class OccupancyMapColor : public OccupancyMapBase<ColorOccupancyNode<float>>
 
 				Key end_key = Base::toKey(end, depth);
 
-				if (0 < depth && !indices_.insert(Base::toCode(end_key)).second) {
+				if (0 < depth && !indices.insert(Base::toCode(end_key)).second) {
 					continue;
 				}
 
@@ -247,11 +259,11 @@ class OccupancyMapColor : public OccupancyMapBase<ColorOccupancyNode<float>>
 
 			LogitType prob_miss_log = prob_miss_log_ / double((2.0 * depth) + 1);
 
-			indices_.clear();
+			indices.clear();
 
 			Base::insertPointCloudWait();
 
-			if (async) {
+			if (async && !Base::isThreadSafetyEnabled()) {
 				integrate_ =
 				    std::async(std::launch::async, &OccupancyMapColor::insertPointCloudHelper,
 				               this, sensor_origin, std::move(discretized),
@@ -268,7 +280,27 @@ class OccupancyMapColor : public OccupancyMapBase<ColorOccupancyNode<float>>
 
 	void updateValue(Code const& code, LogitType const& update, Color color)
 	{
-		auto path = Base::createNode(code);
+		{
+			auto lock = Base::lockWrite(code);
+			DepthType const tree_depth = Base::getTreeDepthLevels();
+			Path path;
+			path[tree_depth] = static_cast<LEAF_NODE*>(&Base::getRoot());
+			Base::createNode(code, path, tree_depth);
+			Base::updateParents(code, path, applyUpdate(code, update, color, path, changes_));
+		}
+
+		Base::refreshDistanceField(std::array<Code, 1>{code}, false);
+	}
+
+	/**
+	 * @brief Update the value and color of the node at path[code.getDepth()], see
+	 * OccupancyMapBase::applyUpdate
+	 *
+	 * @return The depth from which the parents have to be updated
+	 */
+	DepthType applyUpdate(Code const& code, LogitType const& update, Color color,
+	                      Path const& path, CodeSet& changes)
+	{
 		DepthType depth = code.getDepth();
 
 		if (Base::isLeaf(path[depth], depth)) {
@@ -276,14 +308,14 @@ class OccupancyMapColor : public OccupancyMapBase<ColorOccupancyNode<float>>
 
 			if (updateOccupancy(path[depth]->value.occupancy, update)) {
 				if (change_detection_enabled_) {
-					changes_.insert(code);
+					changes.insert(code);
 				}
 			}
 		} else {
 			// TODO: Error
 		}
 
-		Base::updateParents(path, depth);
+		return depth;
 	}
 
 	template <typename T>
@@ -330,6 +362,12 @@ class OccupancyMapColor : public OccupancyMapBase<ColorOccupancyNode<float>>
 	}
 
  protected:
+	//
+	// Snapshot
+	//
+
+	OccupancyMapColor(OccupancyMapColor& other, SnapshotTag tag);
+
 	//
 	// Integrate colors
 	//
@@ -348,9 +386,11 @@ class OccupancyMapColor : public OccupancyMapBase<ColorOccupancyNode<float>>
 	                            Point3 min_change, Point3 max_change)
 	{
 		std::future<void> f = std::async(std::launch::async, [this, &occupied_hits]() {
-			std::for_each(begin(occupied_hits), end(occupied_hits), [this](auto&& hit) {
-				updateValue(std::get<0>(hit), std::get<1>(hit), std::get<2>(hit));
-			});
+			updateValues(occupied_hits,
+			             [this](auto const& hit, Path const& path, CodeSet& changes) {
+				             return applyUpdate(std::get<0>(hit), std::get<1>(hit),
+				                                std::get<2>(hit), path, changes);
+			             });
 		});
 
 		CodeMap<LogitType> free_hits;
@@ -360,16 +400,16 @@ class OccupancyMapColor : public OccupancyMapBase<ColorOccupancyNode<float>>
 
 		f.wait();
 
-		for (auto const& [code, value] : free_hits) {
-			Base::updateValue(code, value);
-		}
+		updateValues(free_hits, [this](auto const& hit, Path const& path, CodeSet& changes) {
+			return Base::applyUpdate(hit.first, hit.second, path, changes);
+		});
 
-		if (min_max_change_detection_enabled_) {
-			for (int i : {0, 1, 2}) {
-				min_change_[i] = std::min(min_change_[i], min_change[i]);
-				max_change_[i] = std::max(max_change_[i], max_change[i]);
-			}
-		}
+		Base::addMinMaxChange(min_change, max_change);
+
+		Base::propagate();
+
+		Base::refreshDistanceField(occupied_hits, false);
+		Base::refreshDistanceField(free_hits, true);
 	}
 
 	//
@@ -0,0 +1,818 @@
+/**
+ * UFOMap: An Efficient Probabilistic 3D Mapping Framework That Embraces the Unknown
+ *
+ * @author D. Duberg, KTH Royal Institute of Technology, Copyright (c) 2020.
+ * @see https://github.com/UnknownFreeOccupied/ufomap
+ * License: BSD 3
+ *
+ */
+
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, D. Duberg, KTH Royal Institute of Technology
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef UFO_MAP_OCCUPANCY_MAP_MAPPED_H
+#define UFO_MAP_OCCUPANCY_MAP_MAPPED_H
+
+// UFO
+#include <ufo/geometry/bounding_volume.h>
+#include <ufo/map/code.h>
+#include <ufo/map/iterator/occupancy_map.h>
+#include <ufo/map/iterator/occupancy_map_nearest.h>
+#include <ufo/map/key.h>
+#include <ufo/map/occupancy_map_base.h>
+#include <ufo/map/occupancy_map_node.h>
+#include <ufo/map/traverse.h>
+#include <ufo/map/types.h>
+
+// STD
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ufo::map
+{
+/**
+ * @brief A node in the memory-mapped file format. The eight children of a node are
+ * stored next to each other, so a node only has to know where the first one is.
+ */
+struct MappedOccupancyNode {
+	// Occupancy in log-odds
+	OccupancyNode<float> value;
+	// Bit 0: this node or any of its children contains free space
+	// Bit 1: this node or any of its children contains unknown space
+	std::uint32_t contains;
+	// Index of the first child, 0 if the node has no children (0 is always the root)
+	std::uint64_t children;
+};
+
+static_assert(sizeof(MappedOccupancyNode) == 16, "The file layout depends on this size");
+
+/**
+ * @brief Read-only occupancy map that is queried directly from a memory-mapped file.
+ *
+ * @details The file is a linearized, pointer-free octree: a fixed size header followed
+ * by all nodes, root first, where each node refers to its children by index. Opening a
+ * file only maps it into memory, nodes are paged in on first access and the pages are
+ * shared between all processes mapping the same file. Values are stored in the byte
+ * order of the machine that wrote the file.
+ *
+ * A file is created from any occupancy map with write() or from a .um file with
+ * convert(). The occupied and free thresholds are fixed when the file is written.
+ */
+class OccupancyMapMapped
+{
+ private:
+	static constexpr DepthType MAX_DEPTH_LEVELS = 21;
+	static constexpr std::uint32_t CONTAINS_FREE = 1U;
+	static constexpr std::uint32_t CONTAINS_UNKNOWN = 2U;
+	static constexpr char FILE_MAGIC[16] = "# UFOMap mapped";
+	static constexpr std::uint32_t FILE_VERSION = 1;
+
+	using DATA_TYPE = OccupancyNode<float>;
+	using INNER_NODE = MappedOccupancyNode;
+	using LEAF_NODE = MappedOccupancyNode;
+
+	using OccupancyMapMappedTreeIterator =
+	    OccupancyMapIterator<OccupancyMapMapped, DATA_TYPE, INNER_NODE, LEAF_NODE, false>;
+	using OccupancyMapMappedLeafIterator =
+	    OccupancyMapIterator<OccupancyMapMapped, DATA_TYPE, INNER_NODE, LEAF_NODE, true>;
+	using OccupancyMapMappedTreeNNIterator =
+	    OccupancyMapNearestIterator<OccupancyMapMapped, DATA_TYPE, INNER_NODE, LEAF_NODE,
+	                                false>;
+	using OccupancyMapMappedLeafNNIterator =
+	    OccupancyMapNearestIterator<OccupancyMapMapped, DATA_TYPE, INNER_NODE, LEAF_NODE,
+	                                true>;
+
+	/**
+	 * @brief The fixed size header at the start of the file
+	 */
+	struct Header {
+		char magic[16];
+		std::uint32_t version;
+		std::uint32_t depth_levels;
+		double resolution;
+		// Thresholds in log-odds
+		double occupied_thres;
+		double free_thres;
+		std::uint64_t num_nodes;
+		// Offset in bytes from the start of the file to the root node
+		std::uint64_t nodes_offset;
+	};
+
+	static_assert(sizeof(Header) == 64, "The file layout depends on this size");
+
+ public:
+	//
+	// Constructors
+	//
+
+	OccupancyMapMapped() {}
+
+	/**
+	 * @brief Map the file filename
+	 *
+	 * @throws std::runtime_error If the file could not be mapped or is not a valid file
+	 */
+	explicit OccupancyMapMapped(std::string const& filename);
+
+	OccupancyMapMapped(OccupancyMapMapped const& other) = delete;
+
+	OccupancyMapMapped(OccupancyMapMapped&& other) noexcept { swap(other); }
+
+	OccupancyMapMapped& operator=(OccupancyMapMapped const& rhs) = delete;
+
+	OccupancyMapMapped& operator=(OccupancyMapMapped&& rhs) noexcept
+	{
+		close();
+		swap(rhs);
+		return *this;
+	}
+
+	//
+	// Destructor
+	//
+
+	~OccupancyMapMapped() { close(); }
+
+	//
+	// Tree type
+	//
+
+	std::string getTreeType() const noexcept { return "occupancy_map_mapped"; }
+
+	//
+	// Open/close
+	//
+
+	/**
+	 * @brief Map the file filename, replacing the currently mapped file
+	 *
+	 * @return true If the file was mapped
+	 */
+	bool open(std::string const& filename);
+
+	void close() noexcept;
+
+	bool isOpen() const noexcept { return nullptr != nodes_; }
+
+	/**
+	 * @return true If filename is a memory-mappable map file
+	 */
+	static bool isMappedFile(std::string const& filename);
+
+	//
+	// Conversion
+	//
+
+	/**
+	 * @brief Write map in the memory-mappable format to filename
+	 *
+	 * @details Nodes are written as the map is traversed depth first, so only the
+	 * children of the nodes on the current path are kept in memory.
+	 *
+	 * @param map Any occupancy map
+	 * @return true If the file was written
+	 */
+	template <typename MAP>
+	static bool write(MAP const& map, std::string const& filename);
+
+	/**
+	 * @brief Convert the .um file filename to the memory-mappable format
+	 *
+	 * @details The .um format does not store the thresholds, so they are given here.
+	 * Colors are not part of the memory-mappable format and are dropped.
+	 *
+	 * @return true If the file was converted
+	 */
+	static bool convert(std::string const& filename, std::string const& mapped_filename,
+	                    double occupied_thres = 0.5, double free_thres = 0.5);
+
+	//
+	// General information
+	//
+
+	static constexpr DepthType getMaxDepthLevels() noexcept { return MAX_DEPTH_LEVELS; }
+
+	double getResolution() const noexcept { return resolution_; }
+
+	DepthType getTreeDepthLevels() const noexcept { return depth_levels_; }
+
+	double getNodeSize(DepthType depth) const { return getNodeHalfSize(depth + 1); }
+
+	double getNodeHalfSize(DepthType depth) const { return nodes_half_sizes_[depth]; }
+
+	Point3 getMin() const noexcept
+	{
+		double half_size = -getNodeHalfSize(getTreeDepthLevels());
+		return Point3(half_size, half_size, half_size);
+	}
+
+	Point3 getMax() const noexcept
+	{
+		double half_size = getNodeHalfSize(getTreeDepthLevels());
+		return Point3(half_size, half_size, half_size);
+	}
+
+	Code getRootCode() const noexcept { return Code(0, getTreeDepthLevels()); }
+
+	std::size_t size() const noexcept { return num_nodes_; }
+
+	double getOccupiedThres() const { return toProb(occupied_thres_); }
+
+	double getFreeThres() const { return toProb(free_thres_); }
+
+	//
+	// Conversion between coordinates, keys and codes
+	//
+
+	Code toCode(Key const& key) const noexcept { return Code(key); }
+
+	Code toCode(Point3 const& coord, DepthType depth = 0) const noexcept
+	{
+		return toCode(toKey(coord, depth));
+	}
+
+	Code toCode(double x, double y, double z, DepthType depth = 0) const noexcept
+	{
+		return toCode(toKey(x, y, z, depth));
+	}
+
+	KeyType toKey(double coord, DepthType depth = 0) const noexcept
+	{
+		int key_value = (int)std::floor(resolution_factor_ * coord);
+		if (0 == depth) {
+			return key_value + max_value_;
+		}
+		return ((key_value >> depth) << depth) + (1 << (depth - 1)) + max_value_;
+	}
+
+	Key toKey(Point3 const& coord, DepthType depth = 0) const noexcept
+	{
+		return Key(toKey(coord[0], depth), toKey(coord[1], depth), toKey(coord[2], depth),
+		           depth);
+	}
+
+	Key toKey(double x, double y, double z, DepthType depth = 0) const noexcept
+	{
+		return Key(toKey(x, depth), toKey(y, depth), toKey(z, depth), depth);
+	}
+
+	//
+	// "Normal" iterators
+	//
+
+	OccupancyMapMappedTreeIterator beginTree(bool occupied_space = true,
+	                                         bool free_space = true,
+	                                         bool unknown_space = false,
+	                                         bool contains = false,
+	                                         DepthType min_depth = 0) const noexcept
+	{
+		return OccupancyMapMappedTreeIterator(this, getRoot(),
+		                                      ufo::geometry::BoundingVolume(), occupied_space,
+		                                      free_space, unknown_space, contains, min_depth);
+	}
+
+	OccupancyMapMappedTreeIterator endTree() const noexcept
+	{
+		return OccupancyMapMappedTreeIterator();
+	}
+
+	OccupancyMapMappedTreeIterator beginTree(
+	    ufo::geometry::BoundingVar const& bounding_volume, bool occupied_space = true,
+	    bool free_space = true, bool unknown_space = false, bool contains = false,
+	    DepthType min_depth = 0) const noexcept
+	{
+		ufo::geometry::BoundingVolume bv;
+		bv.add(bounding_volume);
+		return OccupancyMapMappedTreeIterator(this, getRoot(), bv, occupied_space,
+		                                      free_space, unknown_space, contains, min_depth);
+	}
+
+	OccupancyMapMappedTreeIterator beginTree(
+	    ufo::geometry::BoundingVolume const& bounding_volume, bool occupied_space = true,
+	    bool free_space = true, bool unknown_space = false, bool contains = false,
+	    DepthType min_depth = 0) const noexcept
+	{
+		return OccupancyMapMappedTreeIterator(this, getRoot(), bounding_volume,
+		                                      occupied_space, free_space, unknown_space,
+		                                      contains, min_depth);
+	}
+
+	OccupancyMapMappedLeafIterator beginLeaves(bool occupied_space = true,
+	                                           bool free_space = true,
+	                                           bool unknown_space = false,
+	                                           bool contains = false,
+	                                           DepthType min_depth = 0) const noexcept
+	{
+		return OccupancyMapMappedLeafIterator(this, getRoot(),
+		                                      ufo::geometry::BoundingVolume(), occupied_space,
+		                                      free_space, unknown_space, contains, min_depth);
+	}
+
+	OccupancyMapMappedLeafIterator endLeaves() const noexcept
+	{
+		return OccupancyMapMappedLeafIterator();
+	}
+
+	OccupancyMapMappedLeafIterator beginLeaves(
+	    ufo::geometry::BoundingVar const& bounding_volume, bool occupied_space = true,
+	    bool free_space = true, bool unknown_space = false, bool contains = false,
+	    DepthType min_depth = 0) const noexcept
+	{
+		ufo::geometry::BoundingVolume bv;
+		bv.add(bounding_volume);
+		return OccupancyMapMappedLeafIterator(this, getRoot(), bv, occupied_space,
+		                                      free_space, unknown_space, contains, min_depth);
+	}
+
+	OccupancyMapMappedLeafIterator beginLeaves(
+	    ufo::geometry::BoundingVolume const& bounding_volume, bool occupied_space = true,
+	    bool free_space = true, bool unknown_space = false, bool contains = false,
+	    DepthType min_depth = 0) const noexcept
+	{
+		return OccupancyMapMappedLeafIterator(this, getRoot(), bounding_volume,
+		                                      occupied_space, free_space, unknown_space,
+		                                      contains, min_depth);
+	}
+
+	//
+	// Nearest neighbor iterators
+	//
+
+	OccupancyMapMappedTreeNNIterator beginNNTree(Point3 const& coordinate,
+	                                             bool occupied_space = true,
+	                                             bool free_space = true,
+	                                             bool unknown_space = false,
+	                                             bool contains = false,
+	                                             DepthType min_depth = 0) const noexcept
+	{
+		return OccupancyMapMappedTreeNNIterator(
+		    this, getRoot(), ufo::geometry::BoundingVolume(), coordinate, occupied_space,
+		    free_space, unknown_space, contains, min_depth);
+	}
+
+	OccupancyMapMappedTreeNNIterator endNNTree() const noexcept
+	{
+		return OccupancyMapMappedTreeNNIterator();
+	}
+
+	OccupancyMapMappedTreeNNIterator beginNNTree(
+	    Point3 const& coordinate, ufo::geometry::BoundingVar const& bounding_volume,
+	    bool occupied_space = true, bool free_space = true, bool unknown_space = false,
+	    bool contains = false, DepthType min_depth = 0) const noexcept
+	{
+		ufo::geometry::BoundingVolume bv;
+		bv.add(bounding_volume);
+		return OccupancyMapMappedTreeNNIterator(this, getRoot(), bv, coordinate,
+		                                        occupied_space, free_space, unknown_space,
+		                                        contains, min_depth);
+	}
+
+	OccupancyMapMappedTreeNNIterator beginNNTree(
+	    Point3 const& coordinate, ufo::geometry::BoundingVolume const& bounding_volume,
+	    bool occupied_space = true, bool free_space = true, bool unknown_space = false,
+	    bool contains = false, DepthType min_depth = 0) const noexcept
+	{
+		return OccupancyMapMappedTreeNNIterator(this, getRoot(), bounding_volume,
+		                                        coordinate, occupied_space, free_space,
+		                                        unknown_space, contains, min_depth);
+	}
+
+	OccupancyMapMappedLeafNNIterator beginNNLeaves(Point3 const& coordinate,
+	                                               bool occupied_space = true,
+	                                               bool free_space = true,
+	                                               bool unknown_space = false,
+	                                               bool contains = false,
+	                                               DepthType min_depth = 0) const noexcept
+	{
+		return OccupancyMapMappedLeafNNIterator(
+		    this, getRoot(), ufo::geometry::BoundingVolume(), coordinate, occupied_space,
+		    free_space, unknown_space, contains, min_depth);
+	}
+
+	OccupancyMapMappedLeafNNIterator endNNLeaves() const noexcept
+	{
+		return OccupancyMapMappedLeafNNIterator();
+	}
+
+	OccupancyMapMappedLeafNNIterator beginNNLeaves(
+	    Point3 const& coordinate, ufo::geometry::BoundingVar const& bounding_volume,
+	    bool occupied_space = true, bool free_space = true, bool unknown_space = false,
+	    bool contains = false, DepthType min_depth = 0) const noexcept
+	{
+		ufo::geometry::BoundingVolume bv;
+		bv.add(bounding_volume);
+		return OccupancyMapMappedLeafNNIterator(this, getRoot(), bv, coordinate,
+		                                        occupied_space, free_space, unknown_space,
+		                                        contains, min_depth);
+	}
+
+	OccupancyMapMappedLeafNNIterator beginNNLeaves(
+	    Point3 const& coordinate, ufo::geometry::BoundingVolume const& bounding_volume,
+	    bool occupied_space = true, bool free_space = true, bool unknown_space = false,
+	    bool contains = false, DepthType min_depth = 0) const noexcept
+	{
+		return OccupancyMapMappedLeafNNIterator(this, getRoot(), bounding_volume,
+		                                        coordinate, occupied_space, free_space,
+		                                        unknown_space, contains, min_depth);
+	}
+
+	//
+	// Get occupancy
+	//
+
+	double getOccupancy(Code const& code) const
+	{
+		return getOccupancy(*getNode(code).first);
+	}
+
+	double getOccupancy(Point3 const& coord, DepthType depth = 0) const
+	{
+		return getOccupancy(toCode(coord, depth));
+	}
+
+	double getOccupancy(double x, double y, double z, DepthType depth = 0) const
+	{
+		return getOccupancy(toCode(x, y, z, depth));
+	}
+
+	//
+	// Checking state
+	//
+
+	OccupancyState getState(Code const& code) const
+	{
+		LEAF_NODE const& node = *getNode(code).first;
+		if (isOccupied(node)) {
+			return OccupancyState::occupied;
+		} else if (isFree(node)) {
+			return OccupancyState::free;
+		} else {
+			return OccupancyState::unknown;
+		}
+	}
+
+	OccupancyState getState(Point3 const& coord, DepthType depth = 0) const
+	{
+		return getState(toCode(coord, depth));
+	}
+
+	OccupancyState getState(double x, double y, double z, DepthType depth = 0) const
+	{
+		return getState(toCode(x, y, z, depth));
+	}
+
+	bool isOccupied(Code const& code) const
+	{
+		return OccupancyState::occupied == getState(code);
+	}
+
+	bool isOccupied(Point3 const& coord, DepthType depth = 0) const
+	{
+		return OccupancyState::occupied == getState(coord, depth);
+	}
+
+	bool isOccupied(double x, double y, double z, DepthType depth = 0) const
+	{
+		return OccupancyState::occupied == getState(x, y, z, depth);
+	}
+
+	bool isUnknown(Code const& code) const
+	{
+		return OccupancyState::unknown == getState(code);
+	}
+
+	bool isUnknown(Point3 const& coord, DepthType depth = 0) const
+	{
+		return OccupancyState::unknown == getState(coord, depth);
+	}
+
+	bool isUnknown(double x, double y, double z, DepthType depth = 0) const
+	{
+		return OccupancyState::unknown == getState(x, y, z, depth);
+	}
+
+	bool isFree(Code const& code) const { return OccupancyState::free == getState(code); }
+
+	bool isFree(Point3 const& coord, DepthType depth = 0) const
+	{
+		return OccupancyState::free == getState(coord, depth);
+	}
+
+	bool isFree(double x, double y, double z, DepthType depth = 0) const
+	{
+		return OccupancyState::free == getState(x, y, z, depth);
+	}
+
+	//
+	// Checking if contains
+	//
+
+	bool containsOccupied(Code const& code) const { return isOccupied(code); }
+
+	bool containsOccupied(Point3 const& coord, DepthType depth = 0) const
+	{
+		return containsOccupied(toCode(coord, depth));
+	}
+
+	bool containsOccupied(double x, double y, double z, DepthType depth = 0) const
+	{
+		return containsOccupied(toCode(x, y, z, depth));
+	}
+
+	bool containsUnknown(Code const& code) const
+	{
+		auto [node, depth] = getNode(code);
+		return containsUnknown(*node, depth);
+	}
+
+	bool containsUnknown(Point3 const& coord, DepthType depth = 0) const
+	{
+		return containsUnknown(toCode(coord, depth));
+	}
+
+	bool containsUnknown(double x, double y, double z, DepthType depth = 0) const
+	{
+		return containsUnknown(toCode(x, y, z, depth));
+	}
+
+	bool containsFree(Code const& code) const
+	{
+		auto [node, depth] = getNode(code);
+		return containsFree(*node, depth);
+	}
+
+	bool containsFree(Point3 const& coord, DepthType depth = 0) const
+	{
+		return containsFree(toCode(coord, depth));
+	}
+
+	bool containsFree(double x, double y, double z, DepthType depth = 0) const
+	{
+		return containsFree(toCode(x, y, z, depth));
+	}
+
+ protected:
+	//
+	// Swap
+	//
+
+	void swap(OccupancyMapMapped& other) noexcept;
+
+	//
+	// Probability <-> logit
+	//
+
+	static double toLogit(double prob) { return std::log(prob / (1.0 - prob)); }
+
+	static double toProb(double logit) { return 1.0 / (1.0 + std::exp(-logit)); }
+
+	//
+	// Get node
+	//
+
+	INNER_NODE const& getRoot() const { return nodes_[0]; }
+
+	std::pair<LEAF_NODE const*, DepthType> getNode(Code const& code) const
+	{
+		LEAF_NODE const* node = &getRoot();
+		for (DepthType depth = getTreeDepthLevels(); depth > code.getDepth(); --depth) {
+			if (0 == node->children) {
+				return std::make_pair(node, depth);
+			}
+			node = &getChild(*node, depth - 1, code.getChildIdx(depth - 1));
+		}
+		return std::make_pair(node, code.getDepth());
+	}
+
+	LEAF_NODE const& getChild(INNER_NODE const& inner_node, DepthType,
+	                          unsigned int child_idx) const
+	{
+		return nodes_[inner_node.children + child_idx];
+	}
+
+	static bool isLeaf(LEAF_NODE const* node, DepthType depth) noexcept
+	{
+		return 0 == depth || 0 == node->children;
+	}
+
+	static Point3 getChildCenter(Point3 const& parent_center, double child_half_size,
+	                             unsigned int child_idx)
+	{
+		Point3 child_center(parent_center);
+		child_center[0] += ((child_idx & 1) ? child_half_size : -child_half_size);
+		child_center[1] += ((child_idx & 2) ? child_half_size : -child_half_size);
+		child_center[2] += ((child_idx & 4) ? child_half_size : -child_half_size);
+		return child_center;
+	}
+
+	//
+	// Checking state
+	//
+
+	static double getOccupancy(LEAF_NODE const& node)
+	{
+		return toProb(node.value.occupancy);
+	}
+
+	bool isOccupied(LEAF_NODE const& node) const
+	{
+		return occupied_thres_ < node.value.occupancy;
+	}
+
+	bool isUnknown(LEAF_NODE const& node) const
+	{
+		return free_thres_ <= node.value.occupancy && occupied_thres_ >= node.value.occupancy;
+	}
+
+	bool isFree(LEAF_NODE const& node) const { return free_thres_ > node.value.occupancy; }
+
+	bool containsOccupied(LEAF_NODE const& node, DepthType) const
+	{
+		return isOccupied(node);
+	}
+
+	bool containsUnknown(LEAF_NODE const& node, DepthType depth) const
+	{
+		return 0 == depth ? isUnknown(node) : (node.contains & CONTAINS_UNKNOWN);
+	}
+
+	bool containsFree(LEAF_NODE const& node, DepthType depth) const
+	{
+		return 0 == depth ? isFree(node) : (node.contains & CONTAINS_FREE);
+	}
+
+	//
+	// Input/output (read/write)
+	//
+
+	static Header makeHeader(double resolution, DepthType depth_levels,
+	                         double occupied_thres, double free_thres,
+	                         std::uint64_t num_nodes) noexcept
+	{
+		Header header{};
+		std::memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+		header.version = FILE_VERSION;
+		header.depth_levels = depth_levels;
+		header.resolution = resolution;
+		header.occupied_thres = occupied_thres;
+		header.free_thres = free_thres;
+		header.num_nodes = num_nodes;
+		header.nodes_offset = sizeof(Header);
+		return header;
+	}
+
+	static bool validHeader(Header const& header, std::size_t file_size) noexcept;
+
+ protected:
+	// The mapped file
+	void* data_ = nullptr;
+	std::size_t data_size_ = 0;
+	// Used instead of a mapping where memory-mapping is not available
+	std::vector<char> buffer_;
+
+	MappedOccupancyNode const* nodes_ = nullptr;
+	std::size_t num_nodes_ = 0;
+
+	double resolution_ = 0.0;
+	double resolution_factor_ = 0.0;
+	DepthType depth_levels_ = 0;
+	int max_value_ = 0;
+	std::array<double, MAX_DEPTH_LEVELS + 1> nodes_half_sizes_{};
+
+	// Thresholds in log-odds
+	double occupied_thres_ = 0.0;
+	double free_thres_ = 0.0;
+
+	template <typename T, typename D, typename I, typename L, bool O>
+	friend class OctreeIterator;
+	template <typename T, typename D, typename I, typename L, bool O>
+	friend class OctreeNearestIterator;
+	template <typename T, typename D, typename I, typename L, bool O>
+	friend class OccupancyMapIterator;
+	template <typename T, typename D, typename I, typename L, bool O>
+	friend class OccupancyMapNearestIterator;
+};
+
+//
+// Conversion
+//
+
+template <typename MAP>
+bool OccupancyMapMapped::write(MAP const& map, std::string const& filename)
+{
+	using Logit =
+	    LogitTraits<std::decay_t<decltype(std::declval<MAP const&>().beginTree()->occupancy)>>;
+
+	std::ofstream file(filename.c_str(), std::ios_base::out | std::ios_base::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	// Reserve space for the header and the root, they are written when the traversal is
+	// done. The groups of siblings follow in the order they are done, so the file is
+	// written front to back.
+	Header header{};
+	MappedOccupancyNode root{};
+	file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+	file.write(reinterpret_cast<char const*>(&root), sizeof(root));
+
+	// The children of the nodes on the current path, each waiting for its last child
+	struct Siblings {
+		std::array<MappedOccupancyNode, 8> nodes;
+		std::size_t size;
+		std::size_t next = 0;
+	};
+	std::vector<Siblings> path;
+	path.reserve(MAX_DEPTH_LEVELS + 1);
+	// The root has no siblings
+	path.push_back(Siblings{{}, 1});
+	std::uint64_t num_nodes = 1;
+
+	// Depth first with the children in order, a group of siblings is done when the
+	// subtree of its last sibling is
+	traverse(map, TraversePredicate<true, true, true, false>(), [&](auto const& tree_node) {
+		if (path.empty()) {
+			return;
+		}
+
+		Siblings& siblings = path.back();
+		MappedOccupancyNode& node = siblings.nodes[siblings.next];
+		node.value.occupancy = static_cast<float>(Logit::toLogit(tree_node->occupancy));
+		node.contains = (tree_node.containsFree() ? CONTAINS_FREE : 0U) |
+		                (tree_node.containsUnknown() ? CONTAINS_UNKNOWN : 0U);
+		node.children = 0;
+		if (tree_node.hasChildren()) {
+			path.push_back(Siblings{{}, 8});
+			return;
+		}
+
+		// Append all siblings that are done, and point their parent to them
+		while (!path.empty() && path.back().size == ++path.back().next) {
+			if (1 == path.size()) {
+				root = path.back().nodes[0];
+				path.pop_back();
+				break;
+			}
+			Siblings const& done = path.back();
+			file.write(reinterpret_cast<char const*>(done.nodes.data()),
+			           done.size * sizeof(MappedOccupancyNode));
+			path.pop_back();
+			path.back().nodes[path.back().next].children = num_nodes;
+			num_nodes += 8;
+		}
+	});
+
+	if (!path.empty()) {
+		return false;
+	}
+
+	header = makeHeader(map.getResolution(), map.getTreeDepthLevels(),
+	                    Logit::quantize(toLogit(map.getOccupiedThres())) / Logit::SCALE,
+	                    Logit::quantize(toLogit(map.getFreeThres())) / Logit::SCALE,
+	                    num_nodes);
+	file.seekp(0);
+	file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+	file.write(reinterpret_cast<char const*>(&root), sizeof(root));
+
+	return file.good();
+}
+}  // namespace ufo::map
+
+#endif  // UFO_MAP_OCCUPANCY_MAP_MAPPED_H
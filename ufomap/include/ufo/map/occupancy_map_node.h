@@ -47,10 +47,93 @@
 #include <ufo/map/color.h>
 #include <ufo/map/octree_node.h>
 
+// STD
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
 namespace ufo::map
 {
 using Intensity = uint8_t;
 
+/**
+ * @brief How log-odds are represented in a node with occupancy of type T
+ *
+ * @details Floating point types store the log-odds as they are.
+ *
+ * @tparam T The occupancy type
+ */
+template <typename T, typename = void>
+struct LogitTraits {
+	static constexpr double SCALE = 1.0;
+
+	/**
+	 * @brief Convert a value in node units (log-odds times SCALE) to T
+	 */
+	static T cast(double value) noexcept { return static_cast<T>(value); }
+
+	static T fromLogit(double logit) noexcept { return cast(logit * SCALE); }
+
+	static double toLogit(T value) noexcept { return value; }
+
+	/**
+	 * @brief Round log-odds to the closest value that can be represented, in node units
+	 */
+	static double quantize(double logit) noexcept { return logit * SCALE; }
+
+	static double toProb(T value) noexcept { return 1.0 / (1.0 + std::exp(-value)); }
+};
+
+/**
+ * @brief Integer types store the log-odds in fixed-point as round(logit * SCALE),
+ * saturated to the range of the type. For int8_t SCALE is chosen so log-odds in
+ * [-4, 4) can be represented, a probability in about [0.018, 0.982], in steps of 1/32.
+ * Wider types represent log-odds in [-8, 8), a probability in about [0.0003, 0.9997],
+ * which for int16_t is in steps of 1/4096.
+ */
+template <typename T>
+struct LogitTraits<T, std::enable_if_t<std::is_integral_v<T> && std::is_signed_v<T>>> {
+	// The clamping thresholds keep the log-odds well inside [-4, 4) in practice, so
+	// int8_t spends its few steps on that range instead
+	static constexpr double SCALE =
+	    (static_cast<double>(std::numeric_limits<T>::max()) + 1.0) /
+	    (1 == sizeof(T) ? 4.0 : 8.0);
+
+	static T cast(double value) noexcept
+	{
+		return static_cast<T>(
+		    std::clamp(std::round(value), static_cast<double>(std::numeric_limits<T>::min()),
+		               static_cast<double>(std::numeric_limits<T>::max())));
+	}
+
+	static T fromLogit(double logit) noexcept { return cast(logit * SCALE); }
+
+	static double toLogit(T value) noexcept { return value / SCALE; }
+
+	static double quantize(double logit) noexcept { return fromLogit(logit); }
+
+	static double toProb(T value) noexcept
+	{
+		if constexpr (sizeof(T) <= sizeof(std::int16_t)) {
+			// Lookup table covering every value of T
+			static std::array<double, std::size_t(1) << (8 * sizeof(T))> const table = [] {
+				std::array<double, std::size_t(1) << (8 * sizeof(T))> table;
+				for (std::size_t i = 0; i < table.size(); ++i) {
+					double logit = toLogit(static_cast<T>(std::numeric_limits<T>::min() + i));
+					table[i] = 1.0 / (1.0 + std::exp(-logit));
+				}
+				return table;
+			}();
+			return table[static_cast<std::size_t>(value - std::numeric_limits<T>::min())];
+		} else {
+			return 1.0 / (1.0 + std::exp(-toLogit(value)));
+		}
+	}
+};
+
 template <typename T>
 struct OccupancyNode {
 	T occupancy = 0;
@@ -85,6 +168,35 @@ struct OccupancyNode {
 		s.read(reinterpret_cast<char*>(&occupancy), sizeof(occupancy));
 		return s;
 	}
+
+	/**
+	 * @brief Number of bytes writeData/readData write/read for this node
+	 */
+	static constexpr std::size_t dataSize() noexcept { return sizeof(occupancy); }
+
+	/**
+	 * @brief Write the data from this node to buffer
+	 *
+	 * @param buffer Where to write the data, with room for dataSize() bytes
+	 * @return Pointer past the written data
+	 */
+	char* writeData(char* buffer) const
+	{
+		std::memcpy(buffer, &occupancy, sizeof(occupancy));
+		return buffer + sizeof(occupancy);
+	}
+
+	/**
+	 * @brief Read the data for this node from buffer
+	 *
+	 * @param buffer Where to read the data from, dataSize() bytes
+	 * @return Pointer past the read data
+	 */
+	char const* readData(char const* buffer)
+	{
+		std::memcpy(&occupancy, buffer, sizeof(occupancy));
+		return buffer + sizeof(occupancy);
+	}
 };
 
 struct ColorNode {
@@ -120,6 +232,35 @@ struct ColorNode {
 		s.read(reinterpret_cast<char*>(&color), sizeof(color));
 		return s;
 	}
+
+	/**
+	 * @brief Number of bytes writeData/readData write/read for this node
+	 */
+	static constexpr std::size_t dataSize() noexcept { return sizeof(color); }
+
+	/**
+	 * @brief Write the data from this node to buffer
+	 *
+	 * @param buffer Where to write the data, with room for dataSize() bytes
+	 * @return Pointer past the written data
+	 */
+	char* writeData(char* buffer) const
+	{
+		std::memcpy(buffer, &color, sizeof(color));
+		return buffer + sizeof(color);
+	}
+
+	/**
+	 * @brief Read the data for this node from buffer
+	 *
+	 * @param buffer Where to read the data from, dataSize() bytes
+	 * @return Pointer past the read data
+	 */
+	char const* readData(char const* buffer)
+	{
+		std::memcpy(&color, buffer, sizeof(color));
+		return buffer + sizeof(color);
+	}
 };
 
 template <typename T>
@@ -162,6 +303,36 @@ struct ColorOccupancyNode : OccupancyNode<T>, ColorNode {
 	{
 		return ColorNode::readData(OccupancyNode<T>::readData(s));
 	}
+
+	/**
+	 * @brief Number of bytes writeData/readData write/read for this node
+	 */
+	static constexpr std::size_t dataSize() noexcept
+	{
+		return OccupancyNode<T>::dataSize() + ColorNode::dataSize();
+	}
+
+	/**
+	 * @brief Write the data from this node to buffer
+	 *
+	 * @param buffer Where to write the data, with room for dataSize() bytes
+	 * @return Pointer past the written data
+	 */
+	char* writeData(char* buffer) const
+	{
+		return ColorNode::writeData(OccupancyNode<T>::writeData(buffer));
+	}
+
+	/**
+	 * @brief Read the data for this node from buffer
+	 *
+	 * @param buffer Where to read the data from, dataSize() bytes
+	 * @return Pointer past the read data
+	 */
+	char const* readData(char const* buffer)
+	{
+		return ColorNode::readData(OccupancyNode<T>::readData(buffer));
+	}
 };
 
 template <typename T>
@@ -178,6 +349,30 @@ struct OccupancyMapInnerNodeBase : OccupancyMapLeafNode<T> {
 template <typename T>
 using OccupancyMapInnerNode = OctreeInnerNodeBase<OccupancyMapInnerNodeBase<T>>;
 
+template <typename NODE>
+struct OccupancyMapInnerNodeBlock : OctreeInnerNodeBlock<NODE> {
+	// Bit i is set if sibling i or any of its children contains free space
+	std::uint8_t contains_free = 0;
+	// Bit i is set if sibling i or any of its children contains unknown space
+	std::uint8_t contains_unknown = 0;
+
+	void fillMetadata(OccupancyMapInnerNodeBlock const& other, std::size_t idx) noexcept
+	{
+		contains_free = OccupancyMapInnerNodeBlock::getBit(other.contains_free, idx) ? 0xFF : 0;
+		contains_unknown =
+		    OccupancyMapInnerNodeBlock::getBit(other.contains_unknown, idx) ? 0xFF : 0;
+	}
+};
+
+/**
+ * @brief Inner node that stores its metadata in a structure-of-arrays block together
+ * with its siblings, see OccupancyMapInnerNodeBlock
+ */
+template <typename T>
+struct OccupancyMapCompactInnerNode : OccupancyMapLeafNode<T> {
+	using Block = OccupancyMapInnerNodeBlock<OccupancyMapCompactInnerNode>;
+};
+
 template <typename T>
 struct Node {
 	OccupancyMapLeafNode<T> const* node;
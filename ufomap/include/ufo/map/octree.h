@@ -44,22 +44,32 @@
 
 // UFO
 #include <ufo/map/code.h>
+#include <ufo/map/file_index.h>
 #include <ufo/map/iterator/octree.h>
 #include <ufo/map/iterator/octree_nearest.h>
 #include <ufo/map/key.h>
+#include <ufo/map/lz4_block_stream.h>
+#include <ufo/map/node_block_pool.h>
 #include <ufo/map/octree_node.h>
+#include <ufo/map/serialization_buffer.h>
 #include <ufo/map/types.h>
 
 // STD
 #include <algorithm>
+#include <atomic>
 #include <bitset>
 #include <cstring>
 #include <fstream>
 #include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <numeric>
 #include <optional>
 #include <sstream>
+#include <thread>
 #include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 // Compression
@@ -68,6 +78,15 @@
 
 namespace ufo::map
 {
+/**
+ * @brief How the data of a file or message is compressed
+ */
+enum class Compression {
+	none,       // Not compressed
+	lz4,        // A single LZ4 block, written by file version 1.0.0
+	lz4_blocks  // Independently compressed blocks, see LZ4BlockFormat
+};
+
 template <typename DATA_TYPE, typename INNER_NODE = OctreeInnerNode<DATA_TYPE>,
           typename LEAF_NODE = OctreeLeafNode<DATA_TYPE>>
 class Octree
@@ -89,6 +108,12 @@ class Octree
 
 	using Path = std::array<LEAF_NODE*, MAX_DEPTH_LEVELS>;
 
+	// Whether the inner nodes store their metadata in structure-of-arrays blocks
+	static constexpr bool COMPACT_INNER_NODES = InnerNodeBlockType<INNER_NODE>::compact;
+
+	using InnerChildren = typename InnerNodeBlockType<INNER_NODE>::type;
+	using LeafChildren = std::array<LEAF_NODE, 8>;
+
 	// class Node
 	// {
 	//  protected:
@@ -102,7 +127,22 @@ class Octree
 	// Destructor
 	//
 
-	virtual ~Octree() { clear(); }
+	// The nodes are owned by the pools, which can be shared with snapshots
+	virtual ~Octree()
+	{
+		if (1 < storage_.use_count()) {
+			// Only free the nodes no other octree uses. Shared blocks are only marked in the
+			// modifiable octree, so every block has to be checked.
+			if (getChildrenPointer(getRoot())) {
+				freeChildren(getRoot(), getTreeDepthLevels(), true);
+			}
+			storage_->inner_pool.deallocate(&getBlock(getRoot()));
+		}
+	}
+
+	Octree(Octree const&) = delete;
+
+	Octree& operator=(Octree const&) = delete;
 
 	//
 	// General information
@@ -116,6 +156,18 @@ class Octree
 
 	static std::string getFileVersion() noexcept { return FILE_VERSION; }
 
+	/**
+	 * @brief The compression of data written by the given file version, for data without
+	 * a header such as messages
+	 */
+	static Compression getCompression(std::string const& file_version, bool compressed)
+	{
+		if (!compressed) {
+			return Compression::none;
+		}
+		return "1.0.0" == file_version ? Compression::lz4 : Compression::lz4_blocks;
+	}
+
 	//
 	// Root code
 	//
@@ -133,6 +185,83 @@ class Octree
 
 	bool isAutomaticPruningEnabled() const noexcept { return automatic_pruning_enabled_; }
 
+	//
+	// Huge pages
+	//
+
+	/**
+	 * @brief Back the node memory pools with huge pages (if supported by the system).
+	 * Only affects memory allocated after the call.
+	 *
+	 * @param enable Whether huge pages should be used
+	 */
+	void enableHugePages(bool enable) noexcept
+	{
+		storage_->inner_pool.enableHugePages(enable);
+		storage_->leaf_pool.enableHugePages(enable);
+	}
+
+	bool isHugePagesEnabled() const noexcept
+	{
+		return storage_->inner_pool.isHugePagesEnabled();
+	}
+
+	//
+	// Compression
+	//
+
+	/**
+	 * @brief Set the number of threads used to compress and decompress blocks when
+	 * writing and reading compressed data, and to read subtrees of indexed files
+	 *
+	 * @param num_threads The number of threads, 0 means one per hardware thread
+	 */
+	void setCompressionThreads(unsigned int num_threads) noexcept
+	{
+		compression_threads_ =
+		    0 == num_threads ? std::max(1U, std::thread::hardware_concurrency()) : num_threads;
+	}
+
+	unsigned int getCompressionThreads() const noexcept { return compression_threads_; }
+
+	/**
+	 * @brief Set the number of uncompressed bytes in each independently compressed block.
+	 * Smaller blocks use less memory and spread better over the threads, larger blocks
+	 * compress slightly better.
+	 */
+	void setCompressionBlockSize(std::size_t block_size) noexcept
+	{
+		compression_block_size_ = std::max(std::size_t(1), block_size);
+	}
+
+	std::size_t getCompressionBlockSize() const noexcept { return compression_block_size_; }
+
+	//
+	// File index
+	//
+
+	/**
+	 * @brief Enable or disable writing an index of the subtrees after the data. With the
+	 * index the subtrees are read in parallel, and reading with a bounding volume only
+	 * reads the subtrees that intersect it. Files with an index can still be read by
+	 * readers that do not know about it. Disabled by default, which writes the same
+	 * files as before the index existed.
+	 */
+	void enableFileIndex(bool enable) noexcept { file_index_enabled_ = enable; }
+
+	bool isFileIndexEnabled() const noexcept { return file_index_enabled_; }
+
+	/**
+	 * @brief Set the depth of the indexed subtrees. Every subtree is read as a whole, so
+	 * a lower depth gives finer bounding volume reads but a larger index.
+	 */
+	void setFileIndexDepth(DepthType depth) noexcept
+	{
+		file_index_depth_ = std::max(DepthType(2), depth);
+	}
+
+	DepthType getFileIndexDepth() const noexcept { return file_index_depth_; }
+
 	//
 	// "Normal" iterators
 	//
@@ -252,12 +381,13 @@ class Octree
 			return false;
 		}
 
-		auto [node, depth] = getNode(code);
-		if (code.getDepth() != depth ||
-		    !isNodeCollapsible(static_cast<INNER_NODE const&>(*node), code.getDepth())) {
+		auto [path, depth] = getNodePath(code);
+		INNER_NODE& node = static_cast<INNER_NODE&>(*path[depth]);
+		if (code.getDepth() != depth || isLeaf(node) || !isNodeCollapsible(node, depth)) {
 			return false;
 		}
-		return deleteChildren(static_cast<INNER_NODE&>(node), code.getDepth(), true);
+		deleteChildren(node, depth, true);
+		return true;
 	}
 
 	//
@@ -437,6 +567,22 @@ class Octree
 		       (getNumLeafNodes() * memoryUsageLeafNode());
 	}
 
+	/**
+	 * @return std::size_t memory reserved by the node memory pools
+	 */
+	std::size_t memoryReserved() const noexcept
+	{
+		return storage_->inner_pool.memoryReserved() + storage_->leaf_pool.memoryReserved();
+	}
+
+	/**
+	 * @return std::size_t memory of the node memory pools that currently hold nodes
+	 */
+	std::size_t memoryInUse() const noexcept
+	{
+		return storage_->inner_pool.memoryInUse() + storage_->leaf_pool.memoryInUse();
+	}
+
 	/**
 	 * @return std::size_t number of nodes in the tree
 	 */
@@ -505,11 +651,13 @@ class Octree
 			return false;
 		}
 
-		auto [node, depth] = getNode(code);
-		if (code.getDepth() != depth) {
+		auto [path, depth] = getNodePath(code);
+		INNER_NODE& node = static_cast<INNER_NODE&>(*path[depth]);
+		if (code.getDepth() != depth || isLeaf(node)) {
 			return false;
 		}
-		return deleteChildren(static_cast<INNER_NODE&>(node), code.getDepth(), true);
+		deleteChildren(node, depth, true);
+		return true;
 	}
 
 	//
@@ -540,8 +688,7 @@ class Octree
 
 	void clear() { clear(resolution_, getTreeDepthLevels()); }
 
-	// FIXME: Make virtual
-	void clear(double new_resolution, DepthType new_depth_levels)
+	virtual void clear(double new_resolution, DepthType new_depth_levels)
 	{
 		if (MIN_DEPTH_LEVELS > new_depth_levels || MAX_DEPTH_LEVELS < new_depth_levels) {
 			throw std::invalid_argument("depth_levels can be minimum " +
@@ -549,9 +696,21 @@ class Octree
 			                            std::to_string(MAX_DEPTH_LEVELS));
 		}
 
-		// TODO: Should they be manually deleted?
-		deleteChildren(getRoot(), getTreeDepthLevels(), true);
-		getRoot() = INNER_NODE();
+		// All children live in the pools so there is no need to walk the tree. Pools shared
+		// with snapshots are left to them.
+		if (1 < storage_.use_count()) {
+			bool const huge_pages = isHugePagesEnabled();
+			storage_ = std::make_shared<Storage>();
+			enableHugePages(huge_pages);
+		} else {
+			storage_->inner_pool.clear();
+			storage_->leaf_pool.clear();
+			storage_->shared.clear();
+		}
+		num_inner_nodes_ = 0;
+		num_inner_leaf_nodes_ = 1;
+		num_leaf_nodes_ = 0;
+		allocateRoot();
 		// TODO: Have to call update node
 
 		depth_levels_ = new_depth_levels;
@@ -711,26 +870,22 @@ class Octree
 		std::string id;
 		double resolution;
 		DepthType depth_levels;
-		bool compressed;
+		Compression compression;
 		int uncompressed_data_size;
-		if (!readHeader(s, file_version, id, resolution, depth_levels, compressed,
+		if (!readHeader(s, file_version, id, resolution, depth_levels, compression,
 		                uncompressed_data_size)) {
 			return false;
 		}
 
-		if (compressed) {
-			std::stringstream uncompressed_s(std::ios_base::in | std::ios_base::out |
-			                                 std::ios_base::binary);
-			if (!decompressData(s, uncompressed_s, uncompressed_data_size)) {
-				return false;
-			}
-			return readData(uncompressed_s, resolution, depth_levels, uncompressed_data_size,
-			                compressed);
-		} else {
-			return readData(s, resolution, depth_levels, uncompressed_data_size, compressed);
-		}
+		// readData decompresses if needed
+		return readData(s, ufo::geometry::BoundingVolume(), resolution, depth_levels,
+		                uncompressed_data_size, compression);
 	}
 
+	/**
+	 * @brief Read data written by writeData of this version, see the overload taking the
+	 * compression for data written by other versions
+	 */
 	virtual bool readData(std::istream& s, double resolution, DepthType depth_levels,
 	                      int uncompressed_data_size = 1, bool compressed = false)
 	{
@@ -752,6 +907,20 @@ class Octree
 	                      ufo::geometry::BoundingVolume const& bounding_volume,
 	                      double resolution, DepthType depth_levels,
 	                      int uncompressed_data_size = 1, bool compressed = false)
+	{
+		return readData(s, bounding_volume, resolution, depth_levels,
+		                uncompressed_data_size,
+		                compressed ? Compression::lz4_blocks : Compression::none);
+	}
+
+	/**
+	 * @param compression How the data is compressed, from the header of a file or from
+	 * getCompression
+	 */
+	virtual bool readData(std::istream& s,
+	                      ufo::geometry::BoundingVolume const& bounding_volume,
+	                      double resolution, DepthType depth_levels,
+	                      int uncompressed_data_size, Compression compression)
 	{
 		if (!s.good()) {
 			// TODO: Warning
@@ -761,18 +930,75 @@ class Octree
 			clear(resolution, depth_levels);
 		}
 
-		if (compressed) {
+		// With a single thread the index only helps if some subtrees can be skipped. Only
+		// uncompressed and block compressed data can be indexed.
+		FileIndex index;
+		if (Compression::lz4 != compression &&
+		    (1 < compression_threads_ || !bounding_volume.empty()) && index.read(s) &&
+		    (Compression::lz4_blocks == compression) != index.frames.empty() &&
+		    2 <= index.depth && index.depth < depth_levels) {
+			return readIndexed(s, index, bounding_volume);
+		}
+
+		if (Compression::lz4_blocks == compression) {
+			if (!LZ4BlockFormat::readMagic(s)) {
+				return false;
+			}
+			LZ4BlockInputBuffer buffer(s, compression_threads_);
+			std::istream data(&buffer);
+			ReadBuffer nodes(data);
+			bool const success = readNodes(nodes, bounding_volume);
+			nodes.finish();
+			// Leave s after the compressed data, and the index if there is one
+			bool const valid = buffer.finish();
+			FileIndex::skip(s);
+			return valid && success;
+		} else if (Compression::lz4 == compression) {
+			// Written as a single block
 			std::stringstream uncompressed_s(std::ios_base::in | std::ios_base::out |
 			                                 std::ios_base::binary);
 			if (!decompressData(s, uncompressed_s, uncompressed_data_size)) {
 				return false;
 			}
-			return readNodes(uncompressed_s, bounding_volume);
+			ReadBuffer nodes(uncompressed_s);
+			return readNodes(nodes, bounding_volume);
 		} else {
-			return readNodes(s, bounding_volume);
+			ReadBuffer nodes(s);
+			bool const success = readNodes(nodes, bounding_volume);
+			nodes.finish();
+			FileIndex::skip(s);
+			return success;
 		}
 	}
 
+	/**
+	 * @brief Read uncompressed data, as written by writeData, straight from memory
+	 *
+	 * @param data The data
+	 * @param size Number of bytes of data
+	 * @param resolution The resolution the data was written with
+	 * @param depth_levels The depth levels the data was written with
+	 * @return false If the data ended too soon
+	 */
+	bool readData(void const* data, std::size_t size, double resolution,
+	              DepthType depth_levels)
+	{
+		return readData(data, size, ufo::geometry::BoundingVolume(), resolution,
+		                depth_levels);
+	}
+
+	bool readData(void const* data, std::size_t size,
+	              ufo::geometry::BoundingVolume const& bounding_volume, double resolution,
+	              DepthType depth_levels)
+	{
+		if (getResolution() != resolution || getTreeDepthLevels() != depth_levels) {
+			clear(resolution, depth_levels);
+		}
+
+		ReadBuffer nodes(data, size);
+		return readNodes(nodes, bounding_volume);
+	}
+
 	virtual bool write(std::string const& filename, bool compress = false,
 	                   DepthType min_depth = 0, int compression_acceleration_level = 1,
 	                   int compression_level = 0) const
@@ -836,32 +1062,43 @@ class Octree
 	                   int compression_acceleration_level = 1,
 	                   int compression_level = 0) const
 	{
-		std::stringstream data(std::ios_base::in | std::ios_base::out |
-		                       std::ios_base::binary);
+		// Only complete data is indexed, a bounding volume read of it can then skip the
+		// subtrees outside the bounding volume
+		FileIndex index;
+		index.depth = file_index_depth_;
+		FileIndex* const file_index = file_index_enabled_ && bounding_volume.empty() &&
+		                                      file_index_depth_ < getTreeDepthLevels()
+		                                  ? &index
+		                                  : nullptr;
 
-		int uncompressed_data_size =
-		    writeData(data, bounding_volume, compress, min_depth,
-		              compression_acceleration_level, compression_level);
+		if (compress) {
+			// The framed data stores its own sizes, so it is streamed right after the header
+			writeHeader(s, true, 0);
+			if (0 > writeData(s, bounding_volume, true, min_depth,
+			                  compression_acceleration_level, compression_level, file_index)) {
+				return false;
+			}
+		} else {
+			std::vector<char> data;
+			WriteBuffer nodes(data);
+			if (!writeNodes(nodes, bounding_volume, min_depth, file_index) || !nodes.finish()) {
+				return false;
+			}
 
-		if (0 > uncompressed_data_size) {
-			return false;
-		}
+			writeHeader(s, false,
+			            static_cast<int>(std::min<std::size_t>(
+			                data.size(), std::numeric_limits<int>::max())));
 
-		// Write header
-		s << FILE_HEADER;
-		s << "\n# (feel free to add / change comments, but leave the first line as "
-		     "it "
-		     "is!)\n#\n";
-		s << "version " << getFileVersion() << std::endl;
-		s << "id " << getTreeType() << std::endl;
-		s << "resolution " << getResolution() << std::endl;
-		s << "depth_levels " << getTreeDepthLevels() << std::endl;
-		s << "compressed " << compress << std::endl;
-		s << "uncompressed_data_size " << uncompressed_data_size << std::endl;
-		s << "data" << std::endl;
+			// Write data
+			s.write(data.data(), data.size());
 
-		// Write data
-		s << data.rdbuf();  // Is correct or do I have to change to begin first?
+			index.data_size = data.size();
+			index.stored_size = data.size();
+		}
+
+		if (file_index) {
+			file_index->write(s);
+		}
 
 		return s.good();
 	}
@@ -892,28 +1129,35 @@ class Octree
 	                      int compression_acceleration_level = 1,
 	                      int compression_level = 0) const
 	{
-		const std::streampos initial_write_position = s.tellp();
+		return writeData(s, bounding_volume, compress, min_depth,
+		                 compression_acceleration_level, compression_level, nullptr);
+	}
 
-		if (compress) {
-			std::stringstream data(std::ios_base::in | std::ios_base::out |
-			                       std::ios_base::binary);
-			int uncompressed_data_size =
-			    writeData(data, bounding_volume, false, min_depth,
-			              compression_acceleration_level, compression_level);
-			if (0 > uncompressed_data_size ||
-			    !compressData(data, s, uncompressed_data_size, compression_acceleration_level,
-			                  compression_level)) {
-				return -1;
-			}
-			return uncompressed_data_size;
-		} else {
-			if (!writeNodes(s, bounding_volume, min_depth)) {
-				return -1;
-			}
-		}
+	/**
+	 * @brief Append the data, uncompressed, straight to a contiguous buffer
+	 *
+	 * @param data The vector, of any one byte element type, to append to
+	 * @param min_depth The minimum depth written, deeper nodes are summarized by their
+	 * parent at min_depth
+	 * @return Number of bytes appended, -1 on failure
+	 */
+	template <typename Byte>
+	int writeData(std::vector<Byte>& data, DepthType min_depth = 0) const
+	{
+		return writeData(data, ufo::geometry::BoundingVolume(), min_depth);
+	}
 
-		// Return size of data
-		return s.tellp() - initial_write_position;
+	template <typename Byte>
+	int writeData(std::vector<Byte>& data,
+	              ufo::geometry::BoundingVolume const& bounding_volume,
+	              DepthType min_depth = 0) const
+	{
+		WriteBuffer nodes(data);
+		if (!writeNodes(nodes, bounding_volume, min_depth, nullptr) || !nodes.finish()) {
+			return -1;
+		}
+		return static_cast<int>(
+		    std::min<std::size_t>(nodes.size(), std::numeric_limits<int>::max()));
 	}
 
  protected:
@@ -940,15 +1184,61 @@ class Octree
 		for (std::size_t i = 2; i <= depth_levels_; ++i) {
 			nodes_half_sizes_[i] = nodes_half_sizes_[i - 1] * 2.0;
 		}
+
+		allocateRoot();
+	}
+
+	/**
+	 * @brief Tag for the constructors that create a snapshot of another octree.
+	 */
+	struct SnapshotTag {
+	};
+
+	/**
+	 * @brief Construct an immutable snapshot of other as it is now. All nodes are shared,
+	 * other copies a block of children the first time it modifies it after this.
+	 *
+	 * Pending updates of other have to be applied before this is called.
+	 */
+	Octree(Octree& other, SnapshotTag)
+	    : resolution_(other.resolution_),
+	      resolution_factor_(other.resolution_factor_),
+	      depth_levels_(other.depth_levels_),
+	      max_value_(other.max_value_),
+	      compression_threads_(other.compression_threads_),
+	      compression_block_size_(other.compression_block_size_),
+	      file_index_enabled_(other.file_index_enabled_),
+	      file_index_depth_(other.file_index_depth_),
+	      storage_(other.storage_),
+	      nodes_half_sizes_(other.nodes_half_sizes_),
+	      automatic_pruning_enabled_(other.automatic_pruning_enabled_),
+	      num_inner_nodes_(other.num_inner_nodes_.load()),
+	      num_inner_leaf_nodes_(other.num_inner_leaf_nodes_.load()),
+	      num_leaf_nodes_(other.num_leaf_nodes_.load())
+	{
+		allocateRoot();
+		getBlock(getRoot()) = getBlock(other.getRoot());
+		if (void* children = getChildrenPointer(getRoot())) {
+			addReference(children);
+			setChildrenPointer(getRoot(), children, true);
+			setChildrenPointer(other.getRoot(), children, true);
+		}
 	}
 
 	//
 	// Get root
 	//
 
-	INNER_NODE const& getRoot() const { return root_; }
+	INNER_NODE const& getRoot() const { return *root_; }
+
+	INNER_NODE& getRoot() { return *root_; }
 
-	INNER_NODE& getRoot() { return root_; }
+	void allocateRoot()
+	{
+		// The root lives in the inner pool like every other inner node, so compact inner
+		// nodes can always find their block
+		root_ = &(*storage_->inner_pool.allocate())[0];
+	}
 
 	//
 	// Get node
@@ -964,6 +1254,7 @@ class Octree
 			if (isLeaf(node)) {
 				break;
 			}
+			unshareChildren(node, depth);
 			DepthType child_depth = depth - 1;
 			path[child_depth] = static_cast<LEAF_NODE*>(
 			    &getChild(node, child_depth, code.getChildIdx(child_depth)));
@@ -974,12 +1265,12 @@ class Octree
 	std::pair<LEAF_NODE const*, DepthType> getNode(Code const& code) const
 	{
 		LEAF_NODE const* node = &getRoot();
-		for (DepthType depth = getTreeDepthLevels() - 1; depth > code.getDepth(); --depth) {
+		for (DepthType depth = getTreeDepthLevels(); depth > code.getDepth(); --depth) {
 			INNER_NODE const& inner_node = static_cast<INNER_NODE const&>(*node);
 			if (!hasChildren(inner_node)) {
-				return std::make_pair(node, depth + 1);
+				return std::make_pair(node, depth);
 			}
-			node = &getChild(inner_node, depth, code.getChildIdx(depth));
+			node = &getChild(inner_node, depth - 1, code.getChildIdx(depth - 1));
 		}
 		return std::make_pair(node, code.getDepth());
 	}
@@ -1008,6 +1299,8 @@ class Octree
 			INNER_NODE& node = static_cast<INNER_NODE&>(*path[depth]);
 			if (!hasChildren(node)) {
 				createChildren(node, depth);  // TODO: Add depth
+			} else {
+				unshareChildren(node, depth);
 			}
 			DepthType child_depth = depth - 1;
 			path[child_depth] = static_cast<LEAF_NODE*>(
@@ -1021,21 +1314,24 @@ class Octree
 
 	bool createChildren(INNER_NODE& node, DepthType depth)
 	{
-		if (!node.is_leaf) {
+		// The children, or the memory kept for them when not pruning, can be shared
+		unshareChildren(node, depth);
+
+		if (!isLeaf(node)) {
 			return false;
 		}
 
-		if (!node.children) {
+		if (!getChildrenPointer(node)) {
 			// Allocate children
 			if (1 == depth) {
 				// Children are leaf nodes
-				node.children = new std::array<LEAF_NODE, 8>();
+				setChildrenPointer(node, storage_->leaf_pool.allocate());
 				num_leaf_nodes_ += 8;
 				num_inner_leaf_nodes_ -= 1;
 			} else {
 				// Children are inner nodes
 				// Get 8 new and 1 is made into a inner node
-				node.children = new std::array<INNER_NODE, 8>();
+				setChildrenPointer(node, storage_->inner_pool.allocate());
 				num_inner_leaf_nodes_ += 7;
 			}
 			num_inner_nodes_ += 1;
@@ -1045,6 +1341,11 @@ class Octree
 			for (LEAF_NODE& child : getLeafChildren(node)) {
 				child = static_cast<LEAF_NODE&>(node);
 			}
+		} else if constexpr (COMPACT_INNER_NODES) {
+			InnerChildren& children = getInnerChildren(node);
+			children.nodes.fill(node);
+			children.is_leaf = 0xFF;
+			children.fillMetadata(getBlock(node), getIndexInBlock(node));
 		} else {
 			for (INNER_NODE& child : getInnerChildren(node)) {
 				decltype(child.children) children = child.children;
@@ -1053,51 +1354,227 @@ class Octree
 			}
 		}
 
-		node.is_leaf = false;
+		setLeaf(node, false);
 		return true;
 	}
 
 	void deleteChildren(INNER_NODE& node, DepthType depth, bool manual_pruning = false)
 	{
-		node.is_leaf = true;
+		setLeaf(node, true);
+
+		if (!getChildrenPointer(node) || (!manual_pruning && !automatic_pruning_enabled_)) {
+			return;
+		}
+
+		releaseChildren(node, depth);
+		setChildrenPointer(node, nullptr);
+	}
 
-		if (!node.children || (!manual_pruning && !automatic_pruning_enabled_)) {
+	/**
+	 * @brief Free the children of node and all their descendants and remove them from the
+	 * node counts. Blocks shared with a snapshot are kept for it.
+	 */
+	void releaseChildren(INNER_NODE const& node, DepthType depth)
+	{
+		void* children = getChildrenPointer(node);
+		if (isChildrenShared(node)) {
+			// Count before the reference is dropped, the snapshot could free them after
+			removeNodeCount(children, depth);
+			freeChildren(node, depth, false);
 			return;
 		}
 
 		if (1 == depth) {
 			// Deleting leaf nodes
-			delete &getLeafChildren(node);
+			storage_->leaf_pool.deallocate(static_cast<LeafChildren*>(children));
 			num_leaf_nodes_ -= 8;
 			num_inner_leaf_nodes_ += 1;
 		} else {
 			// Deleting inner nodes
-			std::array<INNER_NODE, 8>& children = getInnerChildren(node);
-			for (INNER_NODE& child : children) {
-				// Manual pruning is true in case automatic_pruning_enabled_ changes between calls
-				deleteChildren(child, depth - 1, true);
+			InnerChildren* block = static_cast<InnerChildren*>(children);
+			for (INNER_NODE const& child : *block) {
+				if (getChildrenPointer(child)) {
+					releaseChildren(child, depth - 1);
+				}
 			}
-			delete &children;
+			storage_->inner_pool.deallocate(block);
 			// Remove 8 and 1 inner node is made into a inner leaf node
 			num_inner_leaf_nodes_ -= 7;
 		}
 		num_inner_nodes_ -= 1;
-		node.children = nullptr;
+	}
+
+	void removeNodeCount(void const* children, DepthType depth)
+	{
+		if (1 == depth) {
+			num_leaf_nodes_ -= 8;
+			num_inner_leaf_nodes_ += 1;
+		} else {
+			for (INNER_NODE const& child : *static_cast<InnerChildren const*>(children)) {
+				if (void const* grandchildren = getChildrenPointer(child)) {
+					removeNodeCount(grandchildren, depth - 1);
+				}
+			}
+			num_inner_leaf_nodes_ -= 7;
+		}
+		num_inner_nodes_ -= 1;
+	}
+
+	/**
+	 * @brief Free the children of node and all their descendants that are not shared with
+	 * another octree, without changing the node counts.
+	 *
+	 * @param check_all Whether blocks that are not marked can be shared, as in snapshots
+	 */
+	void freeChildren(INNER_NODE const& node, DepthType depth, bool check_all)
+	{
+		void* children = getChildrenPointer(node);
+		if ((check_all || isChildrenShared(node)) && !dropReference(children)) {
+			return;
+		}
+
+		if (1 == depth) {
+			storage_->leaf_pool.deallocate(static_cast<LeafChildren*>(children));
+		} else {
+			InnerChildren* block = static_cast<InnerChildren*>(children);
+			for (INNER_NODE const& child : *block) {
+				if (getChildrenPointer(child)) {
+					freeChildren(child, depth - 1, check_all);
+				}
+			}
+			storage_->inner_pool.deallocate(block);
+		}
+	}
+
+	//
+	// Shared children
+	//
+
+	/**
+	 * @brief Make sure the children of node are not shared with a snapshot, by copying
+	 * them if they are. The copied children share their own children instead.
+	 */
+	void unshareChildren(INNER_NODE& node, DepthType depth)
+	{
+		if (!isChildrenShared(node)) {
+			return;
+		}
+
+		void* children = getChildrenPointer(node);
+		std::lock_guard<std::mutex> lock(storage_->mutex);
+
+		auto it = storage_->shared.find(children);
+		if (storage_->shared.end() == it) {
+			// Every snapshot sharing the children is gone
+			setChildrenPointer(node, children);
+			return;
+		}
+		if (1 == --it->second) {
+			storage_->shared.erase(it);
+		}
+
+		if (1 == depth) {
+			LeafChildren* copy = storage_->leaf_pool.allocate();
+			*copy = *static_cast<LeafChildren*>(children);
+			setChildrenPointer(node, copy);
+			return;
+		}
+
+		InnerChildren* copy = storage_->inner_pool.allocate();
+		*copy = *static_cast<InnerChildren*>(children);
+		for (INNER_NODE& child : *copy) {
+			if (void* grandchildren = getChildrenPointer(child)) {
+				++storage_->shared.try_emplace(grandchildren, 1).first->second;
+				setChildrenPointer(child, grandchildren, true);
+			}
+		}
+		setChildrenPointer(node, copy);
+	}
+
+	void addReference(void const* children)
+	{
+		std::lock_guard<std::mutex> lock(storage_->mutex);
+		++storage_->shared.try_emplace(children, 1).first->second;
+	}
+
+	/**
+	 * @return Whether no other octree used the children
+	 */
+	bool dropReference(void const* children)
+	{
+		std::lock_guard<std::mutex> lock(storage_->mutex);
+		auto it = storage_->shared.find(children);
+		if (storage_->shared.end() == it) {
+			return true;
+		}
+		if (1 == --it->second) {
+			storage_->shared.erase(it);
+		}
+		return false;
+	}
+
+	//
+	// Compact inner node blocks
+	//
+
+	static InnerChildren& getBlock(INNER_NODE const& node) noexcept
+	{
+		return *NodeBlockPool<InnerChildren>::blockOf(&node);
+	}
+
+	static std::size_t getIndexInBlock(INNER_NODE const& node) noexcept
+	{
+		return &node - &getBlock(node)[0];
+	}
+
+	//
+	// Children pointer
+	//
+
+	static void* getChildrenPointer(INNER_NODE const& node) noexcept
+	{
+		return reinterpret_cast<void*>(
+		    reinterpret_cast<std::uintptr_t>(getChildrenSlot(node)) & ~SHARED_CHILDREN);
+	}
+
+	/**
+	 * @param shared Whether the children are shared with a snapshot
+	 */
+	static void setChildrenPointer(INNER_NODE& node, void* children,
+	                               bool shared = false) noexcept
+	{
+		getChildrenSlot(node) =
+		    shared ? reinterpret_cast<void*>(reinterpret_cast<std::uintptr_t>(children) |
+		                                     SHARED_CHILDREN)
+		           : children;
+	}
+
+	static bool isChildrenShared(INNER_NODE const& node) noexcept
+	{
+		return reinterpret_cast<std::uintptr_t>(getChildrenSlot(node)) & SHARED_CHILDREN;
+	}
+
+	static void*& getChildrenSlot(INNER_NODE const& node) noexcept
+	{
+		if constexpr (COMPACT_INNER_NODES) {
+			return getBlock(node).children[getIndexInBlock(node)];
+		} else {
+			return const_cast<INNER_NODE&>(node).children;
+		}
 	}
 
 	//
 	// Get children
 	//
 
-	static constexpr std::array<LEAF_NODE, 8>& getLeafChildren(INNER_NODE const& inner_node)
+	static constexpr LeafChildren& getLeafChildren(INNER_NODE const& inner_node)
 	{
-		return *static_cast<std::array<LEAF_NODE, 8>*>(inner_node.children);
+		return *static_cast<LeafChildren*>(getChildrenPointer(inner_node));
 	}
 
-	static constexpr std::array<INNER_NODE, 8>& getInnerChildren(
-	    INNER_NODE const& inner_node)
+	static constexpr InnerChildren& getInnerChildren(INNER_NODE const& inner_node)
 	{
-		return *static_cast<std::array<INNER_NODE, 8>*>(inner_node.children);
+		return *static_cast<InnerChildren*>(getChildrenPointer(inner_node));
 	}
 
 	static LEAF_NODE& getLeafChild(INNER_NODE const& inner_node, unsigned int idx)
@@ -1124,7 +1601,23 @@ class Octree
 	// Checking for children
 	//
 
-	static bool isLeaf(INNER_NODE const& node) noexcept { return node.is_leaf; }
+	static bool isLeaf(INNER_NODE const& node) noexcept
+	{
+		if constexpr (COMPACT_INNER_NODES) {
+			return InnerChildren::getBit(getBlock(node).is_leaf, getIndexInBlock(node));
+		} else {
+			return node.is_leaf;
+		}
+	}
+
+	static void setLeaf(INNER_NODE& node, bool is_leaf) noexcept
+	{
+		if constexpr (COMPACT_INNER_NODES) {
+			InnerChildren::setBit(getBlock(node).is_leaf, getIndexInBlock(node), is_leaf);
+		} else {
+			node.is_leaf = is_leaf;
+		}
+	}
 
 	static bool isLeaf(LEAF_NODE const* node, DepthType depth) noexcept
 	{
@@ -1144,7 +1637,11 @@ class Octree
 
 	bool isNodeCollapsible(INNER_NODE const& node, DepthType depth)
 	{
-		if (1 < depth) {
+		if constexpr (COMPACT_INNER_NODES) {
+			if (1 < depth && 0xFF != getInnerChildren(node).is_leaf) {
+				return false;
+			}
+		} else if (1 < depth) {
 			for (int i = 0; i < 8; ++i) {
 				if (hasChildren(getInnerChild(node, i))) {
 					return false;
@@ -1335,15 +1832,20 @@ class Octree
 	// Input/output (read/write)
 	//
 
+	/**
+	 * @return false If a field is missing or invalid, or the data is compressed in a way
+	 * that is not known
+	 */
 	virtual bool readHeader(std::istream& s, std::string& file_version, std::string& id,
-	                        double& resolution, DepthType& depth_levels, bool& compressed,
-	                        int& uncompressed_data_size) const
+	                        double& resolution, DepthType& depth_levels,
+	                        Compression& compression, int& uncompressed_data_size) const
 	{
 		file_version = "";
 		id = "";
 		resolution = 0.0;
 		depth_levels = 0;
-		compressed = false;
+		bool compressed = false;
+		std::string compression_name = "";
 		uncompressed_data_size = -1;
 
 		std::string token;
@@ -1373,6 +1875,8 @@ class Octree
 				s >> depth_levels;
 			} else if ("compressed" == token) {
 				s >> compressed;
+			} else if ("compression" == token) {
+				s >> compression_name;
 			} else if ("uncompressed_data_size" == token) {
 				s >> uncompressed_data_size;
 			} else {
@@ -1408,6 +1912,18 @@ class Octree
 			return false;
 		}
 
+		// Compressed data without a compression field is a single block, as written before
+		// the field existed
+		if (!compressed) {
+			compression = Compression::none;
+		} else if ("" == compression_name) {
+			compression = Compression::lz4;
+		} else if ("lz4_blocks" == compression_name) {
+			compression = Compression::lz4_blocks;
+		} else {
+			return false;
+		}
+
 		if (getTreeType() != id) {
 			// Wrong tree type
 			return false;
@@ -1416,12 +1932,213 @@ class Octree
 		return true;
 	}
 
-	virtual bool readNodes(std::istream& s,
+	void writeHeader(std::ostream& s, bool compressed, int uncompressed_data_size) const
+	{
+		s << FILE_HEADER;
+		s << "\n# (feel free to add / change comments, but leave the first line as "
+		     "it "
+		     "is!)\n#\n";
+		s << "version " << getFileVersion() << std::endl;
+		s << "id " << getTreeType() << std::endl;
+		s << "resolution " << getResolution() << std::endl;
+		s << "depth_levels " << getTreeDepthLevels() << std::endl;
+		s << "compressed " << compressed << std::endl;
+		if (compressed) {
+			s << "compression lz4_blocks" << std::endl;
+		}
+		s << "uncompressed_data_size " << uncompressed_data_size << std::endl;
+		s << "data" << std::endl;
+	}
+
+	/**
+	 * @brief Read data that has an index, only the parts of the data that are needed are
+	 * read from s. Leaves s after the index.
+	 */
+	bool readIndexed(std::istream& s, FileIndex const& index,
+	                 ufo::geometry::BoundingVolume const& bounding_volume)
+	{
+		std::streampos const data_start = s.tellg();
+
+		// The subtrees that intersect the bounding volume
+		std::vector<char> load(index.subtrees.size(), true);
+		if (!bounding_volume.empty()) {
+			double const half_size = getNodeHalfSize(index.depth);
+			for (std::size_t i = 0; i != load.size(); ++i) {
+				Point3 const center = toCoord(Code(index.subtrees[i].code, index.depth));
+				load[i] = bounding_volume.intersects(ufo::geometry::AABB(center, half_size));
+			}
+		}
+
+		// Everything but the subtrees that are not loaded is needed
+		std::vector<std::pair<std::uint64_t, std::uint64_t>> ranges;
+		std::uint64_t begin = 0;
+		for (std::size_t i = 0; i != load.size(); ++i) {
+			if (!load[i]) {
+				if (begin < index.subtrees[i].offset) {
+					ranges.emplace_back(begin, index.subtrees[i].offset);
+				}
+				begin = index.subtrees[i].offset + index.subtrees[i].size;
+			}
+		}
+		if (begin < index.data_size) {
+			ranges.emplace_back(begin, index.data_size);
+		}
+
+		std::unique_ptr<char[]> data(new char[index.data_size]);
+		bool success = index.frames.empty()
+		                   ? readIndexedRanges(s, data_start, ranges, data.get())
+		                   : readIndexedFrames(s, data_start, index, ranges, data.get());
+		success = success && readIndexedNodes(data.get(), index.data_size, index, load,
+		                                      bounding_volume);
+
+		// The index is last
+		s.clear();
+		s.seekg(0, std::ios_base::end);
+		return success;
+	}
+
+	bool readIndexedRanges(std::istream& s, std::streampos data_start,
+	                       std::vector<std::pair<std::uint64_t, std::uint64_t>> const& ranges,
+	                       char* data)
+	{
+		for (auto const& [begin, end] : ranges) {
+			if (!s.seekg(data_start + std::streamoff(begin)) ||
+			    !s.read(data + begin, end - begin)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * @brief Read the frames that overlap ranges and decompress them in parallel
+	 */
+	bool readIndexedFrames(std::istream& s, std::streampos data_start,
+	                       FileIndex const& index,
+	                       std::vector<std::pair<std::uint64_t, std::uint64_t>> const& ranges,
+	                       char* data)
+	{
+		struct Frame {
+			std::uint64_t uncompressed_offset;
+			std::uint32_t uncompressed_size;
+			std::vector<char> compressed;
+		};
+
+		// Reading is serial, decompressing is not
+		std::vector<Frame> frames;
+		auto range = std::cbegin(ranges);
+		for (std::size_t i = 0; i != index.frames.size() && range != std::cend(ranges); ++i) {
+			std::uint64_t const begin = index.frames[i].uncompressed_offset;
+			std::uint64_t const end = i + 1 == index.frames.size()
+			                              ? index.data_size
+			                              : index.frames[i + 1].uncompressed_offset;
+			while (range != std::cend(ranges) && range->second <= begin) {
+				++range;
+			}
+			if (range == std::cend(ranges) || range->first >= end) {
+				continue;
+			}
+
+			std::uint32_t sizes[2];
+			if (!s.seekg(data_start + std::streamoff(index.frames[i].offset)) ||
+			    !s.read(reinterpret_cast<char*>(sizes), sizeof(sizes)) ||
+			    end - begin != sizes[0]) {
+				return false;
+			}
+			Frame& frame = frames.emplace_back();
+			frame.uncompressed_offset = begin;
+			frame.uncompressed_size = sizes[0];
+			frame.compressed.resize(sizes[1]);
+			if (!s.read(frame.compressed.data(), frame.compressed.size())) {
+				return false;
+			}
+		}
+
+		std::atomic_size_t next = 0;
+		std::atomic_bool success = true;
+		auto worker = [&]() {
+			for (std::size_t i = next++; i < frames.size(); i = next++) {
+				Frame const& frame = frames[i];
+				int const size = LZ4_decompress_safe(
+				    frame.compressed.data(), data + frame.uncompressed_offset,
+				    static_cast<int>(frame.compressed.size()), frame.uncompressed_size);
+				if (static_cast<std::uint32_t>(size) != frame.uncompressed_size) {
+					success = false;
+				}
+			}
+		};
+
+		std::size_t const num_threads =
+		    std::min<std::size_t>(compression_threads_, frames.size());
+		std::vector<std::future<void>> workers;
+		for (std::size_t i = 1; i < num_threads; ++i) {
+			workers.push_back(std::async(std::launch::async, worker));
+		}
+		worker();
+		for (auto& w : workers) {
+			w.get();
+		}
+		return success;
+	}
+
+	int writeData(std::ostream& s, ufo::geometry::BoundingVolume const& bounding_volume,
+	              bool compress, DepthType min_depth, int compression_acceleration_level,
+	              int compression_level, FileIndex* index) const
+	{
+		const std::streampos initial_write_position = s.tellp();
+
+		if (compress) {
+			// Blocks are compressed in parallel as the nodes are written, the uncompressed
+			// data is never in memory all at once
+			LZ4BlockOutputBuffer buffer(s, compression_block_size_, compression_threads_,
+			                            compression_acceleration_level, compression_level);
+			std::ostream data(&buffer);
+			WriteBuffer nodes(data);
+			if (!writeNodes(nodes, bounding_volume, min_depth, index) || !nodes.finish() ||
+			    !buffer.finish()) {
+				return -1;
+			}
+			if (index) {
+				index->data_size = buffer.size();
+				index->stored_size = buffer.compressedSize();
+				index->frames = buffer.frames();
+			}
+			return static_cast<int>(
+			    std::min<std::uint64_t>(buffer.size(), std::numeric_limits<int>::max()));
+		} else {
+			WriteBuffer nodes(s);
+			if (!writeNodes(nodes, bounding_volume, min_depth, index) || !nodes.finish()) {
+				return -1;
+			}
+			if (index) {
+				index->data_size = nodes.size();
+				index->stored_size = nodes.size();
+			}
+		}
+
+		// Return size of data
+		return s.tellp() - initial_write_position;
+	}
+
+	virtual bool readNodes(ReadBuffer& buffer,
 	                       ufo::geometry::BoundingVolume const& bounding_volume) = 0;
 
-	virtual bool writeNodes(std::ostream& s,
+	/**
+	 * @brief Read the data described by index, bytes of subtrees that are not loaded may
+	 * be missing from data
+	 *
+	 * @param load Whether each subtree in the index should be read
+	 */
+	virtual bool readIndexedNodes(char const* data, std::size_t size,
+	                              FileIndex const& index, std::vector<char> const& load,
+	                              ufo::geometry::BoundingVolume const& bounding_volume) = 0;
+
+	/**
+	 * @param index If not null, the subtrees at index->depth are added to it
+	 */
+	virtual bool writeNodes(WriteBuffer& buffer,
 	                        ufo::geometry::BoundingVolume const& bounding_volume,
-	                        DepthType min_depth) const = 0;
+	                        DepthType min_depth, FileIndex* index) const = 0;
 
 	//
 	// Compress/decompress
@@ -1491,7 +2208,29 @@ class Octree
 	DepthType depth_levels_;    // The maximum depth of the octree
 	KeyType max_value_;         // The maximum coordinate value the octree can store
 
-	INNER_NODE root_;  // The root of the octree
+	// Compression
+	unsigned int compression_threads_ = std::max(1U, std::thread::hardware_concurrency());
+	std::size_t compression_block_size_ = std::size_t(1) << 20;
+
+	// File index
+	bool file_index_enabled_ = false;
+	DepthType file_index_depth_ = 6;
+
+	INNER_NODE* root_;  // The root of the octree, stored in the inner pool
+
+	// Memory pools for the children of the inner nodes, shared with the snapshots. A block
+	// shared by n > 1 octrees is marked in the children pointers of the modifiable octree
+	// and has n in shared.
+	struct Storage {
+		NodeBlockPool<InnerChildren> inner_pool;
+		NodeBlockPool<LeafChildren> leaf_pool;
+		std::unordered_map<void const*, std::size_t> shared;
+		std::mutex mutex;  // Guards shared
+	};
+	std::shared_ptr<Storage> storage_ = std::make_shared<Storage>();
+
+	// Lowest bit of a children pointer, set if the children are shared with a snapshot
+	static constexpr std::uintptr_t SHARED_CHILDREN = 1;
 
 	// Stores the half size of a node at a given depth, where the depth is the index
 	std::array<double, MAX_DEPTH_LEVELS + 1> nodes_half_sizes_;
@@ -1500,12 +2239,13 @@ class Octree
 	bool automatic_pruning_enabled_ = true;
 
 	// Memory
-	size_t num_inner_nodes_ = 0;       // Current number of inner nodes
-	size_t num_inner_leaf_nodes_ = 1;  // Current number of inner leaf nodes
-	size_t num_leaf_nodes_ = 0;        // Current number of leaf nodes
+	// Atomic since subtrees can be updated in parallel
+	std::atomic_size_t num_inner_nodes_ = 0;       // Current number of inner nodes
+	std::atomic_size_t num_inner_leaf_nodes_ = 1;  // Current number of inner leaf nodes
+	std::atomic_size_t num_leaf_nodes_ = 0;        // Current number of leaf nodes
 
 	inline static const std::string FILE_HEADER = "# UFOMap file";  // File header
-	inline static const std::string FILE_VERSION = "1.0.0";         // File version
+	inline static const std::string FILE_VERSION = "1.1.0";         // File version
 
 	// TODO: Is this needed? I think so
 	template <typename T, typename D, typename I, typename L, bool O>
@@ -43,7 +43,11 @@
 #define UFO_MAP_OCTREE_NODE_H
 
 // STD
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <type_traits>
 
 namespace ufo::map
 {
@@ -73,6 +77,27 @@ struct OctreeLeafNode {
 	{
 		return value.readData(s);
 	}
+
+	/**
+	 * @brief Number of bytes writeData/readData write/read for this node
+	 */
+	static constexpr std::size_t dataSize() noexcept { return T::dataSize(); }
+
+	/**
+	 * @brief Write the data from this node to buffer
+	 *
+	 * @param buffer Where to write the data, with room for dataSize() bytes
+	 * @return Pointer past the written data
+	 */
+	char* writeData(char* buffer) const { return value.writeData(buffer); }
+
+	/**
+	 * @brief Read the data for this node from buffer
+	 *
+	 * @param buffer Where to read the data from, dataSize() bytes
+	 * @return Pointer past the read data
+	 */
+	char const* readData(char const* buffer) { return value.readData(buffer); }
 };
 
 template <typename T>
@@ -109,6 +134,75 @@ struct OctreeInnerNodeBase : T {
 
 template <typename T>
 using OctreeInnerNode = OctreeInnerNodeBase<OctreeLeafNode<T>>;
+
+//
+// Compact inner nodes
+//
+
+/**
+ * @brief Eight sibling inner nodes stored as structure-of-arrays
+ *
+ * @details The values of the siblings are stored next to each other, followed by the
+ * children pointers and one bit per sibling in each of the masks. A node only holds its
+ * value, the rest is found through the block it lives in.
+ *
+ * @tparam NODE The compact inner node type
+ */
+template <typename NODE>
+struct OctreeInnerNodeBlock {
+	std::array<NODE, 8> nodes;
+	std::array<void*, 8> children{};
+	// Bit i is set if sibling i is a leaf node (has no children)
+	std::uint8_t is_leaf = 0xFF;
+
+	NODE& operator[](std::size_t idx) noexcept { return nodes[idx]; }
+	NODE const& operator[](std::size_t idx) const noexcept { return nodes[idx]; }
+
+	auto begin() noexcept { return nodes.begin(); }
+	auto begin() const noexcept { return nodes.begin(); }
+	auto end() noexcept { return nodes.end(); }
+	auto end() const noexcept { return nodes.end(); }
+
+	/**
+	 * @brief Set the metadata, except is_leaf and children, of all siblings to that of
+	 * sibling idx in block other
+	 */
+	void fillMetadata([[maybe_unused]] OctreeInnerNodeBlock const& other,
+	                  [[maybe_unused]] std::size_t idx) noexcept
+	{
+	}
+
+	static void setBit(std::uint8_t& mask, std::size_t idx, bool value) noexcept
+	{
+		mask = value ? mask | (1U << idx) : mask & ~(1U << idx);
+	}
+
+	static bool getBit(std::uint8_t mask, std::size_t idx) noexcept
+	{
+		return (mask >> idx) & 1U;
+	}
+};
+
+template <typename T>
+struct OctreeCompactInnerNode : OctreeLeafNode<T> {
+	using Block = OctreeInnerNodeBlock<OctreeCompactInnerNode>;
+};
+
+/**
+ * @brief The block eight sibling inner nodes are stored in, std::array<NODE, 8> unless
+ * NODE is a compact inner node with its own Block type
+ */
+template <typename NODE, typename = void>
+struct InnerNodeBlockType {
+	using type = std::array<NODE, 8>;
+	static constexpr bool compact = false;
+};
+
+template <typename NODE>
+struct InnerNodeBlockType<NODE, std::void_t<typename NODE::Block>> {
+	using type = typename NODE::Block;
+	static constexpr bool compact = true;
+};
 }  // namespace ufo::map
 
-#endif  // UFO_MAP_OCTREE_NODE_H
\ No newline at end of file
+#endif  // UFO_MAP_OCTREE_NODE_H
@@ -0,0 +1,315 @@
+/**
+ * UFOMap: An Efficient Probabilistic 3D Mapping Framework That Embraces the Unknown
+ *
+ * @author D. Duberg, KTH Royal Institute of Technology, Copyright (c) 2020.
+ * @see https://github.com/UnknownFreeOccupied/ufomap
+ * License: BSD 3
+ *
+ */
+
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, D. Duberg, KTH Royal Institute of Technology
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef UFO_MAP_SERIALIZATION_BUFFER_H
+#define UFO_MAP_SERIALIZATION_BUFFER_H
+
+// STD
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <ios>
+#include <istream>
+#include <ostream>
+#include <type_traits>
+#include <vector>
+
+namespace ufo::map
+{
+/**
+ * @brief Contiguous buffer the nodes are serialized into.
+ *
+ * @details Either appends to a caller-provided byte vector, which grows as needed, or
+ * writes to a stream in chunks so that the whole data is never in memory at once.
+ * Writing a node is a pointer bump and a copy, instead of a call into the stream.
+ */
+class WriteBuffer
+{
+ public:
+	/**
+	 * @brief Append to data
+	 *
+	 * @param data The vector to append to, any type of one byte elements
+	 */
+	template <typename Byte, typename = std::enable_if_t<1 == sizeof(Byte)>>
+	explicit WriteBuffer(std::vector<Byte>& data)
+	    : container_(&data),
+	      resize_(&resizeVector<Byte>),
+	      begin_(reinterpret_cast<char*>(data.data())),
+	      pos_(begin_ + data.size()),
+	      end_(pos_),
+	      start_(data.size())
+	{
+	}
+
+	/**
+	 * @brief Write to s, at most chunk_size bytes are buffered
+	 *
+	 * @param s The stream to write to
+	 * @param chunk_size Number of bytes buffered before they are written to s
+	 */
+	explicit WriteBuffer(std::ostream& s, std::size_t chunk_size = std::size_t(1) << 20)
+	    : container_(&chunk_),
+	      resize_(&resizeVector<char>),
+	      out_(&s),
+	      chunk_size_(std::max(chunk_size, std::size_t(1)))
+	{
+	}
+
+	WriteBuffer(WriteBuffer const&) = delete;
+
+	WriteBuffer& operator=(WriteBuffer const&) = delete;
+
+	~WriteBuffer() { finish(); }
+
+	/**
+	 * @brief Reserve the next size bytes of the buffer
+	 *
+	 * @param size Number of bytes
+	 * @return Where the bytes should be written, valid until the next call
+	 */
+	char* next(std::size_t size)
+	{
+		if (static_cast<std::size_t>(end_ - pos_) < size) {
+			grow(size);
+		}
+		char* data = pos_;
+		pos_ += size;
+		return data;
+	}
+
+	/**
+	 * @brief Write the bytes of value
+	 */
+	template <typename T>
+	void write(T const& value)
+	{
+		std::memcpy(next(sizeof(T)), &value, sizeof(T));
+	}
+
+	/**
+	 * @brief Write what is buffered to the stream, or shrink the vector to what was
+	 * written. Can be called more than once.
+	 *
+	 * @return true If everything was written
+	 */
+	bool finish()
+	{
+		if (out_) {
+			flush();
+			return out_->good();
+		}
+		std::size_t const used = pos_ - begin_;
+		begin_ = resize_(container_, used);
+		pos_ = begin_ + used;
+		end_ = pos_;
+		return true;
+	}
+
+	/**
+	 * @brief Number of bytes written so far
+	 */
+	std::size_t size() const noexcept { return written_ + (pos_ - begin_) - start_; }
+
+ private:
+	void grow(std::size_t size)
+	{
+		std::size_t capacity;
+		if (out_) {
+			flush();
+			capacity = std::max(chunk_size_, size);
+		} else {
+			// Geometric growth, the vector is shrunk again by finish
+			capacity = std::max({std::size_t(4096), 2 * static_cast<std::size_t>(end_ - begin_),
+			                     static_cast<std::size_t>(pos_ - begin_) + size});
+		}
+		std::size_t const used = pos_ - begin_;
+		begin_ = resize_(container_, capacity);
+		pos_ = begin_ + used;
+		end_ = begin_ + capacity;
+	}
+
+	void flush()
+	{
+		std::size_t const used = pos_ - begin_;
+		if (0 < used) {
+			out_->write(begin_, used);
+			written_ += used;
+			pos_ = begin_;
+		}
+	}
+
+	template <typename Byte>
+	static char* resizeVector(void* data, std::size_t size)
+	{
+		std::vector<Byte>& v = *static_cast<std::vector<Byte>*>(data);
+		v.resize(size);
+		return reinterpret_cast<char*>(v.data());
+	}
+
+ private:
+	std::vector<char> chunk_;
+	void* container_;
+	char* (*resize_)(void*, std::size_t);
+	std::ostream* out_ = nullptr;
+	std::size_t chunk_size_ = 0;
+
+	char* begin_ = nullptr;
+	char* pos_ = nullptr;
+	char* end_ = nullptr;
+
+	std::size_t start_ = 0;    // Size of the vector before anything was written
+	std::size_t written_ = 0;  // Bytes already written to the stream
+};
+
+/**
+ * @brief Contiguous buffer the nodes are deserialized from.
+ *
+ * @details Either reads straight from caller-provided memory, or from a stream in
+ * chunks.
+ */
+class ReadBuffer
+{
+ public:
+	/**
+	 * @brief Read from size bytes starting at data, which has to outlive the buffer
+	 */
+	ReadBuffer(void const* data, std::size_t size)
+	    : pos_(static_cast<char const*>(data)), end_(pos_ + size)
+	{
+	}
+
+	/**
+	 * @brief Read from s, chunk_size bytes at a time
+	 *
+	 * @param s The stream to read from
+	 * @param chunk_size Number of bytes read from s at a time
+	 */
+	explicit ReadBuffer(std::istream& s, std::size_t chunk_size = std::size_t(1) << 20)
+	    : in_(&s), chunk_size_(std::max(chunk_size, std::size_t(1)))
+	{
+	}
+
+	ReadBuffer(ReadBuffer const&) = delete;
+
+	ReadBuffer& operator=(ReadBuffer const&) = delete;
+
+	~ReadBuffer() { finish(); }
+
+	/**
+	 * @brief Consume the next size bytes
+	 *
+	 * @param size Number of bytes
+	 * @return The bytes, valid until the next call, or nullptr if fewer than size bytes
+	 * are left
+	 */
+	char const* next(std::size_t size)
+	{
+		if (static_cast<std::size_t>(end_ - pos_) < size && !fill(size)) {
+			return nullptr;
+		}
+		char const* data = pos_;
+		pos_ += size;
+		return data;
+	}
+
+	/**
+	 * @brief Read the bytes of value
+	 *
+	 * @return false If there are not enough bytes left
+	 */
+	template <typename T>
+	bool read(T& value)
+	{
+		char const* data = next(sizeof(T));
+		if (nullptr == data) {
+			return false;
+		}
+		std::memcpy(&value, data, sizeof(T));
+		return true;
+	}
+
+	/**
+	 * @brief Give back what was read ahead to the stream, if it supports seeking. Can be
+	 * called more than once.
+	 */
+	void finish()
+	{
+		if (in_ && pos_ != end_) {
+			in_->rdbuf()->pubseekoff(-static_cast<std::streamoff>(end_ - pos_),
+			                         std::ios_base::cur, std::ios_base::in);
+			pos_ = end_;
+		}
+	}
+
+ private:
+	bool fill(std::size_t size)
+	{
+		if (!in_) {
+			return false;
+		}
+
+		// Move what is left to the front, then read the rest of the chunk
+		std::size_t const left = end_ - pos_;
+		std::size_t const offset = 0 < left ? pos_ - chunk_.data() : 0;
+		if (chunk_.size() < std::max(chunk_size_, size)) {
+			chunk_.resize(std::max(chunk_size_, size));
+		}
+		std::memmove(chunk_.data(), chunk_.data() + offset, left);
+		std::streamsize const num_read =
+		    in_->rdbuf()->sgetn(chunk_.data() + left, chunk_.size() - left);
+
+		pos_ = chunk_.data();
+		end_ = pos_ + left + std::max(std::streamsize(0), num_read);
+		return static_cast<std::size_t>(end_ - pos_) >= size;
+	}
+
+ private:
+	std::istream* in_ = nullptr;
+	std::size_t chunk_size_ = 0;
+	std::vector<char> chunk_;
+
+	char const* pos_ = nullptr;
+	char const* end_ = nullptr;
+};
+}  // namespace ufo::map
+
+#endif  // UFO_MAP_SERIALIZATION_BUFFER_H
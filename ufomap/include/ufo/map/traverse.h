@@ -0,0 +1,112 @@
+/**
+ * UFOMap: An Efficient Probabilistic 3D Mapping Framework That Embraces the Unknown
+ *
+ * @author D. Duberg, KTH Royal Institute of Technology, Copyright (c) 2020.
+ * @see https://github.com/UnknownFreeOccupied/ufomap
+ * License: BSD 3
+ *
+ */
+
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, D. Duberg, KTH Royal Institute of Technology
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef UFO_MAP_TRAVERSE_H
+#define UFO_MAP_TRAVERSE_H
+
+// UFO
+#include <ufo/map/types.h>
+
+// STD
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace ufo::map
+{
+/**
+ * @brief Selects the nodes visited by traverse, the same as the arguments of beginTree
+ * and beginLeaves but fixed at compile time
+ *
+ * @tparam ONLY_LEAVES Only visit the leaves and the nodes at min_depth, as beginLeaves
+ * @tparam CONTAINS Visit the nodes containing the selected states, instead of the nodes
+ * in them
+ * @tparam BoundingType Any of the geometry types, a BoundingVar or a BoundingVolume.
+ * Only nodes intersecting it are visited. std::monostate visits the whole map.
+ */
+template <bool OCCUPIED_SPACE, bool FREE_SPACE, bool UNKNOWN_SPACE,
+          bool ONLY_LEAVES = true, bool CONTAINS = false,
+          typename BoundingType = std::monostate>
+struct TraversePredicate {
+	DepthType min_depth = 0;
+	BoundingType bounding_volume = BoundingType();
+};
+
+/**
+ * @brief Call f(occupied, free, unknown) with the runtime flags as std::true_type or
+ * std::false_type, to choose a TraversePredicate from runtime settings
+ */
+template <typename F>
+void selectSpace(bool occupied_space, bool free_space, bool unknown_space, F&& f)
+{
+	auto select_unknown = [unknown_space, &f](auto occupied, auto free) {
+		if (unknown_space) {
+			f(occupied, free, std::true_type());
+		} else {
+			f(occupied, free, std::false_type());
+		}
+	};
+	auto select_free = [free_space, &select_unknown](auto occupied) {
+		if (free_space) {
+			select_unknown(occupied, std::true_type());
+		} else {
+			select_unknown(occupied, std::false_type());
+		}
+	};
+	if (occupied_space) {
+		select_free(std::true_type());
+	} else {
+		select_free(std::false_type());
+	}
+}
+
+/**
+ * @brief Call visitor with each node of map selected by predicate, see
+ * OccupancyMapBase::traverse
+ */
+template <typename MAP, typename Predicate, typename Visitor>
+void traverse(MAP const& map, Predicate const& predicate, Visitor&& visitor)
+{
+	map.traverse(predicate, std::forward<Visitor>(visitor));
+}
+}  // namespace ufo::map
+
+#endif  // UFO_MAP_TRAVERSE_H
@@ -44,6 +44,8 @@
 
 #include <ufo/map/occupancy_map.h>
 #include <ufo/map/occupancy_map_color.h>
+#include <ufo/map/occupancy_map_fixed.h>
+#include <ufo/map/occupancy_map_mapped.h>
 #include <ufo/map/point_cloud.h>
 #include <ufo/map/types.h>
 
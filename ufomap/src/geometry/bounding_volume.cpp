@@ -64,4 +64,20 @@ bool BoundingVolume::intersects(BoundingVolume const& other) const
 	}
 	return false;
 }
+
+ChildrenMask BoundingVolume::intersectsChildren(Point const& center,
+                                                double child_half_size) const
+{
+	ChildrenMask mask;
+	for (BoundingVar const& bv : bounding_volume_) {
+		ChildrenMask const bv_mask =
+		    geometry::intersectsChildren(bv, center, child_half_size);
+		mask.intersects |= bv_mask.intersects;
+		mask.inside |= bv_mask.inside;
+		if (0xFF == mask.inside) {
+			break;
+		}
+	}
+	return mask;
+}
 }  // namespace ufo::geometry
\ No newline at end of file
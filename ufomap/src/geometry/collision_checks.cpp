@@ -41,9 +41,17 @@
 
 #include <ufo/geometry/collision_checks.h>
 
+#include <algorithm>
+#include <cmath>
 #include <exception>
 #include <limits>
 
+// The children of a node are tested four at a time with AVX2 when the CPU supports it
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define UFO_GEOMETRY_CHILDREN_AVX2
+#include <immintrin.h>
+#endif
+
 namespace ufo::geometry
 {
 /////////////////////////////////////////////////////////////////////////////////////////
@@ -247,6 +255,395 @@ bool overlapOnAxis(const OBB& obb_1, const OBB& obb_2, const Point& axis)
 	return ((b_min <= a_max) && (a_min <= b_max));
 }
 
+//
+// Support functions
+//
+
+// Touching shapes count as intersecting, the same as for two AABBs. The tolerance keeps
+// that true after rounding, so a node intersects whenever one of its children does.
+constexpr double TOUCHING_TOLERANCE = 1e-9;
+
+// The exact tests against capsules, cones, cylinders, ellipsoids and triangles run GJK
+// on the support functions below. Spheres and capsules are given by their center point
+// and line segment, with the radius as a margin, so GJK never has to converge onto
+// their round surface.
+
+Point support(const AABB& aabb, const Point& direction)
+{
+	return Point(aabb.center.x() + std::copysign(aabb.half_size.x(), direction.x()),
+	             aabb.center.y() + std::copysign(aabb.half_size.y(), direction.y()),
+	             aabb.center.z() + std::copysign(aabb.half_size.z(), direction.z()));
+}
+
+Point support(const Capsule& capsule, const Point& direction)
+{
+	return Point::dot(capsule.end - capsule.start, direction) < 0.0 ? capsule.start
+	                                                                : capsule.end;
+}
+
+Point supportDisk(const Point& center, const Point& axis, double radius,
+                  const Point& direction)
+{
+	double axis_squared = axis.squaredNorm();
+	Point radial = direction;
+	if (0.0 < axis_squared) {
+		radial -= axis * (Point::dot(direction, axis) / axis_squared);
+	}
+	// Along the axis every point of the disk is a support point, and the radial part is
+	// only rounding noise that can point anywhere
+	double radial_norm = radial.norm();
+	return 1e-9 * direction.norm() < radial_norm ? center + radial * (radius / radial_norm)
+	                                             : center;
+}
+
+Point support(const Cone& cone, const Point& direction)
+{
+	Point base = supportDisk(cone.end, cone.end - cone.start, cone.radius, direction);
+	return Point::dot(cone.start, direction) > Point::dot(base, direction) ? cone.start
+	                                                                        : base;
+}
+
+Point support(const Cylinder& cylinder, const Point& direction)
+{
+	Point axis = cylinder.end - cylinder.start;
+	Point const& center = Point::dot(axis, direction) < 0.0 ? cylinder.start : cylinder.end;
+	return supportDisk(center, axis, cylinder.radius, direction);
+}
+
+Point support(const Ellipsoid& ellipsoid, const Point& direction)
+{
+	Point scaled(ellipsoid.radius.x() * direction.x(), ellipsoid.radius.y() * direction.y(),
+	             ellipsoid.radius.z() * direction.z());
+	double scaled_norm = scaled.norm();
+	if (0.0 == scaled_norm) {
+		return ellipsoid.center;
+	}
+	return ellipsoid.center + Point(ellipsoid.radius.x() * scaled.x(),
+	                                ellipsoid.radius.y() * scaled.y(),
+	                                ellipsoid.radius.z() * scaled.z()) /
+	                              scaled_norm;
+}
+
+Point support(const LineSegment& line_segment, const Point& direction)
+{
+	return Point::dot(line_segment.end - line_segment.start, direction) < 0.0
+	           ? line_segment.start
+	           : line_segment.end;
+}
+
+Point support(const OBB& obb, const Point& direction)
+{
+	// The OBB axes are the rows of the rotation matrix, as in the SAT tests above
+	Point local = obb.rotation.rotate(direction);
+	Point corner(std::copysign(obb.half_size.x(), local.x()),
+	             std::copysign(obb.half_size.y(), local.y()),
+	             std::copysign(obb.half_size.z(), local.z()));
+	return obb.center + obb.rotation.inversed().rotate(corner);
+}
+
+Point support(const Point& point, const Point& /*direction*/) { return point; }
+
+Point support(const Sphere& sphere, const Point& /*direction*/) { return sphere.center; }
+
+Point support(const Triangle& triangle, const Point& direction)
+{
+	double dot_0 = Point::dot(triangle.points[0], direction);
+	double dot_1 = Point::dot(triangle.points[1], direction);
+	double dot_2 = Point::dot(triangle.points[2], direction);
+	if (dot_0 >= dot_1 && dot_0 >= dot_2) {
+		return triangle.points[0];
+	}
+	return dot_1 >= dot_2 ? triangle.points[1] : triangle.points[2];
+}
+
+// A frustum only stores its planes, GJK needs its corners
+struct FrustumCorners {
+	std::array<Point, 8> corners;
+};
+
+// The point where three planes meet
+Point planesIntersection(const Plane& plane_1, const Plane& plane_2, const Plane& plane_3)
+{
+	Point cross_23 = Point::cross(plane_2.normal, plane_3.normal);
+	Point cross_31 = Point::cross(plane_3.normal, plane_1.normal);
+	Point cross_12 = Point::cross(plane_1.normal, plane_2.normal);
+	return (cross_23 * -plane_1.distance + cross_31 * -plane_2.distance +
+	        cross_12 * -plane_3.distance) /
+	       Point::dot(plane_1.normal, cross_23);
+}
+
+FrustumCorners frustumCorners(const Frustum& frustum)
+{
+	FrustumCorners corners;
+	for (int i = 0; i < 8; ++i) {
+		corners.corners[i] =
+		    planesIntersection((i & 1) ? frustum.bottom() : frustum.top(),
+		                       (i & 2) ? frustum.right() : frustum.left(),
+		                       (i & 4) ? frustum.far() : frustum.near());
+	}
+	return corners;
+}
+
+Point support(const FrustumCorners& frustum, const Point& direction)
+{
+	Point const* best = &frustum.corners[0];
+	double best_dot = Point::dot(*best, direction);
+	for (int i = 1; i < 8; ++i) {
+		double dot = Point::dot(frustum.corners[i], direction);
+		if (dot > best_dot) {
+			best_dot = dot;
+			best = &frustum.corners[i];
+		}
+	}
+	return *best;
+}
+
+template <class T>
+double margin(const T& /*shape*/)
+{
+	return 0.0;
+}
+
+double margin(const Capsule& capsule) { return capsule.radius; }
+
+double margin(const Sphere& sphere) { return sphere.radius; }
+
+//
+// GJK
+//
+
+// Closest point to the origin on the simplex, which is reduced to the smallest face
+// containing that point. A tetrahedron is only kept if it contains the origin.
+
+Point closestToOriginSegment(Point simplex[4], int& size)
+{
+	Point a = simplex[0];
+	Point ab = simplex[1] - a;
+	double t = -Point::dot(a, ab);
+	if (0.0 >= t) {
+		size = 1;
+		return a;
+	}
+	double ab_squared = ab.squaredNorm();
+	if (t >= ab_squared) {
+		simplex[0] = simplex[1];
+		size = 1;
+		return simplex[0];
+	}
+	return a + ab * (t / ab_squared);
+}
+
+Point closestToOriginTriangle(Point simplex[4], int& size)
+{
+	// Voronoi regions of the triangle, see Ericson, Real-Time Collision Detection 5.1.5
+	Point a = simplex[0];
+	Point b = simplex[1];
+	Point c = simplex[2];
+	Point ab = b - a;
+	Point ac = c - a;
+
+	double d_1 = -Point::dot(ab, a);
+	double d_2 = -Point::dot(ac, a);
+	if (0.0 >= d_1 && 0.0 >= d_2) {
+		size = 1;
+		return a;
+	}
+
+	double d_3 = -Point::dot(ab, b);
+	double d_4 = -Point::dot(ac, b);
+	if (0.0 <= d_3 && d_4 <= d_3) {
+		simplex[0] = b;
+		size = 1;
+		return b;
+	}
+
+	double v_c = d_1 * d_4 - d_3 * d_2;
+	if (0.0 >= v_c && 0.0 <= d_1 && 0.0 >= d_3) {
+		size = 2;
+		return a + ab * (d_1 / (d_1 - d_3));
+	}
+
+	double d_5 = -Point::dot(ab, c);
+	double d_6 = -Point::dot(ac, c);
+	if (0.0 <= d_6 && d_5 <= d_6) {
+		simplex[0] = c;
+		size = 1;
+		return c;
+	}
+
+	double v_b = d_5 * d_2 - d_1 * d_6;
+	if (0.0 >= v_b && 0.0 <= d_2 && 0.0 >= d_6) {
+		simplex[1] = c;
+		size = 2;
+		return a + ac * (d_2 / (d_2 - d_6));
+	}
+
+	double v_a = d_3 * d_6 - d_5 * d_4;
+	if (0.0 >= v_a && 0.0 <= d_4 - d_3 && 0.0 <= d_5 - d_6) {
+		simplex[0] = c;
+		size = 2;
+		return b + (c - b) * ((d_4 - d_3) / ((d_4 - d_3) + (d_5 - d_6)));
+	}
+
+	double denominator = v_a + v_b + v_c;
+	if (0.0 >= denominator) {
+		// Degenerate triangle, the closest point is on one of its edges
+		Point edges[3][4] = {{a, b}, {b, c}, {c, a}};
+		Point closest;
+		double closest_squared = std::numeric_limits<double>::infinity();
+		for (auto& edge : edges) {
+			int edge_size = 2;
+			Point p = closestToOriginSegment(edge, edge_size);
+			if (p.squaredNorm() < closest_squared) {
+				closest_squared = p.squaredNorm();
+				closest = p;
+				std::copy(edge, edge + edge_size, simplex);
+				size = edge_size;
+			}
+		}
+		return closest;
+	}
+	return a + ab * (v_b / denominator) + ac * (v_c / denominator);
+}
+
+Point closestToOriginTetrahedron(Point simplex[4], int& size)
+{
+	// Faces with the vertex opposite to them, see Ericson 5.1.6
+	constexpr int faces[4][4] = {{0, 1, 2, 3}, {0, 2, 3, 1}, {0, 3, 1, 2}, {1, 3, 2, 0}};
+
+	Point closest;
+	double closest_squared = std::numeric_limits<double>::infinity();
+	Point best[4];
+	int best_size = 4;
+	for (auto const& face : faces) {
+		Point a = simplex[face[0]];
+		Point normal = Point::cross(simplex[face[1]] - a, simplex[face[2]] - a);
+		Point opposite = simplex[face[3]] - a;
+		double origin_side = -Point::dot(a, normal);
+		double opposite_side = Point::dot(opposite, normal);
+		// A (nearly) flat tetrahedron has no inside, so all of its faces are checked
+		bool flat = opposite_side * opposite_side <=
+		            1e-18 * normal.squaredNorm() * opposite.squaredNorm();
+		if (flat || 0.0 > origin_side * opposite_side) {
+			Point triangle[4] = {a, simplex[face[1]], simplex[face[2]]};
+			int triangle_size = 3;
+			Point p = closestToOriginTriangle(triangle, triangle_size);
+			if (p.squaredNorm() < closest_squared) {
+				closest_squared = p.squaredNorm();
+				closest = p;
+				std::copy(triangle, triangle + triangle_size, best);
+				best_size = triangle_size;
+			}
+		}
+	}
+
+	if (4 == best_size) {
+		return Point(0.0, 0.0, 0.0);
+	}
+	std::copy(best, best + best_size, simplex);
+	size = best_size;
+	return closest;
+}
+
+Point closestToOrigin(Point simplex[4], int& size)
+{
+	switch (size) {
+		case 1:
+			return simplex[0];
+		case 2:
+			return closestToOriginSegment(simplex, size);
+		case 3:
+			return closestToOriginTriangle(simplex, size);
+		default:
+			return closestToOriginTetrahedron(simplex, size);
+	}
+}
+
+// Whether the distance between two convex shapes is at most the sum of their margins
+template <class T1, class T2>
+bool intersectsConvex(const T1& shape_1, const T2& shape_2)
+{
+	constexpr int max_iterations = 64;
+
+	double radius = margin(shape_1) + margin(shape_2) + TOUCHING_TOLERANCE;
+	double radius_squared = radius * radius;
+
+	Point direction(1.0, 0.0, 0.0);
+	Point v = support(shape_1, direction) - support(shape_2, -direction);
+	Point simplex[4] = {v};
+	int size = 1;
+	for (int i = 0; i < max_iterations; ++i) {
+		double v_squared = v.squaredNorm();
+		if (v_squared <= radius_squared) {
+			return true;
+		}
+
+		Point w = support(shape_1, -v) - support(shape_2, v);
+		double v_dot_w = Point::dot(v, w);
+		// v.w / |v| is a lower bound on the distance between the shapes
+		if (0.0 < v_dot_w && v_dot_w * v_dot_w > radius_squared * v_squared) {
+			return false;
+		}
+		// No support point is closer to the origin than v is
+		if (v_squared - v_dot_w <= 1e-12 * v_squared) {
+			return false;
+		}
+
+		simplex[size++] = w;
+		v = closestToOrigin(simplex, size);
+		// No progress means the shapes touch and v is stuck at rounding noise, which for
+		// large shapes can be above the tolerance
+		if (4 == size || v.squaredNorm() >= v_squared) {
+			return true;
+		}
+	}
+	// Nothing separates the shapes
+	return true;
+}
+
+// Whether the plane lies between the extreme points of the shape along its normal
+template <class T>
+bool intersectsConvex(const Plane& plane, const T& shape)
+{
+	double max = Point::dot(plane.normal, support(shape, plane.normal)) + margin(shape);
+	double min = Point::dot(plane.normal, support(shape, -plane.normal)) - margin(shape);
+	return min <= plane.distance && plane.distance <= max;
+}
+
+// The ray is clipped to the bounds of the convex shape and tested as a line segment
+template <class T>
+bool intersectsConvex(const Ray& ray, const T& shape)
+{
+	Point min;
+	Point max;
+	for (int i = 0; i < 3; ++i) {
+		Point axis(0.0, 0.0, 0.0);
+		axis[i] = 1.0;
+		min[i] = support(shape, -axis)[i] - margin(shape);
+		max[i] = support(shape, axis)[i] + margin(shape);
+	}
+
+	double t_near = 0.0;
+	double t_far = std::numeric_limits<double>::infinity();
+	for (int i = 0; i < 3; ++i) {
+		if (0 != ray.direction[i]) {
+			double t_1 = (min[i] - ray.origin[i]) / ray.direction[i];
+			double t_2 = (max[i] - ray.origin[i]) / ray.direction[i];
+			t_near = std::max(t_near, std::min(t_1, t_2));
+			t_far = std::min(t_far, std::max(t_1, t_2));
+			if (t_near > t_far) {
+				return false;
+			}
+		} else if (min[i] > ray.origin[i] || max[i] < ray.origin[i]) {
+			return false;
+		}
+	}
+
+	LineSegment clipped(ray.origin + ray.direction * t_near,
+	                    ray.origin + ray.direction * t_far);
+	return intersectsConvex(clipped, shape);
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////// Intersection tests
 //////////////////////////////////////
@@ -263,9 +660,25 @@ bool intersects(const AABB& aabb_1, const AABB& aabb_2)
 	       min_2.x() <= max_1.x() && min_2.y() <= max_1.y() && min_2.z() <= max_1.z();
 }
 
-// bool intersects(const AABB& aabb, const Capsule& capsule)
-// {
-// }
+bool intersects(const AABB& aabb, const Capsule& capsule)
+{
+	return intersectsConvex(aabb, capsule);
+}
+
+bool intersects(const AABB& aabb, const Cone& cone)
+{
+	return intersectsConvex(aabb, cone);
+}
+
+bool intersects(const AABB& aabb, const Cylinder& cylinder)
+{
+	return intersectsConvex(aabb, cylinder);
+}
+
+bool intersects(const AABB& aabb, const Ellipsoid& ellipsoid)
+{
+	return intersectsConvex(aabb, ellipsoid);
+}
 
 bool intersects(const AABB& aabb, const Frustum& frustum)
 {
@@ -354,12 +767,326 @@ bool intersects(const AABB& aabb, const Sphere& sphere)
 	return distance_squared < radius_squared;
 }
 
+bool intersects(const AABB& aabb, const Triangle& triangle)
+{
+	// Separating axis test, see Akenine-Moller, Fast 3D Triangle-Box Overlap Testing
+	Point const& half_size = aabb.half_size;
+	Point v[3] = {triangle.points[0] - aabb.center, triangle.points[1] - aabb.center,
+	              triangle.points[2] - aabb.center};
+
+	// The AABB axes
+	for (int i = 0; i < 3; ++i) {
+		double r = half_size[i] + TOUCHING_TOLERANCE;
+		if (std::min({v[0][i], v[1][i], v[2][i]}) > r ||
+		    std::max({v[0][i], v[1][i], v[2][i]}) < -r) {
+			return false;
+		}
+	}
+
+	// The triangle normal and the cross products of the edges with the AABB axes
+	Point edges[3] = {v[1] - v[0], v[2] - v[1], v[0] - v[2]};
+	Point axes[10] = {Point::cross(edges[0], edges[1])};
+	for (int i = 0; i < 3; ++i) {
+		axes[1 + i * 3 + 0] = Point(0.0, -edges[i].z(), edges[i].y());
+		axes[1 + i * 3 + 1] = Point(edges[i].z(), 0.0, -edges[i].x());
+		axes[1 + i * 3 + 2] = Point(-edges[i].y(), edges[i].x(), 0.0);
+	}
+
+	for (Point const& axis : axes) {
+		double p_0 = Point::dot(axis, v[0]);
+		double p_1 = Point::dot(axis, v[1]);
+		double p_2 = Point::dot(axis, v[2]);
+		double r = half_size.x() * std::abs(axis.x()) + half_size.y() * std::abs(axis.y()) +
+		           half_size.z() * std::abs(axis.z()) + TOUCHING_TOLERANCE * axis.norm();
+		if (std::min({p_0, p_1, p_2}) > r || std::max({p_0, p_1, p_2}) < -r) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Capsule
+bool intersects(const Capsule& capsule, const AABB& aabb)
+{
+	return intersects(aabb, capsule);
+}
+
+bool intersects(const Capsule& capsule_1, const Capsule& capsule_2)
+{
+	return intersectsConvex(capsule_1, capsule_2);
+}
+
+bool intersects(const Capsule& capsule, const Cone& cone)
+{
+	return intersectsConvex(capsule, cone);
+}
+
+bool intersects(const Capsule& capsule, const Cylinder& cylinder)
+{
+	return intersectsConvex(capsule, cylinder);
+}
+
+bool intersects(const Capsule& capsule, const Ellipsoid& ellipsoid)
+{
+	return intersectsConvex(capsule, ellipsoid);
+}
+
+bool intersects(const Capsule& capsule, const Frustum& frustum)
+{
+	return intersectsConvex(capsule, frustumCorners(frustum));
+}
+
+bool intersects(const Capsule& capsule, const LineSegment& line_segment)
+{
+	return intersectsConvex(capsule, line_segment);
+}
+
+bool intersects(const Capsule& capsule, const OBB& obb)
+{
+	return intersectsConvex(capsule, obb);
+}
+
+bool intersects(const Capsule& capsule, const Plane& plane)
+{
+	return intersectsConvex(plane, capsule);
+}
+
+bool intersects(const Capsule& capsule, const Point& point)
+{
+	return intersectsConvex(capsule, point);
+}
+
+bool intersects(const Capsule& capsule, const Ray& ray)
+{
+	return intersectsConvex(ray, capsule);
+}
+
+bool intersects(const Capsule& capsule, const Sphere& sphere)
+{
+	return intersectsConvex(capsule, sphere);
+}
+
+bool intersects(const Capsule& capsule, const Triangle& triangle)
+{
+	return intersectsConvex(capsule, triangle);
+}
+
+// Cone
+bool intersects(const Cone& cone, const AABB& aabb) { return intersects(aabb, cone); }
+
+bool intersects(const Cone& cone, const Capsule& capsule)
+{
+	return intersects(capsule, cone);
+}
+
+bool intersects(const Cone& cone_1, const Cone& cone_2)
+{
+	return intersectsConvex(cone_1, cone_2);
+}
+
+bool intersects(const Cone& cone, const Cylinder& cylinder)
+{
+	return intersectsConvex(cone, cylinder);
+}
+
+bool intersects(const Cone& cone, const Ellipsoid& ellipsoid)
+{
+	return intersectsConvex(cone, ellipsoid);
+}
+
+bool intersects(const Cone& cone, const Frustum& frustum)
+{
+	return intersectsConvex(cone, frustumCorners(frustum));
+}
+
+bool intersects(const Cone& cone, const LineSegment& line_segment)
+{
+	return intersectsConvex(cone, line_segment);
+}
+
+bool intersects(const Cone& cone, const OBB& obb) { return intersectsConvex(cone, obb); }
+
+bool intersects(const Cone& cone, const Plane& plane)
+{
+	return intersectsConvex(plane, cone);
+}
+
+bool intersects(const Cone& cone, const Point& point)
+{
+	return intersectsConvex(cone, point);
+}
+
+bool intersects(const Cone& cone, const Ray& ray) { return intersectsConvex(ray, cone); }
+
+bool intersects(const Cone& cone, const Sphere& sphere)
+{
+	return intersectsConvex(cone, sphere);
+}
+
+bool intersects(const Cone& cone, const Triangle& triangle)
+{
+	return intersectsConvex(cone, triangle);
+}
+
+// Cylinder
+bool intersects(const Cylinder& cylinder, const AABB& aabb)
+{
+	return intersects(aabb, cylinder);
+}
+
+bool intersects(const Cylinder& cylinder, const Capsule& capsule)
+{
+	return intersects(capsule, cylinder);
+}
+
+bool intersects(const Cylinder& cylinder, const Cone& cone)
+{
+	return intersects(cone, cylinder);
+}
+
+bool intersects(const Cylinder& cylinder_1, const Cylinder& cylinder_2)
+{
+	return intersectsConvex(cylinder_1, cylinder_2);
+}
+
+bool intersects(const Cylinder& cylinder, const Ellipsoid& ellipsoid)
+{
+	return intersectsConvex(cylinder, ellipsoid);
+}
+
+bool intersects(const Cylinder& cylinder, const Frustum& frustum)
+{
+	return intersectsConvex(cylinder, frustumCorners(frustum));
+}
+
+bool intersects(const Cylinder& cylinder, const LineSegment& line_segment)
+{
+	return intersectsConvex(cylinder, line_segment);
+}
+
+bool intersects(const Cylinder& cylinder, const OBB& obb)
+{
+	return intersectsConvex(cylinder, obb);
+}
+
+bool intersects(const Cylinder& cylinder, const Plane& plane)
+{
+	return intersectsConvex(plane, cylinder);
+}
+
+bool intersects(const Cylinder& cylinder, const Point& point)
+{
+	return intersectsConvex(cylinder, point);
+}
+
+bool intersects(const Cylinder& cylinder, const Ray& ray)
+{
+	return intersectsConvex(ray, cylinder);
+}
+
+bool intersects(const Cylinder& cylinder, const Sphere& sphere)
+{
+	return intersectsConvex(cylinder, sphere);
+}
+
+bool intersects(const Cylinder& cylinder, const Triangle& triangle)
+{
+	return intersectsConvex(cylinder, triangle);
+}
+
+// Ellipsoid
+bool intersects(const Ellipsoid& ellipsoid, const AABB& aabb)
+{
+	return intersects(aabb, ellipsoid);
+}
+
+bool intersects(const Ellipsoid& ellipsoid, const Capsule& capsule)
+{
+	return intersects(capsule, ellipsoid);
+}
+
+bool intersects(const Ellipsoid& ellipsoid, const Cone& cone)
+{
+	return intersects(cone, ellipsoid);
+}
+
+bool intersects(const Ellipsoid& ellipsoid, const Cylinder& cylinder)
+{
+	return intersects(cylinder, ellipsoid);
+}
+
+bool intersects(const Ellipsoid& ellipsoid_1, const Ellipsoid& ellipsoid_2)
+{
+	return intersectsConvex(ellipsoid_1, ellipsoid_2);
+}
+
+bool intersects(const Ellipsoid& ellipsoid, const Frustum& frustum)
+{
+	return intersectsConvex(ellipsoid, frustumCorners(frustum));
+}
+
+bool intersects(const Ellipsoid& ellipsoid, const LineSegment& line_segment)
+{
+	return intersectsConvex(ellipsoid, line_segment);
+}
+
+bool intersects(const Ellipsoid& ellipsoid, const OBB& obb)
+{
+	return intersectsConvex(ellipsoid, obb);
+}
+
+bool intersects(const Ellipsoid& ellipsoid, const Plane& plane)
+{
+	return intersectsConvex(plane, ellipsoid);
+}
+
+bool intersects(const Ellipsoid& ellipsoid, const Point& point)
+{
+	return intersectsConvex(ellipsoid, point);
+}
+
+bool intersects(const Ellipsoid& ellipsoid, const Ray& ray)
+{
+	return intersectsConvex(ray, ellipsoid);
+}
+
+bool intersects(const Ellipsoid& ellipsoid, const Sphere& sphere)
+{
+	return intersectsConvex(ellipsoid, sphere);
+}
+
+bool intersects(const Ellipsoid& ellipsoid, const Triangle& triangle)
+{
+	return intersectsConvex(ellipsoid, triangle);
+}
+
 // Frustum
 bool intersects(const Frustum& frustum, const AABB& aabb)
 {
 	return intersects(aabb, frustum);
 }
 
+bool intersects(const Frustum& frustum, const Capsule& capsule)
+{
+	return intersects(capsule, frustum);
+}
+
+bool intersects(const Frustum& frustum, const Cone& cone)
+{
+	return intersects(cone, frustum);
+}
+
+bool intersects(const Frustum& frustum, const Cylinder& cylinder)
+{
+	return intersects(cylinder, frustum);
+}
+
+bool intersects(const Frustum& frustum, const Ellipsoid& ellipsoid)
+{
+	return intersects(ellipsoid, frustum);
+}
+
 bool intersects(const Frustum& frustum_1, const Frustum& frustum_2)
 {
 	throw std::logic_error("Function not yet implemented");
@@ -414,12 +1141,37 @@ bool intersects(const Frustum& frustum, const Sphere& sphere)
 	return true;
 }
 
+bool intersects(const Frustum& frustum, const Triangle& triangle)
+{
+	return intersectsConvex(frustumCorners(frustum), triangle);
+}
+
 // Line segment
 bool intersects(const LineSegment& line_segment, const AABB& aabb)
 {
 	return intersects(aabb, line_segment);
 }
 
+bool intersects(const LineSegment& line_segment, const Capsule& capsule)
+{
+	return intersects(capsule, line_segment);
+}
+
+bool intersects(const LineSegment& line_segment, const Cone& cone)
+{
+	return intersects(cone, line_segment);
+}
+
+bool intersects(const LineSegment& line_segment, const Cylinder& cylinder)
+{
+	return intersects(cylinder, line_segment);
+}
+
+bool intersects(const LineSegment& line_segment, const Ellipsoid& ellipsoid)
+{
+	return intersects(ellipsoid, line_segment);
+}
+
 bool intersects(const LineSegment& line_segment, const Frustum& frustum)
 {
 	return intersects(frustum, line_segment);
@@ -528,9 +1280,31 @@ bool intersects(const LineSegment& line_segment, const Sphere& sphere)
 	return distance_squared <= (sphere.radius * sphere.radius);
 }
 
+bool intersects(const LineSegment& line_segment, const Triangle& triangle)
+{
+	return intersectsConvex(line_segment, triangle);
+}
+
 // OBB
 bool intersects(const OBB& obb, const AABB& aabb) { return intersects(aabb, obb); }
 
+bool intersects(const OBB& obb, const Capsule& capsule)
+{
+	return intersects(capsule, obb);
+}
+
+bool intersects(const OBB& obb, const Cone& cone) { return intersects(cone, obb); }
+
+bool intersects(const OBB& obb, const Cylinder& cylinder)
+{
+	return intersects(cylinder, obb);
+}
+
+bool intersects(const OBB& obb, const Ellipsoid& ellipsoid)
+{
+	return intersects(ellipsoid, obb);
+}
+
 bool intersects(const OBB& obb, const Frustum& frustum)
 {
 	return intersects(frustum, obb);
@@ -662,9 +1436,31 @@ bool intersects(const OBB& obb, const Sphere& sphere)
 	return distance_squared < sphere.radius * sphere.radius;
 }
 
+bool intersects(const OBB& obb, const Triangle& triangle)
+{
+	return intersectsConvex(obb, triangle);
+}
+
 // Plane
 bool intersects(const Plane& plane, const AABB& aabb) { return intersects(aabb, plane); }
 
+bool intersects(const Plane& plane, const Capsule& capsule)
+{
+	return intersects(capsule, plane);
+}
+
+bool intersects(const Plane& plane, const Cone& cone) { return intersects(cone, plane); }
+
+bool intersects(const Plane& plane, const Cylinder& cylinder)
+{
+	return intersects(cylinder, plane);
+}
+
+bool intersects(const Plane& plane, const Ellipsoid& ellipsoid)
+{
+	return intersects(ellipsoid, plane);
+}
+
 bool intersects(const Plane& plane, const Frustum& frustum)
 {
 	return intersects(frustum, plane);
@@ -706,9 +1502,31 @@ bool intersects(const Plane& plane, const Sphere& sphere)
 	return distance_squared < sphere.radius * sphere.radius;
 }
 
+bool intersects(const Plane& plane, const Triangle& triangle)
+{
+	return intersectsConvex(plane, triangle);
+}
+
 // Point
 bool intersects(const Point& point, const AABB& aabb) { return intersects(aabb, point); }
 
+bool intersects(const Point& point, const Capsule& capsule)
+{
+	return intersects(capsule, point);
+}
+
+bool intersects(const Point& point, const Cone& cone) { return intersects(cone, point); }
+
+bool intersects(const Point& point, const Cylinder& cylinder)
+{
+	return intersects(cylinder, point);
+}
+
+bool intersects(const Point& point, const Ellipsoid& ellipsoid)
+{
+	return intersects(ellipsoid, point);
+}
+
 bool intersects(const Point& point, const Frustum& frustum)
 {
 	return intersects(frustum, point);
@@ -746,9 +1564,31 @@ bool intersects(const Point& point, const Sphere& sphere)
 	return (point - sphere.center).squaredNorm() < sphere.radius * sphere.radius;
 }
 
+bool intersects(const Point& point, const Triangle& triangle)
+{
+	return intersectsConvex(point, triangle);
+}
+
 // Ray
 bool intersects(const Ray& ray, const AABB& aabb) { return intersects(aabb, ray); }
 
+bool intersects(const Ray& ray, const Capsule& capsule)
+{
+	return intersects(capsule, ray);
+}
+
+bool intersects(const Ray& ray, const Cone& cone) { return intersects(cone, ray); }
+
+bool intersects(const Ray& ray, const Cylinder& cylinder)
+{
+	return intersects(cylinder, ray);
+}
+
+bool intersects(const Ray& ray, const Ellipsoid& ellipsoid)
+{
+	return intersects(ellipsoid, ray);
+}
+
 bool intersects(const Ray& ray, const Frustum& frustum)
 {
 	return intersects(frustum, ray);
@@ -780,12 +1620,37 @@ bool intersects(const Ray& ray, const Sphere& sphere)
 	return rSq - (eSq - a * a) >= 0.0;
 }
 
+bool intersects(const Ray& ray, const Triangle& triangle)
+{
+	return intersectsConvex(ray, triangle);
+}
+
 // Sphere
 bool intersects(const Sphere& sphere, const AABB& aabb)
 {
 	return intersects(aabb, sphere);
 }
 
+bool intersects(const Sphere& sphere, const Capsule& capsule)
+{
+	return intersects(capsule, sphere);
+}
+
+bool intersects(const Sphere& sphere, const Cone& cone)
+{
+	return intersects(cone, sphere);
+}
+
+bool intersects(const Sphere& sphere, const Cylinder& cylinder)
+{
+	return intersects(cylinder, sphere);
+}
+
+bool intersects(const Sphere& sphere, const Ellipsoid& ellipsoid)
+{
+	return intersects(ellipsoid, sphere);
+}
+
 bool intersects(const Sphere& sphere, const Frustum& frustum)
 {
 	return intersects(frustum, sphere);
@@ -817,9 +1682,315 @@ bool intersects(const Sphere& sphere_1, const Sphere& sphere_2)
 	return distance_squared < radius_sum * radius_sum;
 }
 
+bool intersects(const Sphere& sphere, const Triangle& triangle)
+{
+	return intersectsConvex(sphere, triangle);
+}
+
+// Triangle
+bool intersects(const Triangle& triangle, const AABB& aabb)
+{
+	return intersects(aabb, triangle);
+}
+
+bool intersects(const Triangle& triangle, const Capsule& capsule)
+{
+	return intersects(capsule, triangle);
+}
+
+bool intersects(const Triangle& triangle, const Cone& cone)
+{
+	return intersects(cone, triangle);
+}
+
+bool intersects(const Triangle& triangle, const Cylinder& cylinder)
+{
+	return intersects(cylinder, triangle);
+}
+
+bool intersects(const Triangle& triangle, const Ellipsoid& ellipsoid)
+{
+	return intersects(ellipsoid, triangle);
+}
+
+bool intersects(const Triangle& triangle, const Frustum& frustum)
+{
+	return intersects(frustum, triangle);
+}
+
+bool intersects(const Triangle& triangle, const LineSegment& line_segment)
+{
+	return intersects(line_segment, triangle);
+}
+
+bool intersects(const Triangle& triangle, const OBB& obb)
+{
+	return intersects(obb, triangle);
+}
+
+bool intersects(const Triangle& triangle, const Plane& plane)
+{
+	return intersects(plane, triangle);
+}
+
+bool intersects(const Triangle& triangle, const Point& point)
+{
+	return intersects(point, triangle);
+}
+
+bool intersects(const Triangle& triangle, const Ray& ray)
+{
+	return intersects(ray, triangle);
+}
+
+bool intersects(const Triangle& triangle, const Sphere& sphere)
+{
+	return intersects(sphere, triangle);
+}
+
+bool intersects(const Triangle& triangle_1, const Triangle& triangle_2)
+{
+	return intersectsConvex(triangle_1, triangle_2);
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////// Inside tests
 /////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////
 
+/////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////// Children tests
+//////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+// Every test below is separable. Child i is offset from the parent center by -offset or
+// offset along x, y and z, given by bit 0, 1 and 2 of i, so the per axis terms are
+// computed once and combined for all eight children.
+
+#if defined(UFO_GEOMETRY_CHILDREN_AVX2)
+bool hasAvx2() noexcept
+{
+	static bool const avx2 = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+	return avx2;
+}
+
+__attribute__((target("avx2"))) ChildrenMask overlapChildrenOnAxisAvx2(
+    double projection, const Point& offset, double radius, double min, double max)
+{
+	__m256d xy = _mm256_add_pd(
+	    _mm256_set1_pd(projection),
+	    _mm256_setr_pd(-offset.x(), offset.x(), -offset.x(), offset.x()));
+	xy = _mm256_add_pd(xy,
+	                   _mm256_setr_pd(-offset.y(), -offset.y(), offset.y(), offset.y()));
+	__m256d const z = _mm256_set1_pd(offset.z());
+	__m256d const projections[2] = {_mm256_sub_pd(xy, z), _mm256_add_pd(xy, z)};
+
+	__m256d const r = _mm256_set1_pd(radius);
+	__m256d const lower = _mm256_set1_pd(min);
+	__m256d const upper = _mm256_set1_pd(max);
+	ChildrenMask mask;
+	for (int i = 0; i < 2; ++i) {
+		__m256d const child_min = _mm256_sub_pd(projections[i], r);
+		__m256d const child_max = _mm256_add_pd(projections[i], r);
+		int const overlap =
+		    _mm256_movemask_pd(_mm256_and_pd(_mm256_cmp_pd(child_min, upper, _CMP_LE_OQ),
+		                                     _mm256_cmp_pd(lower, child_max, _CMP_LE_OQ)));
+		int const contained =
+		    _mm256_movemask_pd(_mm256_and_pd(_mm256_cmp_pd(lower, child_min, _CMP_LE_OQ),
+		                                     _mm256_cmp_pd(child_max, upper, _CMP_LE_OQ)));
+		mask.intersects |= overlap << (4 * i);
+		mask.inside |= contained << (4 * i);
+	}
+	return mask;
+}
+
+__attribute__((target("avx2"))) ChildrenMask sumChildrenAvx2(
+    const double (&near)[3][2], const double (&far)[3][2], double radius_squared)
+{
+	__m256d const r = _mm256_set1_pd(radius_squared);
+	__m256d const near_xy =
+	    _mm256_add_pd(_mm256_setr_pd(near[0][0], near[0][1], near[0][0], near[0][1]),
+	                  _mm256_setr_pd(near[1][0], near[1][0], near[1][1], near[1][1]));
+	__m256d const far_xy =
+	    _mm256_add_pd(_mm256_setr_pd(far[0][0], far[0][1], far[0][0], far[0][1]),
+	                  _mm256_setr_pd(far[1][0], far[1][0], far[1][1], far[1][1]));
+	ChildrenMask mask;
+	for (int i = 0; i < 2; ++i) {
+		__m256d const near_sum = _mm256_add_pd(near_xy, _mm256_set1_pd(near[2][i]));
+		__m256d const far_sum = _mm256_add_pd(far_xy, _mm256_set1_pd(far[2][i]));
+		mask.intersects |= _mm256_movemask_pd(_mm256_cmp_pd(near_sum, r, _CMP_LT_OQ))
+		                   << (4 * i);
+		mask.inside |= _mm256_movemask_pd(_mm256_cmp_pd(far_sum, r, _CMP_LE_OQ)) << (4 * i);
+	}
+	return mask;
+}
+#endif
+
+// Which children overlap, and which are contained in, [min, max] along an axis. The
+// children project to projection +- offset.x() +- offset.y() +- offset.z() with radius.
+ChildrenMask overlapChildrenOnAxis(double projection, const Point& offset, double radius,
+                                   double min, double max)
+{
+#if defined(UFO_GEOMETRY_CHILDREN_AVX2)
+	if (hasAvx2()) {
+		return overlapChildrenOnAxisAvx2(projection, offset, radius, min, max);
+	}
+#endif
+
+	ChildrenMask mask;
+	for (unsigned int i = 0; i < 8; ++i) {
+		double child = projection + ((i & 1) ? offset.x() : -offset.x());
+		child += ((i & 2) ? offset.y() : -offset.y());
+		child += ((i & 4) ? offset.z() : -offset.z());
+		double const child_min = child - radius;
+		double const child_max = child + radius;
+		if (child_min <= max && min <= child_max) {
+			mask.intersects |= 1U << i;
+		}
+		if (min <= child_min && child_max <= max) {
+			mask.inside |= 1U << i;
+		}
+	}
+	return mask;
+}
+
+// Which children have near[0] + near[1] + near[2] < radius_squared, and which have
+// far[0] + far[1] + far[2] <= radius_squared, indexed by the child bit of each axis
+ChildrenMask sumChildren(const double (&near)[3][2], const double (&far)[3][2],
+                         double radius_squared)
+{
+#if defined(UFO_GEOMETRY_CHILDREN_AVX2)
+	if (hasAvx2()) {
+		return sumChildrenAvx2(near, far, radius_squared);
+	}
+#endif
+
+	ChildrenMask mask;
+	for (unsigned int i = 0; i < 8; ++i) {
+		unsigned int const x = i & 1;
+		unsigned int const y = (i >> 1) & 1;
+		unsigned int const z = i >> 2;
+		if (near[0][x] + near[1][y] + near[2][z] < radius_squared) {
+			mask.intersects |= 1U << i;
+		}
+		if (far[0][x] + far[1][y] + far[2][z] <= radius_squared) {
+			mask.inside |= 1U << i;
+		}
+	}
+	return mask;
+}
+
+ChildrenMask intersectsChildren(const AABB& aabb, const Point& center,
+                                double child_half_size)
+{
+	Point const min = aabb.getMin();
+	Point const max = aabb.getMax();
+	ChildrenMask mask{0xFF, 0xFF};
+	for (int i = 0; i < 3; ++i) {
+		Point offset;
+		offset[i] = child_half_size;
+		ChildrenMask const axis =
+		    overlapChildrenOnAxis(center[i], offset, child_half_size, min[i], max[i]);
+		mask.intersects &= axis.intersects;
+		mask.inside &= axis.inside;
+	}
+	return mask;
+}
+
+ChildrenMask intersectsChildren(const Frustum& frustum, const Point& center,
+                                double child_half_size)
+{
+	// Same as classify, a child is outside if it is completely behind a plane
+	ChildrenMask mask{0xFF, 0xFF};
+	for (Plane const& plane : frustum.planes) {
+		Point const offset = plane.normal * child_half_size;
+		double const radius =
+		    std::abs(offset.x()) + std::abs(offset.y()) + std::abs(offset.z());
+		ChildrenMask const axis =
+		    overlapChildrenOnAxis(Point::dot(plane.normal, center), offset, radius,
+		                          -plane.distance, std::numeric_limits<double>::infinity());
+		mask.intersects &= axis.intersects;
+		mask.inside &= axis.inside;
+		if (0 == mask.intersects) {
+			break;
+		}
+	}
+	return mask;
+}
+
+ChildrenMask intersectsChildren(const OBB& obb, const Point& center,
+                                double child_half_size)
+{
+	std::vector<double> obb_rot_matrix;
+	obb.rotation.toRotMatrix(obb_rot_matrix);
+
+	// Same axes as intersects(AABB, OBB)
+	Point axes[15] = {Point(1, 0, 0), Point(0, 1, 0), Point(0, 0, 1),
+	                  Point(obb_rot_matrix[0], obb_rot_matrix[1], obb_rot_matrix[2]),
+	                  Point(obb_rot_matrix[3], obb_rot_matrix[4], obb_rot_matrix[5]),
+	                  Point(obb_rot_matrix[6], obb_rot_matrix[7], obb_rot_matrix[8])};
+	for (int i = 0; i < 3; ++i) {
+		axes[6 + i * 3 + 0] = Point::cross(axes[i], axes[3]);
+		axes[6 + i * 3 + 1] = Point::cross(axes[i], axes[4]);
+		axes[6 + i * 3 + 2] = Point::cross(axes[i], axes[5]);
+	}
+
+	// A child is inside the OBB if it is inside along each of the OBB axes
+	ChildrenMask mask{0xFF, 0xFF};
+	for (int i = 0; i < 15; ++i) {
+		Point const& axis = axes[i];
+		double const obb_radius =
+		    obb.half_size.x() * std::abs(Point::dot(axis, axes[3])) +
+		    obb.half_size.y() * std::abs(Point::dot(axis, axes[4])) +
+		    obb.half_size.z() * std::abs(Point::dot(axis, axes[5]));
+		double const obb_center = Point::dot(axis, obb.center);
+		Point const offset = axis * child_half_size;
+		double const radius =
+		    std::abs(offset.x()) + std::abs(offset.y()) + std::abs(offset.z());
+		ChildrenMask const on_axis =
+		    overlapChildrenOnAxis(Point::dot(axis, center), offset, radius,
+		                          obb_center - obb_radius, obb_center + obb_radius);
+		mask.intersects &= on_axis.intersects;
+		if (3 <= i && 6 > i) {
+			mask.inside &= on_axis.inside;
+		}
+		if (0 == mask.intersects) {
+			return ChildrenMask();
+		}
+	}
+	mask.inside &= mask.intersects;
+	return mask;
+}
+
+ChildrenMask intersectsChildren(const Sphere& sphere, const Point& center,
+                                double child_half_size)
+{
+	// Squared distance to the closest and the farthest point of the child along each axis
+	double near[3][2];
+	double far[3][2];
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < 2; ++j) {
+			double const child = center[i] + (j ? child_half_size : -child_half_size);
+			double const min = child - child_half_size;
+			double const max = child + child_half_size;
+			double const distance = sphere.center[i] - std::clamp(sphere.center[i], min, max);
+			double const distance_far =
+			    std::max(std::abs(sphere.center[i] - min), std::abs(sphere.center[i] - max));
+			near[i][j] = distance * distance;
+			far[i][j] = distance_far * distance_far;
+		}
+	}
+	return sumChildren(near, far, sphere.radius * sphere.radius);
+}
+
+ChildrenMask intersectsChildren(const BoundingVar& bounding_volume, const Point& center,
+                                double child_half_size)
+{
+	return std::visit(
+	    [&center, child_half_size](auto&& arg) -> ChildrenMask {
+		    return intersectsChildren(arg, center, child_half_size);
+	    },
+	    bounding_volume);
+}
+
 }  // namespace ufo::geometry
\ No newline at end of file
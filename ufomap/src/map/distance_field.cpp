@@ -0,0 +1,436 @@
+/**
+ * UFOMap: An Efficient Probabilistic 3D Mapping Framework That Embraces the Unknown
+ *
+ * @author D. Duberg, KTH Royal Institute of Technology, Copyright (c) 2020.
+ * @see https://github.com/UnknownFreeOccupied/ufomap
+ * License: BSD 3
+ *
+ */
+
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, D. Duberg, KTH Royal Institute of Technology
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <ufo/map/distance_field.h>
+
+// STD
+#include <algorithm>
+#include <cmath>
+
+namespace ufo::map
+{
+//
+// Constructor
+//
+
+DistanceField::DistanceField(double resolution, KeyType max_value, double max_distance)
+    : resolution_(resolution),
+      resolution_factor_(1.0 / resolution),
+      max_value_(max_value),
+      max_distance_(max_distance),
+      max_squared_distance_(static_cast<std::uint32_t>(
+          std::floor(std::pow(std::max(0.0, max_distance) / resolution, 2))))
+{
+	open_.resize(std::size_t(max_squared_distance_) + 1);
+	open_min_ = open_.size();
+}
+
+//
+// Obstacles
+//
+
+void DistanceField::setObstacle(Key const& key)
+{
+	Index const index{key[0], key[1], key[2]};
+	Cell& cell = createCell(index);
+	if (isObstacle(cell, index)) {
+		return;
+	}
+	cell.obstacle = index;
+	cell.squared_distance = 0;
+	++num_obstacles_;
+	push(0, index);
+}
+
+void DistanceField::removeObstacle(Key const& key)
+{
+	Index const index{key[0], key[1], key[2]};
+	Cell* cell = findCell(index);
+	if (nullptr == cell || !isObstacle(*cell, index)) {
+		return;
+	}
+	*cell = Cell();
+	cell->raise = true;
+	--num_obstacles_;
+	raise_.push_back(pack(index));
+}
+
+void DistanceField::setObstacles(Key const& min, Key const& max)
+{
+	for (KeyType x = min[0]; x <= max[0]; ++x) {
+		for (KeyType y = min[1]; y <= max[1]; ++y) {
+			for (KeyType z = min[2]; z <= max[2]; ++z) {
+				setObstacle(Key(x, y, z, 0));
+			}
+		}
+	}
+}
+
+void DistanceField::removeObstacles(Key const& min, Key const& max)
+{
+	if (0 == num_obstacles_) {
+		return;
+	}
+
+	Index block_min;
+	Index block_max;
+	double num_blocks = 1.0;
+	for (int i : {0, 1, 2}) {
+		block_min[i] = min[i] >> BLOCK_BITS;
+		block_max[i] = max[i] >> BLOCK_BITS;
+		num_blocks *= double(block_max[i] - block_min[i]) + 1.0;
+	}
+
+	auto remove_in_block = [&](Index const& block) {
+		Index first;
+		Index last;
+		for (int i : {0, 1, 2}) {
+			first[i] = std::max(min[i], block[i] << BLOCK_BITS);
+			last[i] = std::min(max[i], (block[i] << BLOCK_BITS) | BLOCK_MASK);
+		}
+		for (KeyType x = first[0]; x <= last[0]; ++x) {
+			for (KeyType y = first[1]; y <= last[1]; ++y) {
+				for (KeyType z = first[2]; z <= last[2]; ++z) {
+					removeObstacle(Key(x, y, z, 0));
+				}
+			}
+		}
+	};
+
+	// Large regions, such as pruned free space, cover far more blocks than are allocated
+	if (num_blocks > double(blocks_.size())) {
+		for (auto const& [packed, block] : blocks_) {
+			Index const b = unpack(packed);
+			if (block_min[0] <= b[0] && b[0] <= block_max[0] && block_min[1] <= b[1] &&
+			    b[1] <= block_max[1] && block_min[2] <= b[2] && b[2] <= block_max[2]) {
+				remove_in_block(b);
+			}
+		}
+	} else {
+		for (KeyType x = block_min[0]; x <= block_max[0]; ++x) {
+			for (KeyType y = block_min[1]; y <= block_max[1]; ++y) {
+				for (KeyType z = block_min[2]; z <= block_max[2]; ++z) {
+					if (blocks_.count(pack({x, y, z}))) {
+						remove_in_block({x, y, z});
+					}
+				}
+			}
+		}
+	}
+}
+
+bool DistanceField::isObstacle(Key const& key) const
+{
+	Index const index{key[0], key[1], key[2]};
+	Cell const* cell = findCell(index);
+	return nullptr != cell && isObstacle(*cell, index);
+}
+
+//
+// Update
+//
+
+void DistanceField::update()
+{
+	// Reset all voxels whose closest obstacle has been removed first, so each voxel
+	// bordering them is only queued once to refill them
+	while (!raise_.empty()) {
+		Index const index = unpack(raise_.back());
+		raise_.pop_back();
+		raise(index, *findCell(index));
+	}
+
+	while (open_min_ < open_.size()) {
+		std::vector<std::uint64_t>& bucket = open_[open_min_];
+		if (bucket.empty()) {
+			++open_min_;
+			continue;
+		}
+		std::uint32_t const squared_distance = static_cast<std::uint32_t>(open_min_);
+		Index const index = unpack(bucket.back());
+		bucket.pop_back();
+
+		// Skip entries superseded by a lower distance
+		Cell& cell = *findCell(index);
+		if (squared_distance == cell.squared_distance && hasValidObstacle(cell)) {
+			cell.queued = false;
+			lower(index, cell);
+		}
+	}
+}
+
+void DistanceField::clear()
+{
+	blocks_.clear();
+	num_obstacles_ = 0;
+	raise_.clear();
+	for (auto& bucket : open_) {
+		bucket.clear();
+	}
+	open_min_ = open_.size();
+}
+
+//
+// Distance
+//
+
+double DistanceField::distance(Point3 const& point) const
+{
+	return interpolate(point, nullptr);
+}
+
+double DistanceField::distance(Point3 const& point, Point3& gradient) const
+{
+	return interpolate(point, &gradient);
+}
+
+//
+// Cells
+//
+
+DistanceField::Cell* DistanceField::findCell(Index const& index)
+{
+	auto it = blocks_.find(blockOf(index));
+	return blocks_.end() == it ? nullptr : &(*it->second)[cellIndex(index)];
+}
+
+DistanceField::Cell const* DistanceField::findCell(Index const& index) const
+{
+	auto it = blocks_.find(blockOf(index));
+	return blocks_.end() == it ? nullptr : &(*it->second)[cellIndex(index)];
+}
+
+DistanceField::Cell& DistanceField::createCell(Index const& index)
+{
+	auto& block = blocks_[blockOf(index)];
+	if (!block) {
+		block = std::make_unique<Block>();
+	}
+	return (*block)[cellIndex(index)];
+}
+
+DistanceField::Block* DistanceField::neighborBlock(Neighborhood& neighborhood,
+                                                   Index const& index,
+                                                   Index const& neighbor, bool create)
+{
+	std::size_t slot = 0;
+	for (int i : {0, 1, 2}) {
+		slot = 3 * slot + 1 + (neighbor[i] >> BLOCK_BITS) - (index[i] >> BLOCK_BITS);
+	}
+	Block*& block = neighborhood.blocks[slot];
+	if (nullptr != block) {
+		return block;
+	}
+	if (create) {
+		auto& created = blocks_[blockOf(neighbor)];
+		if (!created) {
+			created = std::make_unique<Block>();
+		}
+		block = created.get();
+	} else if (!((neighborhood.fetched >> slot) & 1U)) {
+		// Only look up missing blocks once
+		auto it = blocks_.find(blockOf(neighbor));
+		block = blocks_.end() == it ? nullptr : it->second.get();
+		neighborhood.fetched |= std::uint32_t(1) << slot;
+	}
+	return block;
+}
+
+bool DistanceField::hasValidObstacle(Cell const& cell) const
+{
+	if (NO_OBSTACLE == cell.obstacle[0]) {
+		return false;
+	}
+	Cell const* obstacle = findCell(cell.obstacle);
+	return nullptr != obstacle && isObstacle(*obstacle, cell.obstacle);
+}
+
+//
+// Wavefronts
+//
+
+void DistanceField::push(std::uint32_t squared_distance, Index const& index)
+{
+	open_[squared_distance].push_back(pack(index));
+	open_min_ = std::min(open_min_, std::size_t(squared_distance));
+}
+
+void DistanceField::raise(Index const& index, Cell& cell)
+{
+	std::int64_t const size = std::int64_t(2) * max_value_;
+	Neighborhood neighborhood;
+	for (std::int64_t dx = -1; dx <= 1; ++dx) {
+		for (std::int64_t dy = -1; dy <= 1; ++dy) {
+			for (std::int64_t dz = -1; dz <= 1; ++dz) {
+				std::int64_t const x = index[0] + dx;
+				std::int64_t const y = index[1] + dy;
+				std::int64_t const z = index[2] + dz;
+				if ((0 == dx && 0 == dy && 0 == dz) || 0 > x || 0 > y || 0 > z || size <= x ||
+				    size <= y || size <= z) {
+					continue;
+				}
+				Index const neighbor{KeyType(x), KeyType(y), KeyType(z)};
+				Block* block = neighborBlock(neighborhood, index, neighbor, false);
+				if (nullptr == block) {
+					continue;
+				}
+				Cell& n = (*block)[cellIndex(neighbor)];
+				if (NO_OBSTACLE == n.obstacle[0] || n.raise) {
+					continue;
+				}
+				if (hasValidObstacle(n)) {
+					// Refill the raised voxels from the obstacles that remain
+					if (!n.queued) {
+						n.queued = true;
+						push(n.squared_distance, neighbor);
+					}
+				} else {
+					n = Cell();
+					n.raise = true;
+					raise_.push_back(pack(neighbor));
+				}
+			}
+		}
+	}
+	cell.raise = false;
+}
+
+void DistanceField::lower(Index const& index, Cell const& cell)
+{
+	std::int64_t const size = std::int64_t(2) * max_value_;
+	Index const obstacle = cell.obstacle;
+	Neighborhood neighborhood;
+	for (std::int64_t dx = -1; dx <= 1; ++dx) {
+		for (std::int64_t dy = -1; dy <= 1; ++dy) {
+			for (std::int64_t dz = -1; dz <= 1; ++dz) {
+				std::int64_t const x = index[0] + dx;
+				std::int64_t const y = index[1] + dy;
+				std::int64_t const z = index[2] + dz;
+				if ((0 == dx && 0 == dy && 0 == dz) || 0 > x || 0 > y || 0 > z || size <= x ||
+				    size <= y || size <= z) {
+					continue;
+				}
+				std::int64_t const ox = x - obstacle[0];
+				std::int64_t const oy = y - obstacle[1];
+				std::int64_t const oz = z - obstacle[2];
+				std::int64_t const squared_distance = ox * ox + oy * oy + oz * oz;
+				if (squared_distance > std::int64_t(max_squared_distance_)) {
+					continue;
+				}
+				Index const neighbor{KeyType(x), KeyType(y), KeyType(z)};
+				Block& block = *neighborBlock(neighborhood, index, neighbor, true);
+				Cell& n = block[cellIndex(neighbor)];
+				if (!n.raise && squared_distance < n.squared_distance) {
+					n.obstacle = obstacle;
+					n.squared_distance = static_cast<std::uint32_t>(squared_distance);
+					n.queued = true;
+					push(n.squared_distance, neighbor);
+				}
+			}
+		}
+	}
+}
+
+//
+// Interpolation
+//
+
+double DistanceField::cellDistance(std::int64_t x, std::int64_t y, std::int64_t z) const
+{
+	std::int64_t const size = std::int64_t(2) * max_value_;
+	if (0 > x || 0 > y || 0 > z || size <= x || size <= y || size <= z) {
+		return max_distance_;
+	}
+	Cell const* cell = findCell({KeyType(x), KeyType(y), KeyType(z)});
+	if (nullptr == cell || NO_DISTANCE == cell->squared_distance) {
+		return max_distance_;
+	}
+	return std::min(max_distance_, std::sqrt(double(cell->squared_distance)) * resolution_);
+}
+
+double DistanceField::interpolate(Point3 const& point, Point3* gradient) const
+{
+	// Continuous key, the voxel centers are at whole numbers
+	std::array<std::int64_t, 3> base;
+	std::array<double, 3> t;
+	for (int i : {0, 1, 2}) {
+		double const u = point[i] * resolution_factor_ + double(max_value_) - 0.5;
+		double const b = std::floor(u);
+		base[i] = static_cast<std::int64_t>(b);
+		t[i] = u - b;
+	}
+
+	double v[2][2][2];
+	for (int i = 0; i < 2; ++i) {
+		for (int j = 0; j < 2; ++j) {
+			for (int k = 0; k < 2; ++k) {
+				v[i][j][k] = cellDistance(base[0] + i, base[1] + j, base[2] + k);
+			}
+		}
+	}
+
+	double const sx = 1.0 - t[0];
+	double const sy = 1.0 - t[1];
+	double const sz = 1.0 - t[2];
+
+	if (gradient) {
+		double const gx = sy * sz * (v[1][0][0] - v[0][0][0]) +
+		                  t[1] * sz * (v[1][1][0] - v[0][1][0]) +
+		                  sy * t[2] * (v[1][0][1] - v[0][0][1]) +
+		                  t[1] * t[2] * (v[1][1][1] - v[0][1][1]);
+		double const gy = sx * sz * (v[0][1][0] - v[0][0][0]) +
+		                  t[0] * sz * (v[1][1][0] - v[1][0][0]) +
+		                  sx * t[2] * (v[0][1][1] - v[0][0][1]) +
+		                  t[0] * t[2] * (v[1][1][1] - v[1][0][1]);
+		double const gz = sx * sy * (v[0][0][1] - v[0][0][0]) +
+		                  t[0] * sy * (v[1][0][1] - v[1][0][0]) +
+		                  sx * t[1] * (v[0][1][1] - v[0][1][0]) +
+		                  t[0] * t[1] * (v[1][1][1] - v[1][1][0]);
+		*gradient = Point3(gx, gy, gz) * resolution_factor_;
+	}
+
+	return sx * (sy * (sz * v[0][0][0] + t[2] * v[0][0][1]) +
+	             t[1] * (sz * v[0][1][0] + t[2] * v[0][1][1])) +
+	       t[0] * (sy * (sz * v[1][0][0] + t[2] * v[1][0][1]) +
+	               t[1] * (sz * v[1][1][0] + t[2] * v[1][1][1]));
+}
+}  // namespace ufo::map
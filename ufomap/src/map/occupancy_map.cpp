@@ -57,10 +57,28 @@ OccupancyMap::OccupancyMap(std::string const& filename, bool automatic_pruning,
                            double occupied_thres, double free_thres, double prob_hit,
                            double prob_miss, double clamping_thres_min,
                            double clamping_thres_max)
-    : OccupancyMapBase(filename, automatic_pruning, occupied_thres, free_thres, prob_hit,
+    : OccupancyMapBase(0.1, 16, automatic_pruning, occupied_thres, free_thres, prob_hit,
                        prob_miss, clamping_thres_min, clamping_thres_max)
 {
+	// Read here and not in the base, the tree type is only known once this is constructed
+	read(filename);
 }
 
 OccupancyMap::OccupancyMap(OccupancyMap const& other) : OccupancyMapBase(other) {}
+
+OccupancyMap::OccupancyMap(OccupancyMap& other, SnapshotTag tag)
+    : OccupancyMapBase(other, tag)
+{
+}
+
+//
+// Snapshot
+//
+
+std::shared_ptr<OccupancyMap const> OccupancyMap::snapshot()
+{
+	// Writers in thread safe mode must not change the tree while it is shared
+	auto lock = lockAll<UniqueLock>();
+	return std::shared_ptr<OccupancyMap const>(new OccupancyMap(*this, SnapshotTag()));
+}
 }  // namespace ufo::map
\ No newline at end of file
@@ -57,9 +57,11 @@ OccupancyMapColor::OccupancyMapColor(std::string const& filename, bool automatic
                                      double occupied_thres, double free_thres,
                                      double prob_hit, double prob_miss,
                                      double clamping_thres_min, double clamping_thres_max)
-    : OccupancyMapBase(filename, automatic_pruning, occupied_thres, free_thres, prob_hit,
+    : OccupancyMapBase(0.1, 16, automatic_pruning, occupied_thres, free_thres, prob_hit,
                        prob_miss, clamping_thres_min, clamping_thres_max)
 {
+	// Read here and not in the base, the tree type is only known once this is constructed
+	read(filename);
 }
 
 OccupancyMapColor::OccupancyMapColor(OccupancyMapColor const& other)
@@ -67,12 +69,30 @@ OccupancyMapColor::OccupancyMapColor(OccupancyMapColor const& other)
 {
 }
 
+OccupancyMapColor::OccupancyMapColor(OccupancyMapColor& other, SnapshotTag tag)
+    : OccupancyMapBase(other, tag)
+{
+}
+
+//
+// Snapshot
+//
+
+std::shared_ptr<OccupancyMapColor const> OccupancyMapColor::snapshot()
+{
+	// Writers in thread safe mode must not change the tree while it is shared
+	auto lock = lockAll<UniqueLock>();
+	return std::shared_ptr<OccupancyMapColor const>(
+	    new OccupancyMapColor(*this, SnapshotTag()));
+}
+
 //
 // Set color
 //
 
 void OccupancyMapColor::setColor(Code const& code, Color color)
 {
+	auto lock = lockWrite(code);
 	auto path = Base::createNode(code);
 	DepthType depth = code.getDepth();
 	path[depth]->value.color = color;
@@ -86,6 +106,8 @@ void OccupancyMapColor::setColor(Code const& code, Color color)
 
 Color OccupancyMapColor::getColor(Code const& code) const
 {
+	ensurePropagated();
+	auto lock = lockRead(code);
 	return Base::getNode(code).first->value.color;
 }
 
@@ -131,6 +153,7 @@ void OccupancyMapColor::updateNodeColor(Code code, Color update)
 		return;
 	}
 
+	auto lock = lockWrite(code);
 	auto path = Base::createNode(code);
 	DepthType depth = code.getDepth();
 
@@ -0,0 +1,233 @@
+/**
+ * UFOMap: An Efficient Probabilistic 3D Mapping Framework That Embraces the Unknown
+ *
+ * @author D. Duberg, KTH Royal Institute of Technology, Copyright (c) 2020.
+ * @see https://github.com/UnknownFreeOccupied/ufomap
+ * License: BSD 3
+ *
+ */
+
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, D. Duberg, KTH Royal Institute of Technology
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ufo/map/occupancy_map.h>
+#include <ufo/map/occupancy_map_color.h>
+#include <ufo/map/occupancy_map_fixed.h>
+#include <ufo/map/occupancy_map_mapped.h>
+
+// STD
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define UFO_MAP_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ufo::map
+{
+//
+// Constructors
+//
+
+OccupancyMapMapped::OccupancyMapMapped(std::string const& filename)
+{
+	if (!open(filename)) {
+		throw std::runtime_error("Could not map '" + filename + "'");
+	}
+}
+
+//
+// Open/close
+//
+
+bool OccupancyMapMapped::open(std::string const& filename)
+{
+	close();
+
+#ifdef UFO_MAP_MMAP
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (-1 == fd) {
+		return false;
+	}
+
+	struct stat st;
+	if (-1 == ::fstat(fd, &st) || sizeof(Header) > static_cast<std::size_t>(st.st_size)) {
+		::close(fd);
+		return false;
+	}
+
+	// Read-only and shared, so the page cache is shared with every other process that
+	// maps the same file
+	void* data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	// The mapping keeps the file alive
+	::close(fd);
+	if (MAP_FAILED == data) {
+		return false;
+	}
+	// Queries jump around in the file, read-ahead would mostly load unused pages
+	::madvise(data, st.st_size, MADV_RANDOM);
+
+	data_ = data;
+	data_size_ = st.st_size;
+	char const* bytes = static_cast<char const*>(data_);
+#else
+	std::ifstream file(filename.c_str(), std::ios_base::in | std::ios_base::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+	buffer_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	data_size_ = buffer_.size();
+	char const* bytes = buffer_.data();
+#endif
+
+	Header header;
+	if (sizeof(Header) <= data_size_) {
+		std::memcpy(&header, bytes, sizeof(Header));
+	}
+	if (sizeof(Header) > data_size_ || !validHeader(header, data_size_)) {
+		close();
+		return false;
+	}
+
+	nodes_ = reinterpret_cast<MappedOccupancyNode const*>(bytes + header.nodes_offset);
+	num_nodes_ = header.num_nodes;
+
+	resolution_ = header.resolution;
+	resolution_factor_ = 1.0 / resolution_;
+	depth_levels_ = header.depth_levels;
+	max_value_ = 1 << (depth_levels_ - 1);
+	nodes_half_sizes_[0] = resolution_ / 2.0;
+	nodes_half_sizes_[1] = resolution_;
+	for (std::size_t i = 2; i <= depth_levels_; ++i) {
+		nodes_half_sizes_[i] = nodes_half_sizes_[i - 1] * 2.0;
+	}
+
+	occupied_thres_ = header.occupied_thres;
+	free_thres_ = header.free_thres;
+
+	return true;
+}
+
+void OccupancyMapMapped::close() noexcept
+{
+#ifdef UFO_MAP_MMAP
+	if (nullptr != data_) {
+		::munmap(data_, data_size_);
+	}
+#endif
+	data_ = nullptr;
+	data_size_ = 0;
+	buffer_.clear();
+	buffer_.shrink_to_fit();
+	nodes_ = nullptr;
+	num_nodes_ = 0;
+}
+
+bool OccupancyMapMapped::isMappedFile(std::string const& filename)
+{
+	std::ifstream file(filename.c_str(), std::ios_base::in | std::ios_base::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	Header header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file.good()) {
+		return false;
+	}
+	file.seekg(0, std::ios_base::end);
+	return validHeader(header, file.tellg());
+}
+
+//
+// Conversion
+//
+
+bool OccupancyMapMapped::convert(std::string const& filename,
+                                 std::string const& mapped_filename,
+                                 double occupied_thres, double free_thres)
+{
+	std::string const type = OccupancyMap::readType(filename);
+	if ("occupancy_map" == type) {
+		return write(OccupancyMap(filename, true, occupied_thres, free_thres),
+		             mapped_filename);
+	} else if ("occupancy_map_color" == type) {
+		return write(OccupancyMapColor(filename, true, occupied_thres, free_thres),
+		             mapped_filename);
+	} else if ("occupancy_map_int8" == type) {
+		return write(OccupancyMapInt8(filename, true, occupied_thres, free_thres),
+		             mapped_filename);
+	} else if ("occupancy_map_int16" == type) {
+		return write(OccupancyMapInt16(filename, true, occupied_thres, free_thres),
+		             mapped_filename);
+	}
+	return false;
+}
+
+//
+// Swap
+//
+
+void OccupancyMapMapped::swap(OccupancyMapMapped& other) noexcept
+{
+	std::swap(data_, other.data_);
+	std::swap(data_size_, other.data_size_);
+	std::swap(buffer_, other.buffer_);
+	std::swap(nodes_, other.nodes_);
+	std::swap(num_nodes_, other.num_nodes_);
+	std::swap(resolution_, other.resolution_);
+	std::swap(resolution_factor_, other.resolution_factor_);
+	std::swap(depth_levels_, other.depth_levels_);
+	std::swap(max_value_, other.max_value_);
+	std::swap(nodes_half_sizes_, other.nodes_half_sizes_);
+	std::swap(occupied_thres_, other.occupied_thres_);
+	std::swap(free_thres_, other.free_thres_);
+}
+
+//
+// Input/output (read/write)
+//
+
+bool OccupancyMapMapped::validHeader(Header const& header, std::size_t file_size) noexcept
+{
+	return 0 == std::memcmp(header.magic, FILE_MAGIC, sizeof(header.magic)) &&
+	       FILE_VERSION == header.version && 2 <= header.depth_levels &&
+	       MAX_DEPTH_LEVELS >= header.depth_levels && 0.0 < header.resolution &&
+	       0 < header.num_nodes && sizeof(Header) <= header.nodes_offset &&
+	       0 == header.nodes_offset % alignof(MappedOccupancyNode) &&
+	       header.nodes_offset <= file_size &&
+	       header.num_nodes <= (file_size - header.nodes_offset) / sizeof(MappedOccupancyNode);
+}
+}  // namespace ufo::map
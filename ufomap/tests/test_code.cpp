@@ -0,0 +1,117 @@
+/**
+ * UFOMap: An Efficient Probabilistic 3D Mapping Framework That Embraces the Unknown
+ *
+ * @author D. Duberg, KTH Royal Institute of Technology, Copyright (c) 2020.
+ * @see https://github.com/UnknownFreeOccupied/ufomap
+ * License: BSD 3
+ *
+ */
+
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, D. Duberg, KTH Royal Institute of Technology
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// UFO
+#include <ufo/map/code.h>
+
+// Catch2
+#include <catch2/catch.hpp>
+
+// STD
+#include <cstddef>
+#include <random>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+using namespace ufo::map;
+
+namespace
+{
+template <typename It>
+using Reference = decltype(*std::declval<It>());
+
+// Keys can not be modified through iterators
+using Entry = std::pair<Code const, int>;
+static_assert(std::is_same_v<Code const&, Reference<CodeSet::iterator>>);
+static_assert(std::is_same_v<Entry&, Reference<CodeMap<int>::iterator>>);
+static_assert(std::is_same_v<Entry const&, Reference<CodeMap<int>::const_iterator>>);
+
+Code randomCode(std::mt19937& gen)
+{
+	std::uniform_int_distribution<unsigned int> key(0, 1023);
+	std::uniform_int_distribution<unsigned int> depth(0, 3);
+	return Code(Key(key(gen), key(gen), key(gen), depth(gen)));
+}
+}  // namespace
+
+TEST_CASE("CodeMap and CodeSet behave as the standard containers")
+{
+	std::mt19937 gen(42);
+	CodeMap<int> map(3);
+	CodeSet set(3);
+	std::unordered_map<Code, int, Code::Hash> expected;
+
+	for (int i = 0; i < 20000; ++i) {
+		Code const code = randomCode(gen);
+		map[code] += i;
+		set.insert(code);
+		expected[code] += i;
+	}
+
+	REQUIRE(expected.size() == map.size());
+	REQUIRE(expected.size() == set.size());
+	for (auto const& [code, value] : map) {
+		auto it = expected.find(code);
+		REQUIRE(std::end(expected) != it);
+		CHECK(it->second == value);
+		CHECK(1 == set.count(code));
+	}
+
+	// Values can be modified through iterators
+	for (auto& [code, value] : map) {
+		value = -value;
+	}
+	for (auto const& [code, value] : expected) {
+		auto it = map.find(code);
+		REQUIRE(std::end(map) != it);
+		CHECK(-value == it->second);
+		CHECK(std::end(set) != set.find(code));
+	}
+
+	CHECK_FALSE(map.try_emplace(std::begin(map)->first, 1).second);
+
+	map.clear();
+	set.clear();
+	CHECK(map.empty());
+	CHECK(set.empty());
+	CHECK(std::end(map) == map.find(std::begin(expected)->first));
+}
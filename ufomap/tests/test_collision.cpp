@@ -0,0 +1,300 @@
+/**
+ * UFOMap: An Efficient Probabilistic 3D Mapping Framework That Embraces the Unknown
+ *
+ * @author D. Duberg, KTH Royal Institute of Technology, Copyright (c) 2020.
+ * @see https://github.com/UnknownFreeOccupied/ufomap
+ * License: BSD 3
+ *
+ */
+
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, D. Duberg, KTH Royal Institute of Technology
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// UFO
+#include <ufo/geometry/collision_checks.h>
+
+// Catch2
+#include <catch2/catch.hpp>
+
+// STD
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <random>
+#include <utility>
+
+using namespace ufo::geometry;
+
+namespace
+{
+//
+// Brute force
+//
+
+// A shape given by a function that is at most 0 inside the shape and changes by at most
+// lipschitz per unit of distance
+struct Implicit {
+	std::function<double(Point const&)> f;
+	double lipschitz;
+};
+
+// 1 if the AABB certainly intersects the shape, 0 if it certainly does not and -1 if
+// the samples of the AABB are too coarse to tell
+int bruteForce(AABB const& aabb, Implicit const& shape)
+{
+	std::size_t const n = 12;
+	Point const min = aabb.center - aabb.half_size;
+	Point const step = aabb.half_size * (2.0 / n);
+	// Every point of the AABB is this close to a sample
+	double const cover = step.norm() / 2.0;
+
+	double closest = std::numeric_limits<double>::infinity();
+	for (std::size_t x = 0; x <= n; ++x) {
+		for (std::size_t y = 0; y <= n; ++y) {
+			for (std::size_t z = 0; z <= n; ++z) {
+				double const value =
+				    shape.f(min + Point(x * step[0], y * step[1], z * step[2]));
+				if (-1e-9 > value) {
+					return 1;
+				}
+				closest = std::min(closest, value);
+			}
+		}
+	}
+	return shape.lipschitz * cover + 1e-9 < closest ? 0 : -1;
+}
+
+// As above, but sampling the triangle and using the distance to the AABB
+int bruteForce(AABB const& aabb, Triangle const& triangle)
+{
+	std::size_t const n = 32;
+	double const max_edge = std::max({(triangle.points[1] - triangle.points[0]).norm(),
+	                                  (triangle.points[2] - triangle.points[1]).norm(),
+	                                  (triangle.points[0] - triangle.points[2]).norm()});
+	double const cover = max_edge / n;
+
+	Point const min = aabb.center - aabb.half_size;
+	Point const max = aabb.center + aabb.half_size;
+	Point const inner(1e-9, 1e-9, 1e-9);
+	double closest = std::numeric_limits<double>::infinity();
+	for (std::size_t i = 0; i <= n; ++i) {
+		for (std::size_t j = 0; i + j <= n; ++j) {
+			Point const point = triangle.points[0] +
+			                    (triangle.points[1] - triangle.points[0]) * (double(i) / n) +
+			                    (triangle.points[2] - triangle.points[0]) * (double(j) / n);
+			if (point == point.clamp(min + inner, max - inner)) {
+				return 1;
+			}
+			closest = std::min(closest, (point - point.clamp(min, max)).norm());
+		}
+	}
+	return cover + 1e-9 < closest ? 0 : -1;
+}
+
+double distanceToSegment(Point const& point, Point const& start, Point const& end)
+{
+	Point const direction = end - start;
+	double const squared_length = direction.squaredNorm();
+	double const t =
+	    0.0 == squared_length
+	        ? 0.0
+	        : std::clamp((point - start).dot(direction) / squared_length, 0.0, 1.0);
+	return (point - (start + direction * t)).norm();
+}
+
+Implicit implicit(Capsule const& capsule)
+{
+	return {[capsule](Point const& p) {
+		        return distanceToSegment(p, capsule.start, capsule.end) - capsule.radius;
+	        },
+	        1.0};
+}
+
+// Distance along the axis from start and distance from the axis
+std::pair<double, double> axial(Point const& point, Point const& start, Point const& end)
+{
+	Point const axis = (end - start) / (end - start).norm();
+	double const t = (point - start).dot(axis);
+	return {t, (point - start - axis * t).norm()};
+}
+
+Implicit implicit(Cylinder const& cylinder)
+{
+	double const length = (cylinder.end - cylinder.start).norm();
+	return {[cylinder, length](Point const& p) {
+		        auto const [t, r] = axial(p, cylinder.start, cylinder.end);
+		        return std::max({-t, t - length, r - cylinder.radius});
+	        },
+	        1.0};
+}
+
+Implicit implicit(Cone const& cone)
+{
+	double const length = (cone.end - cone.start).norm();
+	double const slope = cone.radius / length;
+	return {[cone, length, slope](Point const& p) {
+		        auto const [t, r] = axial(p, cone.start, cone.end);
+		        return std::max({-t, t - length, r - slope * t});
+	        },
+	        std::sqrt(1.0 + slope * slope)};
+}
+
+Implicit implicit(Ellipsoid const& ellipsoid)
+{
+	return {[ellipsoid](Point const& p) {
+		        return ((p - ellipsoid.center) / ellipsoid.radius).norm() - 1.0;
+	        },
+	        1.0 / ellipsoid.radius.min()};
+}
+
+//
+// Random shapes
+//
+
+class Random
+{
+ public:
+	Point point() { return Point(position_(gen_), position_(gen_), position_(gen_)); }
+
+	double radius() { return radius_(gen_); }
+
+	AABB aabb()
+	{
+		Point const half_size(size_(gen_), size_(gen_), size_(gen_));
+		Point const center = point();
+		return AABB(center - half_size, center + half_size);
+	}
+
+ private:
+	std::mt19937 gen_{42};
+	std::uniform_real_distribution<double> position_{-1.5, 1.5};
+	std::uniform_real_distribution<double> radius_{0.05, 0.8};
+	std::uniform_real_distribution<double> size_{0.05, 1.0};
+};
+
+template <typename Shape>
+void compare(Shape const& shape, AABB const& aabb, int expected, std::size_t& decided)
+{
+	if (0 > expected) {
+		return;
+	}
+	++decided;
+	CHECK(bool(expected) == intersects(aabb, shape));
+	CHECK(bool(expected) == intersects(shape, aabb));
+}
+
+std::size_t const NUM_CASES = 1000;
+}  // namespace
+
+TEST_CASE("GJK intersection tests agree with brute force")
+{
+	Random random;
+
+	SECTION("Capsule")
+	{
+		std::size_t decided = 0;
+		for (std::size_t i = 0; i < NUM_CASES; ++i) {
+			Capsule const capsule(random.point(), random.point(), random.radius());
+			AABB const aabb = random.aabb();
+			compare(capsule, aabb, bruteForce(aabb, implicit(capsule)), decided);
+		}
+		CHECK(NUM_CASES / 2 < decided);
+	}
+
+	SECTION("Cylinder")
+	{
+		std::size_t decided = 0;
+		for (std::size_t i = 0; i < NUM_CASES; ++i) {
+			Cylinder const cylinder(random.point(), random.point(), random.radius());
+			AABB const aabb = random.aabb();
+			compare(cylinder, aabb, bruteForce(aabb, implicit(cylinder)), decided);
+		}
+		CHECK(NUM_CASES / 2 < decided);
+	}
+
+	SECTION("Cone")
+	{
+		std::size_t decided = 0;
+		for (std::size_t i = 0; i < NUM_CASES; ++i) {
+			Cone const cone(random.point(), random.point(), random.radius());
+			AABB const aabb = random.aabb();
+			compare(cone, aabb, bruteForce(aabb, implicit(cone)), decided);
+		}
+		CHECK(NUM_CASES / 2 < decided);
+	}
+
+	SECTION("Ellipsoid")
+	{
+		std::size_t decided = 0;
+		for (std::size_t i = 0; i < NUM_CASES; ++i) {
+			Ellipsoid const ellipsoid(random.point(), Point(random.radius(), random.radius(),
+			                                                random.radius()));
+			AABB const aabb = random.aabb();
+			compare(ellipsoid, aabb, bruteForce(aabb, implicit(ellipsoid)), decided);
+		}
+		CHECK(NUM_CASES / 2 < decided);
+	}
+
+	SECTION("Triangle")
+	{
+		std::size_t decided = 0;
+		for (std::size_t i = 0; i < NUM_CASES; ++i) {
+			Triangle const triangle(random.point(), random.point(), random.point());
+			AABB const aabb = random.aabb();
+			compare(triangle, aabb, bruteForce(aabb, triangle), decided);
+		}
+		CHECK(NUM_CASES / 2 < decided);
+	}
+}
+
+TEST_CASE("Degenerate capsules and ellipsoids intersect as spheres")
+{
+	Random random;
+	for (std::size_t i = 0; i < NUM_CASES; ++i) {
+		Point const center = random.point();
+		double const radius = random.radius();
+		AABB const aabb = random.aabb();
+
+		// Too close to the surface of the sphere to tell
+		Point const min = aabb.center - aabb.half_size;
+		Point const max = aabb.center + aabb.half_size;
+		if (1e-6 > std::abs((center - center.clamp(min, max)).norm() - radius)) {
+			continue;
+		}
+
+		bool const expected = intersects(aabb, Sphere(center, radius));
+		CHECK(expected == intersects(aabb, Capsule(center, center, radius)));
+		CHECK(expected == intersects(aabb, Ellipsoid(center, Point(radius, radius, radius))));
+	}
+}
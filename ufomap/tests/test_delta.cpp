@@ -0,0 +1,197 @@
+/**
+ * UFOMap: An Efficient Probabilistic 3D Mapping Framework That Embraces the Unknown
+ *
+ * @author D. Duberg, KTH Royal Institute of Technology, Copyright (c) 2020.
+ * @see https://github.com/UnknownFreeOccupied/ufomap
+ * License: BSD 3
+ *
+ */
+
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, D. Duberg, KTH Royal Institute of Technology
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// UFO
+#include <ufo/map/occupancy_map.h>
+
+// Catch2
+#include <catch2/catch.hpp>
+
+// Tests
+#include "test_scene.h"
+
+// STD
+#include <cstdint>
+#include <vector>
+
+using namespace ufo::map;
+
+namespace
+{
+std::vector<char> data(OccupancyMap const& map)
+{
+	std::vector<char> data;
+	REQUIRE(0 < map.writeData(data));
+	return data;
+}
+
+void sync(OccupancyMap& source, OccupancyMap& replica)
+{
+	std::vector<char> delta;
+	REQUIRE(source.writeDelta(delta, replica.getDeltaEpoch()));
+	REQUIRE(replica.applyDelta(delta.data(), delta.size()));
+	CHECK(source.getDeltaEpoch() == replica.getDeltaEpoch());
+}
+}  // namespace
+
+TEST_CASE("Applying deltas keeps a replica equal to the source")
+{
+	auto const scans = ufo::test::testScans(6);
+	double const max_range = ufo::test::testLidar().max_range;
+
+	OccupancyMap source(0.1, 16);
+	source.enableChangeDetection(true);
+	OccupancyMap replica(0.1, 16);
+
+	for (auto const& [origin, cloud] : scans) {
+		source.insertPointCloud(origin, cloud, max_range);
+		sync(source, replica);
+		CHECK(data(source) == data(replica));
+	}
+
+	// Nothing changed, the delta is empty and the epoch stays
+	std::uint64_t const epoch = source.getDeltaEpoch();
+	sync(source, replica);
+	CHECK(epoch == source.getDeltaEpoch());
+	CHECK(data(source) == data(replica));
+}
+
+TEST_CASE("Setting the value of a volume or a node is sent with the delta")
+{
+	auto const scans = ufo::test::testScans(2);
+	double const max_range = ufo::test::testLidar().max_range;
+
+	OccupancyMap source(0.1, 16);
+	source.enableChangeDetection(true);
+	OccupancyMap replica(0.1, 16);
+
+	for (auto const& [origin, cloud] : scans) {
+		source.insertPointCloud(origin, cloud, max_range);
+	}
+	sync(source, replica);
+
+	// Leaf nodes and, with a minimum depth, pruned inner nodes
+	source.setValueVolume(ufo::geometry::Sphere(scans[0].first, 1.0), 0.0);
+	sync(source, replica);
+	CHECK(data(source) == data(replica));
+
+	source.setValueVolume(ufo::geometry::AABB(Point3(-2, -2, -2), Point3(2, 2, 0)), 0.0, 3);
+	sync(source, replica);
+	CHECK(data(source) == data(replica));
+
+	source.setOccupancy(Point3(1.05, 1.05, 1.05), 1.0, 2);
+	sync(source, replica);
+	CHECK(data(source) == data(replica));
+}
+
+TEST_CASE("A delta since an older epoch brings every newer replica up to date")
+{
+	auto const scans = ufo::test::testScans(4);
+	double const max_range = ufo::test::testLidar().max_range;
+
+	OccupancyMap source(0.1, 16);
+	source.enableChangeDetection(true);
+	OccupancyMap behind(0.1, 16);
+	OccupancyMap ahead(0.1, 16);
+
+	source.insertPointCloud(scans[0].first, scans[0].second, max_range);
+	sync(source, behind);
+	sync(source, ahead);
+	std::uint64_t const since = behind.getDeltaEpoch();
+
+	source.insertPointCloud(scans[1].first, scans[1].second, max_range);
+	sync(source, ahead);
+	source.insertPointCloud(scans[2].first, scans[2].second, max_range);
+
+	std::vector<char> delta;
+	REQUIRE(source.writeDelta(delta, since));
+	REQUIRE(behind.applyDelta(delta.data(), delta.size()));
+	REQUIRE(ahead.applyDelta(delta.data(), delta.size()));
+	CHECK(data(source) == data(behind));
+	CHECK(data(source) == data(ahead));
+}
+
+TEST_CASE("Stale replicas and trimmed epochs are rejected")
+{
+	auto const scans = ufo::test::testScans(3);
+	double const max_range = ufo::test::testLidar().max_range;
+
+	OccupancyMap source(0.1, 16);
+	std::vector<char> delta;
+	REQUIRE_FALSE(source.writeDelta(delta, 0));
+	source.enableChangeDetection(true);
+
+	OccupancyMap replica(0.1, 16);
+	OccupancyMap stale(0.1, 16);
+	for (auto const& [origin, cloud] : scans) {
+		source.insertPointCloud(origin, cloud, max_range);
+		sync(source, replica);
+	}
+	std::vector<char> const before = data(stale);
+
+	// The stale replica missed the deltas before the one it gets
+	source.integrateHit(Point3(1.05, 1.05, 1.05));
+	delta.clear();
+	REQUIRE(source.writeDelta(delta, replica.getDeltaEpoch()));
+	CHECK_FALSE(stale.applyDelta(delta.data(), delta.size()));
+	CHECK(0 == stale.getDeltaEpoch());
+	CHECK(before == data(stale));
+	CHECK(replica.applyDelta(delta.data(), delta.size()));
+
+	// Deltas for other resolutions or depth levels
+	OccupancyMap other_resolution(0.2, 16);
+	OccupancyMap other_depth(0.1, 15);
+	CHECK_FALSE(other_resolution.applyDelta(delta.data(), delta.size()));
+	CHECK_FALSE(other_depth.applyDelta(delta.data(), delta.size()));
+
+	// Epochs that are trimmed or have not happened yet
+	std::uint64_t const epoch = source.getDeltaEpoch();
+	source.trimDeltaHistory(epoch - 1);
+	CHECK(epoch - 1 == source.getOldestDeltaEpoch());
+	delta.clear();
+	CHECK_FALSE(source.writeDelta(delta, epoch - 2));
+	CHECK_FALSE(source.writeDelta(delta, epoch + 1));
+	CHECK(source.writeDelta(delta, epoch - 1));
+
+	// A corrupt delta
+	delta.front() = 'X';
+	CHECK_FALSE(replica.applyDelta(delta.data(), delta.size()));
+}
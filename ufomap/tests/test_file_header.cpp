@@ -0,0 +1,162 @@
+/**
+ * UFOMap: An Efficient Probabilistic 3D Mapping Framework That Embraces the Unknown
+ *
+ * @author D. Duberg, KTH Royal Institute of Technology, Copyright (c) 2020.
+ * @see https://github.com/UnknownFreeOccupied/ufomap
+ * License: BSD 3
+ *
+ */
+
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, D. Duberg, KTH Royal Institute of Technology
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// UFO
+#include <ufo/map/occupancy_map.h>
+
+// Catch2
+#include <catch2/catch.hpp>
+
+// Compression
+#include <lz4.h>
+
+// STD
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ufo::map;
+
+namespace
+{
+OccupancyMap testMap()
+{
+	OccupancyMap map(0.1, 16);
+	for (int i = 0; i < 1000; ++i) {
+		map.integrateHit(Point3(0.1 * (i % 17), 0.1 * (i % 23), 0.1 * (i % 5)));
+		map.integrateMiss(Point3(-0.1 * (i % 19), 0.1 * (i % 7), 0.1 * (i % 11)));
+	}
+	return map;
+}
+
+std::vector<char> data(OccupancyMap const& map)
+{
+	std::vector<char> data;
+	REQUIRE(0 < map.writeData(data));
+	return data;
+}
+
+std::string header(std::string const& version, bool compressed,
+                   std::string const& compression, int uncompressed_data_size)
+{
+	std::ostringstream s;
+	s << "# UFOMap file\n";
+	s << "version " << version << "\n";
+	s << "id occupancy_map\n";
+	s << "resolution 0.1\n";
+	s << "depth_levels 16\n";
+	s << "compressed " << compressed << "\n";
+	if (!compression.empty()) {
+		s << "compression " << compression << "\n";
+	}
+	s << "uncompressed_data_size " << uncompressed_data_size << "\n";
+	s << "data\n";
+	return s.str();
+}
+
+bool read(OccupancyMap& map, std::string const& file)
+{
+	std::istringstream s(file, std::ios_base::in | std::ios_base::binary);
+	return map.read(s);
+}
+}  // namespace
+
+TEST_CASE("Written files state their version and compression")
+{
+	OccupancyMap const map = testMap();
+	for (bool compress : {false, true}) {
+		std::ostringstream s(std::ios_base::out | std::ios_base::binary);
+		REQUIRE(map.write(s, compress));
+		std::string const file = s.str();
+		std::string const head = file.substr(0, file.find("\ndata\n"));
+		CHECK(std::string::npos != head.find("version " + map.getFileVersion()));
+		CHECK(compress == (std::string::npos != head.find("compression lz4_blocks")));
+
+		OccupancyMap copy(0.1, 16);
+		REQUIRE(read(copy, file));
+		CHECK((data(map) == data(copy)));
+	}
+}
+
+TEST_CASE("Files compressed as a single block by version 1.0.0 are read")
+{
+	OccupancyMap const map = testMap();
+	std::vector<char> const uncompressed = data(map);
+	std::vector<char> compressed(LZ4_compressBound(uncompressed.size()));
+	int const compressed_size =
+	    LZ4_compress_default(uncompressed.data(), compressed.data(), uncompressed.size(),
+	                         compressed.size());
+	REQUIRE(0 < compressed_size);
+
+	std::string const file = header("1.0.0", true, "", uncompressed.size()) +
+	                         std::string(compressed.data(), compressed_size);
+	OccupancyMap copy(0.1, 16);
+	REQUIRE(read(copy, file));
+	CHECK((uncompressed == data(copy)));
+
+	// As from a message of that version
+	std::istringstream s(std::string(compressed.data(), compressed_size),
+	                     std::ios_base::in | std::ios_base::binary);
+	OccupancyMap message_copy(0.1, 16);
+	REQUIRE(message_copy.readData(s, ufo::geometry::BoundingVolume(), 0.1, 16,
+	                              uncompressed.size(),
+	                              OccupancyMap::getCompression("1.0.0", true)));
+	CHECK((uncompressed == data(message_copy)));
+}
+
+TEST_CASE("Unknown compressions and mislabeled data are rejected")
+{
+	OccupancyMap const map = testMap();
+	std::vector<char> const uncompressed = data(map);
+	std::string const raw(uncompressed.data(), uncompressed.size());
+	OccupancyMap copy(0.1, 16);
+
+	CHECK_FALSE(read(copy, header("1.1.0", true, "zstd", uncompressed.size()) + raw));
+	// Not framed, so not block compressed
+	CHECK_FALSE(read(copy, header("1.1.0", true, "lz4_blocks", 0) + raw));
+
+	CHECK(read(copy, header("1.1.0", false, "", uncompressed.size()) + raw));
+	CHECK((uncompressed == data(copy)));
+
+	CHECK(Compression::none == OccupancyMap::getCompression("1.1.0", false));
+	CHECK(Compression::lz4 == OccupancyMap::getCompression("1.0.0", true));
+	CHECK(Compression::lz4_blocks == OccupancyMap::getCompression("1.1.0", true));
+}
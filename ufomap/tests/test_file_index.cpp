@@ -0,0 +1,201 @@
+/**
+ * UFOMap: An Efficient Probabilistic 3D Mapping Framework That Embraces the Unknown
+ *
+ * @author D. Duberg, KTH Royal Institute of Technology, Copyright (c) 2020.
+ * @see https://github.com/UnknownFreeOccupied/ufomap
+ * License: BSD 3
+ *
+ */
+
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, D. Duberg, KTH Royal Institute of Technology
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// UFO
+#include <ufo/map/occupancy_map.h>
+
+// Catch2
+#include <catch2/catch.hpp>
+
+// Tests
+#include "test_scene.h"
+
+// STD
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ufo::map;
+
+namespace
+{
+DepthType const INDEX_DEPTH = 6;
+
+OccupancyMap const& testMap()
+{
+	static OccupancyMap const map = [] {
+		OccupancyMap map(0.1, 16);
+		for (auto const& [origin, cloud] : ufo::test::testScans(4)) {
+			map.insertPointCloud(origin, cloud, ufo::test::testLidar().max_range);
+		}
+		return map;
+	}();
+	return map;
+}
+
+std::vector<char> data(OccupancyMap const& map)
+{
+	std::vector<char> data;
+	REQUIRE(0 <= map.writeData(data));
+	return data;
+}
+
+std::string file(OccupancyMap const& map, bool index, bool compress)
+{
+	OccupancyMap copy(map);
+	copy.enableFileIndex(index);
+	copy.setFileIndexDepth(INDEX_DEPTH);
+	copy.setCompressionBlockSize(4096);
+
+	std::stringstream s(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+	REQUIRE(copy.write(s, compress));
+	return s.str();
+}
+
+// Reads the part of the file inside bv
+OccupancyMap readPartial(std::string const& file,
+                         ufo::geometry::BoundingVolume const& bv, unsigned int threads,
+                         bool compressed)
+{
+	OccupancyMap map(0.1, 16);
+	map.setCompressionThreads(threads);
+	std::stringstream s(file, std::ios_base::in | std::ios_base::binary);
+	// Skips the header
+	REQUIRE(!OccupancyMap::readType(s).empty());
+	REQUIRE(map.readData(s, bv, 0.1, 16, 0, compressed));
+	return map;
+}
+}  // namespace
+
+TEST_CASE("Indexed files read in parallel give the same map as sequential reads")
+{
+	std::vector<char> const expected = data(testMap());
+
+	for (bool compress : {false, true}) {
+		INFO("compressed " << compress);
+		std::string const indexed = file(testMap(), true, compress);
+		std::string const plain = file(testMap(), false, compress);
+		CHECK(indexed.size() > plain.size());
+
+		for (std::string const* f : {&indexed, &plain}) {
+			for (unsigned int threads : {1U, 4U}) {
+				INFO("indexed " << (f == &indexed) << ", threads " << threads);
+				OccupancyMap map(0.1, 16);
+				map.setCompressionThreads(threads);
+				std::stringstream s(*f, std::ios_base::in | std::ios_base::binary);
+				REQUIRE(map.read(s));
+				CHECK((expected == data(map)));
+			}
+		}
+	}
+}
+
+TEST_CASE("Files with a corrupt index are read without it")
+{
+	std::vector<char> const expected = data(testMap());
+
+	for (bool compress : {false, true}) {
+		INFO("compressed " << compress);
+		std::string const indexed = file(testMap(), true, compress);
+
+		// The index ends with its size and the magic bytes, the number of subtrees comes
+		// after the magic bytes, the depth, the data size and the stored size
+		std::uint64_t index_size;
+		std::memcpy(&index_size, indexed.data() + indexed.size() - 12, sizeof(index_size));
+		std::size_t const num_subtrees_pos = indexed.size() - index_size + 21;
+		std::uint64_t data_size;
+		std::memcpy(&data_size, indexed.data() + num_subtrees_pos - 16, sizeof(data_size));
+
+		// More subtrees than fit in the index
+		for (std::uint64_t num_subtrees : {data_size, std::uint64_t(1) << 60}) {
+			INFO("subtrees " << num_subtrees);
+			std::string corrupt = indexed;
+			std::memcpy(corrupt.data() + num_subtrees_pos, &num_subtrees,
+			            sizeof(num_subtrees));
+
+			OccupancyMap map(0.1, 16);
+			map.setCompressionThreads(4);
+			std::stringstream s(corrupt, std::ios_base::in | std::ios_base::binary);
+			REQUIRE(map.read(s));
+			CHECK((expected == data(map)));
+		}
+	}
+}
+
+TEST_CASE("Bounding volume reads of indexed files only read the subtrees inside")
+{
+	OccupancyMap const& full = testMap();
+	ufo::geometry::BoundingVolume bv;
+	bv.add(ufo::geometry::AABB(ufo::geometry::Point(5.0, 5.0, 1.0), 2.0));
+
+	for (bool compress : {false, true}) {
+		std::string const indexed = file(full, true, compress);
+		for (unsigned int threads : {1U, 4U}) {
+			INFO("compressed " << compress << ", threads " << threads);
+			OccupancyMap const map = readPartial(indexed, bv, threads, compress);
+
+			// Every leaf inside the bounding volume is read, the inner nodes also summarize
+			// the subtrees outside so they differ
+			auto expected_it = full.beginLeaves(bv, true, true, true);
+			auto it = map.beginLeaves(bv, true, true, true);
+			for (; expected_it != full.endLeaves() && it != map.endLeaves();
+			     ++expected_it, ++it) {
+				REQUIRE(expected_it.getCode() == it.getCode());
+				REQUIRE(expected_it.getOccupancy() == it.getOccupancy());
+			}
+			CHECK((full.endLeaves() == expected_it));
+			CHECK((map.endLeaves() == it));
+
+			// Only the subtrees intersecting the bounding volume are read
+			CHECK(data(map).size() < data(full).size());
+			for (auto leaf = map.beginLeaves(true, true, false), end = map.endLeaves();
+			     leaf != end; ++leaf) {
+				DepthType const depth = std::max(leaf.getDepth(), INDEX_DEPTH);
+				ufo::geometry::AABB const subtree(map.toCoord(leaf.getCode(depth)),
+				                                  map.getNodeHalfSize(depth));
+				CHECK(bv.intersects(subtree));
+			}
+		}
+	}
+}
@@ -0,0 +1,129 @@
+/**
+ * UFOMap: An Efficient Probabilistic 3D Mapping Framework That Embraces the Unknown
+ *
+ * @author D. Duberg, KTH Royal Institute of Technology, Copyright (c) 2020.
+ * @see https://github.com/UnknownFreeOccupied/ufomap
+ * License: BSD 3
+ *
+ */
+
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, D. Duberg, KTH Royal Institute of Technology
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// UFO
+#include <ufo/map/occupancy_map.h>
+
+// Catch2
+#include <catch2/catch.hpp>
+
+// Tests
+#include "test_scene.h"
+
+// STD
+#include <cstddef>
+#include <string>
+#include <vector>
+
+using namespace ufo::map;
+
+namespace
+{
+struct Integration {
+	std::string name;
+	unsigned int threads;
+	DepthType split_depth;
+	bool batch;
+	bool packet;
+	bool lazy;
+};
+
+std::vector<char> integrate(Integration const& integration)
+{
+	OccupancyMap map(0.1, 16);
+	map.setIntegrationThreads(integration.threads);
+	map.enableDeterministicIntegration(true);
+	map.setIntegrationSplitDepth(integration.split_depth);
+	map.enableBatchIntegration(integration.batch);
+	map.enablePacketRayCasting(integration.packet);
+	map.enableLazyPropagation(integration.lazy);
+
+	for (auto const& [origin, cloud] : ufo::test::testScans(4)) {
+		map.insertPointCloud(origin, cloud, ufo::test::testLidar().max_range);
+	}
+
+	std::vector<char> data;
+	REQUIRE(0 < map.writeData(data));
+	return data;
+}
+}  // namespace
+
+TEST_CASE("Parallel, batched and packet integration give the serial map")
+{
+	Integration const serial{"serial", 1, 0, false, false, false};
+	std::vector<char> const expected = integrate(serial);
+
+	for (Integration const& integration :
+	     {Integration{"batch", 1, 0, true, false, false},
+	      Integration{"parallel", 4, 10, false, false, false},
+	      Integration{"parallel batch", 4, 10, true, false, false},
+	      Integration{"packet", 1, 0, false, true, false},
+	      Integration{"parallel packet", 4, 10, true, true, false},
+	      Integration{"lazy", 1, 0, true, false, true},
+	      Integration{"parallel lazy", 4, 10, true, true, true}}) {
+		INFO(integration.name);
+		CHECK(expected == integrate(integration));
+	}
+}
+
+TEST_CASE("Lazy propagation gives the eagerly propagated map")
+{
+	OccupancyMap eager(0.1, 16);
+	OccupancyMap lazy(0.1, 16);
+	lazy.enableLazyPropagation(true);
+
+	for (int i = 0; i < 2000; ++i) {
+		Point3 const point(0.1 * (i % 50), 0.1 * ((7 * i) % 40), 0.1 * ((13 * i) % 30));
+		if (i % 3) {
+			eager.integrateMiss(point);
+			lazy.integrateMiss(point);
+		} else {
+			eager.integrateHit(point);
+			lazy.integrateHit(point);
+		}
+	}
+
+	std::vector<char> eager_data;
+	std::vector<char> lazy_data;
+	REQUIRE(0 < eager.writeData(eager_data));
+	REQUIRE(0 < lazy.writeData(lazy_data));
+	CHECK(eager_data == lazy_data);
+}
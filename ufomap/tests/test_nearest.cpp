@@ -0,0 +1,179 @@
+/**
+ * UFOMap: An Efficient Probabilistic 3D Mapping Framework That Embraces the Unknown
+ *
+ * @author D. Duberg, KTH Royal Institute of Technology, Copyright (c) 2020.
+ * @see https://github.com/UnknownFreeOccupied/ufomap
+ * License: BSD 3
+ *
+ */
+
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, D. Duberg, KTH Royal Institute of Technology
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// UFO
+#include <ufo/map/occupancy_map.h>
+
+// Catch2
+#include <catch2/catch.hpp>
+
+// Tests
+#include "test_scene.h"
+
+// STD
+#include <algorithm>
+#include <cstddef>
+#include <random>
+#include <tuple>
+#include <vector>
+
+using namespace ufo::map;
+
+namespace
+{
+OccupancyMap const& testMap()
+{
+	static OccupancyMap const map = [] {
+		OccupancyMap map(0.1, 16);
+		for (auto const& [origin, cloud] : ufo::test::testScans(2)) {
+			map.insertPointCloud(origin, cloud, ufo::test::testLidar().max_range);
+		}
+		return map;
+	}();
+	return map;
+}
+
+// The squared distance to every node the search can return, closest first
+std::vector<double> bruteForce(OccupancyMap const& map, Point3 const& point,
+                               bool occupied_space, bool free_space, DepthType min_depth)
+{
+	std::vector<double> distances;
+	for (auto it = map.beginLeaves(occupied_space, free_space, false, false, min_depth),
+	          end = map.endLeaves();
+	     it != end; ++it) {
+		Point3 const half(it.getHalfSize(), it.getHalfSize(), it.getHalfSize());
+		Point3 const center = it.getCenter();
+		distances.push_back(
+		    (point - point.clamp(center - half, center + half)).squaredNorm());
+	}
+	std::sort(std::begin(distances), std::end(distances));
+	return distances;
+}
+
+std::vector<Point3> queryPoints(std::size_t num_points)
+{
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<double> xy(-15.0, 15.0);
+	std::uniform_real_distribution<double> z(-1.0, 4.0);
+	std::vector<Point3> points;
+	for (std::size_t i = 0; i < num_points; ++i) {
+		points.emplace_back(xy(gen), xy(gen), z(gen));
+	}
+	return points;
+}
+}  // namespace
+
+TEST_CASE("knnSearch finds the k closest nodes")
+{
+	OccupancyMap const& map = testMap();
+	std::vector<OccupancyMap::Neighbor> neighbors;
+
+	for (auto [occupied_space, free_space, min_depth] :
+	     {std::tuple(true, false, 0), std::tuple(false, true, 0),
+	      std::tuple(true, true, 2)}) {
+		INFO("occupied " << occupied_space << ", free " << free_space << ", min depth "
+		                 << min_depth);
+		for (Point3 const& point : queryPoints(20)) {
+			std::vector<double> const expected =
+			    bruteForce(map, point, occupied_space, free_space, min_depth);
+			for (std::size_t k : {1, 10, 100}) {
+				map.knnSearch(point, k, neighbors, occupied_space, free_space, false,
+				              min_depth);
+				REQUIRE(std::min(k, expected.size()) == neighbors.size());
+				for (std::size_t i = 0; i < neighbors.size(); ++i) {
+					CHECK(Approx(expected[i]).margin(1e-9) == neighbors[i].squared_distance);
+					// The reported center is the center of the reported node
+					Code const& code = neighbors[i].code;
+					CHECK(code.getDepth() >= min_depth);
+					CHECK(Approx(0.0).margin(1e-9) ==
+					      (map.toCoord(code) - neighbors[i].center).norm());
+				}
+			}
+		}
+	}
+}
+
+TEST_CASE("radiusSearch finds all nodes within the radius")
+{
+	OccupancyMap const& map = testMap();
+	std::vector<OccupancyMap::Neighbor> neighbors;
+
+	for (Point3 const& point : queryPoints(20)) {
+		std::vector<double> const expected = bruteForce(map, point, true, false, 0);
+		for (double radius : {0.0, 0.5, 2.0}) {
+			map.radiusSearch(point, radius, neighbors);
+			std::size_t const num_within =
+			    std::upper_bound(std::begin(expected), std::end(expected), radius * radius) -
+			    std::begin(expected);
+			REQUIRE(num_within == neighbors.size());
+			for (std::size_t i = 0; i < neighbors.size(); ++i) {
+				CHECK(Approx(expected[i]).margin(1e-9) == neighbors[i].squared_distance);
+			}
+		}
+	}
+}
+
+TEST_CASE("Batched searches give the single point results")
+{
+	OccupancyMap map(testMap());
+	map.setIntegrationThreads(4);
+	std::vector<Point3> const points = queryPoints(256);
+
+	std::vector<std::vector<OccupancyMap::Neighbor>> batch;
+	std::vector<OccupancyMap::Neighbor> single;
+
+	map.knnSearch(points, 5, batch);
+	REQUIRE(points.size() == batch.size());
+	for (std::size_t i = 0; i < points.size(); ++i) {
+		map.knnSearch(points[i], 5, single);
+		REQUIRE(single.size() == batch[i].size());
+		for (std::size_t j = 0; j < single.size(); ++j) {
+			CHECK(single[j].code == batch[i][j].code);
+		}
+	}
+
+	map.radiusSearch(points, 1.0, batch);
+	REQUIRE(points.size() == batch.size());
+	for (std::size_t i = 0; i < points.size(); ++i) {
+		map.radiusSearch(points[i], 1.0, single);
+		CHECK(single.size() == batch[i].size());
+	}
+}
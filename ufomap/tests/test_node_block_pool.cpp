@@ -0,0 +1,120 @@
+/**
+ * UFOMap: An Efficient Probabilistic 3D Mapping Framework That Embraces the Unknown
+ *
+ * @author D. Duberg, KTH Royal Institute of Technology, Copyright (c) 2020.
+ * @see https://github.com/UnknownFreeOccupied/ufomap
+ * License: BSD 3
+ *
+ */
+
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, D. Duberg, KTH Royal Institute of Technology
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// UFO
+#include <ufo/map/node_block_pool.h>
+
+// Catch2
+#include <catch2/catch.hpp>
+
+// STD
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <vector>
+
+using namespace ufo::map;
+
+namespace
+{
+using Block = std::array<std::uint64_t, 8>;
+}  // namespace
+
+TEST_CASE("Blocks are handed out once, also from many threads")
+{
+	NodeBlockPool<Block> pool;
+	std::size_t const num_threads = 8;
+	std::size_t const num_blocks = 10000;
+
+	// Each thread keeps every other block, the rest is returned right away
+	std::vector<std::future<std::vector<Block*>>> workers;
+	for (std::size_t t = 0; t < num_threads; ++t) {
+		workers.push_back(std::async(std::launch::async, [&pool, t]() {
+			std::vector<Block*> kept;
+			for (std::size_t i = 0; i < num_blocks; ++i) {
+				Block* block = pool.allocate();
+				block->fill(t);
+				if (i % 2) {
+					pool.deallocate(block);
+				} else {
+					kept.push_back(block);
+				}
+			}
+			return kept;
+		}));
+	}
+
+	std::vector<Block*> blocks;
+	for (std::size_t t = 0; t < num_threads; ++t) {
+		std::vector<Block*> const kept = workers[t].get();
+		for (Block* block : kept) {
+			CHECK(std::all_of(std::begin(*block), std::end(*block),
+			                  [t](std::uint64_t value) { return t == value; }));
+		}
+		blocks.insert(std::end(blocks), std::begin(kept), std::end(kept));
+	}
+
+	std::sort(std::begin(blocks), std::end(blocks));
+	CHECK(std::end(blocks) == std::adjacent_find(std::begin(blocks), std::end(blocks)));
+	CHECK(blocks.size() == pool.numBlocks());
+	CHECK(pool.memoryInUse() <= pool.memoryReserved());
+
+	// Given back from another thread than they were taken from
+	for (Block* block : blocks) {
+		pool.deallocate(block);
+		CHECK(block == NodeBlockPool<Block>::blockOf(&(*block)[3]));
+	}
+	CHECK(0 == pool.numBlocks());
+
+	// The returned blocks are reused
+	std::size_t const reserved = pool.memoryReserved();
+	for (std::size_t i = 0; i < blocks.size(); ++i) {
+		blocks[i] = pool.allocate();
+	}
+	CHECK(reserved == pool.memoryReserved());
+
+	pool.clear();
+	CHECK(0 == pool.numBlocks());
+	CHECK(0 == pool.numSlabs());
+	CHECK(0 == pool.memoryReserved());
+}
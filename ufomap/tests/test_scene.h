@@ -0,0 +1,91 @@
+/**
+ * UFOMap: An Efficient Probabilistic 3D Mapping Framework That Embraces the Unknown
+ *
+ * @author D. Duberg, KTH Royal Institute of Technology, Copyright (c) 2020.
+ * @see https://github.com/UnknownFreeOccupied/ufomap
+ * License: BSD 3
+ *
+ */
+
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, D. Duberg, KTH Royal Institute of Technology
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef UFO_TESTS_TEST_SCENE_H
+#define UFO_TESTS_TEST_SCENE_H
+
+// UFO
+#include <ufo/map/point_cloud.h>
+
+// Benchmark
+#include "scan_generator.h"
+
+// STD
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace ufo::test
+{
+/**
+ * @brief A LiDAR with few beams and a short range, so the tests run fast
+ */
+inline benchmark::LidarModel testLidar()
+{
+	benchmark::LidarModel lidar;
+	lidar.beams = 8;
+	lidar.points_per_beam = 256;
+	lidar.max_range = 15.0;
+	return lidar;
+}
+
+/**
+ * @brief Scans of the benchmark scene, taken along a circle through it
+ *
+ * @return The sensor origin and the point cloud of each scan
+ */
+inline std::vector<std::pair<map::Point3, map::PointCloud>> testScans(
+    std::size_t num_scans, std::uint32_t seed = 42)
+{
+	benchmark::Scene const scene(seed);
+	benchmark::ScanGenerator generator(scene, seed);
+	benchmark::LidarModel const lidar = testLidar();
+
+	std::vector<std::pair<map::Point3, map::PointCloud>> scans;
+	for (auto const& pose : benchmark::circularTrajectory(scene, num_scans)) {
+		scans.emplace_back(pose.position, generator.scan(pose, lidar));
+	}
+	return scans;
+}
+}  // namespace ufo::test
+
+#endif  // UFO_TESTS_TEST_SCENE_H
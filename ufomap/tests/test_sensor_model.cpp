@@ -0,0 +1,153 @@
+/**
+ * UFOMap: An Efficient Probabilistic 3D Mapping Framework That Embraces the Unknown
+ *
+ * @author D. Duberg, KTH Royal Institute of Technology, Copyright (c) 2020.
+ * @see https://github.com/UnknownFreeOccupied/ufomap
+ * License: BSD 3
+ *
+ */
+
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, D. Duberg, KTH Royal Institute of Technology
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// UFO
+#include <ufo/map/occupancy_map.h>
+#include <ufo/map/occupancy_map_fixed.h>
+
+// Catch2
+#include <catch2/catch.hpp>
+
+// STD
+#include <cstddef>
+#include <vector>
+
+using namespace ufo::map;
+
+namespace
+{
+struct SensorModel {
+	double occupied_thres;
+	double free_thres;
+	double prob_hit;
+	double prob_miss;
+	double clamping_thres_min;
+	double clamping_thres_max;
+};
+
+template <typename Map>
+Map makeMap(SensorModel const& model)
+{
+	return Map(0.1, 16, false, model.occupied_thres, model.free_thres, model.prob_hit,
+	           model.prob_miss, model.clamping_thres_min, model.clamping_thres_max);
+}
+
+template <typename Map>
+int classify(Map const& map, Code const& code)
+{
+	return map.isOccupied(code) ? 1 : (map.isFree(code) ? -1 : 0);
+}
+
+// Voxel i gets hit/miss sequence i, bit j is the j:th update and set for a hit
+Code sequenceCode(OccupancyMap const& map, std::size_t i)
+{
+	return map.toCode(0.05 + 0.1 * (i % 128), 0.05 + 0.1 * (i / 128), 0.05);
+}
+}  // namespace
+
+TEST_CASE("Fixed-point maps classify hit/miss sequences as floating point does")
+{
+	// The defaults, asymmetric thresholds, equal hit and miss, and a strong hit
+	std::vector<SensorModel> const models = {{0.5, 0.5, 0.7, 0.4, 0.1192, 0.971},
+	                                         {0.75, 0.35, 0.7, 0.4, 0.1192, 0.971},
+	                                         {0.6, 0.4, 0.65, 0.35, 0.15, 0.95},
+	                                         {0.5, 0.5, 0.9, 0.45, 0.12, 0.97}};
+	// Every sequence this long, and every prefix of it
+	std::size_t const length = 14;
+	std::size_t const num_sequences = std::size_t(1) << length;
+
+	for (SensorModel const& model : models) {
+		auto reference = makeMap<OccupancyMap>(model);
+		auto int8 = makeMap<OccupancyMapInt8>(model);
+		auto int16 = makeMap<OccupancyMapInt16>(model);
+
+		for (std::size_t step = 0; step < length; ++step) {
+			std::size_t int8_mismatches = 0;
+			std::size_t int16_mismatches = 0;
+			for (std::size_t i = 0; i < num_sequences; ++i) {
+				Code const code = sequenceCode(reference, i);
+				if ((i >> step) & 1U) {
+					reference.integrateHit(code);
+					int8.integrateHit(code);
+					int16.integrateHit(code);
+				} else {
+					reference.integrateMiss(code);
+					int8.integrateMiss(code);
+					int16.integrateMiss(code);
+				}
+				int const expected = classify(reference, code);
+				int8_mismatches += expected != classify(int8, code);
+				int16_mismatches += expected != classify(int16, code);
+			}
+			INFO("hit " << model.prob_hit << ", miss " << model.prob_miss << ", step "
+			            << step + 1);
+			CHECK(0 == int8_mismatches);
+			CHECK(0 == int16_mismatches);
+		}
+	}
+}
+
+TEST_CASE("Fixed-point maps keep the voxels free after the hits a miss run undoes")
+{
+	SensorModel const model = {0.5, 0.5, 0.7, 0.4, 0.1192, 0.971};
+	auto reference = makeMap<OccupancyMap>(model);
+	auto int8 = makeMap<OccupancyMapInt8>(model);
+	auto int16 = makeMap<OccupancyMapInt16>(model);
+
+	// Hits followed by misses, which int8 with rounded increments turned occupied or
+	// unknown
+	for (auto [hits, misses] : {std::pair(4, 9), std::pair(3, 7)}) {
+		Code const code = sequenceCode(reference, hits);
+		for (int i = 0; i < hits; ++i) {
+			reference.integrateHit(code);
+			int8.integrateHit(code);
+			int16.integrateHit(code);
+		}
+		for (int i = 0; i < misses; ++i) {
+			reference.integrateMiss(code);
+			int8.integrateMiss(code);
+			int16.integrateMiss(code);
+		}
+		REQUIRE(reference.isFree(code));
+		CHECK(int8.isFree(code));
+		CHECK(int16.isFree(code));
+	}
+}
@@ -61,6 +61,8 @@
 
 // STD
 #include <future>
+#include <memory>
+#include <mutex>
 #include <variant>
 #include <vector>
 
@@ -94,6 +96,16 @@ class Server
 
 	void configCallback(ufomap_mapping::ServerConfig &config, uint32_t level);
 
+	/**
+	 * @brief Snapshot of the map, which can be read while the map is modified.
+	 */
+	template <class Map>
+	std::shared_ptr<Map const> snapshot(Map &map)
+	{
+		std::lock_guard<std::mutex> lock(map_mutex_);
+		return map.snapshot();
+	}
+
  private:
 	//
 	// ROS parameters
@@ -136,6 +148,7 @@ class Server
 
 	// Map
 	std::variant<std::monostate, ufo::map::OccupancyMap, ufo::map::OccupancyMapColor> map_;
+	std::mutex map_mutex_;  // Held while the map is modified or a snapshot is taken
 	std::string frame_id_;
 
 	// Integration
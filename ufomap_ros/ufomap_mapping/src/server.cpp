@@ -59,12 +59,12 @@ Server::Server(ros::NodeHandle &nh, ros::NodeHandle &nh_priv)
 	double resolution = nh_priv_.param("resolution", 0.05);
 	ufo::map::DepthType depth_levels = nh_priv_.param("depth_levels", 16);
 
-	// Automatic pruning is disabled so we can work in multiple threads for subscribers,
-	// services and publishers
+	// Publishers and services read from snapshots of the map, so it can be pruned while
+	// they work in other threads
 	if (nh_priv_.param("color_map", false)) {
-		map_.emplace<ufo::map::OccupancyMapColor>(resolution, depth_levels, false);
+		map_.emplace<ufo::map::OccupancyMapColor>(resolution, depth_levels);
 	} else {
-		map_.emplace<ufo::map::OccupancyMap>(resolution, depth_levels, false);
+		map_.emplace<ufo::map::OccupancyMap>(resolution, depth_levels);
 	}
 
 	// Enable min/max change detection
@@ -108,6 +108,8 @@ void Server::cloudCallback(sensor_msgs::PointCloud2::ConstPtr const &msg)
 	std::visit(
 	    [this, &msg, &transform](auto &map) {
 		    if constexpr (!std::is_same_v<std::decay_t<decltype(map)>, std::monostate>) {
+			    std::lock_guard<std::mutex> lock(map_mutex_);
+
 			    auto start = std::chrono::steady_clock::now();
 
 			    // Update map
@@ -185,28 +187,23 @@ void Server::cloudCallback(sensor_msgs::PointCloud2::ConstPtr const &msg)
 					    // TODO: should this be here?
 					    map.resetMinMaxChangeDetection();
 
-					    update_async_handler_ = std::async(
-					        std::launch::async, [this, aabb, stamp = msg->header.stamp]() {
-						        std::visit(
-						            [this, &aabb, stamp](auto &map) {
-							            if constexpr (!std::is_same_v<std::decay_t<decltype(map)>,
-							                                          std::monostate>) {
-								            for (int i = 0; i < map_pub_.size(); ++i) {
-									            if (map_pub_[i] && (0 < map_pub_[i].getNumSubscribers() ||
-									                                map_pub_[i].isLatched())) {
-										            ufomap_msgs::UFOMapStamped::Ptr msg(
-										                new ufomap_msgs::UFOMapStamped);
-										            if (ufomap_msgs::ufoToMsg(map, msg->map, aabb, compress_,
-										                                      i)) {
-											            msg->header.stamp = stamp;
-											            msg->header.frame_id = frame_id_;
-											            map_pub_[i].publish(msg);
-										            }
-									            }
-								            }
-							            }
-						            },
-						            map_);
+					    // The lock is already held
+					    update_async_handler_ =
+					        std::async(std::launch::async, [this, aabb, stamp = msg->header.stamp,
+					                                        snapshot = map.snapshot()]() {
+						        for (int i = 0; i < map_pub_.size(); ++i) {
+							        if (map_pub_[i] && (0 < map_pub_[i].getNumSubscribers() ||
+							                            map_pub_[i].isLatched())) {
+								        ufomap_msgs::UFOMapStamped::Ptr msg(
+								            new ufomap_msgs::UFOMapStamped);
+								        if (ufomap_msgs::ufoToMsg(*snapshot, msg->map, aabb, compress_,
+								                                  i)) {
+									        msg->header.stamp = stamp;
+									        msg->header.frame_id = frame_id_;
+									        map_pub_[i].publish(msg);
+								        }
+							        }
+						        }
 					        });
 
 					    double update_time =
@@ -302,7 +299,7 @@ void Server::mapConnectCallback(ros::SingleSubscriberPublisher const &pub, int d
 			    auto start = std::chrono::steady_clock::now();
 
 			    ufomap_msgs::UFOMapStamped::Ptr msg(new ufomap_msgs::UFOMapStamped);
-			    if (ufomap_msgs::ufoToMsg(map, msg->map, compress_, depth)) {
+			    if (ufomap_msgs::ufoToMsg(*snapshot(map), msg->map, compress_, depth)) {
 				    msg->header.stamp = ros::Time::now();
 				    msg->header.frame_id = frame_id_;
 				    pub.publish(msg);
@@ -332,7 +329,7 @@ bool Server::getMapCallback(ufomap_srvs::GetMap::Request &request,
 		    if constexpr (!std::is_same_v<std::decay_t<decltype(map)>, std::monostate>) {
 			    ufo::geometry::BoundingVolume bv =
 			        ufomap_msgs::msgToUfo(request.bounding_volume);
-			    response.success = ufomap_msgs::ufoToMsg(map, response.map, bv,
+			    response.success = ufomap_msgs::ufoToMsg(*snapshot(map), response.map, bv,
 			                                             request.compress, request.depth);
 		    } else {
 			    response.success = false;
@@ -350,6 +347,7 @@ bool Server::clearVolumeCallback(ufomap_srvs::ClearVolume::Request &request,
 		    if constexpr (!std::is_same_v<std::decay_t<decltype(map)>, std::monostate>) {
 			    ufo::geometry::BoundingVolume bv =
 			        ufomap_msgs::msgToUfo(request.bounding_volume);
+			    std::lock_guard<std::mutex> lock(map_mutex_);
 			    for (auto &b : bv) {
 				    map.setValueVolume(b, map.getClampingThresMin(), request.depth);
 			    }
@@ -368,6 +366,7 @@ bool Server::resetCallback(ufomap_srvs::Reset::Request &request,
 	std::visit(
 	    [this, &request, &response](auto &map) {
 		    if constexpr (!std::is_same_v<std::decay_t<decltype(map)>, std::monostate>) {
+			    std::lock_guard<std::mutex> lock(map_mutex_);
 			    map.clear(request.new_resolution, request.new_depth_levels);
 			    response.success = true;
 		    } else {
@@ -386,8 +385,9 @@ bool Server::saveMapCallback(ufomap_srvs::SaveMap::Request &request,
 		    if constexpr (!std::is_same_v<std::decay_t<decltype(map)>, std::monostate>) {
 			    ufo::geometry::BoundingVolume bv =
 			        ufomap_msgs::msgToUfo(request.bounding_volume);
-			    response.success = map.write(request.filename, bv, request.compress,
-			                                 request.depth, 1, request.compression_level);
+			    response.success =
+			        snapshot(map)->write(request.filename, bv, request.compress,
+			                             request.depth, 1, request.compression_level);
 		    } else {
 			    response.success = false;
 		    }
@@ -413,7 +413,7 @@ void Server::timerCallback(ros::TimerEvent const &event)
 						    auto start = std::chrono::steady_clock::now();
 
 						    ufomap_msgs::UFOMapStamped::Ptr msg(new ufomap_msgs::UFOMapStamped);
-						    if (ufomap_msgs::ufoToMsg(map, msg->map, compress_, i)) {
+						    if (ufomap_msgs::ufoToMsg(*snapshot(map), msg->map, compress_, i)) {
 							    msg->header = header;
 							    map_pub_[i].publish(msg);
 						    }
@@ -465,6 +465,7 @@ void Server::configCallback(ufomap_mapping::ServerConfig &config, uint32_t level
 	std::visit(
 	    [this, &config](auto &map) {
 		    if constexpr (!std::is_same_v<std::decay_t<decltype(map)>, std::monostate>) {
+			    std::lock_guard<std::mutex> lock(map_mutex_);
 			    map.setProbHit(config.prob_hit);
 			    map.setProbMiss(config.prob_miss);
 			    map.setClampingThresMin(config.clamping_thres_min);
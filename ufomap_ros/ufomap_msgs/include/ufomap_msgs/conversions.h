@@ -66,6 +66,7 @@
 #include <ufomap_msgs/UFOMap.h>
 
 // STD
+#include <sstream>
 #include <type_traits>
 
 namespace ufomap_msgs
@@ -122,15 +123,25 @@ ufomap_msgs::BoundingVolume ufoToMsg(
 template <typename TreeType>
 bool msgToUfo(ufomap_msgs::UFOMap const& msg, TreeType& tree)
 {
+	if (msg.data.empty()) {
+		return false;
+	}
+
+	if (!msg.info.compressed) {
+		// Read straight from the message
+		return tree.readData(msg.data.data(), msg.data.size(),
+		                     msgToUfo(msg.info.bounding_volume), msg.info.resolution,
+		                     msg.info.depth_levels);
+	}
+
 	std::stringstream data_stream(std::ios_base::in | std::ios_base::out |
 	                              std::ios_base::binary);
-	if (!msg.data.empty()) {
-		data_stream.write((char const*)&msg.data[0], msg.data.size());
-		return tree.readData(data_stream, msgToUfo(msg.info.bounding_volume),
-		                     msg.info.resolution, msg.info.depth_levels,
-		                     msg.info.uncompressed_data_size, msg.info.compressed);
-	}
-	return false;
+	data_stream.write((char const*)&msg.data[0], msg.data.size());
+	// Messages from older versions are compressed differently
+	return tree.readData(data_stream, msgToUfo(msg.info.bounding_volume),
+	                     msg.info.resolution, msg.info.depth_levels,
+	                     msg.info.uncompressed_data_size,
+	                     TreeType::getCompression(msg.info.version, msg.info.compressed));
 }
 
 //
@@ -171,6 +182,13 @@ bool ufoToMsg(TreeType const& tree, ufomap_msgs::UFOMap& msg,
 	msg.info.compressed = compress;
 	msg.info.bounding_volume = ufoToMsg(bounding_volume);
 
+	if (!compress) {
+		// Serialize straight into the message
+		msg.data.clear();
+		msg.info.uncompressed_data_size = tree.writeData(msg.data, bounding_volume, depth);
+		return 0 <= msg.info.uncompressed_data_size;
+	}
+
 	std::stringstream data_stream(std::ios_base::in | std::ios_base::out |
 	                              std::ios_base::binary);
 	msg.info.uncompressed_data_size =
@@ -264,44 +264,55 @@ void UFOMapDisplay::update(float wall_dt, float ros_dt)
 
 					    ufo::geometry::AABB aabb_bbx(min_value, max_value);
 					    int min_depth = depth_property_->getInt();
-					    for (auto it = map.beginLeaves(aabb_bbx, render_type_[OCCUPIED]->getBool(),
-					                                   render_type_[FREE]->getBool(),
-					                                   render_type_[UNKNOWN]->getBool(), false,
-					                                   min_depth),
-					              end = map.endLeaves();
-					         it != end; ++it) {
+					    auto add_node = [&](auto const& node) {
 						    VoxelType type;
-						    if (it.isOccupied()) {
+						    if (node.isOccupied()) {
 							    type = OCCUPIED;
-						    } else if (it.isFree()) {
+						    } else if (node.isFree()) {
 							    type = FREE;
 						    } else {
 							    type = UNKNOWN;
 						    }
 
-						    ufo::geometry::AABB it_aabb = it.getBoundingVolume();
-						    ufo::map::Point3 it_min = it_aabb.getMin();
-						    ufo::map::Point3 it_max = it_aabb.getMax();
+						    ufo::geometry::AABB node_aabb = node.getBoundingVolume();
+						    ufo::map::Point3 node_min = node_aabb.getMin();
+						    ufo::map::Point3 node_max = node_aabb.getMax();
 
 						    if (min_coord.contains(type)) {
 							    for (int i : {0, 1, 2}) {
-								    min_coord[type][i] = std::min(min_coord[type][i], it_min[i]);
-								    max_coord[type][i] = std::max(max_coord[type][i], it_max[i]);
+								    min_coord[type][i] = std::min(min_coord[type][i], node_min[i]);
+								    max_coord[type][i] = std::max(max_coord[type][i], node_max[i]);
 							    }
 						    } else {
-							    min_coord[type] = it_min;
-							    max_coord[type] = it_max;
+							    min_coord[type] = node_min;
+							    max_coord[type] = node_max;
 						    }
 
 						    rviz::PointCloud::Point point;
 						    if constexpr (std::is_same_v<T, ufo::map::OccupancyMapColor>) {
-							    point.setColor(it->color.r / 255.0, it->color.g / 255.0,
-							                   it->color.b / 255.0, it.getOccupancy());
+							    point.setColor(node->color.r / 255.0, node->color.g / 255.0,
+							                   node->color.b / 255.0, node.getOccupancy());
 						    }
 
 						    addPoint(points, probabilities, aabb_bbx, type, min_depth, point,
-						             it.getOccupancy(), it.getDepth(), it.getBoundingVolume());
-					    }
+						             node.getOccupancy(), node.getDepth(), node_aabb);
+					    };
+
+					    // The rendered spaces are fixed at compile time for the traversal
+					    ufo::map::selectSpace(
+					        render_type_[OCCUPIED]->getBool(), render_type_[FREE]->getBool(),
+					        render_type_[UNKNOWN]->getBool(),
+					        [&](auto occupied, auto free, auto unknown) {
+						        using Predicate =
+						            ufo::map::TraversePredicate<decltype(occupied)::value,
+						                                        decltype(free)::value,
+						                                        decltype(unknown)::value, true, false,
+						                                        ufo::geometry::AABB>;
+						        ufo::map::traverse(
+						            map,
+						            Predicate{static_cast<ufo::map::DepthType>(min_depth), aabb_bbx},
+						            add_node);
+					        });
 
 					    for (VoxelType const& type : points.keys()) {
 						    if (OCCUPIED != type ||